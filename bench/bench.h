@@ -0,0 +1,75 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/compiler.h"
+#include "core/hash_table.h"
+#include "core/mono_time.h"
+#include "core/types.h"
+
+#if M_compiler_is_msvc()
+#  include <intrin.h>
+#endif
+
+// A benchmark is a function that does its work |m_iteration_count| times:
+//   void hash_map_insert_bench(Bench_t* bench) {
+//     ...setup...
+//     bench->start_timer();
+//     for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+//       ...
+//     }
+//     bench->stop_timer();
+//   }
+// The whole call is timed if start_timer() is never called.
+// A benchmark that processes data can set |m_bytes_per_iteration| to also report the throughput.
+// The iteration count is picked so a run takes long enough to be measured, then the benchmark is run a few times and the statistics of the time per iteration are reported.
+
+class Bench_t {
+public:
+  void start_timer() {
+    m_is_timer_used = true;
+    m_start = mono_time_now();
+  }
+
+  void stop_timer() { m_elapsed += mono_time_now() - m_start; }
+
+  S64 m_iteration_count = 1;
+  S64 m_bytes_per_iteration = 0;
+  bool m_is_timer_used = false;
+  S64 m_start = 0;
+  S64 m_elapsed = 0;
+};
+
+typedef void (*Bench_func_t)(Bench_t* bench);
+
+#define M_register_bench(func) \
+  extern void func(Bench_t*); \
+  benches[#func] = func
+
+#if M_compiler_is_msvc()
+extern volatile const void* g_bench_sink_;
+#endif
+
+// Makes the compiler think that |value| is used so the code that computes it isn't removed.
+template <typename T>
+inline void bench_do_not_optimize(const T& value) {
+#if M_compiler_is_msvc()
+  g_bench_sink_ = &value;
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// Makes the compiler think that all memory is read and written so the stores before it aren't removed.
+inline void bench_clobber_memory() {
+#if M_compiler_is_msvc()
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : : "memory");
+#endif
+}
@@ -0,0 +1,77 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/bc.h"
+
+#include "bench/bench.h"
+#include "core/core_allocators.h"
+#include "core/dynamic_array.h"
+#include "core/utils.h"
+
+// Compressing a 512x512 RGBA8 image of noisy gradients, in MB of input pixels per second.
+// BC7 is slow enough that a bigger image would only make the runs longer.
+
+static const int sc_bc_bench_size = 512;
+
+typedef bool (*Bc_encode_func_t_)(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format, E_bc_quality quality);
+
+static void bc_encode_bench_(Bench_t* bench, Bc_encode_func_t_ encode, E_bc_format format, E_bc_quality quality) {
+  Dynamic_array_t<U8> src(g_persistent_allocator);
+  Dynamic_array_t<U8> dst(g_persistent_allocator);
+  M_scope_exit(src.destroy());
+  M_scope_exit(dst.destroy());
+  src.resize(sc_bc_bench_size * sc_bc_bench_size * 4);
+  dst.resize(bc_get_size(format, sc_bc_bench_size, sc_bc_bench_size));
+  U32 seed = 1;
+  for (int y = 0; y < sc_bc_bench_size; ++y) {
+    for (int x = 0; x < sc_bc_bench_size; ++x) {
+      U8* p = src.m_p + (y * sc_bc_bench_size + x) * 4;
+      for (int c = 0; c < 4; ++c) {
+        seed = seed * 1664525 + 1013904223;
+        p[c] = ((x * (c + 1) + y * (3 - c)) >> 3) + (seed >> 28);
+      }
+    }
+  }
+  bench->m_bytes_per_iteration = src.len();
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    encode(src.m_p, sc_bc_bench_size, sc_bc_bench_size, dst.m_p, format, quality);
+    bench_do_not_optimize(dst.m_p);
+  }
+  bench->stop_timer();
+}
+
+void bc1_encode_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode, e_bc_format_bc1, e_bc_quality_normal);
+}
+
+void bc1_encode_scalar_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode_scalar, e_bc_format_bc1, e_bc_quality_normal);
+}
+
+void bc4_encode_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode, e_bc_format_bc4, e_bc_quality_normal);
+}
+
+void bc5_encode_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode, e_bc_format_bc5, e_bc_quality_normal);
+}
+
+void bc7_encode_fastest_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode, e_bc_format_bc7, e_bc_quality_fastest);
+}
+
+void bc7_encode_fast_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode, e_bc_format_bc7, e_bc_quality_fast);
+}
+
+void bc7_encode_normal_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode, e_bc_format_bc7, e_bc_quality_normal);
+}
+
+void bc7_encode_normal_scalar_bench(Bench_t* bench) {
+  bc_encode_bench_(bench, bc_encode_scalar, e_bc_format_bc7, e_bc_quality_normal);
+}
@@ -0,0 +1,69 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/hash_table.h"
+
+#include "bench/bench.h"
+#include "core/linear_allocator.h"
+#include "core/utils.h"
+
+#include <unordered_map>
+
+// Number of keys for the lookup benchmarks.
+static const int sc_key_count = 1 << 16;
+
+void hash_map_insert_bench(Bench_t* bench) {
+  Linear_allocator_t<> allocator("hash_map_insert_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  Hash_map_t<int, int> map(&allocator);
+  map.reserve(bench->m_iteration_count);
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    map[i] = i;
+  }
+  bench_clobber_memory();
+  bench->stop_timer();
+}
+
+void hash_map_lookup_bench(Bench_t* bench) {
+  Linear_allocator_t<> allocator("hash_map_lookup_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  Hash_map_t<int, int> map(&allocator);
+  map.reserve(sc_key_count);
+  for (int i = 0; i < sc_key_count; ++i) {
+    map[i] = i;
+  }
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    bench_do_not_optimize(map.find(i & (sc_key_count - 1)));
+  }
+  bench->stop_timer();
+}
+
+void std_unordered_map_insert_bench(Bench_t* bench) {
+  std::unordered_map<int, int, Hash_t<int>> map;
+  map.reserve(bench->m_iteration_count);
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    map[i] = i;
+  }
+  bench_clobber_memory();
+  bench->stop_timer();
+}
+
+void std_unordered_map_lookup_bench(Bench_t* bench) {
+  std::unordered_map<int, int, Hash_t<int>> map;
+  map.reserve(sc_key_count);
+  for (int i = 0; i < sc_key_count; ++i) {
+    map[i] = i;
+  }
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    auto it = map.find(i & (sc_key_count - 1));
+    bench_do_not_optimize(it);
+  }
+  bench->stop_timer();
+}
@@ -0,0 +1,63 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/mipmap.h"
+
+#include "bench/bench.h"
+#include "core/core_allocators.h"
+#include "core/dynamic_array.h"
+#include "core/utils.h"
+
+// Downsampling a 2048x2048 RGBA8 image to 1024x1024, in MB of input pixels per second.
+
+static const int sc_mip_bench_size = 2048;
+
+typedef bool (*Mip_downsample_func_t_)(const U8* src, U32 width, U32 height, U8* dst, E_format format, E_mip_filter filter, bool is_srgb);
+
+static void mip_downsample_bench_(Bench_t* bench, Mip_downsample_func_t_ downsample, E_mip_filter filter, bool is_srgb) {
+  Dynamic_array_t<U8> src(g_persistent_allocator);
+  Dynamic_array_t<U8> dst(g_persistent_allocator);
+  M_scope_exit(src.destroy());
+  M_scope_exit(dst.destroy());
+  src.resize(sc_mip_bench_size * sc_mip_bench_size * 4);
+  dst.resize(src.len() / 4);
+  U32 seed = 1;
+  for (Sip i = 0; i < src.len(); ++i) {
+    seed = seed * 1664525 + 1013904223;
+    src[i] = seed >> 24;
+  }
+  bench->m_bytes_per_iteration = src.len();
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    downsample(src.m_p, sc_mip_bench_size, sc_mip_bench_size, dst.m_p, e_format_r8g8b8a8_unorm, filter, is_srgb);
+    bench_do_not_optimize(dst.m_p);
+  }
+  bench->stop_timer();
+}
+
+void mip_box_bench(Bench_t* bench) {
+  mip_downsample_bench_(bench, mip_downsample, e_mip_filter_box, false);
+}
+
+void mip_box_scalar_bench(Bench_t* bench) {
+  mip_downsample_bench_(bench, mip_downsample_scalar, e_mip_filter_box, false);
+}
+
+void mip_box_srgb_bench(Bench_t* bench) {
+  mip_downsample_bench_(bench, mip_downsample, e_mip_filter_box, true);
+}
+
+void mip_kaiser_bench(Bench_t* bench) {
+  mip_downsample_bench_(bench, mip_downsample, e_mip_filter_kaiser, false);
+}
+
+void mip_kaiser_scalar_bench(Bench_t* bench) {
+  mip_downsample_bench_(bench, mip_downsample_scalar, e_mip_filter_kaiser, false);
+}
+
+void mip_kaiser_srgb_bench(Bench_t* bench) {
+  mip_downsample_bench_(bench, mip_downsample, e_mip_filter_kaiser, true);
+}
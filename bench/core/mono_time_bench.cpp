@@ -0,0 +1,15 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/mono_time.h"
+
+#include "bench/bench.h"
+
+void mono_time_now_bench(Bench_t* bench) {
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    bench_do_not_optimize(mono_time_now());
+  }
+}
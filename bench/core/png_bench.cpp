@@ -0,0 +1,145 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/png.h"
+
+#include "bench/bench.h"
+#include "core/core_allocators.h"
+#include "core/dynamic_array.h"
+#include "core/file.h"
+#include "core/linear_allocator.h"
+#include "core/loader/png_unfilter.h"
+#include "core/log.h"
+#include "core/path_utils.h"
+#include "core/utils.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "third_party/stb/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "third_party/stb/stb_image_write.h"
+
+// Decode throughput of Png_loader_t and stb_image on the same files, in MB of decoded pixels per second.
+// The generated image is compressed by stb_image_write which only writes fixed Huffman blocks,
+// assets/basecolor.png is written by a normal encoder so it's mostly dynamic Huffman blocks.
+
+static const int sc_generated_png_size = 2048;
+
+static void append_png_data_(void* context, void* data, int size) {
+  ((Dynamic_array_t<U8>*)context)->append_array((const U8*)data, size);
+}
+
+// Gradients with a bit of noise so it compresses about as well as a photo-like texture.
+static Dynamic_array_t<U8> create_generated_png_() {
+  Dynamic_array_t<U8> file(g_persistent_allocator);
+  Dynamic_array_t<U8> pixels(g_persistent_allocator);
+  pixels.resize(sc_generated_png_size * sc_generated_png_size * 4);
+  U32 seed = 1;
+  for (int y = 0; y < sc_generated_png_size; ++y) {
+    for (int x = 0; x < sc_generated_png_size; ++x) {
+      seed = seed * 1664525 + 1013904223;
+      U8* p = &pixels[(y * sc_generated_png_size + x) * 4];
+      p[0] = x / 8 + (seed >> 29);
+      p[1] = y / 8 + (seed >> 30);
+      p[2] = (x + y) / 16;
+      p[3] = 255;
+    }
+  }
+  stbi_write_png_to_func(append_png_data_, &file, sc_generated_png_size, sc_generated_png_size, 4, pixels.m_p, sc_generated_png_size * 4);
+  pixels.destroy();
+  return file;
+}
+
+// The files are created once and shared by all the runs.
+static const Dynamic_array_t<U8>& get_generated_png_() {
+  static const Dynamic_array_t<U8> sc_file = create_generated_png_();
+  return sc_file;
+}
+
+static const Dynamic_array_t<U8>& get_asset_png_() {
+  static const Dynamic_array_t<U8> sc_file = File_t::read_whole_file_as_binary(g_persistent_allocator, g_exe_dir.join(M_txt("assets/basecolor.png")).m_path);
+  return sc_file;
+}
+
+static void png_decode_bench_(Bench_t* bench, const Dynamic_array_t<U8>& file) {
+  M_check_log_return(file.len(), "No PNG to decode");
+  Linear_allocator_t<> allocator("png_decode_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    Png_loader_t png;
+    M_check(png.init(&allocator, file.m_p, file.len()));
+    bench->m_bytes_per_iteration = png.m_width * png.m_height * png.m_bytes_per_pixel;
+    bench_do_not_optimize(png.m_data);
+    png.destroy();
+  }
+  bench->stop_timer();
+}
+
+static void stb_png_decode_bench_(Bench_t* bench, const Dynamic_array_t<U8>& file) {
+  M_check_log_return(file.len(), "No PNG to decode");
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    int x, y, n;
+    stbi_uc* data = stbi_load_from_memory(file.m_p, file.len(), &x, &y, &n, 0);
+    M_check(data);
+    bench->m_bytes_per_iteration = x * y * n;
+    bench_do_not_optimize(data);
+    stbi_image_free(data);
+  }
+  bench->stop_timer();
+}
+
+void png_decode_generated_bench(Bench_t* bench) {
+  png_decode_bench_(bench, get_generated_png_());
+}
+
+void stb_png_decode_generated_bench(Bench_t* bench) {
+  stb_png_decode_bench_(bench, get_generated_png_());
+}
+
+void png_decode_asset_bench(Bench_t* bench) {
+  png_decode_bench_(bench, get_asset_png_());
+}
+
+void stb_png_decode_asset_bench(Bench_t* bench) {
+  stb_png_decode_bench_(bench, get_asset_png_());
+}
+
+typedef bool (*Unfilter_row_func_t_)(U8 filter_type, int bytes_per_pixel, const U8* filtered, const U8* prior, U8* row, int len);
+
+// Unfilters a 2048x2048 RGBA image with the rows cycling through Sub, Up, Average and Paeth.
+static void png_unfilter_bench_(Bench_t* bench, Unfilter_row_func_t_ unfilter_row) {
+  const int c_row_len = sc_generated_png_size * 4;
+  Dynamic_array_t<U8> filtered(g_persistent_allocator);
+  Dynamic_array_t<U8> image(g_persistent_allocator);
+  M_scope_exit(filtered.destroy());
+  M_scope_exit(image.destroy());
+  filtered.resize(c_row_len * sc_generated_png_size);
+  image.resize(c_row_len * sc_generated_png_size);
+  U32 seed = 1;
+  for (Sip i = 0; i < filtered.len(); ++i) {
+    seed = seed * 1664525 + 1013904223;
+    filtered[i] = seed >> 24;
+  }
+  bench->m_bytes_per_iteration = image.len();
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    for (int r = 0; r < sc_generated_png_size; ++r) {
+      U8* row = image.m_p + r * c_row_len;
+      unfilter_row(e_png_filter_sub + r % 4, 4, filtered.m_p + r * c_row_len, r ? row - c_row_len : NULL, row, c_row_len);
+    }
+    bench_do_not_optimize(image.m_p);
+  }
+  bench->stop_timer();
+}
+
+void png_unfilter_bench(Bench_t* bench) {
+  png_unfilter_bench_(bench, png_unfilter_row);
+}
+
+void png_unfilter_scalar_bench(Bench_t* bench) {
+  png_unfilter_bench_(bench, png_unfilter_row_scalar);
+}
@@ -0,0 +1,190 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/xml.h"
+
+#include "bench/bench.h"
+#include "core/core_allocators.h"
+#include "core/dynamic_array.h"
+#include "core/linear_allocator.h"
+#include "core/loader/xml_reader.h"
+#include "core/loader/xml_scan.h"
+#include "core/utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Parsing about 8 MB of generated COLLADA-like XML, in MB of XML per second.
+// Half of it is big float arrays and the other half is small nodes with attributes.
+
+static void append_str_(Dynamic_array_t<char>* xml, const char* str) {
+  xml->append_array(str, strlen(str));
+}
+
+static void create_xml_(Dynamic_array_t<char>* xml) {
+  U32 seed = 1;
+  char line[256];
+  append_str_(xml, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n");
+  append_str_(xml, "  <library_geometries>\n");
+  for (int i = 0; i < 64; ++i) {
+    snprintf(line, sizeof(line), "    <source id=\"mesh%d-positions\">\n      <float_array id=\"mesh%d-positions-array\" count=\"9000\">", i, i);
+    append_str_(xml, line);
+    for (int j = 0; j < 9000; ++j) {
+      seed = seed * 1664525 + 1013904223;
+      snprintf(line, sizeof(line), "%s%.5f", j ? " " : "", (S32)seed / 2147483648.0);
+      append_str_(xml, line);
+    }
+    append_str_(xml, "</float_array>\n    </source>\n");
+  }
+  append_str_(xml, "  </library_geometries>\n  <library_visual_scenes>\n");
+  for (int i = 0; xml->len() < 8 * 1024 * 1024; ++i) {
+    snprintf(line, sizeof(line), "    <node id=\"joint%d\" name=\"joint &amp; %d\" sid=\"joint%d\" type=\"JOINT\">\n      <matrix sid=\"transform\">1 0 0 %d 0 1 0 0 0 0 1 0 0 0 0 1</matrix>\n", i, i, i, i);
+    append_str_(xml, line);
+    append_str_(xml, "      <instance_controller url=\"#skin\"><skeleton>#root</skeleton></instance_controller>\n    </node>\n");
+  }
+  append_str_(xml, "  </library_visual_scenes>\n</COLLADA>\n");
+}
+
+void xml_parse_bench(Bench_t* bench) {
+  Dynamic_array_t<char> xml(g_persistent_allocator);
+  Dynamic_array_t<char> buffer(g_persistent_allocator);
+  M_scope_exit(xml.destroy());
+  M_scope_exit(buffer.destroy());
+  create_xml_(&xml);
+  buffer.resize(xml.len());
+  Linear_allocator_t<> allocator("xml_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  bench->m_bytes_per_iteration = xml.len();
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    // The parser writes into the buffer so it's restored each time.
+    memcpy(buffer.m_p, xml.m_p, xml.len());
+    Scope_allocator_t<> scope_allocator(&allocator);
+    Xml_t parser(&scope_allocator);
+    parser.init_in_situ(buffer.m_p, buffer.len());
+    bench_do_not_optimize(parser.m_root);
+  }
+  bench->stop_timer();
+}
+
+// The same XML pulled event by event through a 64 KB window instead of building the nodes.
+void xml_reader_bench(Bench_t* bench) {
+  Dynamic_array_t<char> xml(g_persistent_allocator);
+  M_scope_exit(xml.destroy());
+  create_xml_(&xml);
+  Linear_allocator_t<> allocator("xml_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  bench->m_bytes_per_iteration = xml.len();
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    Scope_allocator_t<> scope_allocator(&allocator);
+    Xml_reader_t reader(&scope_allocator);
+    reader.init(xml.m_p, xml.len());
+    S64 event_count = 0;
+    while (reader.next() < e_xml_event_end_document) {
+      ++event_count;
+    }
+    bench_do_not_optimize(event_count);
+    reader.destroy();
+  }
+  bench->stop_timer();
+}
+
+// The lookups of a loader on the parsed XML: the nodes of a tag in the whole document and in each big subtree, and the first
+// node of a tag in the small subtrees.
+template <bool T_use_index>
+static void xml_find_by_tag_bench_(Bench_t* bench) {
+  Dynamic_array_t<char> xml(g_persistent_allocator);
+  M_scope_exit(xml.destroy());
+  create_xml_(&xml);
+  Linear_allocator_t<> allocator("xml_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  Xml_t parser(&allocator);
+  parser.init_in_situ(xml.m_p, xml.len());
+  Xml_index_t index(&allocator);
+  index.init(parser.m_root);
+  const Xml_node_t* scenes = parser.m_root->m_children.last();
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    Scope_allocator_t<> scope_allocator(&allocator);
+    Xml_nodes_t nodes(&scope_allocator);
+    int count = 0;
+    if (T_use_index) {
+      index.find_all_by_tag(&nodes, parser.m_root, "float_array");
+      for (const Xml_node_t* node : parser.m_root->m_children) {
+        count += index.count_all_by_tag(node, "skeleton");
+      }
+      for (int j = 0; j < 1024; ++j) {
+        count += index.find_first_by_tag(scenes->m_children[j], "skeleton") != NULL;
+      }
+    } else {
+      parser.m_root->find_all_by_tag(&nodes, "float_array");
+      for (const Xml_node_t* node : parser.m_root->m_children) {
+        count += node->count_all_by_tag("skeleton");
+      }
+      for (int j = 0; j < 1024; ++j) {
+        count += scenes->m_children[j]->find_first_by_tag("skeleton") != NULL;
+      }
+    }
+    bench_do_not_optimize(count);
+    bench_do_not_optimize(nodes.len());
+  }
+  bench->stop_timer();
+}
+
+void xml_find_by_tag_bench(Bench_t* bench) {
+  xml_find_by_tag_bench_<false>(bench);
+}
+
+void xml_index_find_by_tag_bench(Bench_t* bench) {
+  xml_find_by_tag_bench_<true>(bench);
+}
+
+// Building the index of the parsed XML.
+void xml_index_init_bench(Bench_t* bench) {
+  Dynamic_array_t<char> xml(g_persistent_allocator);
+  M_scope_exit(xml.destroy());
+  create_xml_(&xml);
+  Linear_allocator_t<> allocator("xml_bench_allocator");
+  M_scope_exit(allocator.destroy());
+  Xml_t parser(&allocator);
+  parser.init_in_situ(xml.m_p, xml.len());
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    Scope_allocator_t<> scope_allocator(&allocator);
+    Xml_index_t index(&scope_allocator);
+    index.init(parser.m_root);
+    bench_do_not_optimize(index);
+  }
+  bench->stop_timer();
+}
+
+template <void (*T_scan)(const char*, Xml_scan_masks_t*)>
+static void xml_scan_bench_(Bench_t* bench) {
+  Dynamic_array_t<char> xml(g_persistent_allocator);
+  M_scope_exit(xml.destroy());
+  create_xml_(&xml);
+  Sip len = xml.len() & ~(Sip)63;
+  bench->m_bytes_per_iteration = len;
+  bench->start_timer();
+  for (S64 i = 0; i < bench->m_iteration_count; ++i) {
+    for (Sip j = 0; j < len; j += 64) {
+      Xml_scan_masks_t masks;
+      T_scan(xml.m_p + j, &masks);
+      bench_do_not_optimize(masks);
+    }
+  }
+  bench->stop_timer();
+}
+
+// Classifying every block of the same XML, the parser only classifies the blocks of the tags.
+void xml_scan_bench(Bench_t* bench) {
+  xml_scan_bench_<xml_scan_64>(bench);
+}
+
+void xml_scan_scalar_bench(Bench_t* bench) {
+  xml_scan_bench_<xml_scan_64_scalar>(bench);
+}
@@ -0,0 +1,177 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "bench/bench.h"
+#include "core/command_line.h"
+#include "core/core_allocators.h"
+#include "core/core_init.h"
+#include "core/dynamic_array.h"
+#include "core/linear_allocator.h"
+#include "core/log.h"
+#include "core/utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if M_compiler_is_msvc()
+volatile const void* g_bench_sink_ = NULL;
+#endif
+
+static const S64 sc_max_iteration_count = 1000000000;
+
+struct Bench_result_t_ {
+  const char* name;
+  S64 iteration_count;
+  int run_count;
+  // Time per iteration.
+  F64 min_ns;
+  F64 median_ns;
+  F64 p95_ns;
+  F64 mean_ns;
+  F64 stddev_ns;
+  // 0 if the benchmark doesn't set Bench_t::m_bytes_per_iteration.
+  F64 median_mb_per_s;
+};
+
+// Returns the time of the run.
+static S64 run_once_(Bench_func_t func, S64 iteration_count, S64* o_bytes_per_iteration = NULL) {
+  Bench_t bench;
+  bench.m_iteration_count = iteration_count;
+  S64 start = mono_time_now();
+  func(&bench);
+  S64 elapsed = mono_time_now() - start;
+  if (o_bytes_per_iteration) {
+    *o_bytes_per_iteration = bench.m_bytes_per_iteration;
+  }
+  return bench.m_is_timer_used ? bench.m_elapsed : elapsed;
+}
+
+// Grows the iteration count until a run takes at least |min_run_time|, the runs also warm up the caches.
+static S64 calibrate_(Bench_func_t func, S64 min_run_time) {
+  S64 iteration_count = 1;
+  while (true) {
+    S64 elapsed = run_once_(func, iteration_count);
+    if (elapsed >= min_run_time || iteration_count >= sc_max_iteration_count) {
+      return iteration_count;
+    }
+    // Aim a bit higher than |min_run_time| so the next run is likely long enough.
+    S64 next_count = elapsed > 0 ? (S64)(iteration_count * 1.4 * min_run_time / elapsed) : iteration_count * 100;
+    iteration_count = min(max(next_count, iteration_count + 1), min(iteration_count * 100, sc_max_iteration_count));
+  }
+}
+
+static Bench_result_t_ run_bench_(const char* name, Bench_func_t func, S64 min_run_time, int run_count, Dynamic_array_t<F64>* times) {
+  Bench_result_t_ rv = {};
+  rv.name = name;
+  rv.run_count = run_count;
+  rv.iteration_count = calibrate_(func, min_run_time);
+  S64 bytes_per_iteration = 0;
+  run_once_(func, rv.iteration_count, &bytes_per_iteration);
+  times->resize(run_count);
+  F64 sum = 0;
+  for (int i = 0; i < run_count; ++i) {
+    (*times)[i] = mono_time_to_us(run_once_(func, rv.iteration_count)) * 1000.0 / rv.iteration_count;
+    sum += (*times)[i];
+  }
+  std::sort(times->begin(), times->end());
+  rv.min_ns = (*times)[0];
+  rv.median_ns = run_count % 2 ? (*times)[run_count / 2] : ((*times)[run_count / 2 - 1] + (*times)[run_count / 2]) / 2;
+  rv.p95_ns = (*times)[max((int)ceil(run_count * 0.95) - 1, 0)];
+  rv.mean_ns = sum / run_count;
+  F64 variance = 0;
+  for (int i = 0; i < run_count; ++i) {
+    variance += ((*times)[i] - rv.mean_ns) * ((*times)[i] - rv.mean_ns);
+  }
+  rv.stddev_ns = run_count > 1 ? sqrt(variance / (run_count - 1)) : 0;
+  rv.median_mb_per_s = rv.median_ns > 0 ? bytes_per_iteration * 1000.0 / rv.median_ns : 0;
+  return rv;
+}
+
+int main(int argc, char** argv) {
+  core_init(M_txt("bench.log"));
+  // Only the benchmarks whose name contains the filter are run.
+  g_cl->register_flag(NULL, "--filter", e_value_type_string);
+  g_cl->register_flag(NULL, "--json", e_value_type_bool);
+  g_cl->register_flag(NULL, "--runs", e_value_type_string);
+  g_cl->register_flag(NULL, "--min-run-time-ms", e_value_type_string);
+  g_cl->parse(argc, argv);
+  log_set_levels_from_command_line();
+  const char* filter = g_cl->get_flag_value("--filter").m_const_string;
+  bool is_json = g_cl->get_flag_value("--json").get_bool();
+  const char* runs = g_cl->get_flag_value("--runs").m_const_string;
+  const char* min_run_time_ms = g_cl->get_flag_value("--min-run-time-ms").m_const_string;
+  int run_count = runs ? max(atoi(runs), 1) : 10;
+  S64 min_run_time = mono_time_from_s((min_run_time_ms ? max(atoi(min_run_time_ms), 1) : 20) / 1000.0);
+
+  Hash_map_t<const char*, Bench_func_t> benches(g_persistent_allocator);
+  M_register_bench(bc1_encode_bench);
+  M_register_bench(bc1_encode_scalar_bench);
+  M_register_bench(bc4_encode_bench);
+  M_register_bench(bc5_encode_bench);
+  M_register_bench(bc7_encode_fast_bench);
+  M_register_bench(bc7_encode_fastest_bench);
+  M_register_bench(bc7_encode_normal_bench);
+  M_register_bench(bc7_encode_normal_scalar_bench);
+  M_register_bench(hash_map_insert_bench);
+  M_register_bench(hash_map_lookup_bench);
+  M_register_bench(mip_box_bench);
+  M_register_bench(mip_box_scalar_bench);
+  M_register_bench(mip_box_srgb_bench);
+  M_register_bench(mip_kaiser_bench);
+  M_register_bench(mip_kaiser_scalar_bench);
+  M_register_bench(mip_kaiser_srgb_bench);
+  M_register_bench(mono_time_now_bench);
+  M_register_bench(png_decode_asset_bench);
+  M_register_bench(png_decode_generated_bench);
+  M_register_bench(png_unfilter_bench);
+  M_register_bench(png_unfilter_scalar_bench);
+  M_register_bench(stb_png_decode_asset_bench);
+  M_register_bench(stb_png_decode_generated_bench);
+  M_register_bench(std_unordered_map_insert_bench);
+  M_register_bench(std_unordered_map_lookup_bench);
+  M_register_bench(xml_find_by_tag_bench);
+  M_register_bench(xml_index_find_by_tag_bench);
+  M_register_bench(xml_index_init_bench);
+  M_register_bench(xml_parse_bench);
+  M_register_bench(xml_reader_bench);
+  M_register_bench(xml_scan_bench);
+  M_register_bench(xml_scan_scalar_bench);
+
+  Linear_allocator_t<> allocator("bench_allocator");
+  M_scope_exit(allocator.destroy());
+  Dynamic_array_t<F64> times(&allocator);
+  bool is_first = true;
+  if (is_json) {
+    printf("{\"benchmarks\":[");
+  }
+  for (auto& bench : benches) {
+    if (filter && !strstr(bench.key, filter)) {
+      continue;
+    }
+    Bench_result_t_ r = run_bench_(bench.key, bench.value, min_run_time, run_count, &times);
+    if (is_json) {
+      printf("%s\n  {\"name\":\"%s\",\"iterations\":%lld,\"runs\":%d,\"min_ns\":%.3f,\"median_ns\":%.3f,\"p95_ns\":%.3f,\"mean_ns\":%.3f,\"stddev_ns\":%.3f,\"median_mb_per_s\":%.3f}",
+             is_first ? "" : ",", r.name, (long long)r.iteration_count, r.run_count, r.min_ns, r.median_ns, r.p95_ns, r.mean_ns, r.stddev_ns, r.median_mb_per_s);
+    } else if (r.median_mb_per_s > 0) {
+      M_logi("%-32s median %10.3f ns  p95 %10.3f ns  min %10.3f ns  stddev %8.3f ns  %10.1f MB/s  (%lld iterations x %d runs)",
+             r.name, r.median_ns, r.p95_ns, r.min_ns, r.stddev_ns, r.median_mb_per_s, (long long)r.iteration_count, r.run_count);
+    } else {
+      M_logi("%-32s median %10.3f ns  p95 %10.3f ns  min %10.3f ns  stddev %8.3f ns  (%lld iterations x %d runs)",
+             r.name, r.median_ns, r.p95_ns, r.min_ns, r.stddev_ns, (long long)r.iteration_count, r.run_count);
+    }
+    is_first = false;
+  }
+  if (is_json) {
+    printf("\n]}\n");
+    fflush(stdout);
+  }
+  core_destroy();
+  return 0;
+}
@@ -0,0 +1,227 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/binary_log.h"
+
+#include "core/utils.h"
+
+#include <stdio.h>
+
+#include <atomic>
+
+// Maximum number of binary log call sites.
+#define M_binary_log_max_site_count_ 4096
+// Maximum length of a conversion specification.
+#define M_binary_log_max_spec_len_ 32
+
+struct Binary_log_site_t_ {
+  const char* file;
+  int line;
+  const char* format;
+  const E_binary_log_arg_* arg_types;
+  // Sizes of the arguments before they are stored as 8 bytes.
+  const U8* arg_sizes;
+  int arg_count;
+};
+
+// A parsed conversion specification, |start| points to '%'.
+struct Binary_log_spec_t_ {
+  const char* start;
+  const char* end;
+  // Where the length modifiers start (they are dropped when decoding).
+  const char* length_start;
+  char conversion;
+};
+
+// Id 0 is invalid.
+static Binary_log_site_t_ g_binary_log_sites_[M_binary_log_max_site_count_];
+static std::atomic<U32> g_binary_log_site_count_{1};
+
+// Finds the next conversion specification from |p|. Returns false if there is none.
+// "%%" is not a conversion specification and it's skipped.
+static bool find_next_spec_(Binary_log_spec_t_* o_spec, const char* p) {
+  while (true) {
+    p = strchr(p, '%');
+    if (!p) {
+      return false;
+    }
+    if (p[1] == '%') {
+      p += 2;
+      continue;
+    }
+    break;
+  }
+  o_spec->start = p++;
+  while (*p && strchr("-+ #0", *p)) {
+    ++p;
+  }
+  while (*p && (*p == '*' || *p == '.' || (*p >= '0' && *p <= '9'))) {
+    ++p;
+  }
+  o_spec->length_start = p;
+  while (*p && strchr("hlLqjzt", *p)) {
+    ++p;
+  }
+  o_spec->conversion = *p;
+  o_spec->end = *p ? p + 1 : p;
+  return true;
+}
+
+static bool is_conversion_valid_(E_binary_log_arg_ arg_type, char conversion) {
+  switch (arg_type) {
+  case e_binary_log_arg_integer:
+    return strchr("diuoxXc", conversion);
+  case e_binary_log_arg_float:
+    return strchr("fFeEgGaA", conversion);
+  case e_binary_log_arg_pointer:
+    return conversion == 'p';
+  case e_binary_log_arg_string:
+    return conversion == 's';
+  }
+  return false;
+}
+
+U32 binary_log_register_(const char* file, int line, const char* format, const E_binary_log_arg_* arg_types, const U8* arg_sizes, int arg_count) {
+  int spec_count = 0;
+  Binary_log_spec_t_ spec;
+  for (const char* p = format; find_next_spec_(&spec, p); p = spec.end) {
+    M_check_log_return_val(spec_count < arg_count, 0, "Binary log %s(%d) has more conversions than arguments", file, line);
+    M_check_log_return_val(spec.conversion && is_conversion_valid_(arg_types[spec_count], spec.conversion), 0, "Binary log %s(%d) has an invalid conversion for argument %d", file, line, spec_count);
+    M_check_log_return_val(!memchr(spec.start, '*', spec.end - spec.start), 0, "Binary log %s(%d) can't use '*' width or precision", file, line);
+    M_check_log_return_val(spec.end - spec.start < M_binary_log_max_spec_len_ - 3, 0, "Binary log %s(%d) has a too long conversion", file, line);
+    ++spec_count;
+  }
+  M_check_log_return_val(spec_count == arg_count, 0, "Binary log %s(%d) has more arguments than conversions", file, line);
+  U32 id = g_binary_log_site_count_.fetch_add(1, std::memory_order_relaxed);
+  M_check_log_return_val(id < M_binary_log_max_site_count_, 0, "Too many binary log call sites");
+  Binary_log_site_t_* site = &g_binary_log_sites_[id];
+  site->file = file;
+  site->line = line;
+  site->format = format;
+  site->arg_types = arg_types;
+  site->arg_sizes = arg_sizes;
+  site->arg_count = arg_count;
+  return id;
+}
+
+// Returns the size of the integer that the length modifiers in [from, to) read, 0 if there is none.
+static int get_length_modifier_size_(const char* from, const char* to) {
+  int len = to - from;
+  if (len == 2 && from[0] == 'h' && from[1] == 'h') {
+    return sizeof(char);
+  }
+  if (len == 2 && from[0] == 'l' && from[1] == 'l') {
+    return sizeof(long long);
+  }
+  if (len != 1) {
+    return 0;
+  }
+  switch (from[0]) {
+  case 'h':
+    return sizeof(short);
+  case 'l':
+    return sizeof(long);
+  case 'q':
+    return sizeof(long long);
+  case 'j':
+    return sizeof(intmax_t);
+  case 'z':
+    return sizeof(size_t);
+  case 't':
+    return sizeof(ptrdiff_t);
+  }
+  return 0;
+}
+
+// Appends the text in [from, to) to |out|, "%%" is converted to '%'.
+static void append_text_(char* out, int* len, int max_len, const char* from, const char* to) {
+  for (const char* c = from; c < to && *len < max_len; ++c) {
+    out[(*len)++] = *c;
+    if (*c == '%' && c + 1 < to && c[1] == '%') {
+      ++c;
+    }
+  }
+}
+
+int binary_log_decode_(char* out, int out_len, const U8* payload, Sip payload_len, const char* level_str, S64 start_time) {
+  U32 id;
+  S64 time;
+  memcpy(&id, payload, sizeof(id));
+  memcpy(&time, payload + sizeof(id), sizeof(time));
+  const U8* arg_p = payload + sizeof(id) + sizeof(time);
+  const U8* arg_end = payload + payload_len;
+  const Binary_log_site_t_* site = &g_binary_log_sites_[id];
+
+  // Leave space for the new line and the null character.
+  const int c_max_len = out_len - 2;
+  int len = snprintf(out, out_len, "%s(%d): %s: [%.6f] ", site->file, site->line, level_str, mono_time_to_s(time - start_time));
+  len = min(len, c_max_len);
+  Binary_log_spec_t_ spec;
+  const char* p = site->format;
+  for (int i = 0; i < site->arg_count && arg_p < arg_end && find_next_spec_(&spec, p); ++i) {
+    append_text_(out, &len, c_max_len, p, spec.start);
+    p = spec.end;
+    // Rebuild the specification without the length modifiers, then add the ones that match the stored argument.
+    char spec_format[M_binary_log_max_spec_len_];
+    int spec_len = spec.length_start - spec.start;
+    memcpy(spec_format, spec.start, spec_len);
+    int written = 0;
+    E_binary_log_arg_ arg_type = site->arg_types[i];
+    if (arg_type == e_binary_log_arg_string) {
+      U32 str_len;
+      memcpy(&str_len, arg_p, sizeof(str_len));
+      const char* str = (const char*)arg_p + sizeof(str_len);
+      arg_p += sizeof(str_len) + str_len + 1;
+      spec_format[spec_len++] = 's';
+      spec_format[spec_len] = 0;
+      written = snprintf(out + len, out_len - len, spec_format, str);
+    } else {
+      U64 v;
+      memcpy(&v, arg_p, sizeof(v));
+      arg_p += sizeof(v);
+      if (arg_type == e_binary_log_arg_float) {
+        F64 f;
+        memcpy(&f, &v, sizeof(f));
+        spec_format[spec_len++] = spec.conversion;
+        spec_format[spec_len] = 0;
+        written = snprintf(out + len, out_len - len, spec_format, f);
+      } else if (arg_type == e_binary_log_arg_pointer) {
+        spec_format[spec_len++] = 'p';
+        spec_format[spec_len] = 0;
+        written = snprintf(out + len, out_len - len, spec_format, (void*)(Uip)v);
+      } else if (spec.conversion == 'c') {
+        spec_format[spec_len++] = 'c';
+        spec_format[spec_len] = 0;
+        written = snprintf(out + len, out_len - len, spec_format, (int)v);
+      } else {
+        // printf reads an int without a length modifier, smaller arguments are promoted to it.
+        int size = get_length_modifier_size_(spec.length_start, spec.end - 1);
+        if (!size) {
+          size = max((int)site->arg_sizes[i], (int)sizeof(int));
+        }
+        if (size < (int)sizeof(v)) {
+          int shift = (sizeof(v) - size) * 8;
+          if (spec.conversion == 'd' || spec.conversion == 'i') {
+            v = (U64)((S64)(v << shift) >> shift);
+          } else {
+            v = (v << shift) >> shift;
+          }
+        }
+        spec_format[spec_len++] = 'l';
+        spec_format[spec_len++] = 'l';
+        spec_format[spec_len++] = spec.conversion;
+        spec_format[spec_len] = 0;
+        written = snprintf(out + len, out_len - len, spec_format, (long long)v);
+      }
+    }
+    len = min(len + written, c_max_len);
+  }
+  // The rest of the format after the last conversion.
+  append_text_(out, &len, c_max_len, p, p + strlen(p));
+  out[len++] = '\n';
+  out[len] = 0;
+  return len;
+}
@@ -0,0 +1,130 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/types.h"
+
+#include <string.h>
+
+#include <type_traits>
+
+// Binary logs defer the formatting to the log writer thread.
+// Each call site registers its file, line, format and argument types once (when it's first reached) and gets an id.
+// After that, a log only copies the id, a timestamp and the raw bytes of the arguments into the log ring.
+// Integers are stored as 8 bytes, floats as doubles and strings are copied with their length so they can be freed after the call.
+// The size of each integer argument is registered so it's truncated like printf would when it's decoded (%x of -1 is ffffffff).
+// Supported conversions: d, i, u, o, x, X, c, f, F, e, E, g, G, a, A, s, p (without '*' width or precision).
+
+enum E_binary_log_arg_ : U8 {
+  e_binary_log_arg_integer,
+  e_binary_log_arg_float,
+  e_binary_log_arg_pointer,
+  e_binary_log_arg_string,
+};
+
+// Returns 0 if the call site can't be registered.
+U32 binary_log_register_(const char* file, int line, const char* format, const E_binary_log_arg_* arg_types, const U8* arg_sizes, int arg_count);
+// Formats |payload| into |out| (null-terminated, ends with a new line), returns the length of the text.
+int binary_log_decode_(char* out, int out_len, const U8* payload, Sip payload_len, const char* level_str, S64 start_time);
+
+template <typename T_arg>
+constexpr E_binary_log_arg_ get_binary_log_arg_type_() {
+  // Arrays (string literals) decay to pointers.
+  using T = std::decay_t<T_arg>;
+  if constexpr (std::is_same_v<T, char*> || std::is_same_v<T, const char*>) {
+    return e_binary_log_arg_string;
+  } else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+    return e_binary_log_arg_pointer;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return e_binary_log_arg_float;
+  } else {
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "Unsupported binary log argument");
+    return e_binary_log_arg_integer;
+  }
+}
+
+template <typename T>
+Sip get_binary_log_arg_size_(const T& arg) {
+  if constexpr (get_binary_log_arg_type_<T>() == e_binary_log_arg_string) {
+    // Length + string + null. Arrays decay to a pointer first so the null check isn't always true for them.
+    const char* str = arg;
+    return sizeof(U32) + (str ? strlen(str) : 0) + 1;
+  } else {
+    return sizeof(U64);
+  }
+}
+
+template <typename T>
+U8* write_binary_log_arg_(U8* p, const T& arg) {
+  constexpr E_binary_log_arg_ c_type = get_binary_log_arg_type_<T>();
+  if constexpr (c_type == e_binary_log_arg_string) {
+    const char* str = arg;
+    U32 len = str ? strlen(str) : 0;
+    memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+    memcpy(p, str ? str : "", len + 1);
+    return p + len + 1;
+  } else if constexpr (c_type == e_binary_log_arg_float) {
+    F64 v = arg;
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+  } else if constexpr (c_type == e_binary_log_arg_pointer) {
+    U64 v = (Uip)arg;
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+  } else {
+    S64 v = (S64)arg;
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+  }
+}
+
+template <typename... T_args>
+void ng_log_binary_(E_log_level_ level, U32 id, const T_args&... args) {
+  if (!id) {
+    return;
+  }
+  const Sip c_payload_len = sizeof(U32) + sizeof(S64) + (Sip(0) + ... + get_binary_log_arg_size_(args));
+  U8* payload = log_begin_binary_record_(level, c_payload_len);
+  if (!payload) {
+    return;
+  }
+  S64 now = mono_time_now();
+  memcpy(payload, &id, sizeof(id));
+  memcpy(payload + sizeof(id), &now, sizeof(now));
+  U8* p = payload + sizeof(id) + sizeof(now);
+  ((p = write_binary_log_arg_(p, args)), ...);
+  log_end_binary_record_(payload);
+}
+
+template <typename... T_args>
+struct Binary_log_arg_types_t_ {
+  static constexpr int sc_count = sizeof...(T_args);
+  // The last element makes sure the array is never empty.
+  static constexpr E_binary_log_arg_ sc_types[] = {get_binary_log_arg_type_<T_args>()..., e_binary_log_arg_integer};
+  static constexpr U8 sc_sizes[] = {(U8)sizeof(T_args)..., 0};
+};
+
+// Only used in decltype() so the arguments of a binary log are not evaluated when it's registered.
+template <typename... T_args>
+Binary_log_arg_types_t_<std::decay_t<T_args>...> get_binary_log_arg_types_(const T_args&...);
+
+#define M_log_binary_(level, category, format, ...)                                                                         \
+  {                                                                                                                        \
+    if (M_log_is_enabled(level, category)) {                                                                               \
+      using zz_binary_log_arg_types = decltype(get_binary_log_arg_types_(__VA_ARGS__));                                    \
+      static const U32 zz_binary_log_id =                                                                                  \
+          binary_log_register_(__FILE__, __LINE__, format, zz_binary_log_arg_types::sc_types, zz_binary_log_arg_types::sc_sizes, zz_binary_log_arg_types::sc_count); \
+      ng_log_binary_(level, zz_binary_log_id, ##__VA_ARGS__);                                                              \
+    }                                                                                                                      \
+  }
+
+// Trace log, cheap enough to be used every frame.
+#define M_logct(category, format, ...) M_log_binary_(e_log_level_trace, category, format, ##__VA_ARGS__)
+#define M_logt(format, ...) M_logct(e_log_category_general, format, ##__VA_ARGS__)
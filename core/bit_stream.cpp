@@ -5,5 +5,25 @@
 //----------------------------------------------------------------------------//
 
 #include "core/bit_stream.h"
-#include "core/log.h"
 
+void Bit_stream_t::refill_slow_() {
+  while (m_bit_count < sc_min_bit_count_after_refill) {
+    if (m_p == m_end && m_next_data_func) {
+      const U8* data;
+      Sip len;
+      if (m_next_data_func(m_next_data_context, &data, &len)) {
+        m_data = data;
+        m_p = data;
+        m_end = data + len;
+        m_readable_len = len;
+        continue;
+      }
+      m_next_data_func = NULL;
+    }
+    // Zeros are shifted in after the end.
+    U64 byte = m_p < m_end ? *m_p : 0;
+    m_buffer |= byte << m_bit_count;
+    ++m_p;
+    m_bit_count += 8;
+  }
+}
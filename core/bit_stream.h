@@ -6,5 +6,97 @@
 
 #pragma once
 
+#include "core/log.h"
 #include "core/types.h"
 
+#include <string.h>
+
+// Reads bits from a byte array, the least significant bit of a byte is read first (like DEFLATE).
+// The bits are buffered in a 64-bit integer that is refilled with an unaligned 8-byte load, so there is no branch per bit or per byte.
+// The fast refill needs 8 readable bytes, the end of the data is refilled byte by byte unless the caller pads it with sc_padding zeros.
+// Reading past the end gives zeros and sets is_overrun().
+// The data can be split in parts (like the IDAT chunks of a PNG), the next part is requested from |next_data_func| when the current one runs out.
+class Bit_stream_t {
+public:
+  // Returns false if there isn't any more data.
+  typedef bool (*Next_data_func_t)(void* context, const U8** o_data, Sip* o_len);
+
+  // Zeros after the data that keep all the refills on the fast path.
+  static constexpr int sc_padding = 8;
+  // Number of bits that are always available after refill().
+  static constexpr int sc_min_bit_count_after_refill = 56;
+
+  // |padding| is the number of zeros after |len|, 0 or sc_padding. The parts from |next_data_func| don't have padding.
+  Bit_stream_t(const U8* data, Sip len, Sip padding = 0, Next_data_func_t next_data_func = NULL, void* next_data_context = NULL)
+      : m_data(data), m_p(data), m_end(data + len), m_readable_len(len + padding), m_next_data_func(next_data_func), m_next_data_context(next_data_context) {
+    refill();
+  }
+
+  // After this, at least sc_min_bit_count_after_refill bits can be peeked, skipped or consumed without refilling.
+  void refill() {
+    if (m_readable_len - (m_p - m_data) >= 8) {
+      U64 v;
+      memcpy(&v, m_p, sizeof(v));
+      m_buffer |= v << m_bit_count;
+      // Only the whole bytes that fit in the buffer are consumed.
+      m_p += (63 - m_bit_count) >> 3;
+      m_bit_count |= sc_min_bit_count_after_refill;
+    } else {
+      refill_slow_();
+    }
+  }
+
+  // These don't refill, |bit_count| must be <= the number of buffered bits.
+  U32 peek_lsb(int bit_count) const { return m_buffer & ((1ull << bit_count) - 1); }
+  void skip(int bit_count) {
+    m_buffer >>= bit_count;
+    m_bit_count -= bit_count;
+  }
+  U32 consume_lsb_no_refill(int bit_count) {
+    U32 rv = peek_lsb(bit_count);
+    skip(bit_count);
+    return rv;
+  }
+
+  // |bit_count| <= 32.
+  U32 consume_lsb(int bit_count) {
+    M_check(bit_count <= 32);
+    refill();
+    return consume_lsb_no_refill(bit_count);
+  }
+
+  // The first bit is the most significant bit of the result (Huffman codes in DEFLATE), |bit_count| <= 16.
+  U16 consume_msb(int bit_count) {
+    M_check(bit_count <= 16);
+    U16 rv = consume_lsb(bit_count);
+    rv = ((rv & 0xAAAA) >> 1) | ((rv & 0x5555) << 1);
+    rv = ((rv & 0xCCCC) >> 2) | ((rv & 0x3333) << 2);
+    rv = ((rv & 0xF0F0) >> 4) | ((rv & 0x0F0F) << 4);
+    rv = ((rv & 0xFF00) >> 8) | ((rv & 0x00FF) << 8);
+    return rv >> (16 - bit_count);
+  }
+
+  // Drops the bits until the next byte boundary.
+  void align_to_byte() { skip(m_bit_count & 7); }
+
+  // Number of bytes that have been consumed, including a partially consumed byte.
+  Sip get_consumed_byte_count() const { return (m_p - m_data) - m_bit_count / 8; }
+
+  // True if more bits were consumed than the data has (the last part if it's split).
+  bool is_overrun() const { return m_p > m_end && (m_p - m_end) * 8 > m_bit_count; }
+
+  const U8* m_data = NULL;
+  // The next byte that isn't in |m_buffer|, it can be past |m_end| after reading past the end.
+  const U8* m_p = NULL;
+  const U8* m_end = NULL;
+  // The data and the padding.
+  Sip m_readable_len = 0;
+  U64 m_buffer = 0;
+  int m_bit_count = 0;
+  // NULL if the data isn't split or the last part has been reached.
+  Next_data_func_t m_next_data_func = NULL;
+  void* m_next_data_context = NULL;
+
+private:
+  void refill_slow_();
+};
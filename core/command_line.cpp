@@ -21,6 +21,11 @@ void Command_line_t::init() {
   g_cl_ = Command_line_t(g_persistent_allocator);
   g_cl = &g_cl_;
   g_cl->register_flag(NULL, "--gpu", e_value_type_string);
+  // See log_set_levels().
+  g_cl->register_flag(NULL, "--log-level", e_value_type_string);
+  // See sampling_profiler_start_from_command_line().
+  g_cl->register_flag(NULL, "--sampling-profile", e_value_type_string);
+  g_cl->register_flag(NULL, "--sampling-profile-hz", e_value_type_string);
 }
 
 Command_line_t::Command_line_t(Allocator_t* allocator) : m_flags(allocator) {}
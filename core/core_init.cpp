@@ -10,9 +10,12 @@
 #include "core/core_allocators.h"
 #include "core/debug.h"
 #include "core/file.h"
+#include "core/job.h"
 #include "core/log.h"
 #include "core/mono_time.h"
 #include "core/path_utils.h"
+#include "core/profiler.h"
+#include "core/sampling_profiler.h"
 
 bool core_init(const Os_char* log_path) {
   bool rv = true;
@@ -23,11 +26,18 @@ bool core_init(const Os_char* log_path) {
   rv &= File_t::init();
   Path_t final_log_path = g_exe_dir.join(log_path);
   rv &= log_init(final_log_path.m_path);
+  M_logci(e_log_category_core, "mono_time source: %s, %.1f ns per mono_time_now()", mono_time_get_source(), mono_time_get_now_overhead_ns());
   rv &= debug_init();
+  rv &= profiler_init();
+  profiler_set_thread_name("main");
+  rv &= job_system_init();
   return rv;
 }
 
 void core_destroy() {
+  sampling_profiler_destroy();
+  job_system_destroy();
+  profiler_destroy();
   log_destroy();
   core_allocators_destroy();
   return;
@@ -28,5 +28,10 @@
 #endif
 
 bool debug_init();
+// Writes the return addresses of the current thread to |traces|, returns the number of addresses.
+int debug_capture_stack_trace(void** traces, int max_count);
+// Writes "<module>: <function>" of |address| to |buffer|.
+// Symbols are loaded once per module and cached so this is cheap enough to be called for every sample of a profiler.
+void debug_get_symbol_name(char* buffer, int len, const void* address);
 void debug_get_stack_trace(char* buffer, int len);
 bool debug_is_debugger_attached();
@@ -7,120 +7,244 @@
 #include "core/debug.h"
 
 #include "core/log.h"
+#include "core/sync.h"
+#include "core/types.h"
+#include "core/utils.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
+#include <cxxabi.h>
 #include <elf.h>
 #include <execinfo.h>
 #include <fcntl.h>
-#include <link.h> // For ElfW macro.
+#include <link.h> // For ElfW macro and dl_iterate_phdr.
 #include <linux/limits.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define M_max_sections_ 64
-#define M_max_symbols_ 2048
-#define M_max_symbol_name_length_ 256
+// Maximum number of loaded modules (the executable and shared libraries).
+#define M_debug_max_modules_ 256
 
-static void find_symbol_name(const char* path, size_t offset, char* out_symbol_name) {
-  out_symbol_name[0] = '\0';
-  int fd = open(path, O_RDONLY);
-  if (fd == -1) {
-    return;
+struct Elf_symbol_t_ {
+  // Offset from the load bias of the module.
+  Uip start;
+  Uip size;
+  const char* name;
+  // Set the first time the symbol is looked up.
+  const char* demangled_name;
+};
+
+// A loaded ELF module. Its symbol table is parsed on the first lookup, the names point into the mapped file.
+struct Elf_module_t_ {
+  char path[PATH_MAX];
+  Uip load_bias;
+  // Address range of the loaded segments.
+  Uip start;
+  Uip end;
+  bool is_parsed;
+  const U8* file;
+  Sz file_size;
+  Elf_symbol_t_* symbols;
+  int symbol_count;
+};
+
+static Elf_module_t_ g_debug_modules_[M_debug_max_modules_];
+static int g_debug_module_count_ = 0;
+// Guards the modules, symbolizing can happen on any thread.
+static Mutex_t g_debug_mutex_;
+
+static int add_module_(struct dl_phdr_info* info, size_t, void*) {
+  Uip start = (Uip)-1;
+  Uip end = 0;
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+    if (phdr->p_type == PT_LOAD) {
+      start = min(start, (Uip)(info->dlpi_addr + phdr->p_vaddr));
+      end = max(end, (Uip)(info->dlpi_addr + phdr->p_vaddr + phdr->p_memsz));
+    }
   }
-  ElfW(Ehdr) ehdr;
-  pread(fd, &ehdr, sizeof(ehdr), 0);
-  ElfW(Shdr) sections[M_max_sections_];
-  int remaining_sections = ehdr.e_shnum;
-  int read_sections = 0;
-  while (remaining_sections) {
-    int section_count = remaining_sections > M_max_sections_ ? M_max_sections_ : remaining_sections;
-    pread(fd, &sections, section_count * ehdr.e_shentsize, ehdr.e_shoff + read_sections * ehdr.e_shentsize);
-    remaining_sections -= section_count;
-    read_sections += section_count;
-    for (int i = 0; i < section_count; ++i) {
-      if (sections[i].sh_type == SHT_SYMTAB) {
-        ElfW(Shdr)* symtab = &sections[i];
-        int remaining_symbols = symtab->sh_size / symtab->sh_entsize;
-        int read_symbols = 0;
-        while (remaining_symbols) {
-          int symbol_count =
-              remaining_symbols > M_max_symbols_ ? M_max_symbols_ : remaining_symbols;
-          ElfW(Sym) symbols[M_max_symbols_];
-          pread(fd, &symbols, symbol_count * sizeof(ElfW(Sym)), symtab->sh_offset + read_symbols * sizeof(ElfW(Sym)));
-          remaining_symbols -= symbol_count;
-          read_symbols += symbol_count;
-          for (int j = 0; j < symbol_count; ++j) {
-            ElfW(Sym)* sym = &symbols[j];
-            if (sym->st_name && sym->st_size && sym->st_value <= offset && sym->st_value + sym->st_size > offset) {
-              ElfW(Shdr) strtab;
-              // symtab->sh_link is the index of the related string table header
-              // in the section header table.
-              pread(fd, &strtab, sizeof(strtab), ehdr.e_shoff + symtab->sh_link * ehdr.e_shentsize);
-              char symbol_name[M_max_symbol_name_length_];
-              pread(fd, &symbol_name, M_max_symbol_name_length_, strtab.sh_offset + sym->st_name);
-              memcpy(out_symbol_name, symbol_name, M_max_symbol_name_length_);
-              goto out;
-            }
-          }
-        }
+  if (start >= end) {
+    return 0;
+  }
+  for (int i = 0; i < g_debug_module_count_; ++i) {
+    if (g_debug_modules_[i].start == start && g_debug_modules_[i].load_bias == info->dlpi_addr) {
+      return 0;
+    }
+  }
+  if (g_debug_module_count_ == M_debug_max_modules_) {
+    return 1;
+  }
+  Elf_module_t_* module = &g_debug_modules_[g_debug_module_count_++];
+  *module = {};
+  module->load_bias = info->dlpi_addr;
+  module->start = start;
+  module->end = end;
+  // The executable doesn't have a name.
+  if (info->dlpi_name && info->dlpi_name[0]) {
+    snprintf(module->path, sizeof(module->path), "%s", info->dlpi_name);
+  } else {
+    Sip len = readlink("/proc/self/exe", module->path, sizeof(module->path) - 1);
+    module->path[len > 0 ? len : 0] = '\0';
+  }
+  return 0;
+}
+
+static Elf_module_t_* find_module_(Uip address) {
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < g_debug_module_count_; ++i) {
+      Elf_module_t_* module = &g_debug_modules_[i];
+      if (address >= module->start && address < module->end) {
+        return module;
       }
     }
+    // The module may be loaded after the last time we looked.
+    if (pass == 0) {
+      dl_iterate_phdr(add_module_, NULL);
+    }
+  }
+  return NULL;
+}
+
+// Maps the ELF file of |module| and sorts the function symbols by address.
+// Uses .symtab if it exists, otherwise .dynsym (stripped binaries).
+static void parse_module_(Elf_module_t_* module) {
+  module->is_parsed = true;
+  int fd = open(module->path, O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(ElfW(Ehdr))) {
+    close(fd);
+    return;
   }
-out:
+  void* file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
   close(fd);
+  if (file == MAP_FAILED) {
+    return;
+  }
+  module->file = (const U8*)file;
+  module->file_size = st.st_size;
+
+  const ElfW(Ehdr)* ehdr = (const ElfW(Ehdr)*)module->file;
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) || ehdr->e_shoff + (Sz)ehdr->e_shnum * ehdr->e_shentsize > module->file_size) {
+    return;
+  }
+  const ElfW(Shdr)* symtab = NULL;
+  for (int i = 0; i < ehdr->e_shnum; ++i) {
+    const ElfW(Shdr)* section = (const ElfW(Shdr)*)(module->file + ehdr->e_shoff + i * ehdr->e_shentsize);
+    if (section->sh_type == SHT_SYMTAB || (section->sh_type == SHT_DYNSYM && !symtab)) {
+      symtab = section;
+    }
+  }
+  if (!symtab || !symtab->sh_entsize || symtab->sh_link >= ehdr->e_shnum) {
+    return;
+  }
+  // sh_link is the index of the related string table header in the section header table.
+  const ElfW(Shdr)* strtab = (const ElfW(Shdr)*)(module->file + ehdr->e_shoff + symtab->sh_link * ehdr->e_shentsize);
+  if (symtab->sh_offset + symtab->sh_size > module->file_size || strtab->sh_offset + strtab->sh_size > module->file_size) {
+    return;
+  }
+  const ElfW(Sym)* syms = (const ElfW(Sym)*)(module->file + symtab->sh_offset);
+  const char* strings = (const char*)(module->file + strtab->sh_offset);
+  int sym_count = symtab->sh_size / symtab->sh_entsize;
+  module->symbols = (Elf_symbol_t_*)malloc(sym_count * sizeof(Elf_symbol_t_));
+  for (int i = 0; i < sym_count; ++i) {
+    const ElfW(Sym)* sym = &syms[i];
+    // ELF32_ST_TYPE and ELF64_ST_TYPE are the same.
+    if (ELF64_ST_TYPE(sym->st_info) != STT_FUNC || !sym->st_name || !sym->st_size || sym->st_name >= strtab->sh_size) {
+      continue;
+    }
+    module->symbols[module->symbol_count++] = {sym->st_value, sym->st_size, strings + sym->st_name, NULL};
+  }
+  std::sort(module->symbols, module->symbols + module->symbol_count, [](const Elf_symbol_t_& s1, const Elf_symbol_t_& s2) {
+    return s1.start < s2.start;
+  });
+}
+
+static Elf_symbol_t_* find_symbol_(Elf_module_t_* module, Uip offset) {
+  // The last symbol that starts at or before |offset|.
+  int lo = 0;
+  int hi = module->symbol_count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (module->symbols[mid].start <= offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return NULL;
+  }
+  Elf_symbol_t_* symbol = &module->symbols[lo - 1];
+  return offset < symbol->start + symbol->size ? symbol : NULL;
+}
+
+static const char* get_demangled_name_(Elf_symbol_t_* symbol) {
+  if (!symbol->demangled_name) {
+    int status = -1;
+    char* demangled = NULL;
+    if (symbol->name[0] == '_' && symbol->name[1] == 'Z') {
+      demangled = abi::__cxa_demangle(symbol->name, NULL, NULL, &status);
+    }
+    symbol->demangled_name = status == 0 ? demangled : symbol->name;
+  }
+  return symbol->demangled_name;
 }
 
 bool debug_init() {
+  // backtrace() loads libgcc the first time it's called, do it now instead of in the middle of a crash or a signal handler.
+  void* trace;
+  backtrace(&trace, 1);
   return true;
 }
 
+int debug_capture_stack_trace(void** traces, int max_count) {
+  return backtrace(traces, max_count);
+}
+
+void debug_get_symbol_name(char* buffer, int len, const void* address) {
+  Scope_lock_t lock(&g_debug_mutex_);
+  Elf_module_t_* module = find_module_((Uip)address);
+  const char* path = "??";
+  const char* symbol_name = "";
+  if (module) {
+    path = module->path;
+    if (!module->is_parsed) {
+      parse_module_(module);
+    }
+    Elf_symbol_t_* symbol = find_symbol_(module, (Uip)address - module->load_bias);
+    if (symbol) {
+      symbol_name = get_demangled_name_(symbol);
+    }
+  }
+  snprintf(buffer, len, "%s: %s", path, symbol_name);
+}
+
 void debug_get_stack_trace(char* buffer, int len) {
   memset(buffer, 0, len);
   M_check_return(len <= M_max_stack_trace_length_);
   void* traces[M_max_traces_];
-  int count = backtrace((void**)traces, M_max_traces_);
-  char** symbols = backtrace_symbols(traces, count);
-  if (!symbols) {
-    return;
-  }
-  size_t buf_remaning_size = len - 1;
-  for (int i = 0; i < count; ++i) {
-    char* symbol = symbols[i];
-    char path[PATH_MAX];
-    // symbol looks like this:
-    // /usr/lib/libc.so.6(__libc_start_main+0xf3) [0x7f7d878f7023]
-
-    // find '('
-    const char* end_of_path = (const char*)memchr((void*)symbol, '(', strlen(symbol));
-    size_t path_len = end_of_path - symbol;
-    memcpy(path, symbol, path_len);
-    path[path_len] = '\0';
-    // Check if the symbol name exists.
-    char symbol_name[M_max_symbol_name_length_];
-    symbol_name[0] = '\0';
-    if (end_of_path[1] != ')') {
-      if (end_of_path[1] != '+') {
-        const char* end_of_symbol_name = (const char*)memchr((void*)end_of_path, '+', strlen(end_of_path));
-        int symbol_len = end_of_symbol_name - end_of_path - 1;
-        memcpy(&symbol_name, end_of_path + 1, symbol_len);
-        symbol_name[symbol_len] = '\0';
-      } else {
-        const char* start_of_offset = (const char*)memchr((void*)end_of_path, 'x', strlen(end_of_path));
-        size_t offset; sscanf(start_of_offset + 1, "%lx", &offset); find_symbol_name(path, offset, symbol_name);
-      }
-    }
-    int written = snprintf(buffer, buf_remaning_size, "%s: %s\n", path, symbol_name);
+  int count = debug_capture_stack_trace(traces, M_max_traces_);
+  int remaining_size = len;
+  for (int i = 0; i < count && remaining_size > 1; ++i) {
+    // A return address may be past the end of its function if the last instruction is a call, look up the call instead.
+    debug_get_symbol_name(buffer, remaining_size, (const U8*)traces[i] - 1);
+    int written = strlen(buffer);
     buffer += written;
-    buf_remaning_size -= written;
-    if (!buf_remaning_size) {
-      break;
+    remaining_size -= written;
+    if (remaining_size > 1) {
+      *buffer++ = '\n';
+      --remaining_size;
     }
   }
-  free(symbols);
 }
 
 bool debug_is_debugger_attached() {
@@ -19,6 +19,30 @@ bool debug_init() {
   return true;
 }
 
+int debug_capture_stack_trace(void** traces, int max_count) {
+  return CaptureStackBackTrace(0, max_count, traces, NULL);
+}
+
+void debug_get_symbol_name(char* buffer, int len, const void* address) {
+  // DbgHelp caches the symbols of each module after SymInitialize().
+  char symbol_buffer[sizeof(SYMBOL_INFO) + M_max_symbol_length_ * sizeof(TCHAR)] = {};
+  PSYMBOL_INFO symbol_info = (PSYMBOL_INFO)symbol_buffer;
+  symbol_info->SizeOfStruct = sizeof(SYMBOL_INFO);
+  symbol_info->MaxNameLen = M_max_symbol_length_ - 1;
+  DWORD64 displacement = 0;
+  HANDLE current_process = GetCurrentProcess();
+  char module_path[MAX_PATH] = "??";
+  HMODULE module = NULL;
+  if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR)address, &module)) {
+    GetModuleFileNameA(module, module_path, MAX_PATH);
+  }
+  if (SymFromAddr(current_process, (DWORD64)address, &displacement, symbol_info)) {
+    snprintf(buffer, len, "%s: %s", module_path, symbol_info->Name);
+  } else {
+    snprintf(buffer, len, "%s: ", module_path);
+  }
+}
+
 void debug_get_stack_trace(char* buffer, int len) {
   // TODO: mutex
   // std::lock_guard<std::mutex> lk(g_mutex);
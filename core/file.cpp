@@ -187,6 +187,11 @@ bool File_t::write(Sip* bytes_written, const void* in, Sip size) {
   return true;
 }
 
+bool File_t::write_v(Sip* bytes_written, const File_iovec_t* vecs, int vec_count) {
+  flush();
+  return write_v_plat_(bytes_written, vecs, vec_count);
+}
+
 void File_t::seek(enum E_file_from from, Sip distance) {
   File_buffer_t* fbuf = m_internal_buffer;
   if (!fbuf) {
@@ -30,6 +30,12 @@ enum E_file_from {
 class Allocator_t;
 struct File_buffer_t;
 
+// A chunk of memory to be written by File_t::write_v.
+struct File_iovec_t {
+  const void* p;
+  Sip len;
+};
+
 class File_t {
 public:
   static bool init();
@@ -45,6 +51,8 @@ public:
   bool read(void* buffer, Sip* bytes_read, Sip size);
   bool read_line(char* buffer, Sip size);
   bool write(Sip* bytes_written, const void* in, Sip size);
+  // Flushes the internal buffer then writes all |vecs| with as few system calls as possible.
+  bool write_v(Sip* bytes_written, const File_iovec_t* vecs, int vec_count);
   void seek(enum E_file_from from, Sip distance);
   void flush();
 
@@ -71,5 +79,6 @@ private:
 
   bool read_plat_(void* buffer, Sip* bytes_read, Sip size);
   bool write_plat_(Sip* bytes_written, const void* buffer, Sip size);
+  bool write_v_plat_(Sip* bytes_written, const File_iovec_t* vecs, int vec_count);
   void seek_plat_(E_file_from from, Sip distance);
 };
@@ -7,11 +7,14 @@
 #include "core/file.h"
 
 #include "core/log.h"
+#include "core/utils.h"
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 void File_t::delete_path(const char* path) {
@@ -68,6 +71,25 @@ bool File_t::write_plat_(Sip* bytes_written, const void* buffer, Sip size) {
   return true;
 }
 
+bool File_t::write_v_plat_(Sip* bytes_written, const File_iovec_t* vecs, int vec_count) {
+  M_check_return_val(is_valid(), false);
+  static_assert(sizeof(File_iovec_t) == sizeof(struct iovec), "File_iovec_t has to match iovec");
+  Sip total_bytes_written = 0;
+  while (vec_count) {
+    int count = vec_count > IOV_MAX ? IOV_MAX : vec_count;
+    Sip rv = ::writev(m_handle, (const struct iovec*)vecs, count);
+    if (rv == -1) {
+      maybe_assign(bytes_written, total_bytes_written);
+      return false;
+    }
+    total_bytes_written += rv;
+    vecs += count;
+    vec_count -= count;
+  }
+  maybe_assign(bytes_written, total_bytes_written);
+  return true;
+}
+
 void File_t::seek_plat_(E_file_from from, Sip distance) {
   M_check_return(is_valid());
   int whence;
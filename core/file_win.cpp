@@ -73,6 +73,22 @@ bool File_t::write_plat_(Sip* bytes_written, const void* buffer, Sip size) {
   return rv;
 }
 
+bool File_t::write_v_plat_(Sip* bytes_written, const File_iovec_t* vecs, int vec_count) {
+  M_check_return_val(is_valid(), false);
+  // There is no gather write for non-overlapped files, so just write them one by one.
+  Sip total_bytes_written = 0;
+  for (int i = 0; i < vec_count; ++i) {
+    DWORD bytes_written_plat = 0;
+    if (!WriteFile(m_handle, vecs[i].p, vecs[i].len, &bytes_written_plat, NULL)) {
+      maybe_assign(bytes_written, total_bytes_written);
+      return false;
+    }
+    total_bytes_written += bytes_written_plat;
+  }
+  maybe_assign(bytes_written, total_bytes_written);
+  return true;
+}
+
 void File_t::seek_plat_(E_file_from from, Sip distance) {
   M_check_return(is_valid());
   DWORD move_method;
@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/frame_stats.h"
+
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/utils.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <bit>
+
+// Times below |gc_sub_bucket_count_| have their own bucket. The others are bucketed by their highest bit and the
+// |gc_sub_bucket_bits_| bits after it, so a bucket is at most 1/32 of its lowest time wide.
+static constexpr int gc_sub_bucket_bits_ = 5;
+static constexpr int gc_sub_bucket_count_ = 1 << gc_sub_bucket_bits_;
+static constexpr int gc_bucket_count_ = (64 - gc_sub_bucket_bits_) * gc_sub_bucket_count_;
+
+static int get_bucket_(S64 t) {
+  U64 v = max(t, (S64)0);
+  if (v < (U64)gc_sub_bucket_count_) {
+    return (int)v;
+  }
+  int high_bit = std::bit_width(v) - 1;
+  int shift = high_bit - gc_sub_bucket_bits_;
+  return (shift + 1) * gc_sub_bucket_count_ + (int)((v >> shift) & (gc_sub_bucket_count_ - 1));
+}
+
+// The middle of the bucket.
+static S64 get_bucket_time_(int bucket) {
+  if (bucket < gc_sub_bucket_count_) {
+    return bucket;
+  }
+  int shift = bucket / gc_sub_bucket_count_ - 1;
+  S64 low = (S64)(gc_sub_bucket_count_ + bucket % gc_sub_bucket_count_) << shift;
+  return low + ((S64)1 << shift) / 2;
+}
+
+bool Frame_stats_t::init(const char* const* channel_names, int channel_count, int window_size, const Os_char* csv_path) {
+  M_check_return_val(channel_count > 0, false);
+  m_channel_names = channel_names;
+  m_channel_count = channel_count;
+  m_window_size = window_size;
+  m_frame_count = 0;
+  // Everything is allocated here so adding frames never allocates.
+  if (m_window_size > 0) {
+    m_window_values.resize((Sip)m_window_size * m_channel_count);
+    m_scratch.resize(m_window_size);
+  }
+  m_runs.resize(m_channel_count);
+  for (Frame_stat_run_t_& run : m_runs) {
+    run = {INT64_MAX, INT64_MIN, 0};
+  }
+  m_histogram.resize((Sip)gc_bucket_count_ * m_channel_count);
+  memset(m_histogram.m_p, 0, m_histogram.len() * sizeof(U32));
+  if (csv_path) {
+    M_check_log_return_val(m_csv_file.open(csv_path, e_file_mode_write), false, "Can't open the frame stats CSV file");
+    m_has_csv_file = true;
+    m_csv_file.write(NULL, "frame", 5);
+    for (int i = 0; i < m_channel_count; ++i) {
+      char buffer[128];
+      int len = snprintf(buffer, sizeof(buffer), ",%s_ms", m_channel_names[i]);
+      m_csv_file.write(NULL, buffer, len);
+    }
+    m_csv_file.write(NULL, "\n", 1);
+  }
+  return true;
+}
+
+void Frame_stats_t::destroy() {
+  if (m_frame_count) {
+    log_summary_("Frame stats of the whole run", 0, m_frame_count, true);
+  }
+  if (m_has_csv_file) {
+    m_csv_file.close();
+    m_has_csv_file = false;
+  }
+  m_window_values.destroy();
+  m_scratch.destroy();
+  m_runs.destroy();
+  m_histogram.destroy();
+}
+
+void Frame_stats_t::add_frame(const S64* times) {
+  for (int i = 0; i < m_channel_count; ++i) {
+    if (m_window_size > 0) {
+      m_window_values[(m_frame_count % m_window_size) * m_channel_count + i] = times[i];
+    }
+    Frame_stat_run_t_& run = m_runs[i];
+    run.min = min(run.min, times[i]);
+    run.max = max(run.max, times[i]);
+    run.sum += times[i];
+    ++m_histogram[(Sip)i * gc_bucket_count_ + get_bucket_(times[i])];
+  }
+  if (m_has_csv_file) {
+    char buffer[64];
+    int len = snprintf(buffer, sizeof(buffer), "%lld", (long long)m_frame_count);
+    m_csv_file.write(NULL, buffer, len);
+    for (int i = 0; i < m_channel_count; ++i) {
+      len = snprintf(buffer, sizeof(buffer), ",%.4f", mono_time_to_ms(times[i]));
+      m_csv_file.write(NULL, buffer, len);
+    }
+    m_csv_file.write(NULL, "\n", 1);
+  }
+  ++m_frame_count;
+  if (m_window_size > 0 && m_frame_count % m_window_size == 0) {
+    log_summary_("Frame stats", m_frame_count - m_window_size, m_window_size, false);
+  }
+}
+
+void Frame_stats_t::get_window_summary(int channel, Frame_stat_summary_t* summary) {
+  *summary = {};
+  M_check_return(channel >= 0 && channel < m_channel_count);
+  M_check_return(m_window_size > 0 && m_frame_count > 0);
+  // The frames are in the first slots until the ring is full, their order doesn't matter.
+  Sip frame_count = min(m_frame_count, (Sip)m_window_size);
+  S64 sum = 0;
+  for (Sip i = 0; i < frame_count; ++i) {
+    m_scratch[i] = m_window_values[i * m_channel_count + channel];
+    sum += m_scratch[i];
+  }
+  S64* first = m_scratch.m_p;
+  S64* last = m_scratch.m_p + frame_count;
+  std::sort(first, last);
+  // Nearest-rank percentiles.
+  auto get_percentile = [&](F64 p) { return first[max((Sip)ceil(p * frame_count) - 1, (Sip)0)]; };
+  summary->min = mono_time_to_ms(first[0]);
+  summary->avg = mono_time_to_ms(sum) / frame_count;
+  summary->p50 = mono_time_to_ms(get_percentile(0.5));
+  summary->p99 = mono_time_to_ms(get_percentile(0.99));
+  summary->max = mono_time_to_ms(last[-1]);
+}
+
+void Frame_stats_t::get_run_summary(int channel, Frame_stat_summary_t* summary) {
+  *summary = {};
+  M_check_return(channel >= 0 && channel < m_channel_count);
+  M_check_return(m_frame_count > 0);
+  const Frame_stat_run_t_& run = m_runs[channel];
+  const U32* histogram = m_histogram.m_p + (Sip)channel * gc_bucket_count_;
+  // Nearest-rank percentiles, the time of the bucket of the rank is clamped to the real range.
+  auto get_percentile = [&](F64 p) {
+    Sip rank = max((Sip)ceil(p * m_frame_count), (Sip)1);
+    Sip count = 0;
+    int bucket = 0;
+    while ((count += histogram[bucket]) < rank) {
+      ++bucket;
+    }
+    return min(max(get_bucket_time_(bucket), run.min), run.max);
+  };
+  summary->min = mono_time_to_ms(run.min);
+  summary->avg = mono_time_to_ms(run.sum) / m_frame_count;
+  summary->p50 = mono_time_to_ms(get_percentile(0.5));
+  summary->p99 = mono_time_to_ms(get_percentile(0.99));
+  summary->max = mono_time_to_ms(run.max);
+}
+
+void Frame_stats_t::log_summary_(const char* title, Sip first_frame, Sip frame_count, bool is_whole_run) {
+  M_logi("%s (frames %lld-%lld), in ms:", title, (long long)first_frame, (long long)(first_frame + frame_count - 1));
+  for (int i = 0; i < m_channel_count; ++i) {
+    Frame_stat_summary_t s;
+    if (is_whole_run) {
+      get_run_summary(i, &s);
+    } else {
+      get_window_summary(i, &s);
+    }
+    M_logi("  %-12s min %8.3f  avg %8.3f  p50 %8.3f  p99 %8.3f  max %8.3f", m_channel_names[i], s.min, s.avg, s.p50, s.p99, s.max);
+  }
+}
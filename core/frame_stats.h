@@ -0,0 +1,63 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/dynamic_array.h"
+#include "core/file.h"
+#include "core/types.h"
+
+class Allocator_t;
+
+// Statistics of a channel over a range of frames, in milliseconds.
+struct Frame_stat_summary_t {
+  F64 min;
+  F64 avg;
+  F64 p50;
+  F64 p99;
+  F64 max;
+};
+
+// The whole run of a channel. The percentiles come from |m_histogram| which has log-linear buckets.
+struct Frame_stat_run_t_ {
+  S64 min;
+  S64 max;
+  S64 sum;
+};
+
+// Collects a few timings (channels) per frame.
+// It logs the statistics of every |window_size| frames and the whole run when it's destroyed, the frames can also be written to a CSV file.
+// Only the last |window_size| frames are kept so the memory doesn't grow with the run.
+class Frame_stats_t {
+public:
+  Frame_stats_t(Allocator_t* allocator) : m_window_values(allocator), m_scratch(allocator), m_runs(allocator), m_histogram(allocator) {}
+  // |channel_names| must be alive as long as the stats.
+  // |window_size| <= 0 means only the summary of the whole run is logged. |csv_path| can be NULL.
+  bool init(const char* const* channel_names, int channel_count, int window_size, const Os_char* csv_path);
+  void destroy();
+  // |times| has one time (from mono_time_now() differences) for each channel.
+  void add_frame(const S64* times);
+  // The last |m_window_size| frames or less if there aren't enough frames yet.
+  void get_window_summary(int channel, Frame_stat_summary_t* summary);
+  // Every frame, p50 and p99 are rounded to their histogram bucket which is within 1/64 of the real value.
+  void get_run_summary(int channel, Frame_stat_summary_t* summary);
+  Sip get_frame_count() const { return m_frame_count; }
+
+  void log_summary_(const char* title, Sip first_frame, Sip frame_count, bool is_whole_run);
+
+  const char* const* m_channel_names = NULL;
+  int m_channel_count = 0;
+  int m_window_size = 0;
+  Sip m_frame_count = 0;
+  // A ring of |m_window_size| frames with |m_channel_count| times per frame.
+  Dynamic_array_t<S64> m_window_values;
+  Dynamic_array_t<S64> m_scratch;
+  Dynamic_array_t<Frame_stat_run_t_> m_runs;
+  // One histogram per channel.
+  Dynamic_array_t<U32> m_histogram;
+  File_t m_csv_file;
+  bool m_has_csv_file = false;
+};
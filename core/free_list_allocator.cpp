@@ -30,6 +30,11 @@ static bool is_enough_for_allocation_header_(Sip size) {
   return size > sizeof(Alloc_header_t_);
 }
 
+// Sizes are rounded up so the Free_block_t_ that may follow an allocation is aligned.
+static Sip align_size_(Sip size) {
+  return (size + alignof(Free_block_t_) - 1) & ~(Sip)(alignof(Free_block_t_) - 1);
+}
+
 static bool is_allocaiton_adjacent_to_free_block_(Alloc_header_t_* header, Free_block_t_* block) {
   return block && (U8*)header + sizeof(Alloc_header_t_) + header->size == (U8*)block;
 }
@@ -52,15 +57,18 @@ void Free_list_allocator_t::destroy() {
 
 void* Free_list_allocator_t::aligned_alloc(Sip size, Sip alignment) {
   M_check_log_return_val(check_aligned_alloc_(size, alignment), NULL, "Alignment is not power of 2");
+  size = align_size_(size);
   Free_block_t_* fit_block;
   Free_block_t_* prior_block;
   U8* p = find_best_fit_free_block_(&fit_block, &prior_block, size, alignment);
   M_check_log_return_val(p, NULL, "Free list allocator \"%s\" doesn't have enough space to alloc %d bytes", m_name, size);
   Sip padding_and_header = p - (U8*)fit_block;
+  // The header can be where |fit_block| is.
+  Sip fit_block_size = fit_block->size;
   bool rv = shrink_free_block_(fit_block, prior_block, padding_and_header + size);
   Alloc_header_t_* hdr = get_allocation_header_(p);
   hdr->start = (U8*)fit_block;
-  hdr->size = rv ? size : fit_block->size - padding_and_header;
+  hdr->size = rv ? size : fit_block_size - padding_and_header;
   hdr->alignment = alignment;
 #if M_is_dev()
   hdr->p = p;
@@ -70,6 +78,7 @@ void* Free_list_allocator_t::aligned_alloc(Sip size, Sip alignment) {
 
 void* Free_list_allocator_t::realloc(void* p, Sip size) {
   M_check_log_return_val(check_p_in_dev_(p) && size, NULL, "Invalid pointer to realloc");
+  size = align_size_(size);
 
   Alloc_header_t_* header = get_allocation_header_(p);
   // Remaining free space is surely not enough.
@@ -100,7 +109,7 @@ void Free_list_allocator_t::free(void* p) {
   m_used_size -= freed_size;
   Free_block_t_* new_block = (Free_block_t_*)header->start;
   new_block->size = freed_size;
-  new_block->size = NULL;
+  new_block->next = NULL;
   add_and_merge_free_block_(new_block);
 }
 
@@ -202,9 +211,11 @@ void Free_list_allocator_t::realloc_smaller_(U8* p, Sip size, Free_block_t_* pri
   // Free_block_t_ to the end of the new allocation.
   if (is_allocaiton_adjacent_to_free_block_(header, next_block)) {
     header->size = size;
+    // |shifted_block| overlaps |next_block|.
+    Free_block_t_ old_next_block = *next_block;
     Free_block_t_* shifted_block = (Free_block_t_*)(p + size);
-    shifted_block->size = next_block->size + size_after_shrunk;
-    shifted_block->next = next_block->next;
+    shifted_block->size = old_next_block.size + size_after_shrunk;
+    shifted_block->next = old_next_block.next;
     link_and_merge_free_blocks_(&prior_block, &shifted_block);
     m_used_size -= size_after_shrunk;
     return;
@@ -229,9 +240,11 @@ U8* Free_list_allocator_t::realloc_bigger_(U8* p, Sip size, Free_block_t_* prior
     if (header->size + next_block->size >= size) {
       Sip size_after_extended = header->size + next_block->size - size;
       if (is_enough_for_allocation_header_(size_after_extended)) {
+        // |new_block| overlaps |next_block|.
+        Free_block_t_* next_next_block = next_block->next;
         Free_block_t_* new_block = (Free_block_t_*)(p + size);
         new_block->size = size_after_extended;
-        new_block->next = next_block->next;
+        new_block->next = next_next_block;
         link_and_merge_free_blocks_(&prior_block, &new_block);
         m_used_size += size - header->size;
         header->size = size;
@@ -265,12 +278,14 @@ U8* Free_list_allocator_t::realloc_bigger_(U8* p, Sip size, Free_block_t_* prior
   U8* returned_pointer = find_best_fit_free_block_(&fit_block, &prior_fit_block, size, backup_header.alignment);
   if (returned_pointer) {
     m_used_size -= backup_header.size + (p - backup_header.start);
-    memmove(returned_pointer, p, size);
+    // Only the old allocation is copied, the rest of |size| may be past the end of the memory.
+    memmove(returned_pointer, p, backup_header.size);
     Sip padding_and_header = returned_pointer - (U8*)fit_block;
+    Sip fit_block_size = fit_block->size;
     bool rv = shrink_free_block_(fit_block, prior_fit_block, padding_and_header + size);
     header = get_allocation_header_(returned_pointer);
     header->start = (U8*)fit_block;
-    header->size = rv ? size : fit_block->size - padding_and_header;
+    header->size = rv ? size : fit_block_size - padding_and_header;
     header->alignment = backup_header.alignment;
 #if M_is_dev()
     header->p = returned_pointer;
@@ -286,7 +301,7 @@ U8* Free_list_allocator_t::realloc_bigger_(U8* p, Sip size, Free_block_t_* prior
   }
   m_first_block = backup_m_first_block;
   *header = backup_header;
-  M_logd("Free list allocator \"%s\" doesn't have enough space to alloc %d bytes", m_name, size);
+  M_logcd(e_log_category_core, "Free list allocator \"%s\" doesn't have enough space to alloc %d bytes", m_name, size);
   return NULL;
 }
 
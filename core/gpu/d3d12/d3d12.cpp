@@ -133,6 +133,8 @@ static DXGI_FORMAT convert_format_to_dxgi_format(E_format format) {
       return DXGI_FORMAT_R8_UINT;
     case e_format_r8_unorm:
       return DXGI_FORMAT_R8_UNORM;
+    case e_format_r8g8_unorm:
+      return DXGI_FORMAT_R8G8_UNORM;
     case e_format_r8g8b8a8_uint:
       return DXGI_FORMAT_R8G8B8A8_UINT;
     case e_format_r8g8b8a8_unorm:
@@ -145,8 +147,22 @@ static DXGI_FORMAT convert_format_to_dxgi_format(E_format format) {
       return DXGI_FORMAT_R16G16B16A16_UINT;
     case e_format_r16g16b16a16_unorm:
       return DXGI_FORMAT_R16G16B16A16_UNORM;
+    case e_format_r16g16b16a16_float:
+      return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case e_format_r11g11b10_float:
+      return DXGI_FORMAT_R11G11B10_FLOAT;
     case e_format_r24_unorm_x8_typeless:
       return DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+    case e_format_bc1_unorm:
+      return DXGI_FORMAT_BC1_UNORM;
+    case e_format_bc3_unorm:
+      return DXGI_FORMAT_BC3_UNORM;
+    case e_format_bc4_unorm:
+      return DXGI_FORMAT_BC4_UNORM;
+    case e_format_bc5_unorm:
+      return DXGI_FORMAT_BC5_UNORM;
+    case e_format_bc6h_ufloat:
+      return DXGI_FORMAT_BC6H_UF16;
     case e_format_bc7_unorm:
       return DXGI_FORMAT_BC7_UNORM;
     case e_format_bc7_typeless:
@@ -282,7 +298,7 @@ bool D3d12_t::init(Window_t* w) {
     dxgi_factory->EnumAdapters1(adapter_i, &adapter);
     DXGI_ADAPTER_DESC1 desc;
     adapter->GetDesc1(&desc);
-    M_logi("%ls", desc.Description);
+    M_logci(e_log_category_gpu, "%ls", desc.Description);
     M_dx_check_return_false_(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&m_device)));
   }
 
@@ -445,8 +461,10 @@ Texture_t* D3d12_t::create_texture_cube(Allocator_t* allocator, const Texture_cr
   pitched_desc.Depth = 1;
   pitched_desc.RowPitch = (ci.row_pitch + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
   auto m_texture_subbuffer = allocate_sub_buffer_(&m_upload_buffer, 6 * ci.row_count * pitched_desc.RowPitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
-  for (int i = 0; i < 6* ci.row_count; ++i) {
-    memcpy(m_texture_subbuffer.cpu_p + i * ci.row_pitch, &ci.data[i * ci.row_pitch], ci.row_pitch);
+  // Only the top levels are uploaded.
+  for (int i = 0; i < 6; ++i) {
+    const U8* face_data = ci.subresources ? ci.subresources[i * max(ci.mip_count, 1u)].data : ci.data + i * ci.row_pitch * ci.row_count;
+    memcpy(m_texture_subbuffer.cpu_p + i * ci.row_pitch * ci.row_count, face_data, ci.row_pitch * ci.row_count);
   }
   D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed_texture = {};
   placed_texture.Footprint = pitched_desc;
@@ -12,21 +12,37 @@
 #endif
 #include "core/gpu/vulkan/vulkan.h"
 #include "core/loader/dds.h"
+#include "core/loader/mipmap.h"
 #include "core/log.h"
 #include "core/window/window.h"
 
 Texture_create_info_t get_texture_create_info(const Dds_loader_t& dds) {
   Texture_create_info_t ci = {};
-  ci.data = dds.m_data;
-  ci.width = dds.m_header->width;
-  ci.height = dds.m_header->height;
+  const Texture_subresource_t& top_level = dds.m_subresources[0];
+  ci.data = top_level.data;
+  ci.width = top_level.width;
+  ci.height = top_level.height;
+  ci.row_pitch = top_level.row_pitch;
+  ci.row_count = top_level.row_count;
   ci.format = dds.m_format;
-  if (ci.format == e_format_bc7_unorm) {
-    ci.row_pitch = ci.width * 4;
-    ci.row_count = ci.height / 4;
-  } else {
-    M_unimplemented();
-  }
+  ci.subresources = dds.m_subresources.m_p;
+  ci.mip_count = dds.m_mip_count;
+  ci.array_size = dds.m_array_size;
+  return ci;
+}
+
+Texture_create_info_t get_texture_create_info(const Mip_chain_t& mips) {
+  Texture_create_info_t ci = {};
+  const Texture_subresource_t& top_level = mips.m_subresources[0];
+  ci.data = top_level.data;
+  ci.width = top_level.width;
+  ci.height = top_level.height;
+  ci.row_pitch = top_level.row_pitch;
+  ci.row_count = top_level.row_count;
+  ci.format = mips.m_format;
+  ci.subresources = mips.m_subresources;
+  ci.mip_count = mips.m_mip_count;
+  ci.array_size = 1;
   return ci;
 }
 
@@ -185,6 +201,15 @@ void Gpu_t::resize_render_pass(Render_pass_t* render_pass) {
   M_unimplemented();
 }
 
+U64 Gpu_t::get_upload_fence_value() {
+  return 0;
+}
+
+bool Gpu_t::is_upload_fence_value_completed(U64 value) {
+  // The backends that don't override it upload synchronously.
+  return true;
+}
+
 int Gpu_t::convert_format_to_size_(E_format format) {
   switch(format) {
     case e_format_r32g32b32a32_float:
@@ -199,6 +224,8 @@ int Gpu_t::convert_format_to_size_(E_format format) {
       return 1;
     case e_format_r8_unorm:
       return 4;
+    case e_format_r8g8_unorm:
+      return 2;
     case e_format_r8g8b8a8_uint:
       return 4;
     case e_format_r8g8b8a8_unorm:
@@ -211,11 +238,22 @@ int Gpu_t::convert_format_to_size_(E_format format) {
       return 8;
     case e_format_r16g16b16a16_unorm:
       return 8;
+    case e_format_r16g16b16a16_float:
+      return 8;
+    case e_format_r11g11b10_float:
+      return 4;
     case e_format_r24_unorm_x8_typeless:
       return 4;
+    // A 4x4 block for the block compressed formats.
+    case e_format_bc1_unorm:
+    case e_format_bc4_unorm:
+      return 8;
+    case e_format_bc3_unorm:
+    case e_format_bc5_unorm:
+    case e_format_bc6h_ufloat:
     case e_format_bc7_unorm:
     case e_format_bc7_typeless:
-      return 4;
+      return 16;
     default:
       M_unimplemented();
   }
@@ -8,11 +8,13 @@
 
 #include "core/fixed_array.h"
 #include "core/path.h"
+#include "core/task.h"
 #include "core/types.h"
 
 class Allocator_t;
 class Command_line_t;
 class Dds_loader_t;
+struct Mip_chain_t;
 class Window_t;
 
 enum E_shader_stage {
@@ -46,13 +48,27 @@ enum E_format {
   e_format_r32g32_float,
   e_format_r8_uint,
   e_format_r8_unorm,
+  e_format_r8g8_unorm,
   e_format_r8g8b8a8_uint,
   e_format_r8g8b8a8_unorm,
   e_format_r16_uint,
   e_format_r16_unorm,
   e_format_r16g16b16a16_uint,
   e_format_r16g16b16a16_unorm,
+  e_format_r16g16b16a16_float,
+  e_format_r11g11b10_float,
   e_format_r24_unorm_x8_typeless,
+  // Block compressed formats have 4x4 blocks of 8 bytes (BC1 and BC4) or 16 bytes.
+  // RGB with 1 bit alpha.
+  e_format_bc1_unorm,
+  // RGBA with BC4 alpha.
+  e_format_bc3_unorm,
+  // R.
+  e_format_bc4_unorm,
+  // RG.
+  e_format_bc5_unorm,
+  // Unsigned half float RGB.
+  e_format_bc6h_ufloat,
   e_format_bc7_unorm,
   e_format_bc7_typeless,
 };
@@ -74,13 +90,28 @@ enum E_topology {
   e_topology_line,
 };
 
+// One mip level of one array slice.
+struct Texture_subresource_t {
+  U8* data;
+  U32 width;
+  U32 height;
+  // Rows of blocks for block compressed formats.
+  U32 row_pitch;
+  U32 row_count;
+};
+
 struct Texture_create_info_t {
+  // The top level of the first slice, |data| of a cube texture has the 6 faces one after another.
   U8* data;
   U32 width;
   U32 height;
   U32 row_pitch;
   U32 row_count;
   E_format format;
+  // |mip_count| * |array_size| subresources, the mips of the first slice are first. If it's NULL, the top level above is the only level.
+  const Texture_subresource_t* subresources;
+  U32 mip_count;
+  U32 array_size;
 };
 
 struct Texture_t {
@@ -243,6 +274,17 @@ struct Scissor_t {
 };
 
 Texture_create_info_t get_texture_create_info(const Dds_loader_t& dds);
+Texture_create_info_t get_texture_create_info(const Mip_chain_t& mips);
+
+// Times that the backends measure in the current frame (mono_time_now() differences).
+struct Gpu_frame_times_t {
+  // Waiting for the next back buffer (vkAcquireNextImageKHR).
+  S64 acquire = 0;
+  // Waiting for the GPU to finish the last frame that used the same command buffer (vkWaitForFences).
+  S64 fence_wait = 0;
+  // Submitting and presenting.
+  S64 cmd_end = 0;
+};
 
 class Gpu_t {
 public:
@@ -283,7 +325,18 @@ public:
   virtual void on_resized();
   virtual void resize_render_pass(Render_pass_t* render_pass);
 
+  // create_texture*() can return before the data is uploaded, the fence value is incremented by each upload.
+  // Rendering waits for the pending uploads so the textures can be used right away.
+  virtual U64 get_upload_fence_value();
+  virtual bool is_upload_fence_value_completed(U64 value);
+
   static int convert_format_to_size_(E_format format);
 
   Window_t* m_window = NULL;
+  Gpu_frame_times_t m_frame_times;
 };
+
+// co_await it in a Task_t to wait for the uploads up to |fence_value| without blocking a worker.
+inline auto gpu_wait_for_upload_async(Gpu_t* gpu, U64 fence_value) {
+  return task_poll([gpu, fence_value]() { return gpu->is_upload_fence_value_completed(fence_value); });
+}
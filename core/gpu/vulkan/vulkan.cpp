@@ -12,6 +12,8 @@
 #include "core/linear_allocator.h"
 #include "core/os.h"
 #include "core/log.h"
+#include "core/mono_time.h"
+#include "core/profiler.h"
 #include "core/string.h"
 #include "core/utils.h"
 #include "core/window/window.h"
@@ -44,6 +46,7 @@ struct Vk_sub_buffer_t_ {
 struct Vulkan_texture_t : Texture_t {
   VkImage image;
   VkDeviceMemory memory;
+  U32 layer_count = 1;
 };
 
 struct Vulkan_sampler_t : Sampler_t {
@@ -111,6 +114,8 @@ static VkFormat convert_format_to_vk_format(E_format format) {
       return VK_FORMAT_R8_UINT;
     case e_format_r8_unorm:
       return VK_FORMAT_R8_UNORM;
+    case e_format_r8g8_unorm:
+      return VK_FORMAT_R8G8_UNORM;
     case e_format_r8g8b8a8_uint:
       return VK_FORMAT_R8G8B8A8_UINT;
     case e_format_r8g8b8a8_unorm:
@@ -123,8 +128,22 @@ static VkFormat convert_format_to_vk_format(E_format format) {
       return VK_FORMAT_R16G16B16A16_UINT;
     case e_format_r16g16b16a16_unorm:
       return VK_FORMAT_R16G16B16A16_UNORM;
+    case e_format_r16g16b16a16_float:
+      return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case e_format_r11g11b10_float:
+      return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
     case e_format_r24_unorm_x8_typeless:
       return VK_FORMAT_D24_UNORM_S8_UINT;
+    case e_format_bc1_unorm:
+      return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case e_format_bc3_unorm:
+      return VK_FORMAT_BC3_UNORM_BLOCK;
+    case e_format_bc4_unorm:
+      return VK_FORMAT_BC4_UNORM_BLOCK;
+    case e_format_bc5_unorm:
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case e_format_bc6h_ufloat:
+      return VK_FORMAT_BC6H_UFLOAT_BLOCK;
     case e_format_bc7_unorm:
       return VK_FORMAT_BC7_UNORM_BLOCK;
     default:
@@ -168,7 +187,7 @@ static VkBool32 debug_cb_(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEX
 	if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) {
     M_logf("layer: %s\ncode: %d\nmessage: %s", layer_prefix, msg_code, msg);
 	} else if (flags & VK_DEBUG_REPORT_WARNING_BIT_EXT) {
-    M_logw("layer: %s\ncode: %d\nmessage: %s", layer_prefix, msg_code, msg);
+    M_logcw(e_log_category_gpu, "layer: %s\ncode: %d\nmessage: %s", layer_prefix, msg_code, msg);
 	}
 	return VK_FALSE;
 }
@@ -252,7 +271,7 @@ bool Vulkan_t::init(Window_t* w) {
   {
     vkGetPhysicalDeviceProperties(m_chosen_device, &m_device_props);
     m_min_alignment = m_device_props.limits.minMemoryMapAlignment;
-    M_logi("Chosen GPU: %s", m_device_props.deviceName);
+    M_logci(e_log_category_gpu, "Chosen GPU: %s", m_device_props.deviceName);
   }
 
   int m_transfer_queue_idx = -1;
@@ -400,6 +419,8 @@ bool Vulkan_t::init(Window_t* w) {
     for (int i = 0; i < m_swapchain_image_count; ++i) {
       vkCreateFence(m_device, &fence_ci, NULL, &m_fences[i]);
     }
+    fence_ci.flags = 0;
+    M_vk_check_return_false(vkCreateFence(m_device, &fence_ci, NULL, &m_upload_fence));
   }
   {
     VkSemaphoreCreateInfo semaphore_ci = {};
@@ -425,89 +446,69 @@ bool Vulkan_t::init(Window_t* w) {
 }
 
 void Vulkan_t::destroy() {
+  wait_for_upload_();
+  vkDestroyFence(m_device, m_upload_fence, NULL);
 }
 
-Texture_t* Vulkan_t::create_texture(Allocator_t* allocator, const Texture_create_info_t& ci) {
-  Sz texture_size = ci.row_count * ci.row_pitch;
-  memcpy(m_upload_buffer.cpu_p, ci.data, texture_size);
-  VkBufferImageCopy copy_region = {};
-  copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  copy_region.imageSubresource.mipLevel = 0;
-  copy_region.imageSubresource.baseArrayLayer = 0;
-  copy_region.imageSubresource.layerCount = 1;
-  copy_region.imageExtent.width = ci.width;
-  copy_region.imageExtent.height = ci.height;
-  copy_region.imageExtent.depth = 1;
-  copy_region.bufferOffset = 0;
-
-  VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
-  cmd_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  cmd_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-  vkBeginCommandBuffer(m_transfer_cmd_buffer, &cmd_buffer_begin_info);
-  VkImage image;
-  VkDeviceMemory memory;
-  create_image_(&image, &memory, ci.width, ci.height, convert_format_to_vk_format(ci.format), VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT);
-  VkImageSubresourceRange subresource_range = {};
-  subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  subresource_range.baseMipLevel = 0;
-  subresource_range.levelCount = 1;
-  subresource_range.layerCount = 1;
-  VkImageMemoryBarrier image_barrier = {};
-  image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  image_barrier.image = image;
-  image_barrier.subresourceRange = subresource_range;
-  image_barrier.srcAccessMask = 0;
-  image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  vkCmdPipelineBarrier(m_transfer_cmd_buffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
-  vkCmdCopyBufferToImage(m_transfer_cmd_buffer, m_upload_buffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
-
-  image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-  vkCmdPipelineBarrier(m_transfer_cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
-  // m_device->flushCommandBuffer(m_transfer_cmd_buffer, m_transfer_queue, true);
-  {
-    vkEndCommandBuffer(m_transfer_cmd_buffer);
-
-    VkSubmitInfo submit_info = {};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &m_transfer_cmd_buffer;
-
-    VkFenceCreateInfo fence_ci = {};
-    fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_ci.flags = 0;
-    VkFence fence;
-    vkCreateFence(m_device, &fence_ci, nullptr, &fence);
-
-    vkQueueSubmit(m_transfer_q, 1, &submit_info, fence);
-    vkWaitForFences(m_device, 1, &fence, VK_TRUE, (U64)(-1));
+U64 Vulkan_t::get_upload_fence_value() {
+  return m_upload_fence_value;
+}
 
-    vkDestroyFence(m_device, fence, nullptr);
+bool Vulkan_t::is_upload_fence_value_completed(U64 value) {
+  if (value > m_completed_upload_fence_value && vkGetFenceStatus(m_device, m_upload_fence) == VK_SUCCESS) {
+    m_completed_upload_fence_value = m_upload_fence_value;
   }
-  auto rv = allocator->construct<Vulkan_texture_t>();
-  rv->image = image;
-  rv->memory = memory;
-  return rv;
+  return value <= m_completed_upload_fence_value;
+}
+
+Texture_t* Vulkan_t::create_texture(Allocator_t* allocator, const Texture_create_info_t& ci) {
+  return create_texture_(allocator, ci, false);
 }
 
 Texture_t* Vulkan_t::create_texture_cube(Allocator_t* allocator, const Texture_create_info_t& ci) {
   M_check(ci.width == ci.height);
-  Sz texture_size = ci.row_count * ci.row_pitch;
-  memcpy(m_upload_buffer.cpu_p, ci.data, 6*texture_size);
-  VkBufferImageCopy copy_region = {};
-  copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  copy_region.imageSubresource.mipLevel = 0;
-  copy_region.imageSubresource.baseArrayLayer = 0;
-  copy_region.imageSubresource.layerCount = 6;
-  copy_region.imageExtent.width = ci.width;
-  copy_region.imageExtent.height = ci.height;
-  copy_region.imageExtent.depth = 1;
-  copy_region.bufferOffset = 0;
+  return create_texture_(allocator, ci, true);
+}
+
+Texture_t* Vulkan_t::create_texture_(Allocator_t* allocator, const Texture_create_info_t& ci, bool is_cube) {
+  M_profile_zone("Vulkan_t::create_texture_");
+  U32 mip_count = max(ci.mip_count, 1u);
+  U32 layer_count = max(ci.array_size, is_cube ? 6u : 1u);
+  M_check_return_val(!is_cube || layer_count == 6, NULL);
+  // Without a table there is only the top level, the cube faces are one after another in |ci.data|.
+  Texture_subresource_t top_levels[6];
+  const Texture_subresource_t* subresources = ci.subresources;
+  if (!subresources) {
+    M_check_return_val(mip_count == 1 && layer_count <= static_array_size(top_levels), NULL);
+    for (U32 i = 0; i < layer_count; ++i) {
+      top_levels[i] = {ci.data + (Sip)i * ci.row_count * ci.row_pitch, ci.width, ci.height, ci.row_pitch, ci.row_count};
+    }
+    subresources = top_levels;
+  }
+  Linear_allocator_t<> temp_allocator("create_texture_temp_allocator");
+  M_scope_exit(temp_allocator.destroy());
+  U32 subresource_count = mip_count * layer_count;
+  VkBufferImageCopy* copy_regions = (VkBufferImageCopy*)temp_allocator.alloc_zero(subresource_count * sizeof(VkBufferImageCopy));
+  // The upload buffer and the transfer command buffer are reused.
+  wait_for_upload_();
+  // All the subresources are copied by one command, their offsets are aligned to a texel block.
+  Sz offset = 0;
+  for (U32 i = 0; i < subresource_count; ++i) {
+    const Texture_subresource_t& subresource = subresources[i];
+    Sz size = (Sz)subresource.row_pitch * subresource.row_count;
+    M_check_log_return_val(offset + size <= m_upload_buffer.size, NULL, "The texture doesn't fit in the upload buffer");
+    memcpy((U8*)m_upload_buffer.cpu_p + offset, subresource.data, size);
+    VkBufferImageCopy* copy_region = &copy_regions[i];
+    copy_region->bufferOffset = offset;
+    copy_region->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy_region->imageSubresource.mipLevel = i % mip_count;
+    copy_region->imageSubresource.baseArrayLayer = i / mip_count;
+    copy_region->imageSubresource.layerCount = 1;
+    copy_region->imageExtent.width = subresource.width;
+    copy_region->imageExtent.height = subresource.height;
+    copy_region->imageExtent.depth = 1;
+    offset = (offset + size + 15) & ~(Sz)15;
+  }
 
   VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
   cmd_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -515,12 +516,13 @@ Texture_t* Vulkan_t::create_texture_cube(Allocator_t* allocator, const Texture_c
   vkBeginCommandBuffer(m_transfer_cmd_buffer, &cmd_buffer_begin_info);
   VkImage image;
   VkDeviceMemory memory;
-  create_image_(&image, &memory, ci.width, ci.height, convert_format_to_vk_format(ci.format), VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+  VkImageCreateFlags flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | (is_cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0);
+  create_image_(&image, &memory, ci.width, ci.height, mip_count, layer_count, convert_format_to_vk_format(ci.format), VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, flags);
   VkImageSubresourceRange subresource_range = {};
   subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   subresource_range.baseMipLevel = 0;
-  subresource_range.levelCount = 1;
-  subresource_range.layerCount = 6;
+  subresource_range.levelCount = mip_count;
+  subresource_range.layerCount = layer_count;
   VkImageMemoryBarrier image_barrier = {};
   image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   image_barrier.image = image;
@@ -530,7 +532,7 @@ Texture_t* Vulkan_t::create_texture_cube(Allocator_t* allocator, const Texture_c
   image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
   vkCmdPipelineBarrier(m_transfer_cmd_buffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
-  vkCmdCopyBufferToImage(m_transfer_cmd_buffer, m_upload_buffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+  vkCmdCopyBufferToImage(m_transfer_cmd_buffer, m_upload_buffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_count, copy_regions);
 
   image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
   image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
@@ -539,31 +541,13 @@ Texture_t* Vulkan_t::create_texture_cube(Allocator_t* allocator, const Texture_c
 
   vkCmdPipelineBarrier(m_transfer_cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
   // m_device->flushCommandBuffer(m_transfer_cmd_buffer, m_transfer_queue, true);
-  {
-    vkEndCommandBuffer(m_transfer_cmd_buffer);
-
-    VkSubmitInfo submit_info = {};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &m_transfer_cmd_buffer;
-
-    VkFenceCreateInfo fence_ci = {};
-    fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_ci.flags = 0;
-    VkFence fence;
-    vkCreateFence(m_device, &fence_ci, nullptr, &fence);
-
-    vkQueueSubmit(m_transfer_q, 1, &submit_info, fence);
-    vkWaitForFences(m_device, 1, &fence, VK_TRUE, (U64)(-1));
-
-    vkDestroyFence(m_device, fence, nullptr);
-  }
+  submit_upload_();
   auto rv = allocator->construct<Vulkan_texture_t>();
   rv->image = image;
   rv->memory = memory;
-  rv->is_cube = true;
+  rv->layer_count = layer_count;
+  rv->is_cube = is_cube;
   return rv;
-  return NULL;
 }
 
 Resources_set_t* Vulkan_t::create_resources_set(Allocator_t* allocator, const Resources_set_create_info_t& ci) {
@@ -651,7 +635,7 @@ Render_target_t* Vulkan_t::create_depth_stencil(Allocator_t* allocator, const De
     usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
   }
   auto rv = allocator->construct<Vulkan_render_target_t>();
-  create_image_(&rv->image, &rv->memory, (U32)m_window->m_width, (U32)m_window->m_height, m_depth_format, usage, 0);
+  create_image_(&rv->image, &rv->memory, (U32)m_window->m_width, (U32)m_window->m_height, 1, 1, m_depth_format, usage, 0);
   VkImageView image_view = create_image_view_(rv->image, VK_IMAGE_VIEW_TYPE_2D, m_depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
   rv->state = e_resource_state_undefined;
   rv->image_view = image_view;
@@ -801,7 +785,7 @@ Resource_t Vulkan_t::create_sampler(Allocator_t* allocator, const Sampler_create
   sampler_ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   sampler_ci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   sampler_ci.minLod = 0.0f;
-  sampler_ci.maxLod = 0.0f;
+  sampler_ci.maxLod = VK_LOD_CLAMP_NONE;
   sampler_ci.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
   M_vk_check(vkCreateSampler(m_device, &sampler_ci, NULL, &sampler));
 
@@ -823,6 +807,8 @@ Resource_t Vulkan_t::create_image_view(Allocator_t* allocator, const Image_view_
     auto vk_texture = (Vulkan_texture_t*)ci.texture;
     if (vk_texture->is_cube) {
       image_view->image_view = create_image_view_(vk_texture->image, VK_IMAGE_VIEW_TYPE_CUBE, convert_format_to_vk_format(ci.format), VK_IMAGE_ASPECT_COLOR_BIT);
+    } else if (vk_texture->layer_count > 1) {
+      image_view->image_view = create_image_view_(vk_texture->image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, convert_format_to_vk_format(ci.format), VK_IMAGE_ASPECT_COLOR_BIT);
     } else {
       image_view->image_view = create_image_view_(vk_texture->image, VK_IMAGE_VIEW_TYPE_2D, convert_format_to_vk_format(ci.format), VK_IMAGE_ASPECT_COLOR_BIT);
     }
@@ -1045,11 +1031,17 @@ Pipeline_state_object_t* Vulkan_t::create_pipeline_state_object(Allocator_t* all
 }
 
 void Vulkan_t::get_back_buffer() {
+  M_profile_zone("Vulkan_t::get_back_buffer");
+  S64 start = mono_time_now();
   M_vk_check(vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_image_available_semaphore, VK_NULL_HANDLE, &m_next_swapchain_image_idx));
+  m_frame_times.acquire = mono_time_now() - start;
 }
 
 void Vulkan_t::cmd_begin() {
+  M_profile_zone("Vulkan_t::cmd_begin");
+  S64 start = mono_time_now();
   vkWaitForFences(m_device, 1, &m_fences[m_next_swapchain_image_idx], true, UINT64_MAX);
+  m_frame_times.fence_wait = mono_time_now() - start;
   vkResetFences(m_device, 1, &m_fences[m_next_swapchain_image_idx]);
   vkResetCommandBuffer(get_active_cmd_buffer_(), 0);
   VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
@@ -1147,7 +1139,12 @@ void Vulkan_t::cmd_set_scissor(int count, const Scissor_t* scissors) {
 }
 
 void Vulkan_t::cmd_end() {
+  M_profile_zone("Vulkan_t::cmd_end");
+  S64 start = mono_time_now();
+  M_scope_exit(m_frame_times.cmd_end = mono_time_now() - start);
   vkEndCommandBuffer(get_active_cmd_buffer_());
+  // The textures that are used in this frame must be uploaded.
+  wait_for_upload_();
   VkSubmitInfo submit_info = {};
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   submit_info.waitSemaphoreCount = 1;
@@ -1180,6 +1177,7 @@ void Vulkan_t::cmd_end() {
 
 void Vulkan_t::on_resized() {
   vkDeviceWaitIdle(m_device);
+  m_completed_upload_fence_value = m_upload_fence_value;
   for (int i = 0; i < m_swapchain_image_count; ++i) {
     vkDestroyImageView(m_device, m_swapchain_image_views[i], NULL);
   }
@@ -1225,10 +1223,12 @@ VkImageView Vulkan_t::create_image_view_(VkImage image, VkImageViewType view_typ
   image_view_ci.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
   image_view_ci.subresourceRange.aspectMask = aspect_flags;
   image_view_ci.subresourceRange.baseMipLevel = 0;
-  image_view_ci.subresourceRange.levelCount = 1;
+  image_view_ci.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
   image_view_ci.subresourceRange.baseArrayLayer = 0;
   if (view_type == VK_IMAGE_VIEW_TYPE_CUBE) {
     image_view_ci.subresourceRange.layerCount = 6;
+  } else if (view_type == VK_IMAGE_VIEW_TYPE_2D_ARRAY) {
+    image_view_ci.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
   } else {
     image_view_ci.subresourceRange.layerCount = 1;
   }
@@ -1269,22 +1269,39 @@ void Vulkan_t::allocate_sub_buffer_(Vk_sub_buffer_t_* sub_buffer, Vk_buffer_t_*
   buffer->offset_for_sub_buffer = aligned_offset + size;
 }
 
+void Vulkan_t::submit_upload_() {
+  M_profile_zone("Vulkan_t::submit_upload_");
+  vkEndCommandBuffer(m_transfer_cmd_buffer);
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &m_transfer_cmd_buffer;
+  vkResetFences(m_device, 1, &m_upload_fence);
+  M_vk_check(vkQueueSubmit(m_transfer_q, 1, &submit_info, m_upload_fence));
+  ++m_upload_fence_value;
+}
+
+void Vulkan_t::wait_for_upload_() {
+  if (m_completed_upload_fence_value < m_upload_fence_value) {
+    M_profile_zone("Vulkan_t::wait_for_upload_");
+    vkWaitForFences(m_device, 1, &m_upload_fence, VK_TRUE, (U64)(-1));
+    m_completed_upload_fence_value = m_upload_fence_value;
+  }
+}
+
 VkCommandBuffer Vulkan_t::get_active_cmd_buffer_() const {
   return m_graphics_cmd_buffers[m_next_swapchain_image_idx];
 }
 
-void Vulkan_t::create_image_(VkImage* image, VkDeviceMemory* memory, U32 width, U32 height, VkFormat format, VkImageUsageFlags usage, VkImageCreateFlags flags) {
+void Vulkan_t::create_image_(VkImage* image, VkDeviceMemory* memory, U32 width, U32 height, U32 mip_count, U32 layer_count, VkFormat format, VkImageUsageFlags usage, VkImageCreateFlags flags) {
   VkImageCreateInfo image_ci = {};
   image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   image_ci.imageType = VK_IMAGE_TYPE_2D;
   image_ci.format = format;
   image_ci.extent = {width, height, 1};
-  image_ci.mipLevels = 1;
-  if (flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) {
-    image_ci.arrayLayers = 6;
-  } else {
-    image_ci.arrayLayers = 1;
-  }
+  image_ci.mipLevels = mip_count;
+  image_ci.arrayLayers = layer_count;
   image_ci.samples = VK_SAMPLE_COUNT_1_BIT;
   image_ci.tiling = VK_IMAGE_TILING_OPTIMAL;
   image_ci.usage = usage;
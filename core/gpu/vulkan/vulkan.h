@@ -58,6 +58,9 @@ public:
   void on_resized() override;
   void resize_render_pass(Render_pass_t* render_pass) override;
 
+  U64 get_upload_fence_value() override;
+  bool is_upload_fence_value_completed(U64 value) override;
+
   Linear_allocator_t<> m_vk_allocator;
   VkInstance m_instance;
   VkSurfaceKHR m_surface;
@@ -85,6 +88,11 @@ public:
   Dynamic_array_t<VkCommandBuffer> m_graphics_cmd_buffers;
   VkCommandBuffer m_transfer_cmd_buffer;
   Dynamic_array_t<VkFence> m_fences;
+  // Signaled when the last upload is done, the upload buffer and |m_transfer_cmd_buffer| can't be reused before that.
+  VkFence m_upload_fence;
+  // Number of submitted uploads.
+  U64 m_upload_fence_value = 0;
+  U64 m_completed_upload_fence_value = 0;
   U32 m_next_swapchain_image_idx;
   VkSemaphore m_image_available_semaphore;
   VkSemaphore m_rendering_finished_semaphore;
@@ -94,7 +102,11 @@ private:
   bool create_buffer_(Vk_buffer_t_* buffer, Sz size, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlagBits mem_prop_flags);
   void allocate_sub_buffer_(Vk_sub_buffer_t_* sub_buffer, Vk_buffer_t_* buffer, Sip size, int alignment);
   VkCommandBuffer get_active_cmd_buffer_() const;
-  void create_image_(VkImage* image, VkDeviceMemory* memory, U32 width, U32 height, VkFormat format, VkImageUsageFlags usage, VkImageCreateFlags flags);
+  void create_image_(VkImage* image, VkDeviceMemory* memory, U32 width, U32 height, U32 mip_count, U32 layer_count, VkFormat format, VkImageUsageFlags usage, VkImageCreateFlags flags);
+  // Uploads all the subresources of |ci| in one copy.
+  Texture_t* create_texture_(Allocator_t* allocator, const Texture_create_info_t& ci, bool is_cube);
   void create_swapchain_();
   void create_framebuffers_(Vulkan_render_pass_t* render_pass);
+  void submit_upload_();
+  void wait_for_upload_();
 };
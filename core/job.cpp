@@ -0,0 +1,414 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/job.h"
+
+#include "core/allocator.h"
+#include "core/linear_allocator.h"
+#include "core/log.h"
+#include "core/profiler.h"
+#include "core/thread.h"
+#include "core/utils.h"
+
+// Capacity of a worker's deque, must be a power of 2. A job that doesn't fit is executed immediately.
+#define M_job_deque_size_ 4096
+// Number of jobs that a worker can allocate before reusing them, must be a power of 2.
+#define M_job_pool_size_ 4096
+// Size of the data that a job can carry inline.
+#define M_job_data_size_ 48
+// How many times an idle worker looks for a job before it sleeps.
+#define M_job_spin_count_ 64
+
+struct Job_t_ {
+  Job_func_t func;
+  void* args;
+  Job_counter_t* counter;
+  // Next pending job of a counter.
+  Job_t_* next;
+  // True until the job has finished, then it can be reused.
+  std::atomic<bool> is_busy;
+  alignas(8) U8 data[M_job_data_size_];
+};
+
+// Chase-Lev deque ("Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al. 2013) with a fixed capacity.
+// Only the owner pushes and pops at |bottom|, other workers steal at |top|.
+struct Job_deque_t_ {
+  alignas(64) std::atomic<S64> top;
+  alignas(64) std::atomic<S64> bottom;
+  alignas(64) std::atomic<Job_t_*> jobs[M_job_deque_size_];
+};
+
+struct Job_worker_t_ {
+  Job_deque_t_ deque;
+  Job_t_ pool[M_job_pool_size_];
+  // Only used by the owner.
+  U32 pool_index;
+  U32 random_state;
+  Thread_t thread;
+};
+
+struct Job_range_args_t_ {
+  Job_range_func_t func;
+  void* args;
+  Job_counter_t* counter;
+  int begin;
+  int end;
+  int grain_size;
+};
+static_assert(sizeof(Job_range_args_t_) <= M_job_data_size_);
+
+// Owns the workers, it's destroyed with the job system so the system can be initialized again.
+static Linear_allocator_t<> g_job_allocator_("job_allocator");
+static Job_worker_t_* g_job_workers_ = NULL;
+static int g_job_worker_count_ = 0;
+static std::atomic<bool> g_job_is_running_;
+static std::atomic<int> g_job_sleeping_count_;
+static std::atomic<U32> g_job_wake_seq_;
+static thread_local int g_job_worker_index_ = -1;
+
+static bool push_(Job_deque_t_* deque, Job_t_* job) {
+  S64 b = deque->bottom.load(std::memory_order_relaxed);
+  S64 t = deque->top.load(std::memory_order_acquire);
+  if (b - t >= M_job_deque_size_) {
+    return false;
+  }
+  deque->jobs[b & (M_job_deque_size_ - 1)].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  deque->bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+static Job_t_* pop_(Job_deque_t_* deque) {
+  S64 b = deque->bottom.load(std::memory_order_relaxed) - 1;
+  deque->bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  S64 t = deque->top.load(std::memory_order_relaxed);
+  if (t > b) {
+    deque->bottom.store(b + 1, std::memory_order_relaxed);
+    return NULL;
+  }
+  Job_t_* job = deque->jobs[b & (M_job_deque_size_ - 1)].load(std::memory_order_relaxed);
+  if (t == b) {
+    // The last job, race with the thieves.
+    if (!deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      job = NULL;
+    }
+    deque->bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+static Job_t_* steal_(Job_deque_t_* deque) {
+  S64 t = deque->top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  S64 b = deque->bottom.load(std::memory_order_acquire);
+  if (t >= b) {
+    return NULL;
+  }
+  Job_t_* job = deque->jobs[t & (M_job_deque_size_ - 1)].load(std::memory_order_relaxed);
+  if (!deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+    return NULL;
+  }
+  return job;
+}
+
+static bool has_any_job_() {
+  for (int i = 0; i < g_job_worker_count_; ++i) {
+    Job_deque_t_* deque = &g_job_workers_[i].deque;
+    if (deque->bottom.load(std::memory_order_seq_cst) > deque->top.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Pops a job of the current worker or steals one from the others, starting at a random worker.
+static Job_t_* get_job_() {
+  Job_worker_t_* worker = &g_job_workers_[g_job_worker_index_];
+  Job_t_* job = pop_(&worker->deque);
+  if (job) {
+    return job;
+  }
+  // xorshift32
+  U32 r = worker->random_state;
+  r ^= r << 13;
+  r ^= r >> 17;
+  r ^= r << 5;
+  worker->random_state = r;
+  for (int i = 0; i < g_job_worker_count_; ++i) {
+    int victim = (r + i) % g_job_worker_count_;
+    if (victim == g_job_worker_index_) {
+      continue;
+    }
+    job = steal_(&g_job_workers_[victim].deque);
+    if (job) {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+static void wake_workers_(int job_count) {
+  // Pairs with the fence in worker_loop_() so either the worker sees the new jobs or we see it sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (g_job_sleeping_count_.load(std::memory_order_relaxed) > 0) {
+    g_job_wake_seq_.fetch_add(1, std::memory_order_seq_cst);
+    if (job_count == 1) {
+      g_job_wake_seq_.notify_one();
+    } else {
+      g_job_wake_seq_.notify_all();
+    }
+  }
+}
+
+static void execute_(Job_t_* job);
+
+// Pushes the jobs to the current worker's deque. A thread that isn't a worker doesn't have one so it runs them.
+static void schedule_(Job_t_* jobs) {
+  int job_count = 0;
+  for (Job_t_* job = jobs; job;) {
+    Job_t_* next = job->next;
+    if (g_job_worker_index_ != -1 && push_(&g_job_workers_[g_job_worker_index_].deque, job)) {
+      ++job_count;
+    } else {
+      execute_(job);
+    }
+    job = next;
+  }
+  if (job_count) {
+    wake_workers_(job_count);
+  }
+}
+
+static void decrement_counter_(Job_counter_t* counter) {
+  int count = counter->m_count.load(std::memory_order_relaxed);
+  while (true) {
+    if (count == 1) {
+      // The counter is locked before it reaches 0 so job_wait() doesn't return while its pending jobs are being taken.
+      counter->m_mutex.lock();
+      if (counter->m_count.compare_exchange_strong(count, 0, std::memory_order_acq_rel)) {
+        Job_t_* pending_jobs = counter->m_pending_jobs;
+        counter->m_pending_jobs = NULL;
+        counter->m_mutex.unlock();
+        schedule_(pending_jobs);
+        return;
+      }
+      counter->m_mutex.unlock();
+    } else if (counter->m_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+}
+
+static void execute_(Job_t_* job) {
+  job->func(job->args);
+  Job_counter_t* counter = job->counter;
+  job->is_busy.store(false, std::memory_order_release);
+  if (counter) {
+    decrement_counter_(counter);
+  }
+}
+
+static bool try_execute_one_job_() {
+  Job_t_* job = get_job_();
+  if (job) {
+    execute_(job);
+    return true;
+  }
+  return false;
+}
+
+static Job_t_* alloc_job_(Job_func_t func, void* args, Job_counter_t* counter) {
+  Job_worker_t_* worker = &g_job_workers_[g_job_worker_index_];
+  Job_t_* job;
+  // Skip the jobs that haven't finished, some jobs can stay in a deque for a long time.
+  // If they are all busy, help until one finishes.
+  while (true) {
+    int i = 0;
+    for (; i < M_job_pool_size_; ++i) {
+      job = &worker->pool[worker->pool_index++ & (M_job_pool_size_ - 1)];
+      if (!job->is_busy.load(std::memory_order_acquire)) {
+        break;
+      }
+    }
+    if (i < M_job_pool_size_) {
+      break;
+    }
+    if (!try_execute_one_job_()) {
+      Thread_t::yield();
+    }
+  }
+  job->func = func;
+  job->args = args;
+  job->counter = counter;
+  job->next = NULL;
+  job->is_busy.store(true, std::memory_order_relaxed);
+  return job;
+}
+
+static void worker_loop_(void* args) {
+  g_job_worker_index_ = (int)(Sip)args;
+  profiler_set_thread_name("job worker");
+  int idle_count = 0;
+  while (g_job_is_running_.load(std::memory_order_acquire)) {
+    if (try_execute_one_job_()) {
+      idle_count = 0;
+      continue;
+    }
+    if (++idle_count < M_job_spin_count_) {
+      Thread_t::yield();
+      continue;
+    }
+    U32 seq = g_job_wake_seq_.load(std::memory_order_seq_cst);
+    g_job_sleeping_count_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_any_job_() && g_job_is_running_.load(std::memory_order_acquire)) {
+      g_job_wake_seq_.wait(seq, std::memory_order_seq_cst);
+    }
+    g_job_sleeping_count_.fetch_sub(1, std::memory_order_relaxed);
+    idle_count = 0;
+  }
+}
+
+bool job_system_init(int worker_count) {
+  M_check_log_return_val(!g_job_workers_, false, "The job system is already initialized");
+  if (worker_count <= 0) {
+    worker_count = Thread_t::get_total_thread_count();
+  }
+  worker_count = max(worker_count, 1);
+  g_job_workers_ = (Job_worker_t_*)g_job_allocator_.aligned_alloc(worker_count * sizeof(Job_worker_t_), alignof(Job_worker_t_));
+  M_check_log_return_val(g_job_workers_, false, "Can't allocate the job workers");
+  for (int i = 0; i < worker_count; ++i) {
+    new (&g_job_workers_[i]) Job_worker_t_();
+    g_job_workers_[i].random_state = i * 2654435761u + 1;
+  }
+  g_job_worker_count_ = worker_count;
+  g_job_worker_index_ = 0;
+  g_job_is_running_.store(true, std::memory_order_release);
+  for (int i = 1; i < worker_count; ++i) {
+    if (!g_job_workers_[i].thread.init(worker_loop_, (void*)(Sip)i)) {
+      // Nobody pops this worker's deque but its jobs can still be stolen, so keep the worker count as it is.
+      M_logw("Can't create job worker %d", i);
+    }
+  }
+  return true;
+}
+
+void job_system_destroy() {
+  if (!g_job_workers_) {
+    return;
+  }
+  g_job_is_running_.store(false, std::memory_order_release);
+  g_job_wake_seq_.fetch_add(1, std::memory_order_seq_cst);
+  g_job_wake_seq_.notify_all();
+  for (int i = 1; i < g_job_worker_count_; ++i) {
+    g_job_workers_[i].thread.wait_for();
+  }
+  for (int i = 0; i < g_job_worker_count_; ++i) {
+    g_job_workers_[i].~Job_worker_t_();
+  }
+  g_job_allocator_.destroy();
+  g_job_workers_ = NULL;
+  g_job_worker_count_ = 0;
+  g_job_worker_index_ = -1;
+}
+
+int job_get_worker_count() {
+  return max(g_job_worker_count_, 1);
+}
+
+int job_get_worker_index() {
+  return g_job_worker_index_;
+}
+
+void job_run(const Job_decl_t* jobs, int count, Job_counter_t* counter, Job_counter_t* dependency) {
+  if (count <= 0) {
+    return;
+  }
+  if (counter) {
+    counter->m_count.fetch_add(count, std::memory_order_relaxed);
+  }
+  if (g_job_worker_index_ == -1) {
+    // Not a worker (or the job system isn't initialized), run the jobs now.
+    if (dependency) {
+      job_wait(dependency);
+    }
+    // The counter may have jobs that wait for it so it's decremented like the jobs of the workers.
+    for (int i = 0; i < count; ++i) {
+      jobs[i].func(jobs[i].args);
+      if (counter) {
+        decrement_counter_(counter);
+      }
+    }
+    return;
+  }
+  Job_t_* first = NULL;
+  Job_t_* last = NULL;
+  for (int i = 0; i < count; ++i) {
+    Job_t_* job = alloc_job_(jobs[i].func, jobs[i].args, counter);
+    if (last) {
+      last->next = job;
+    } else {
+      first = job;
+    }
+    last = job;
+  }
+  if (dependency) {
+    Scope_lock_t lock(&dependency->m_mutex);
+    if (dependency->m_count.load(std::memory_order_acquire) > 0) {
+      last->next = dependency->m_pending_jobs;
+      dependency->m_pending_jobs = first;
+      return;
+    }
+  }
+  schedule_(first);
+}
+
+void job_wait(Job_counter_t* counter) {
+  while (counter->m_count.load(std::memory_order_acquire) > 0 || counter->m_mutex.m_state.load(std::memory_order_acquire) != Mutex_t::e_state_unlocked) {
+    if (g_job_worker_index_ == -1 || !try_execute_one_job_()) {
+      Thread_t::yield();
+    }
+  }
+}
+
+bool job_execute_one() {
+  return g_job_worker_index_ != -1 && try_execute_one_job_();
+}
+
+static void range_job_(void* args) {
+  Job_range_args_t_ range = *(Job_range_args_t_*)args;
+  // Split the range in halves, the other halves can be stolen while this worker continues with the first half.
+  while (range.end - range.begin > range.grain_size) {
+    int mid = range.begin + (range.end - range.begin) / 2;
+    Job_t_* job = alloc_job_(range_job_, NULL, range.counter);
+    Job_range_args_t_* half = (Job_range_args_t_*)job->data;
+    *half = range;
+    half->begin = mid;
+    job->args = half;
+    range.counter->m_count.fetch_add(1, std::memory_order_relaxed);
+    schedule_(job);
+    range.end = mid;
+  }
+  range.func(range.begin, range.end, range.args);
+}
+
+void job_parallel_for(int begin, int end, int grain_size, Job_range_func_t func, void* args) {
+  if (begin >= end) {
+    return;
+  }
+  if (grain_size <= 0) {
+    grain_size = max((end - begin) / (job_get_worker_count() * 4), 1);
+  }
+  if (g_job_worker_index_ == -1 || end - begin <= grain_size) {
+    func(begin, end, args);
+    return;
+  }
+  Job_counter_t counter;
+  Job_range_args_t_ range = {func, args, &counter, begin, end, grain_size};
+  range_job_(&range);
+  job_wait(&counter);
+}
@@ -0,0 +1,62 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/sync.h"
+#include "core/types.h"
+
+#include <atomic>
+
+// A work-stealing job system.
+// There is one worker per hardware thread, the thread that calls job_system_init() is worker 0 and the rest are new threads.
+// Each worker has a Chase-Lev deque: it pushes and pops jobs at the bottom and the other workers steal from the top.
+// Jobs can only be run and waited for from workers (including inside jobs).
+
+struct Job_t_;
+
+typedef void (*Job_func_t)(void* args);
+typedef void (*Job_range_func_t)(int begin, int end, void* args);
+
+struct Job_decl_t {
+  Job_func_t func;
+  void* args;
+};
+
+// Counts the unfinished jobs that are run with it.
+// Jobs can also be run after a counter reaches 0, which is how dependencies between jobs are expressed.
+struct Job_counter_t {
+  std::atomic<int> m_count{0};
+  // Jobs that are waiting for this counter to reach 0.
+  Job_t_* m_pending_jobs = NULL;
+  // Guards |m_pending_jobs| and the last decrement.
+  Mutex_t m_mutex;
+};
+
+// |worker_count| <= 0 means one worker per hardware thread.
+bool job_system_init(int worker_count = 0);
+void job_system_destroy();
+int job_get_worker_count();
+// Returns -1 if the current thread is not a worker.
+int job_get_worker_index();
+
+// Runs |count| jobs. |counter| (can be NULL) is incremented by |count| now and decremented when each job finishes.
+// If |dependency| is not NULL, the jobs start only after it reaches 0.
+void job_run(const Job_decl_t* jobs, int count, Job_counter_t* counter, Job_counter_t* dependency = NULL);
+// Runs other jobs until |counter| reaches 0.
+void job_wait(Job_counter_t* counter);
+// Runs one job of the current worker or steals one. Returns false if there wasn't any job or the current thread is not a worker.
+bool job_execute_one();
+// Calls |func| on sub-ranges of [begin, end) in parallel and waits for all of them.
+// The range is split in halves until a sub-range has at most |grain_size| indices.
+// |grain_size| <= 0 picks one that makes about 4 sub-ranges per worker.
+void job_parallel_for(int begin, int end, int grain_size, Job_range_func_t func, void* args);
+
+// |func| is called as func(int begin, int end).
+template <typename T_func>
+void job_parallel_for(int begin, int end, int grain_size, const T_func& func) {
+  job_parallel_for(begin, end, grain_size, [](int b, int e, void* args) { (*(const T_func*)args)(b, e); }, (void*)&func);
+}
@@ -35,6 +35,12 @@ void Linear_allocator_t<T_initial_size>::destroy() {
     ::free(page);
     page = next;
   }
+  // Back to the stack page so the allocator can be used again.
+  m_first_page->next = NULL;
+  m_current_page = m_first_page;
+  m_top = (U8*)(m_current_page + 1);
+  m_total_size = T_initial_size;
+  m_used_size = sizeof(Linear_allocator_page_t_);
 }
 
 template <Sz T_initial_size>
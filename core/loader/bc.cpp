@@ -0,0 +1,1129 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/bc.h"
+
+#include "core/job.h"
+#include "core/log.h"
+#include "core/profiler.h"
+#include "core/utils.h"
+
+#include <math.h>
+#include <string.h>
+
+// SSE2 is always there on x64.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define M_bc_sse2_ 1
+#include <emmintrin.h>
+#endif
+
+// Images that have fewer blocks are done by one job.
+static const int gc_min_parallel_block_count_ = 1024;
+// Rows of a job are about this many blocks.
+static const int gc_job_block_count_ = 256;
+
+// Bytes of a pixel that are compared, one byte for each channel.
+static const U32 gc_channel_r_ = 0x000000ff;
+static const U32 gc_channel_a_ = 0xff000000;
+static const U32 gc_channel_rgb_ = 0x00ffffff;
+static const U32 gc_channel_rgba_ = 0xffffffff;
+
+// Interpolation weights out of 64 for 2, 3 and 4 bit indices.
+static const int gc_bc7_weights2_[] = {0, 21, 43, 64};
+static const int gc_bc7_weights3_[] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const int gc_bc7_weights4_[] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// Bit i is the subset of pixel i.
+static const U16 gc_bc7_partitions2_[64] = {
+  0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80, 0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+  0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce, 0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+  0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a, 0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+  0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c, 0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+// Bits 2i and 2i + 1 are the subset of pixel i.
+static const U32 gc_bc7_partitions3_[64] = {
+  0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+  0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+  0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+  0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+  0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+  0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+  0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+  0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+};
+
+// The anchor of subset 0 is always pixel 0, the index of an anchor has one bit less because its highest bit is 0.
+static const U8 gc_bc7_anchors2_[64] = {
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+  15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+  6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+};
+
+static const U8 gc_bc7_anchors3_[64][2] = {
+  {3, 15}, {3, 8}, {15, 8}, {15, 3}, {8, 15}, {3, 15}, {15, 3}, {15, 8},
+  {8, 15}, {8, 15}, {6, 15}, {6, 15}, {6, 15}, {5, 15}, {3, 15}, {3, 8},
+  {3, 15}, {3, 8}, {8, 15}, {15, 3}, {3, 15}, {3, 8}, {6, 15}, {10, 8},
+  {5, 3}, {8, 15}, {8, 6}, {6, 10}, {8, 15}, {5, 15}, {15, 10}, {15, 8},
+  {8, 15}, {15, 3}, {3, 15}, {5, 10}, {6, 10}, {10, 8}, {8, 9}, {15, 10},
+  {15, 6}, {3, 15}, {15, 8}, {5, 15}, {15, 3}, {15, 6}, {15, 6}, {15, 8},
+  {3, 15}, {15, 3}, {5, 15}, {5, 15}, {5, 15}, {8, 15}, {5, 15}, {10, 15},
+  {5, 15}, {10, 15}, {8, 15}, {13, 15}, {15, 3}, {12, 15}, {3, 15}, {3, 8},
+};
+
+struct Bc7_mode_t_ {
+  int subset_count;
+  int partition_bits;
+  int rotation_bits;
+  int index_selection_bits;
+  int color_bits;
+  // 0 means the alpha is 255.
+  int alpha_bits;
+  // The lowest bit of all the components of an endpoint, there is one for each endpoint or one for both endpoints of a subset.
+  bool has_endpoint_p_bits;
+  bool has_shared_p_bits;
+  int index_bits;
+  // The alpha of modes 4 and 5 has its own indices.
+  int index2_bits;
+};
+
+static const Bc7_mode_t_ gc_bc7_modes_[8] = {
+  {3, 4, 0, 0, 4, 0, true, false, 3, 0},
+  {2, 6, 0, 0, 6, 0, false, true, 3, 0},
+  {3, 6, 0, 0, 5, 0, false, false, 2, 0},
+  {2, 6, 0, 0, 7, 0, true, false, 2, 0},
+  {1, 0, 2, 1, 5, 6, false, false, 2, 3},
+  {1, 0, 2, 0, 7, 8, false, false, 2, 2},
+  {1, 0, 0, 0, 7, 7, true, false, 4, 0},
+  {2, 6, 0, 0, 5, 5, true, false, 2, 0},
+};
+
+// Number of partitions that are tried by modes 1 and 3 for each quality.
+static const int gc_bc7_partition_counts_[] = {0, 1, 4, 16};
+
+// The 16 pixels of a 4x4 block, row by row. It's aligned for the SSE2 loads.
+struct alignas(16) Bc_block_t_ {
+  U8 pixels[16][4];
+};
+
+// The endpoints of a BC7 subset before and after they are expanded to 8 bits.
+struct Bc7_endpoints_t_ {
+  U8 quantized[2][4];
+  U8 p_bits[2];
+  U8 colors[2][4];
+};
+
+struct Bc7_block_t_ {
+  int mode;
+  int partition;
+  Bc7_endpoints_t_ endpoints[3];
+  U8 indices[16];
+  U8 indices2[16];
+  U32 error;
+};
+
+struct Bc_encoder_t_ {
+  const U8* src;
+  U8* dst;
+  U32 width;
+  U32 height;
+  U32 block_width;
+  U32 block_height;
+  int block_size;
+  E_bc_format format;
+  E_bc_quality quality;
+  bool is_simd;
+};
+
+static const int* get_bc7_weights_(int index_bits) {
+  return index_bits == 2 ? gc_bc7_weights2_ : (index_bits == 3 ? gc_bc7_weights3_ : gc_bc7_weights4_);
+}
+
+static int get_bc7_subset_(int subset_count, int partition, int pixel) {
+  if (subset_count == 2) {
+    return (gc_bc7_partitions2_[partition] >> pixel) & 1;
+  }
+  if (subset_count == 3) {
+    return (gc_bc7_partitions3_[partition] >> (2 * pixel)) & 3;
+  }
+  return 0;
+}
+
+static int get_bc7_anchor_(int subset_count, int partition, int subset) {
+  if (subset == 0) {
+    return 0;
+  }
+  return subset_count == 2 ? gc_bc7_anchors2_[partition] : gc_bc7_anchors3_[partition][subset - 1];
+}
+
+// Finds the closest entry of |palette| to each pixel in |pixel_mask|, only the bytes in |channel_mask| are compared.
+// Returns the sum of the squared errors of those pixels, the indices of the other pixels are not written.
+static U32 find_indices_scalar_(const Bc_block_t_& block, const U8 (*palette)[4], int palette_count, U32 channel_mask, U32 pixel_mask, U8* o_indices) {
+  U32 error = 0;
+  for (int i = 0; i < 16; ++i) {
+    if (!(pixel_mask & (1 << i))) {
+      continue;
+    }
+    U32 best_error = 0xffffffff;
+    int best_index = 0;
+    for (int j = 0; j < palette_count; ++j) {
+      U32 e = 0;
+      for (int c = 0; c < 4; ++c) {
+        if ((channel_mask >> (c * 8)) & 0xff) {
+          int d = block.pixels[i][c] - palette[j][c];
+          e += d * d;
+        }
+      }
+      if (e < best_error) {
+        best_error = e;
+        best_index = j;
+      }
+    }
+    o_indices[i] = best_index;
+    error += best_error;
+  }
+  return error;
+}
+
+#if M_bc_sse2_
+// 4 pixels are compared to an entry at a time. The absolute differences are done on bytes and squared with madd on 16 bits.
+static U32 find_indices_sse2_(const Bc_block_t_& block, const U8 (*palette)[4], int palette_count, U32 channel_mask, U32 pixel_mask, U8* o_indices) {
+  __m128i mask = _mm_set1_epi32(channel_mask);
+  __m128i zero = _mm_setzero_si128();
+  __m128i pixels[4];
+  __m128i best_errors[4];
+  __m128i best_indices[4];
+  for (int i = 0; i < 4; ++i) {
+    pixels[i] = _mm_and_si128(_mm_load_si128((const __m128i*)block.pixels[i * 4]), mask);
+    best_errors[i] = _mm_set1_epi32(0x7fffffff);
+    best_indices[i] = zero;
+  }
+  for (int j = 0; j < palette_count; ++j) {
+    U32 entry;
+    memcpy(&entry, palette[j], 4);
+    __m128i e = _mm_and_si128(_mm_set1_epi32(entry), mask);
+    __m128i index = _mm_set1_epi32(j);
+    for (int i = 0; i < 4; ++i) {
+      __m128i d = _mm_or_si128(_mm_subs_epu8(pixels[i], e), _mm_subs_epu8(e, pixels[i]));
+      // RG and BA of 2 pixels.
+      __m128i lo = _mm_unpacklo_epi8(d, zero);
+      __m128i hi = _mm_unpackhi_epi8(d, zero);
+      lo = _mm_madd_epi16(lo, lo);
+      hi = _mm_madd_epi16(hi, hi);
+      __m128 rg = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 ba = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+      __m128i error = _mm_add_epi32(_mm_castps_si128(rg), _mm_castps_si128(ba));
+      // Strictly less so the first of the equal entries is kept like the scalar code.
+      __m128i is_better = _mm_cmplt_epi32(error, best_errors[i]);
+      best_errors[i] = _mm_or_si128(_mm_and_si128(is_better, error), _mm_andnot_si128(is_better, best_errors[i]));
+      best_indices[i] = _mm_or_si128(_mm_and_si128(is_better, index), _mm_andnot_si128(is_better, best_indices[i]));
+    }
+  }
+  alignas(16) U32 errors[16];
+  alignas(16) U32 indices[16];
+  for (int i = 0; i < 4; ++i) {
+    _mm_store_si128((__m128i*)&errors[i * 4], best_errors[i]);
+    _mm_store_si128((__m128i*)&indices[i * 4], best_indices[i]);
+  }
+  U32 error = 0;
+  for (int i = 0; i < 16; ++i) {
+    if (pixel_mask & (1 << i)) {
+      o_indices[i] = indices[i];
+      error += errors[i];
+    }
+  }
+  return error;
+}
+#endif
+
+static U32 find_indices_(const Bc_encoder_t_* e, const Bc_block_t_& block, const U8 (*palette)[4], int palette_count, U32 channel_mask, U32 pixel_mask, U8* o_indices) {
+#if M_bc_sse2_
+  if (e->is_simd) {
+    return find_indices_sse2_(block, palette, palette_count, channel_mask, pixel_mask, o_indices);
+  }
+#endif
+  return find_indices_scalar_(block, palette, palette_count, channel_mask, pixel_mask, o_indices);
+}
+
+static float clamp_255_(float v) {
+  return min(max(v, 0.0f), 255.0f);
+}
+
+// Fits a line through the pixels in |pixel_mask| along their principal axis, the endpoints are the projections of the extreme pixels.
+// Only the channels in |channel_mask| are used, the others are 0.
+static void fit_line_(const Bc_block_t_& block, U32 pixel_mask, U32 channel_mask, float o_endpoints[2][4]) {
+  bool has_channels[4];
+  for (int c = 0; c < 4; ++c) {
+    has_channels[c] = (channel_mask >> (c * 8)) & 0xff;
+  }
+  float mean[4] = {};
+  int count = 0;
+  for (int i = 0; i < 16; ++i) {
+    if (pixel_mask & (1 << i)) {
+      for (int c = 0; c < 4; ++c) {
+        mean[c] += has_channels[c] ? block.pixels[i][c] : 0;
+      }
+      ++count;
+    }
+  }
+  for (int c = 0; c < 4; ++c) {
+    mean[c] /= max(count, 1);
+  }
+  float covariance[4][4] = {};
+  for (int i = 0; i < 16; ++i) {
+    if (!(pixel_mask & (1 << i))) {
+      continue;
+    }
+    float d[4];
+    for (int c = 0; c < 4; ++c) {
+      d[c] = has_channels[c] ? block.pixels[i][c] - mean[c] : 0.0f;
+    }
+    for (int a = 0; a < 4; ++a) {
+      for (int b = a; b < 4; ++b) {
+        covariance[a][b] += d[a] * d[b];
+      }
+    }
+  }
+  // The power iteration starts from the row of the channel that varies the most.
+  int start = 0;
+  for (int c = 1; c < 4; ++c) {
+    start = covariance[c][c] > covariance[start][start] ? c : start;
+  }
+  float axis[4];
+  for (int c = 0; c < 4; ++c) {
+    axis[c] = c < start ? covariance[c][start] : covariance[start][c];
+  }
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    float next[4] = {};
+    float max_value = 0.0f;
+    for (int a = 0; a < 4; ++a) {
+      for (int b = 0; b < 4; ++b) {
+        next[a] += (a < b ? covariance[a][b] : covariance[b][a]) * axis[b];
+      }
+      max_value = max(max_value, fabsf(next[a]));
+    }
+    if (max_value < 1e-6f) {
+      break;
+    }
+    for (int c = 0; c < 4; ++c) {
+      axis[c] = next[c] / max_value;
+    }
+  }
+  float length2 = 0.0f;
+  for (int c = 0; c < 4; ++c) {
+    length2 += axis[c] * axis[c];
+  }
+  if (length2 < 1e-6f) {
+    // All the pixels are the same.
+    for (int c = 0; c < 4; ++c) {
+      o_endpoints[0][c] = mean[c];
+      o_endpoints[1][c] = mean[c];
+    }
+    return;
+  }
+  float min_t = 1e30f;
+  float max_t = -1e30f;
+  for (int i = 0; i < 16; ++i) {
+    if (pixel_mask & (1 << i)) {
+      float t = 0.0f;
+      for (int c = 0; c < 4; ++c) {
+        t += has_channels[c] ? (block.pixels[i][c] - mean[c]) * axis[c] : 0.0f;
+      }
+      min_t = min(min_t, t);
+      max_t = max(max_t, t);
+    }
+  }
+  for (int c = 0; c < 4; ++c) {
+    o_endpoints[0][c] = clamp_255_(mean[c] + min_t / length2 * axis[c]);
+    o_endpoints[1][c] = clamp_255_(mean[c] + max_t / length2 * axis[c]);
+  }
+}
+
+// Least squares endpoints of the pixels in |pixel_mask| for their |indices|. |weights| are the positions of the indices between the endpoints,
+// a negative weight is an index that isn't between them (the black of BC1 or 0 and 255 of BC4). Returns false if the system can't be solved.
+static bool refine_line_(const Bc_block_t_& block, U32 pixel_mask, U32 channel_mask, const U8* indices, const float* weights, float o_endpoints[2][4]) {
+  float aa = 0.0f;
+  float ab = 0.0f;
+  float bb = 0.0f;
+  float ax[4] = {};
+  float bx[4] = {};
+  for (int i = 0; i < 16; ++i) {
+    // The indices of the other pixels may not be set.
+    if (!(pixel_mask & (1 << i))) {
+      continue;
+    }
+    float w = weights[indices[i]];
+    if (w < 0.0f) {
+      continue;
+    }
+    float a = 1.0f - w;
+    aa += a * a;
+    ab += a * w;
+    bb += w * w;
+    for (int c = 0; c < 4; ++c) {
+      ax[c] += a * block.pixels[i][c];
+      bx[c] += w * block.pixels[i][c];
+    }
+  }
+  float det = aa * bb - ab * ab;
+  if (fabsf(det) < 1e-6f) {
+    return false;
+  }
+  for (int c = 0; c < 4; ++c) {
+    if ((channel_mask >> (c * 8)) & 0xff) {
+      o_endpoints[0][c] = clamp_255_((bb * ax[c] - ab * bx[c]) / det);
+      o_endpoints[1][c] = clamp_255_((aa * bx[c] - ab * ax[c]) / det);
+    }
+  }
+  return true;
+}
+
+static U8 expand_bits_(int value, int bits) {
+  value <<= 8 - bits;
+  return value | (value >> bits);
+}
+
+static void get_bc1_palette_(U16 c0, U16 c1, U8 (*o_palette)[4]) {
+  U16 colors[2] = {c0, c1};
+  for (int i = 0; i < 2; ++i) {
+    o_palette[i][0] = expand_bits_(colors[i] >> 11, 5);
+    o_palette[i][1] = expand_bits_((colors[i] >> 5) & 0x3f, 6);
+    o_palette[i][2] = expand_bits_(colors[i] & 0x1f, 5);
+    o_palette[i][3] = 255;
+  }
+  for (int c = 0; c < 3; ++c) {
+    if (c0 > c1) {
+      o_palette[2][c] = (2 * o_palette[0][c] + o_palette[1][c]) / 3;
+      o_palette[3][c] = (o_palette[0][c] + 2 * o_palette[1][c]) / 3;
+    } else {
+      o_palette[2][c] = (o_palette[0][c] + o_palette[1][c]) / 2;
+      o_palette[3][c] = 0;
+    }
+  }
+  o_palette[2][3] = 255;
+  o_palette[3][3] = c0 > c1 ? 255 : 0;
+}
+
+// The values are in all the channels so the palette can be compared to any channel.
+static void get_bc4_palette_(U8 e0, U8 e1, U8 (*o_palette)[4]) {
+  U8 values[8];
+  values[0] = e0;
+  values[1] = e1;
+  if (e0 > e1) {
+    for (int i = 2; i < 8; ++i) {
+      values[i] = ((8 - i) * e0 + (i - 1) * e1) / 7;
+    }
+  } else {
+    for (int i = 2; i < 6; ++i) {
+      values[i] = ((6 - i) * e0 + (i - 1) * e1) / 5;
+    }
+    values[6] = 0;
+    values[7] = 255;
+  }
+  for (int i = 0; i < 8; ++i) {
+    memset(o_palette[i], values[i], 4);
+  }
+}
+
+static void get_bc7_palette_(const U8 colors[2][4], int index_bits, U8 (*o_palette)[4]) {
+  const int* weights = get_bc7_weights_(index_bits);
+  for (int i = 0; i < (1 << index_bits); ++i) {
+    for (int c = 0; c < 4; ++c) {
+      o_palette[i][c] = ((64 - weights[i]) * colors[0][c] + weights[i] * colors[1][c] + 32) >> 6;
+    }
+  }
+}
+
+static U16 quantize_565_(const float color[4]) {
+  int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+  int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+  int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+  return (r << 11) | (g << 5) | b;
+}
+
+static void load_block_(const Bc_encoder_t_* e, U32 block_x, U32 block_y, Bc_block_t_* o_block) {
+  for (U32 y = 0; y < 4; ++y) {
+    U32 src_y = min(block_y * 4 + y, e->height - 1);
+    for (U32 x = 0; x < 4; ++x) {
+      U32 src_x = min(block_x * 4 + x, e->width - 1);
+      memcpy(o_block->pixels[y * 4 + x], e->src + ((Sip)src_y * e->width + src_x) * 4, 4);
+    }
+  }
+}
+
+// Evaluates the 565 endpoints |c0| and |c1|. They are ordered for the 4 color mode, or for the 3 color mode if there are transparent pixels.
+static U32 evaluate_bc1_(const Bc_encoder_t_* e, const Bc_block_t_& block, U32 opaque_mask, U16* c0, U16* c1, U8* o_indices) {
+  bool has_alpha = opaque_mask != 0xffff;
+  if (has_alpha ? *c0 > *c1 : *c0 < *c1) {
+    swap(c0, c1);
+  }
+  U8 palette[4][4];
+  get_bc1_palette_(*c0, *c1, palette);
+  // The 4th entry of the 3 color mode is transparent.
+  U32 error = find_indices_(e, block, palette, *c0 > *c1 ? 4 : 3, gc_channel_rgb_, opaque_mask, o_indices);
+  for (int i = 0; i < 16; ++i) {
+    if (!(opaque_mask & (1 << i))) {
+      o_indices[i] = 3;
+    }
+  }
+  return error;
+}
+
+static void encode_bc1_(const Bc_encoder_t_* e, const Bc_block_t_& block, U8* dst) {
+  static const float sc_weights4[] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+  static const float sc_weights3[] = {0.0f, 1.0f, 0.5f, -1.0f};
+  U32 opaque_mask = 0;
+  for (int i = 0; i < 16; ++i) {
+    opaque_mask |= block.pixels[i][3] >= 128 ? 1 << i : 0;
+  }
+  U16 best_colors[2] = {0, 0};
+  U8 best_indices[16];
+  memset(best_indices, 3, sizeof(best_indices));
+  if (opaque_mask) {
+    float endpoints[2][4];
+    fit_line_(block, opaque_mask, gc_channel_rgb_, endpoints);
+    U32 best_error = 0xffffffff;
+    for (int i = 0; i < 3; ++i) {
+      U16 c0 = quantize_565_(endpoints[0]);
+      U16 c1 = quantize_565_(endpoints[1]);
+      U8 indices[16];
+      U32 error = evaluate_bc1_(e, block, opaque_mask, &c0, &c1, indices);
+      if (error < best_error) {
+        best_error = error;
+        best_colors[0] = c0;
+        best_colors[1] = c1;
+        memcpy(best_indices, indices, sizeof(indices));
+      }
+      // The endpoints may have been swapped.
+      if (c0 != quantize_565_(endpoints[0])) {
+        for (int c = 0; c < 4; ++c) {
+          swap(&endpoints[0][c], &endpoints[1][c]);
+        }
+      }
+      if (!error || !refine_line_(block, opaque_mask, gc_channel_rgb_, indices, c0 > c1 ? sc_weights4 : sc_weights3, endpoints)) {
+        break;
+      }
+    }
+  }
+  memcpy(dst, best_colors, 4);
+  U32 indices = 0;
+  for (int i = 0; i < 16; ++i) {
+    indices |= best_indices[i] << (2 * i);
+  }
+  memcpy(dst + 4, &indices, 4);
+}
+
+static U32 evaluate_bc4_(const Bc_encoder_t_* e, const Bc_block_t_& block, U32 channel_mask, U8 e0, U8 e1, U8* o_indices) {
+  U8 palette[8][4];
+  get_bc4_palette_(e0, e1, palette);
+  return find_indices_(e, block, palette, 8, channel_mask, 0xffff, o_indices);
+}
+
+static void encode_bc4_(const Bc_encoder_t_* e, const Bc_block_t_& block, int channel, U8* dst) {
+  static const float sc_weights8[] = {0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f};
+  static const float sc_weights6[] = {0.0f, 1.0f, 1.0f / 5.0f, 2.0f / 5.0f, 3.0f / 5.0f, 4.0f / 5.0f, -1.0f, -1.0f};
+  U32 channel_mask = gc_channel_r_ << (channel * 8);
+  int min_value = 255;
+  int max_value = 0;
+  // Without 0 and 255, they are in the palette of the 6 value mode.
+  int inner_min_value = 255;
+  int inner_max_value = 0;
+  for (int i = 0; i < 16; ++i) {
+    int v = block.pixels[i][channel];
+    min_value = min(min_value, v);
+    max_value = max(max_value, v);
+    if (v != 0 && v != 255) {
+      inner_min_value = min(inner_min_value, v);
+      inner_max_value = max(inner_max_value, v);
+    }
+  }
+  U8 best_endpoints[2] = {(U8)max_value, (U8)min_value};
+  U8 best_indices[16];
+  U32 best_error = evaluate_bc4_(e, block, channel_mask, best_endpoints[0], best_endpoints[1], best_indices);
+  U8 indices[16];
+  memcpy(indices, best_indices, sizeof(indices));
+  float endpoints[2][4] = {};
+  // The 8 value mode is refined.
+  for (int i = 0; i < 2 && best_error && max_value > min_value; ++i) {
+    if (!refine_line_(block, 0xffff, channel_mask, indices, sc_weights8, endpoints)) {
+      break;
+    }
+    U8 e0 = (U8)(endpoints[0][channel] + 0.5f);
+    U8 e1 = (U8)(endpoints[1][channel] + 0.5f);
+    if (e0 <= e1) {
+      break;
+    }
+    U32 error = evaluate_bc4_(e, block, channel_mask, e0, e1, indices);
+    if (error >= best_error) {
+      break;
+    }
+    best_error = error;
+    best_endpoints[0] = e0;
+    best_endpoints[1] = e1;
+    memcpy(best_indices, indices, sizeof(indices));
+  }
+  if (best_error && (min_value == 0 || max_value == 255)) {
+    U8 e0 = inner_min_value <= inner_max_value ? inner_min_value : 0;
+    U8 e1 = inner_min_value <= inner_max_value ? inner_max_value : 0;
+    for (int i = 0; i < 2; ++i) {
+      U32 error = evaluate_bc4_(e, block, channel_mask, e0, e1, indices);
+      if (error < best_error) {
+        best_error = error;
+        best_endpoints[0] = e0;
+        best_endpoints[1] = e1;
+        memcpy(best_indices, indices, sizeof(indices));
+      }
+      if (!error || !refine_line_(block, 0xffff, channel_mask, indices, sc_weights6, endpoints)) {
+        break;
+      }
+      e0 = (U8)(endpoints[0][channel] + 0.5f);
+      e1 = (U8)(endpoints[1][channel] + 0.5f);
+      if (e0 > e1) {
+        break;
+      }
+    }
+  }
+  dst[0] = best_endpoints[0];
+  dst[1] = best_endpoints[1];
+  U64 bits = 0;
+  for (int i = 0; i < 16; ++i) {
+    bits |= (U64)best_indices[i] << (3 * i);
+  }
+  for (int i = 0; i < 6; ++i) {
+    dst[2 + i] = (U8)(bits >> (8 * i));
+  }
+}
+
+// Quantizes |endpoints| to |bits| and the p-bit |p_bit| (-1 if there isn't one), returns the squared error of the expanded components.
+static float quantize_bc7_endpoint_(const float endpoint[4], U32 channel_mask, int color_bits, int alpha_bits, int p_bit, U8* o_quantized, U8* o_color) {
+  float error = 0.0f;
+  for (int c = 0; c < 4; ++c) {
+    if (!((channel_mask >> (c * 8)) & 0xff)) {
+      continue;
+    }
+    int bits = c < 3 ? color_bits : alpha_bits;
+    if (!bits) {
+      o_quantized[c] = 0;
+      o_color[c] = 255;
+      continue;
+    }
+    int total_bits = p_bit >= 0 ? bits + 1 : bits;
+    int max_value = (1 << bits) - 1;
+    float v = endpoint[c] * ((1 << total_bits) - 1) / 255.0f;
+    int q = (int)(p_bit >= 0 ? (v - p_bit) * 0.5f : v);
+    // The expansion isn't linear so the 2 closest values are compared.
+    float best_error = 1e30f;
+    for (int candidate = max(q, 0); candidate <= min(q + 1, max_value); ++candidate) {
+      U8 color = expand_bits_(p_bit >= 0 ? (candidate << 1) | p_bit : candidate, total_bits);
+      float d = color - endpoint[c];
+      if (d * d < best_error) {
+        best_error = d * d;
+        o_quantized[c] = candidate;
+        o_color[c] = color;
+      }
+    }
+    error += best_error;
+  }
+  return error;
+}
+
+static void quantize_bc7_endpoints_(const Bc7_mode_t_& mode, const float endpoints[2][4], U32 channel_mask, Bc7_endpoints_t_* o_endpoints) {
+  if (mode.has_endpoint_p_bits) {
+    for (int i = 0; i < 2; ++i) {
+      U8 quantized[4];
+      U8 color[4];
+      float error0 = quantize_bc7_endpoint_(endpoints[i], channel_mask, mode.color_bits, mode.alpha_bits, 0, o_endpoints->quantized[i], o_endpoints->colors[i]);
+      float error1 = quantize_bc7_endpoint_(endpoints[i], channel_mask, mode.color_bits, mode.alpha_bits, 1, quantized, color);
+      o_endpoints->p_bits[i] = error1 < error0;
+      if (error1 < error0) {
+        memcpy(o_endpoints->quantized[i], quantized, 4);
+        memcpy(o_endpoints->colors[i], color, 4);
+      }
+    }
+  } else if (mode.has_shared_p_bits) {
+    Bc7_endpoints_t_ other = *o_endpoints;
+    float error0 = 0.0f;
+    float error1 = 0.0f;
+    for (int i = 0; i < 2; ++i) {
+      error0 += quantize_bc7_endpoint_(endpoints[i], channel_mask, mode.color_bits, mode.alpha_bits, 0, o_endpoints->quantized[i], o_endpoints->colors[i]);
+      error1 += quantize_bc7_endpoint_(endpoints[i], channel_mask, mode.color_bits, mode.alpha_bits, 1, other.quantized[i], other.colors[i]);
+    }
+    o_endpoints->p_bits[0] = o_endpoints->p_bits[1] = 0;
+    if (error1 < error0) {
+      *o_endpoints = other;
+      o_endpoints->p_bits[0] = o_endpoints->p_bits[1] = 1;
+    }
+  } else {
+    for (int i = 0; i < 2; ++i) {
+      quantize_bc7_endpoint_(endpoints[i], channel_mask, mode.color_bits, mode.alpha_bits, -1, o_endpoints->quantized[i], o_endpoints->colors[i]);
+    }
+  }
+}
+
+// Fits the endpoints of the pixels in |pixel_mask| for the channels in |channel_mask| and finds their indices.
+// The other channels of |o_endpoints| and the indices of the other pixels are kept.
+static U32 encode_bc7_subset_(const Bc_encoder_t_* e, const Bc_block_t_& block, const Bc7_mode_t_& mode, U32 pixel_mask, U32 channel_mask, int index_bits, Bc7_endpoints_t_* o_endpoints, U8* o_indices) {
+  float weights[16];
+  const int* int_weights = get_bc7_weights_(index_bits);
+  for (int i = 0; i < (1 << index_bits); ++i) {
+    weights[i] = int_weights[i] / 64.0f;
+  }
+  float endpoints[2][4];
+  fit_line_(block, pixel_mask, channel_mask, endpoints);
+  int refine_count = e->quality >= e_bc_quality_normal ? 2 : 1;
+  U32 best_error = 0xffffffff;
+  for (int i = 0; i <= refine_count; ++i) {
+    Bc7_endpoints_t_ candidate = *o_endpoints;
+    quantize_bc7_endpoints_(mode, endpoints, channel_mask, &candidate);
+    U8 palette[16][4];
+    get_bc7_palette_(candidate.colors, index_bits, palette);
+    U8 indices[16];
+    U32 error = find_indices_(e, block, palette, 1 << index_bits, channel_mask, pixel_mask, indices);
+    if (error < best_error) {
+      best_error = error;
+      *o_endpoints = candidate;
+      for (int j = 0; j < 16; ++j) {
+        o_indices[j] = (pixel_mask & (1 << j)) ? indices[j] : o_indices[j];
+      }
+    }
+    if (!error || i == refine_count || !refine_line_(block, pixel_mask, channel_mask, indices, weights, endpoints)) {
+      break;
+    }
+  }
+  return best_error;
+}
+
+static void encode_bc7_partitioned_(const Bc_encoder_t_* e, const Bc_block_t_& block, int mode_index, int partition, Bc7_block_t_* o_block) {
+  const Bc7_mode_t_& mode = gc_bc7_modes_[mode_index];
+  o_block->mode = mode_index;
+  o_block->partition = partition;
+  o_block->error = 0;
+  U32 mask1 = gc_bc7_partitions2_[partition];
+  U32 masks[2] = {~mask1 & 0xffff, mask1};
+  for (int s = 0; s < 2; ++s) {
+    o_block->error += encode_bc7_subset_(e, block, mode, masks[s], gc_channel_rgb_, mode.index_bits, &o_block->endpoints[s], o_block->indices);
+  }
+}
+
+// The error of a partition is estimated from how far the pixels of each subset are from their principal axis,
+// which is the variance that isn't along the axis. The sums of subset 0 are the sums of the block minus the ones of subset 1.
+static void rank_bc7_partitions_(const Bc_block_t_& block, int count, int* o_partitions) {
+  // Count, R, G, B, RR, RG, RB, GG, GB, BB of each combination of 4 pixels, the sums of a subset are 4 lookups.
+  float nibble_sums[4][16][10];
+  for (int n = 0; n < 4; ++n) {
+    memset(nibble_sums[n][0], 0, sizeof(nibble_sums[n][0]));
+    for (int bit = 0; bit < 4; ++bit) {
+      const U8* pixel = block.pixels[n * 4 + bit];
+      float r = pixel[0];
+      float g = pixel[1];
+      float b = pixel[2];
+      float sums[10] = {1.0f, r, g, b, r * r, r * g, r * b, g * g, g * b, b * b};
+      // The combinations that have this bit are the ones without it plus this pixel.
+      for (int v = 1 << bit; v < (2 << bit); ++v) {
+        for (int j = 0; j < 10; ++j) {
+          nibble_sums[n][v][j] = nibble_sums[n][v - (1 << bit)][j] + sums[j];
+        }
+      }
+    }
+  }
+  float block_sums[10];
+  for (int j = 0; j < 10; ++j) {
+    block_sums[j] = nibble_sums[0][15][j] + nibble_sums[1][15][j] + nibble_sums[2][15][j] + nibble_sums[3][15][j];
+  }
+  float errors[64];
+  int order[64];
+  for (int p = 0; p < 64; ++p) {
+    U32 mask1 = gc_bc7_partitions2_[p];
+    float subset_sums[2][10];
+    for (int j = 0; j < 10; ++j) {
+      subset_sums[1][j] = nibble_sums[0][mask1 & 15][j] + nibble_sums[1][(mask1 >> 4) & 15][j] + nibble_sums[2][(mask1 >> 8) & 15][j] + nibble_sums[3][mask1 >> 12][j];
+      subset_sums[0][j] = block_sums[j] - subset_sums[1][j];
+    }
+    float error = 0.0f;
+    for (int s = 0; s < 2; ++s) {
+      const float* sums = subset_sums[s];
+      float inverse_count = 1.0f / sums[0];
+      float c[3][3];
+      c[0][0] = sums[4] - sums[1] * sums[1] * inverse_count;
+      c[0][1] = c[1][0] = sums[5] - sums[1] * sums[2] * inverse_count;
+      c[0][2] = c[2][0] = sums[6] - sums[1] * sums[3] * inverse_count;
+      c[1][1] = sums[7] - sums[2] * sums[2] * inverse_count;
+      c[1][2] = c[2][1] = sums[8] - sums[2] * sums[3] * inverse_count;
+      c[2][2] = sums[9] - sums[3] * sums[3] * inverse_count;
+      float trace = c[0][0] + c[1][1] + c[2][2];
+      // 2 steps of the power iteration from the row of the channel that varies the most, the largest eigenvalue is the Rayleigh quotient.
+      int start = c[1][1] > c[0][0] ? 1 : 0;
+      start = c[2][2] > c[start][start] ? 2 : start;
+      float axis[3] = {c[start][0], c[start][1], c[start][2]};
+      float next[3];
+      for (int a = 0; a < 3; ++a) {
+        next[a] = c[a][0] * axis[0] + c[a][1] * axis[1] + c[a][2] * axis[2];
+      }
+      float length2 = next[0] * next[0] + next[1] * next[1] + next[2] * next[2];
+      float eigenvalue = 0.0f;
+      if (length2 > 1e-6f) {
+        float quotient = 0.0f;
+        for (int a = 0; a < 3; ++a) {
+          quotient += next[a] * (c[a][0] * next[0] + c[a][1] * next[1] + c[a][2] * next[2]);
+        }
+        eigenvalue = quotient / length2;
+      }
+      error += max(trace - eigenvalue, 0.0f);
+    }
+    errors[p] = error;
+    int i = p;
+    for (; i > 0 && errors[order[i - 1]] > error; --i) {
+      order[i] = order[i - 1];
+    }
+    order[i] = p;
+  }
+  memcpy(o_partitions, order, count * sizeof(int));
+}
+
+// The highest bit of the index of an anchor must be 0, the endpoints are swapped and the indices are inverted if it isn't.
+static void fix_bc7_anchors_(Bc7_block_t_* b) {
+  const Bc7_mode_t_& mode = gc_bc7_modes_[b->mode];
+  U32 channel_mask = mode.index2_bits ? gc_channel_rgb_ : gc_channel_rgba_;
+  for (int s = 0; s < mode.subset_count; ++s) {
+    int anchor = get_bc7_anchor_(mode.subset_count, b->partition, s);
+    if (!(b->indices[anchor] >> (mode.index_bits - 1))) {
+      continue;
+    }
+    Bc7_endpoints_t_* endpoints = &b->endpoints[s];
+    for (int c = 0; c < 4; ++c) {
+      if ((channel_mask >> (c * 8)) & 0xff) {
+        swap(&endpoints->quantized[0][c], &endpoints->quantized[1][c]);
+        swap(&endpoints->colors[0][c], &endpoints->colors[1][c]);
+      }
+    }
+    if (mode.has_endpoint_p_bits) {
+      swap(&endpoints->p_bits[0], &endpoints->p_bits[1]);
+    }
+    for (int i = 0; i < 16; ++i) {
+      if (get_bc7_subset_(mode.subset_count, b->partition, i) == s) {
+        b->indices[i] = (1 << mode.index_bits) - 1 - b->indices[i];
+      }
+    }
+  }
+  if (mode.index2_bits && (b->indices2[0] >> (mode.index2_bits - 1))) {
+    swap(&b->endpoints[0].quantized[0][3], &b->endpoints[0].quantized[1][3]);
+    swap(&b->endpoints[0].colors[0][3], &b->endpoints[0].colors[1][3]);
+    for (int i = 0; i < 16; ++i) {
+      b->indices2[i] = (1 << mode.index2_bits) - 1 - b->indices2[i];
+    }
+  }
+}
+
+static void write_bits_(U8* dst, int* offset, U32 value, int count) {
+  for (int i = 0; i < count; ++i, ++*offset) {
+    dst[*offset / 8] |= ((value >> i) & 1) << (*offset % 8);
+  }
+}
+
+static U32 read_bits_(const U8* src, int* offset, int count) {
+  U32 value = 0;
+  for (int i = 0; i < count; ++i, ++*offset) {
+    value |= ((src[*offset / 8] >> (*offset % 8)) & 1) << i;
+  }
+  return value;
+}
+
+// Writes a block without rotation and index selection.
+static void pack_bc7_(const Bc7_block_t_& b, U8* dst) {
+  const Bc7_mode_t_& mode = gc_bc7_modes_[b.mode];
+  memset(dst, 0, 16);
+  int offset = 0;
+  write_bits_(dst, &offset, 1 << b.mode, b.mode + 1);
+  write_bits_(dst, &offset, b.partition, mode.partition_bits);
+  write_bits_(dst, &offset, 0, mode.rotation_bits + mode.index_selection_bits);
+  for (int c = 0; c < 4; ++c) {
+    int bits = c < 3 ? mode.color_bits : mode.alpha_bits;
+    for (int s = 0; s < mode.subset_count; ++s) {
+      for (int i = 0; i < 2; ++i) {
+        write_bits_(dst, &offset, b.endpoints[s].quantized[i][c], bits);
+      }
+    }
+  }
+  for (int s = 0; s < mode.subset_count; ++s) {
+    if (mode.has_endpoint_p_bits) {
+      write_bits_(dst, &offset, b.endpoints[s].p_bits[0], 1);
+      write_bits_(dst, &offset, b.endpoints[s].p_bits[1], 1);
+    } else if (mode.has_shared_p_bits) {
+      write_bits_(dst, &offset, b.endpoints[s].p_bits[0], 1);
+    }
+  }
+  for (int i = 0; i < 16; ++i) {
+    int s = get_bc7_subset_(mode.subset_count, b.partition, i);
+    bool is_anchor = get_bc7_anchor_(mode.subset_count, b.partition, s) == i;
+    write_bits_(dst, &offset, b.indices[i], mode.index_bits - is_anchor);
+  }
+  if (mode.index2_bits) {
+    for (int i = 0; i < 16; ++i) {
+      write_bits_(dst, &offset, b.indices2[i], mode.index2_bits - (i == 0));
+    }
+  }
+  M_check(offset == 128);
+}
+
+static void encode_bc7_(const Bc_encoder_t_* e, const Bc_block_t_& block, U8* dst) {
+  bool is_opaque = true;
+  for (int i = 0; i < 16; ++i) {
+    is_opaque &= block.pixels[i][3] == 255;
+  }
+  Bc7_block_t_ best = {};
+  best.mode = 6;
+  best.error = encode_bc7_subset_(e, block, gc_bc7_modes_[6], 0xffff, gc_channel_rgba_, 4, &best.endpoints[0], best.indices);
+  if (e->quality >= e_bc_quality_fast && best.error) {
+    Bc7_block_t_ candidate = {};
+    if (is_opaque) {
+      int partitions[16];
+      int partition_count = gc_bc7_partition_counts_[e->quality];
+      rank_bc7_partitions_(block, partition_count, partitions);
+      for (int i = 0; i < partition_count && best.error; ++i) {
+        for (int mode = 1; mode <= 3; mode += 2) {
+          encode_bc7_partitioned_(e, block, mode, partitions[i], &candidate);
+          if (candidate.error < best.error) {
+            best = candidate;
+          }
+        }
+      }
+    } else {
+      // The color and the alpha have their own indices.
+      const Bc7_mode_t_& mode = gc_bc7_modes_[5];
+      candidate.mode = 5;
+      candidate.error = encode_bc7_subset_(e, block, mode, 0xffff, gc_channel_rgb_, mode.index_bits, &candidate.endpoints[0], candidate.indices);
+      candidate.error += encode_bc7_subset_(e, block, mode, 0xffff, gc_channel_a_, mode.index2_bits, &candidate.endpoints[0], candidate.indices2);
+      if (candidate.error < best.error) {
+        best = candidate;
+      }
+    }
+  }
+  fix_bc7_anchors_(&best);
+  pack_bc7_(best, dst);
+}
+
+static void encode_rows_(const Bc_encoder_t_* e, int begin, int end) {
+  Bc_block_t_ block;
+  for (int y = begin; y < end; ++y) {
+    U8* dst = e->dst + (Sip)y * e->block_width * e->block_size;
+    for (U32 x = 0; x < e->block_width; ++x, dst += e->block_size) {
+      load_block_(e, x, y, &block);
+      switch (e->format) {
+        case e_bc_format_bc1:
+          encode_bc1_(e, block, dst);
+          break;
+        case e_bc_format_bc4:
+          encode_bc4_(e, block, 0, dst);
+          break;
+        case e_bc_format_bc5:
+          encode_bc4_(e, block, 0, dst);
+          encode_bc4_(e, block, 1, dst + 8);
+          break;
+        case e_bc_format_bc7:
+          encode_bc7_(e, block, dst);
+          break;
+      }
+    }
+  }
+}
+
+static bool encode_(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format, E_bc_quality quality, bool is_simd) {
+  M_check_return_val(src && dst && width > 0 && height > 0, false);
+  M_check_return_val(quality >= e_bc_quality_fastest && quality <= e_bc_quality_slow, false);
+  Bc_encoder_t_ e = {};
+  e.src = src;
+  e.dst = dst;
+  e.width = width;
+  e.height = height;
+  e.block_width = (width + 3) / 4;
+  e.block_height = (height + 3) / 4;
+  e.block_size = bc_get_block_size(format);
+  e.format = format;
+  e.quality = quality;
+  e.is_simd = is_simd;
+  Sip block_count = (Sip)e.block_width * e.block_height;
+  if (!is_simd || job_get_worker_index() == -1 || block_count < gc_min_parallel_block_count_) {
+    encode_rows_(&e, 0, e.block_height);
+    return true;
+  }
+  int grain_size = max(gc_job_block_count_ / (int)e.block_width, 1);
+  job_parallel_for(0, e.block_height, grain_size, [&e](int begin, int end) {
+    encode_rows_(&e, begin, end);
+  });
+  return true;
+}
+
+int bc_get_block_size(E_bc_format format) {
+  return format == e_bc_format_bc1 || format == e_bc_format_bc4 ? 8 : 16;
+}
+
+Sip bc_get_size(E_bc_format format, U32 width, U32 height) {
+  return (Sip)((width + 3) / 4) * ((height + 3) / 4) * bc_get_block_size(format);
+}
+
+bool bc_encode(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format, E_bc_quality quality) {
+  M_profile_zone("bc_encode");
+  return encode_(src, width, height, dst, format, quality, true);
+}
+
+bool bc_encode_scalar(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format, E_bc_quality quality) {
+  return encode_(src, width, height, dst, format, quality, false);
+}
+
+static void decode_bc1_(const U8* src, U8 (*o_pixels)[4]) {
+  U16 c0;
+  U16 c1;
+  U32 indices;
+  memcpy(&c0, src, 2);
+  memcpy(&c1, src + 2, 2);
+  memcpy(&indices, src + 4, 4);
+  U8 palette[4][4];
+  get_bc1_palette_(c0, c1, palette);
+  for (int i = 0; i < 16; ++i) {
+    memcpy(o_pixels[i], palette[(indices >> (2 * i)) & 3], 4);
+  }
+}
+
+static void decode_bc4_(const U8* src, int channel, U8 (*o_pixels)[4]) {
+  U8 palette[8][4];
+  get_bc4_palette_(src[0], src[1], palette);
+  U64 indices = 0;
+  for (int i = 0; i < 6; ++i) {
+    indices |= (U64)src[2 + i] << (8 * i);
+  }
+  for (int i = 0; i < 16; ++i) {
+    o_pixels[i][channel] = palette[(indices >> (3 * i)) & 7][0];
+  }
+}
+
+static void decode_bc7_(const U8* src, U8 (*o_pixels)[4]) {
+  int mode_index = 0;
+  while (mode_index < 8 && !(src[0] & (1 << mode_index))) {
+    ++mode_index;
+  }
+  if (mode_index == 8) {
+    // Reserved.
+    memset(o_pixels, 0, 64);
+    return;
+  }
+  const Bc7_mode_t_& mode = gc_bc7_modes_[mode_index];
+  int offset = mode_index + 1;
+  int partition = read_bits_(src, &offset, mode.partition_bits);
+  int rotation = read_bits_(src, &offset, mode.rotation_bits);
+  int index_selection = read_bits_(src, &offset, mode.index_selection_bits);
+  int quantized[3][2][4] = {};
+  for (int c = 0; c < 4; ++c) {
+    int bits = c < 3 ? mode.color_bits : mode.alpha_bits;
+    for (int s = 0; s < mode.subset_count; ++s) {
+      for (int i = 0; i < 2; ++i) {
+        quantized[s][i][c] = read_bits_(src, &offset, bits);
+      }
+    }
+  }
+  U8 colors[3][2][4];
+  for (int s = 0; s < mode.subset_count; ++s) {
+    int p_bits[2] = {-1, -1};
+    if (mode.has_endpoint_p_bits) {
+      p_bits[0] = read_bits_(src, &offset, 1);
+      p_bits[1] = read_bits_(src, &offset, 1);
+    } else if (mode.has_shared_p_bits) {
+      p_bits[0] = p_bits[1] = read_bits_(src, &offset, 1);
+    }
+    for (int i = 0; i < 2; ++i) {
+      for (int c = 0; c < 4; ++c) {
+        int bits = c < 3 ? mode.color_bits : mode.alpha_bits;
+        if (!bits) {
+          colors[s][i][c] = 255;
+        } else if (p_bits[i] >= 0) {
+          colors[s][i][c] = expand_bits_((quantized[s][i][c] << 1) | p_bits[i], bits + 1);
+        } else {
+          colors[s][i][c] = expand_bits_(quantized[s][i][c], bits);
+        }
+      }
+    }
+  }
+  int indices[16];
+  int indices2[16];
+  for (int i = 0; i < 16; ++i) {
+    int s = get_bc7_subset_(mode.subset_count, partition, i);
+    bool is_anchor = get_bc7_anchor_(mode.subset_count, partition, s) == i;
+    indices[i] = read_bits_(src, &offset, mode.index_bits - is_anchor);
+  }
+  for (int i = 0; i < 16 && mode.index2_bits; ++i) {
+    indices2[i] = read_bits_(src, &offset, mode.index2_bits - (i == 0));
+  }
+  for (int i = 0; i < 16; ++i) {
+    int s = get_bc7_subset_(mode.subset_count, partition, i);
+    int color_weight = get_bc7_weights_(mode.index_bits)[indices[i]];
+    int alpha_weight = color_weight;
+    if (mode.index2_bits) {
+      alpha_weight = get_bc7_weights_(mode.index2_bits)[indices2[i]];
+      if (index_selection) {
+        swap(&color_weight, &alpha_weight);
+      }
+    }
+    for (int c = 0; c < 4; ++c) {
+      int w = c < 3 ? color_weight : alpha_weight;
+      o_pixels[i][c] = ((64 - w) * colors[s][0][c] + w * colors[s][1][c] + 32) >> 6;
+    }
+    if (rotation) {
+      swap(&o_pixels[i][rotation - 1], &o_pixels[i][3]);
+    }
+  }
+}
+
+bool bc_decode(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format) {
+  M_check_return_val(src && dst && width > 0 && height > 0, false);
+  int block_size = bc_get_block_size(format);
+  U32 block_width = (width + 3) / 4;
+  U32 block_height = (height + 3) / 4;
+  U8 pixels[16][4];
+  for (U32 by = 0; by < block_height; ++by) {
+    for (U32 bx = 0; bx < block_width; ++bx, src += block_size) {
+      switch (format) {
+        case e_bc_format_bc1:
+          decode_bc1_(src, pixels);
+          break;
+        case e_bc_format_bc4:
+        case e_bc_format_bc5:
+          for (int i = 0; i < 16; ++i) {
+            pixels[i][0] = pixels[i][1] = pixels[i][2] = 0;
+            pixels[i][3] = 255;
+          }
+          decode_bc4_(src, 0, pixels);
+          if (format == e_bc_format_bc5) {
+            decode_bc4_(src + 8, 1, pixels);
+          }
+          break;
+        case e_bc_format_bc7:
+          decode_bc7_(src, pixels);
+          break;
+      }
+      for (U32 y = 0; y < 4 && by * 4 + y < height; ++y) {
+        U32 copy_width = min(4u, width - bx * 4);
+        memcpy(dst + ((Sip)(by * 4 + y) * width + bx * 4) * 4, pixels[y * 4], copy_width * 4);
+      }
+    }
+  }
+  return true;
+}
+
+double bc_get_psnr(const U8* a, const U8* b, U32 width, U32 height, int channel_count) {
+  double sum = 0.0;
+  Sip pixel_count = (Sip)width * height;
+  for (Sip i = 0; i < pixel_count; ++i) {
+    for (int c = 0; c < channel_count; ++c) {
+      double d = (double)a[i * 4 + c] - b[i * 4 + c];
+      sum += d * d;
+    }
+  }
+  if (sum == 0.0) {
+    return 99.0;
+  }
+  double mse = sum / ((double)pixel_count * channel_count);
+  return 10.0 * log10(255.0 * 255.0 / mse);
+}
@@ -0,0 +1,52 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/types.h"
+
+enum E_bc_format {
+  // RGB with 1 bit alpha, 8 bytes per block.
+  e_bc_format_bc1,
+  // R, 8 bytes per block.
+  e_bc_format_bc4,
+  // RG, 16 bytes per block.
+  e_bc_format_bc5,
+  // RGBA, 16 bytes per block.
+  e_bc_format_bc7,
+};
+
+// Quality of the BC7 encoder, BC1/BC4/BC5 don't have a mode search and are always done the same way.
+enum E_bc_quality {
+  // Only mode 6.
+  e_bc_quality_fastest,
+  // Modes 1 and 3 with the best partition for opaque blocks, mode 5 for blocks with alpha.
+  e_bc_quality_fast,
+  // Same modes with the 4 best partitions and one more refinement.
+  e_bc_quality_normal,
+  // Same modes with the 16 best partitions.
+  e_bc_quality_slow,
+};
+
+// Bytes of a 4x4 block.
+int bc_get_block_size(E_bc_format format);
+// Bytes of a |width| x |height| image, the blocks at the right and the bottom are partial.
+Sip bc_get_size(E_bc_format format, U32 width, U32 height);
+
+// Compresses |src| of |width| x |height| tightly packed RGBA8 to |dst| of bc_get_size() bytes, the rows of blocks are tightly packed.
+// BC4 takes R and BC5 takes RG. The pixels outside of the image are copies of the last column or row.
+// The indices are searched with SSE2 if it's available. On a worker, the rows of blocks of big images are split among the workers.
+bool bc_encode(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format, E_bc_quality quality);
+// Same as bc_encode() without SIMD and jobs, bc_encode() is tested against it.
+bool bc_encode_scalar(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format, E_bc_quality quality);
+
+// Decompresses |src| to tightly packed RGBA8. BC4 is decoded to (R, 0, 0, 255) and BC5 to (R, G, 0, 255).
+// Every BC7 mode is decoded, not only the ones that the encoder writes.
+bool bc_decode(const U8* src, U32 width, U32 height, U8* dst, E_bc_format format);
+
+// Peak signal-to-noise ratio in dB of |b| against |a|, both are tightly packed RGBA8.
+// Only the first |channel_count| channels are compared, it's 99 if they are the same.
+double bc_get_psnr(const U8* a, const U8* b, U32 width, U32 height, int channel_count);
@@ -11,20 +11,197 @@
 #include "core/hash_table.h"
 #include "core/linear_allocator.h"
 #include "core/loader/xml.h"
+#include "core/loader/xml_reader.h"
 #include "core/log.h"
 #include "core/math/quat.h"
 #include "core/math/vec4.h"
+#include "core/profiler.h"
 #include "core/string.h"
 #include "core/utils.h"
 
 #include <ctype.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 union Source_array_t_{
   Dynamic_array_t<float> float_array;
+  Dynamic_array_t<int> int_array;
   Dynamic_array_t<Cstring_t> name_array;
 };
 
+typedef Hash_map_t<const Xml_node_t*, Source_array_t_> Dae_arrays_t_;
+
+static bool is_float_array_(const Cstring_t& tag_name) {
+  return tag_name == "float_array";
+}
+
+static bool is_int_array_(const Cstring_t& tag_name) {
+  return tag_name == "p" || tag_name == "v" || tag_name == "vcount";
+}
+
+static void append_string_(Dynamic_array_t<char>* strings, const Cstring_t& str) {
+  strings->append_array(str.m_p, str.m_length);
+  strings->append(0);
+}
+
+static Mstring_t copy_string_(Allocator_t* allocator, const Cstring_t& str) {
+  char* p = (char*)allocator->alloc(str.m_length + 1);
+  memcpy(p, str.m_p, str.m_length);
+  p[str.m_length] = 0;
+  return Mstring_t(p, str.m_length);
+}
+
+// Streams the file and builds the nodes without the texts of <float_array>, <p>, <v> and <vcount>. Their numbers are parsed
+// to |o_arrays| chunk by chunk as the text events come so the raw text of the big arrays is never in memory.
+// The other texts are kept, their chunks are joined by a space.
+static Xml_node_t* stream_dae_(Allocator_t* allocator, const Path_t& path, Dae_arrays_t_* o_arrays) {
+  M_profile_zone("stream_dae_");
+  Linear_allocator_t<> scratch_allocator("dae_stream_allocator");
+  M_scope_exit(scratch_allocator.destroy());
+  Xml_reader_t reader(&scratch_allocator);
+  M_scope_exit(reader.destroy());
+  if (!reader.init(path)) {
+    return NULL;
+  }
+  Dynamic_array_t<Xml_node_t*> open_nodes(&scratch_allocator);
+  M_scope_exit(open_nodes.destroy());
+  // Where the children of each open node start in |children|.
+  Dynamic_array_t<Sip> child_starts(&scratch_allocator);
+  M_scope_exit(child_starts.destroy());
+  Dynamic_array_t<Xml_node_t*> children(&scratch_allocator);
+  M_scope_exit(children.destroy());
+  Dynamic_array_t<Xml_attribute_t> attributes(&scratch_allocator);
+  M_scope_exit(attributes.destroy());
+  // The name and the attributes of a tag are gathered here and copied with one allocation once they are all read because the
+  // reader reuses its window.
+  Dynamic_array_t<char> strings(&scratch_allocator);
+  M_scope_exit(strings.destroy());
+  // The text of the last open node until its first child or its closing tag.
+  Dynamic_array_t<char> text(&scratch_allocator);
+  M_scope_exit(text.destroy());
+  // The arrays don't have children so there is only one that is open.
+  Dynamic_array_t<float> floats(allocator);
+  Dynamic_array_t<int> ints(allocator);
+  bool is_in_float_array = false;
+  bool is_in_int_array = false;
+
+  Xml_node_t* root = NULL;
+  E_xml_event event = reader.next();
+  while (event != e_xml_event_end_document) {
+    M_check_log_return_val(event != e_xml_event_error, NULL, "Can't read " M_txt_p, path.m_path);
+    if (event == e_xml_event_start_element) {
+      if (open_nodes.len()) {
+        Xml_node_t* parent = open_nodes.last();
+        if (text.len() && children.len() == child_starts.last()) {
+          parent->m_raw_text = copy_string_(allocator, Cstring_t(text.m_p, text.len()));
+        }
+        text.resize(0);
+      }
+      Sip name_length = reader.m_name.m_length;
+      strings.resize(0);
+      append_string_(&strings, reader.m_name);
+      attributes.resize(0);
+      while ((event = reader.next()) == e_xml_event_attribute) {
+        append_string_(&strings, reader.m_name);
+        append_string_(&strings, reader.m_value);
+        attributes.append({Cstring_t(NULL, reader.m_name.m_length), Mstring_t(NULL, reader.m_value.m_length), true});
+      }
+      // The strings are right after the node in the same allocation, they are in the order they were appended and each one is
+      // followed by its 0.
+      Xml_node_t* node = new (allocator->alloc(sizeof(Xml_node_t) + strings.len())) Xml_node_t(allocator);
+      node->m_is_text_decoded = true;
+      char* p = (char*)(node + 1);
+      memcpy(p, strings.m_p, strings.len());
+      node->m_tag_name = Cstring_t(p, name_length);
+      p += name_length + 1;
+      for (Xml_attribute_t& attr : attributes) {
+        attr.name.m_p = p;
+        p += attr.name.m_length + 1;
+        attr.raw_value.m_p = p;
+        p += attr.raw_value.m_length + 1;
+      }
+      if (attributes.len()) {
+        node->m_attributes.resize(attributes.len());
+        memcpy(node->m_attributes.m_p, attributes.m_p, attributes.len() * sizeof(Xml_attribute_t));
+      }
+      if (open_nodes.len()) {
+        children.append(node);
+      } else {
+        root = node;
+      }
+      open_nodes.append(node);
+      child_starts.append(children.len());
+      is_in_float_array = is_float_array_(node->m_tag_name);
+      is_in_int_array = is_int_array_(node->m_tag_name);
+      if (is_in_float_array) {
+        floats = Dynamic_array_t<float>(allocator);
+        Cstring_t count = node->get_attribute("count");
+        if (count.m_p) {
+          floats.reserve(atoi(count.m_p));
+        }
+      } else if (is_in_int_array) {
+        ints = Dynamic_array_t<int>(allocator);
+      }
+      // |event| is the one after the attributes.
+      continue;
+    }
+    if (event == e_xml_event_text) {
+      // The chunks are split at spaces so a number is never cut.
+      char* p = (char*)reader.m_value.m_p;
+      if (is_in_float_array) {
+        while (true) {
+          char* end;
+          float f = strtof(p, &end);
+          if (end == p) {
+            break;
+          }
+          floats.append(f);
+          p = end;
+        }
+      } else if (is_in_int_array) {
+        while (true) {
+          char* end;
+          int i = strtol(p, &end, 10);
+          if (end == p) {
+            break;
+          }
+          ints.append(i);
+          p = end;
+        }
+      } else if (children.len() == child_starts.last()) {
+        if (text.len()) {
+          text.append(' ');
+        }
+        text.append_array(reader.m_value.m_p, reader.m_value.m_length);
+      }
+    } else if (event == e_xml_event_end_element) {
+      Xml_node_t* node = open_nodes.last();
+      if (is_in_float_array) {
+        (*o_arrays)[node].float_array = floats;
+      } else if (is_in_int_array) {
+        (*o_arrays)[node].int_array = ints;
+      } else if (text.len() && children.len() == child_starts.last()) {
+        node->m_raw_text = copy_string_(allocator, Cstring_t(text.m_p, text.len()));
+      }
+      text.resize(0);
+      is_in_float_array = false;
+      is_in_int_array = false;
+      Sip start = child_starts.last();
+      Sip count = children.len() - start;
+      if (count) {
+        node->m_children.resize(count);
+        memcpy(node->m_children.m_p, children.m_p + start, count * sizeof(Xml_node_t*));
+      }
+      children.resize(start);
+      open_nodes.resize(open_nodes.len() - 1);
+      child_starts.resize(child_starts.len() - 1);
+    }
+    event = reader.next();
+  }
+  return root;
+}
+
 M4_t parse_m4_(const char* s, const char** out) {
   M4_t rv;
   char** temp_out = (char**)&s;
@@ -46,8 +223,10 @@ void update_inv_bind_matrix_(Dynamic_array_t<M4_t>* inv_bind_matrices, Joint_t*
 
 void parse_geometry_node_(Linear_allocator_t<>* allocator,
                           Dynamic_array_t<Vertex_t>* m_vertices,
+                          const Xml_index_t& index,
                           const Xml_node_t* geometry,
                           const Hash_map_t<Cstring_t, Source_array_t_>& sources,
+                          const Dae_arrays_t_& arrays,
                           const Dynamic_array_t<Cstring_t>* joints,
                           int mat_idx,
                           const Dynamic_array_t<float>* weights,
@@ -58,18 +237,20 @@ void parse_geometry_node_(Linear_allocator_t<>* allocator,
                           int joint_offset,
                           int weight_offset) {
   Scope_allocator_t<> temp_allocator(allocator);
-  auto position_semantic = geometry->find_first_by_tag("vertices")->find_first_by_attr("semantic", "POSITION");
-  const Dynamic_array_t<float>& positions = sources.find(position_semantic->m_attributes.find("source")->get_substr(1))->float_array;
+  auto position_semantic = index.find_first_by_tag(geometry, "vertices")->find_first_by_attr("semantic", "POSITION");
+  const Dynamic_array_t<float>& positions = sources.find(position_semantic->get_attribute("source").get_substr(1))->float_array;
 
   int position_count = positions.len() / 3;
   Dynamic_array_t<Vertex_t> vertices(&temp_allocator);
   vertices.resize(position_count);
   if (vertex_weights) {
-    int vertex_weights_count = atoi(vertex_weights->m_attributes.find("count")->m_p);
+    int vertex_weights_count = atoi(vertex_weights->get_attribute("count").m_p);
     M_check(positions.len() / 3 == vertex_weights_count);
 
-    char* vcount_p = vertex_weights->find_first_by_tag("vcount")->m_text.m_p;
-    char* v_p = vertex_weights->find_first_by_tag("v")->m_text.m_p;
+    const Dynamic_array_t<int>& vcounts = arrays.find(index.find_first_by_tag(vertex_weights, "vcount"))->int_array;
+    const Dynamic_array_t<int>& vs = arrays.find(index.find_first_by_tag(vertex_weights, "v"))->int_array;
+    M_check(vcounts.len() >= position_count);
+    int v_idx = 0;
     for (int i = 0; i < position_count; ++i) {
       // Only |position|, |joints_idx|, and |weights| are filled for now
       Vertex_t& vertex = vertices[i];
@@ -77,11 +258,11 @@ void parse_geometry_node_(Linear_allocator_t<>* allocator,
       V3_t pos = ((V3_t*)positions.m_p)[i];
       vertex.position = V4_t{pos.x, pos.y, pos.z, 1.f};
       vertex.position = bind_shape_matrix * vertex.position;
-      int vcount = strtof(vcount_p, &vcount_p);
+      int vcount = vcounts[i];
       float total_weight = 0.f;
       for (int j = 0; j < vcount; ++j) {
         for (int k = 0; k < stride; ++k) {
-          int v = strtol(v_p, &v_p, 10);
+          int v = vs[v_idx++];
           if (k == joint_offset) {
             M_check(v != -1);
             vertex.joint_idx[j] = (*joint_map->find((*joints)[v]))->mat_idx;
@@ -108,33 +289,35 @@ void parse_geometry_node_(Linear_allocator_t<>* allocator,
   }
 
   Xml_nodes_t triangles_tags(&temp_allocator);
-  geometry->find_all_by_tag(&triangles_tags, "triangles");
+  index.find_all_by_tag(&triangles_tags, geometry, "triangles");
   int vertex_count = 0;
   for (auto triangles_tag : triangles_tags) {
-    vertex_count += atoi(triangles_tag->m_attributes.find("count")->m_p);
+    vertex_count += atoi(triangles_tag->get_attribute("count").m_p);
   }
   m_vertices->reserve(m_vertices->len() + vertex_count);
   for (auto triangles_tag : triangles_tags) {
-    int triangle_count = atoi(triangles_tag->m_attributes.find("count")->m_p);
-    int triangle_stride = triangles_tag->count_all_by_tag("input");
+    int triangle_count = atoi(triangles_tag->get_attribute("count").m_p);
+    int triangle_stride = index.count_all_by_tag(triangles_tag, "input");
 
     auto vertex_semantic = triangles_tag->find_first_by_attr("semantic", "VERTEX");
-    int vertex_offset = atoi(vertex_semantic->m_attributes.find("offset")->m_p);
+    int vertex_offset = atoi(vertex_semantic->get_attribute("offset").m_p);
 
     auto normal_semantic = triangles_tag->find_first_by_attr("semantic", "NORMAL");
     int normal_offset = -1;
     const Dynamic_array_t<float>* normals = NULL;
     if (normal_semantic) {
-      normal_offset = atoi(normal_semantic->m_attributes.find("offset")->m_p);
-      normals = &sources.find(normal_semantic->m_attributes.find("source")->get_substr(1))->float_array;
+      normal_offset = atoi(normal_semantic->get_attribute("offset").m_p);
+      normals = &sources.find(normal_semantic->get_attribute("source").get_substr(1))->float_array;
     }
 
-    char* triangle_p = triangles_tag->find_first_by_tag("p")->m_text.m_p;
+    const Dynamic_array_t<int>& indices = arrays.find(index.find_first_by_tag(triangles_tag, "p"))->int_array;
+    M_check(indices.len() >= triangle_count * 3 * triangle_stride);
+    int index_idx = 0;
     for (int i = 0; i < triangle_count; ++i) {
       for (int j = 0; j < 3; ++j) {
         Vertex_t vertex;
         for (int k = 0; k < triangle_stride; ++k) {
-          int index = strtol(triangle_p, &triangle_p, 10);
+          int index = indices[index_idx++];
           if (k == vertex_offset) {
             vertex.position = vertices[index].position;
             memcpy(&vertex.joint_idx, &vertices[index].joint_idx, sizeof(vertex.joint_idx));
@@ -149,33 +332,35 @@ void parse_geometry_node_(Linear_allocator_t<>* allocator,
   }
 
   Xml_nodes_t polylist_tags(&temp_allocator);
-  geometry->find_all_by_tag(&polylist_tags, "polylist");
+  index.find_all_by_tag(&polylist_tags, geometry, "polylist");
   vertex_count = 0;
   for (auto polylist_tag : polylist_tags) {
-    vertex_count += atoi(polylist_tag->m_attributes.find("count")->m_p);
+    vertex_count += atoi(polylist_tag->get_attribute("count").m_p);
   }
   m_vertices->reserve(m_vertices->len() + vertex_count);
   for (auto polylist_tag : polylist_tags) {
-    int triangle_count = atoi(polylist_tag->m_attributes.find("count")->m_p);
-    int triangle_stride = polylist_tag->count_all_by_tag("input");
+    int triangle_count = atoi(polylist_tag->get_attribute("count").m_p);
+    int triangle_stride = index.count_all_by_tag(polylist_tag, "input");
 
     auto vertex_semantic = polylist_tag->find_first_by_attr("semantic", "VERTEX");
-    int vertex_offset = atoi(vertex_semantic->m_attributes.find("offset")->m_p);
+    int vertex_offset = atoi(vertex_semantic->get_attribute("offset").m_p);
 
     auto normal_semantic = polylist_tag->find_first_by_attr("semantic", "NORMAL");
     int normal_offset = -1;
     const Dynamic_array_t<float>* normals = NULL;
     if (normal_semantic) {
-      normal_offset = atoi(normal_semantic->m_attributes.find("offset")->m_p);
-      normals = &sources.find(normal_semantic->m_attributes.find("source")->get_substr(1))->float_array;
+      normal_offset = atoi(normal_semantic->get_attribute("offset").m_p);
+      normals = &sources.find(normal_semantic->get_attribute("source").get_substr(1))->float_array;
     }
 
-    char* p = polylist_tag->find_first_by_tag("p")->m_text.m_p;
+    const Dynamic_array_t<int>& indices = arrays.find(index.find_first_by_tag(polylist_tag, "p"))->int_array;
+    M_check(indices.len() >= triangle_count * 3 * triangle_stride);
+    int index_idx = 0;
     for (int i = 0; i < triangle_count; ++i) {
       for (int j = 0; j < 3; ++j) {
         Vertex_t vertex;
         for (int k = 0; k < triangle_stride; ++k) {
-          int index = strtol(p, &p, 10);
+          int index = indices[index_idx++];
           if (k == vertex_offset) {
             vertex.position = vertices[index].position;
             memcpy(&vertex.joint_idx, &vertices[index].joint_idx, sizeof(vertex.joint_idx));
@@ -192,17 +377,19 @@ void parse_geometry_node_(Linear_allocator_t<>* allocator,
 
 void build_joint_hierarchy_(Dae_loader_t* loader,
                             const Xml_node_t* root,
+                            const Xml_index_t& index,
                             Linear_allocator_t<>* temp_allocator,
                             const Hash_map_t<Cstring_t, Source_array_t_>& sources,
+                            const Dae_arrays_t_& arrays,
                             const Xml_node_t* node,
                             const M4_t& parent_mat,
                             Joint_t* joint,
                             Hash_map_t<Cstring_t, Joint_t*>* map,
                             Dynamic_array_t<M4_t>* matrices) {
-  Cstring_t id = *node->m_attributes.find("id");
+  Cstring_t id = node->get_attribute("id");
   const Xml_node_t* matrix = node->find_first_by_path("matrix");
   if (matrix) {
-    joint->default_mat = parse_m4_(matrix->m_text.m_p, NULL);
+    joint->default_mat = parse_m4_(matrix->get_text().m_p, NULL);
   } else {
     joint->default_mat = m4_identity();
   }
@@ -211,13 +398,13 @@ void build_joint_hierarchy_(Dae_loader_t* loader,
   (*map)[id] = joint;
   for (const auto& child : node->m_children) {
     if (child->m_tag_name == "instance_geometry") {
-      const Xml_node_t* geometry = root->find_first_by_attr("id", child->m_attributes.find("url")->get_substr(1));
-      parse_geometry_node_(temp_allocator, &loader->m_vertices, geometry, sources, NULL, joint->mat_idx, NULL, NULL, NULL, m4_identity(), -1, -1, -1);
+      const Xml_node_t* geometry = root->find_first_by_attr("id", child->get_attribute("url").get_substr(1));
+      parse_geometry_node_(temp_allocator, &loader->m_vertices, index, geometry, sources, arrays, NULL, joint->mat_idx, NULL, NULL, NULL, m4_identity(), -1, -1, -1);
     } else if (child->m_tag_name == "node") {
       // TODO: do we have to check that type == "JOINT"?
       Joint_t* child_joint = joint->children.m_allocator->construct<Joint_t>(joint->children.m_allocator);
       joint->children.append(child_joint);
-      build_joint_hierarchy_(loader, root, temp_allocator, sources, child, (*matrices)[joint->mat_idx], child_joint, map, matrices);
+      build_joint_hierarchy_(loader, root, index, temp_allocator, sources, arrays, child, (*matrices)[joint->mat_idx], child_joint, map, matrices);
     }
   }
 }
@@ -271,37 +458,36 @@ Dae_loader_t::Dae_loader_t(Allocator_t* allocator)
     : m_vertices(allocator), m_animations(allocator), m_joint_matrices(allocator), m_inv_bind_matrices(allocator), m_root_joint(allocator) {}
 
 bool Dae_loader_t::init(const Path_t& path) {
+  M_profile_zone("Dae_loader_t::init");
   Linear_allocator_t<> temp_allocator("temp_allocator");
   M_scope_exit(temp_allocator.destroy());
-  Xml_t xml(&temp_allocator);
-  xml.init(path);
+  Dae_arrays_t_ arrays(&temp_allocator);
+  Xml_node_t* root = stream_dae_(&temp_allocator, path, &arrays);
+  M_check_return_false(root);
+  // Most of the lookups below are by tag and the index answers them without walking the subtrees.
+  Xml_index_t index(&temp_allocator);
+  index.init(root);
 
   Xml_nodes_t source_nodes(&temp_allocator);
-  xml.m_root->find_all_by_tag(&source_nodes, "source");
+  index.find_all_by_tag(&source_nodes, root, "source");
   Hash_map_t<Cstring_t, Source_array_t_> sources(&temp_allocator);
-  sources.reserve(sources.len());
+  sources.reserve(source_nodes.len());
   for (auto source_node : source_nodes) {
     {
-      auto float_array = source_node->find_first_by_tag("float_array");
+      auto float_array = index.find_first_by_tag(source_node, "float_array");
       if (float_array) {
-        Dynamic_array_t<float> floats(&temp_allocator);
-        int count = atoi(float_array->m_attributes.find("count")->m_p);
-        floats.resize(count);
-        char* p = float_array->m_text.m_p;
-        for (int i = 0; i < count; ++i) {
-          float x = strtof(p, &p);
-          floats[i] = x;
-        }
-        sources[*source_node->m_attributes.find("id")].float_array = floats;
+        const Dynamic_array_t<float>& floats = arrays.find(float_array)->float_array;
+        M_check(floats.len() == atoi(float_array->get_attribute("count").m_p));
+        sources[source_node->get_attribute("id")].float_array = floats;
       }
     }
     {
-      auto name_array = source_node->find_first_by_tag("Name_array");
+      auto name_array = index.find_first_by_tag(source_node, "Name_array");
       if (name_array) {
         Dynamic_array_t<Cstring_t> names(&temp_allocator);
-        int count = atoi(name_array->m_attributes.find("count")->m_p);
+        int count = atoi(name_array->get_attribute("count").m_p);
         names.resize(count);
-        char* p = name_array->m_text.m_p;
+        char* p = (char*)name_array->get_text().m_p;
         for (int i = 0; i < count; ++i) {
           while (isspace(*p)) {
             ++p;
@@ -312,17 +498,17 @@ bool Dae_loader_t::init(const Path_t& path) {
           }
           names[i] = Cstring_t(start, p);
         };
-        sources[*source_node->m_attributes.find("id")].name_array = names;
+        sources[source_node->get_attribute("id")].name_array = names;
       }
     }
   }
 
   Hash_map_t<Cstring_t, Joint_t*> joint_map(&temp_allocator);
-  const Xml_node_t* root_joint = xml.m_root->find_first_by_tag("visual_scene")->find_first_by_tag("node");
-  build_joint_hierarchy_(this, xml.m_root, &temp_allocator, sources, root_joint, m4_identity(), &m_root_joint, &joint_map, &m_joint_matrices);
+  const Xml_node_t* root_joint = index.find_first_by_tag(index.find_first_by_tag(root, "visual_scene"), "node");
+  build_joint_hierarchy_(this, root, index, &temp_allocator, sources, arrays, root_joint, m4_identity(), &m_root_joint, &joint_map, &m_joint_matrices);
 
   Xml_nodes_t controllers(&temp_allocator);
-  xml.m_root->find_first_by_path("library_controllers")->find_all_by_tag(&controllers, "controller");
+  index.find_all_by_tag(&controllers, root->find_first_by_path("library_controllers"), "controller");
 
   m_inv_bind_matrices.resize(m_joint_matrices.len());
   for (auto& m : m_inv_bind_matrices) {
@@ -331,36 +517,38 @@ bool Dae_loader_t::init(const Path_t& path) {
   // We only parse meshes referred by <skin>
   Dynamic_array_t<Dynamic_array_t<Vertex_t>> meshes(&temp_allocator);
   for (const auto& controller : controllers) {
-    const Xml_node_t* skin = controller->find_first_by_tag("skin");
+    const Xml_node_t* skin = index.find_first_by_tag(controller, "skin");
     M4_t bind_shape_matrix = m4_identity();
     {
-      const Xml_node_t* bind_shape_matrix_tag = skin->find_first_by_tag("bind_shape_matrix");
-      bind_shape_matrix = parse_m4_(bind_shape_matrix_tag->m_text.m_p, NULL);
+      const Xml_node_t* bind_shape_matrix_tag = index.find_first_by_tag(skin, "bind_shape_matrix");
+      bind_shape_matrix = parse_m4_(bind_shape_matrix_tag->get_text().m_p, NULL);
     }
-    auto vertex_weights = controller->find_first_by_tag("vertex_weights");
+    auto vertex_weights = index.find_first_by_tag(controller, "vertex_weights");
     auto joint_semantic = vertex_weights->find_first_by_attr("semantic", "JOINT");
-    int joint_offset = atoi(joint_semantic->m_attributes.find("offset")->m_p);
-    const Dynamic_array_t<Cstring_t>& joints = sources.find(joint_semantic->m_attributes.find("source")->get_substr(1))->name_array;
+    int joint_offset = atoi(joint_semantic->get_attribute("offset").m_p);
+    const Dynamic_array_t<Cstring_t>& joints = sources.find(joint_semantic->get_attribute("source").get_substr(1))->name_array;
 
-    auto inv_bind_matrix_semantic = controller->find_first_by_tag("joints")->find_first_by_attr("semantic", "INV_BIND_MATRIX");
-    const Dynamic_array_t<float>& inv_bind_matrices = sources.find(inv_bind_matrix_semantic->m_attributes.find("source")->get_substr(1))->float_array;
+    auto inv_bind_matrix_semantic = index.find_first_by_tag(controller, "joints")->find_first_by_attr("semantic", "INV_BIND_MATRIX");
+    const Dynamic_array_t<float>& inv_bind_matrices = sources.find(inv_bind_matrix_semantic->get_attribute("source").get_substr(1))->float_array;
     // TODO: INV_BIND_MATRIX can duplicate multiple times
     for (int i = 0; i < joints.len(); ++i) {
       int idx = (*joint_map.find(joints[i]))->mat_idx;
       m_inv_bind_matrices[idx] = ((M4_t*)inv_bind_matrices.m_p)[i];
     }
 
-    int stride = vertex_weights->count_all_by_tag("input");
+    int stride = index.count_all_by_tag(vertex_weights, "input");
 
     auto weight_semantic = vertex_weights->find_first_by_attr("semantic", "WEIGHT");
-    int weight_offset = atoi(weight_semantic->m_attributes.find("offset")->m_p);
-    const Dynamic_array_t<float>& weights = sources.find(weight_semantic->m_attributes.find("source")->get_substr(1))->float_array;
+    int weight_offset = atoi(weight_semantic->get_attribute("offset").m_p);
+    const Dynamic_array_t<float>& weights = sources.find(weight_semantic->get_attribute("source").get_substr(1))->float_array;
 
-    const Xml_node_t* geometry = xml.m_root->find_first_by_attr("id", skin->m_attributes.find("source")->get_substr(1));
+    const Xml_node_t* geometry = root->find_first_by_attr("id", skin->get_attribute("source").get_substr(1));
     parse_geometry_node_(&temp_allocator,
                          &m_vertices,
+                         index,
                          geometry,
                          sources,
+                         arrays,
                          &joints,
                          -1,
                          &weights,
@@ -374,29 +562,29 @@ bool Dae_loader_t::init(const Path_t& path) {
   // update_inv_bind_matrix_(&m_inv_bind_matrices, &m_root_joint);
 
   {
-    const Xml_node_t* animations_node = xml.m_root->find_first_by_path("library_animations");
+    const Xml_node_t* animations_node = root->find_first_by_path("library_animations");
     m_animations.reserve(animations_node->m_children.len());
     for (const auto& animation_node : animations_node->m_children) {
       // TODO: <animation> can contain <animation> as child
       Animation_t animation(m_vertices.m_allocator);
-      const Xml_node_t* sampler = animation_node->find_first_by_tag("sampler");
+      const Xml_node_t* sampler = index.find_first_by_tag(animation_node, "sampler");
       {
-        Cstring_t animation_times_id = sampler->find_first_by_attr("semantic", "INPUT")->m_attributes.find("source")->get_substr(1);
+        Cstring_t animation_times_id = sampler->find_first_by_attr("semantic", "INPUT")->get_attribute("source").get_substr(1);
         const Dynamic_array_t<float>& animation_times = sources.find(animation_times_id)->float_array;
         animation.times.resize(animation_times.len());
         memcpy(animation.times.m_p, animation_times.m_p, animation_times.len() * sizeof(float));
         animation.duration = animation.times.last();
       }
       {
-        Cstring_t animation_matrices_id = sampler->find_first_by_attr("semantic", "OUTPUT")->m_attributes.find("source")->get_substr(1);
+        Cstring_t animation_matrices_id = sampler->find_first_by_attr("semantic", "OUTPUT")->get_attribute("source").get_substr(1);
         const Dynamic_array_t<float>& animation_matrices = sources.find(animation_matrices_id)->float_array;
         M_check(animation_matrices.len() == animation.times.len() * 16);
         animation.matrices.resize(animation.times.len());
         memcpy(animation.matrices.m_p, animation_matrices.m_p, animation.times.len() * sizeof(M4_t));
       }
-      auto channel_node = animation_node->find_first_by_tag("channel");
+      auto channel_node = index.find_first_by_tag(animation_node, "channel");
       M_check(channel_node->m_tag_name == "channel");
-      Cstring_t target = channel_node->m_attributes.find("target")->to_const();
+      Cstring_t target = channel_node->get_attribute("target");
       Sip slash_index;
       M_check(target.find_char(&slash_index, '/'));
       Joint_t** joint = joint_map.find(target.get_substr(0, slash_index));
@@ -8,10 +8,64 @@
 
 #include "core/file.h"
 #include "core/log.h"
+#include "core/profiler.h"
 #include "core/utils.h"
 
+#define M_dds_flags_caps_ 0x1
+#define M_dds_flags_height_ 0x2
+#define M_dds_flags_width_ 0x4
+#define M_dds_flags_pixel_format_ 0x1000
+#define M_dds_flags_mip_map_count_ 0x20000
+#define M_dds_pixel_format_four_cc_ 0x4
+#define M_dds_caps_complex_ 0x8
+#define M_dds_caps_texture_ 0x1000
+#define M_dds_caps_mip_map_ 0x400000
+#define M_dds_resource_misc_texture_cube_ 0x4
+
+// Block compressed formats have rows of 4x4 blocks.
+static bool get_subresource_size_(E_format format, U32 width, U32 height, U32* o_row_pitch, U32* o_row_count) {
+  U32 block_dimension = 1;
+  U32 block_size = 0;
+  switch (format) {
+    case e_format_r8g8_unorm:
+      block_size = 2;
+      break;
+    case e_format_r11g11b10_float:
+      block_size = 4;
+      break;
+    case e_format_r16g16b16a16_float:
+      block_size = 8;
+      break;
+    case e_format_bc1_unorm:
+    case e_format_bc4_unorm:
+      block_dimension = 4;
+      block_size = 8;
+      break;
+    case e_format_bc3_unorm:
+    case e_format_bc5_unorm:
+    case e_format_bc6h_ufloat:
+    case e_format_bc7_unorm:
+    case e_format_bc7_typeless:
+      block_dimension = 4;
+      block_size = 16;
+      break;
+    default:
+      return false;
+  }
+  *o_row_pitch = ((width + block_dimension - 1) / block_dimension) * block_size;
+  *o_row_count = (height + block_dimension - 1) / block_dimension;
+  return true;
+}
+
 bool Dds_loader_t::init(const Path_t& path) {
-  m_file_data = File_t::read_whole_file_as_binary(m_file_data.m_allocator, path.m_path);
+  M_profile_zone("Dds_loader_t::init(path)");
+  return init(File_t::read_whole_file_as_binary(m_file_data.m_allocator, path.m_path));
+}
+
+bool Dds_loader_t::init(const Dynamic_array_t<U8>& file_data) {
+  M_profile_zone("Dds_loader_t::init");
+  m_file_data = file_data;
+  M_check_return_val(m_file_data.len() >= (Sip)(4 + sizeof(Dds_header_t)), false);
   U8* p = m_file_data.m_p;
   U32 magic_num = *(U32*)p;
   p += 4;
@@ -20,8 +74,33 @@ bool Dds_loader_t::init(const Path_t& path) {
   M_check_return_val(m_header->size == 124, false);
   p += sizeof(Dds_header_t);
   M_check_log_return_val(m_header->pixel_format.four_cc == four_cc("DX10"), false, "Howelse do we check the format");
+  M_check_return_val(m_file_data.len() >= (Sip)(4 + sizeof(Dds_header_t) + sizeof(Dds_header_dxt10_t)), false);
   m_header10 = (Dds_header_dxt10_t*)p;
   switch(m_header10->dxgi_format) {
+    case e_dxgi_format_r16g16b16a16_float:
+      m_format = e_format_r16g16b16a16_float;
+      break;
+    case e_dxgi_format_r11g11b10_float:
+      m_format = e_format_r11g11b10_float;
+      break;
+    case e_dxgi_format_r8g8_unorm:
+      m_format = e_format_r8g8_unorm;
+      break;
+    case e_dxgi_format_bc1_unorm:
+      m_format = e_format_bc1_unorm;
+      break;
+    case e_dxgi_format_bc3_unorm:
+      m_format = e_format_bc3_unorm;
+      break;
+    case e_dxgi_format_bc4_unorm:
+      m_format = e_format_bc4_unorm;
+      break;
+    case e_dxgi_format_bc5_unorm:
+      m_format = e_format_bc5_unorm;
+      break;
+    case e_dxgi_format_bc6h_uf16:
+      m_format = e_format_bc6h_ufloat;
+      break;
     case e_dxgi_format_bc7_unorm:
       m_format = e_format_bc7_unorm;
       break;
@@ -30,9 +109,62 @@ bool Dds_loader_t::init(const Path_t& path) {
   }
   p+= sizeof(Dds_header_dxt10_t);
   m_data = p;
+  m_mip_count = (m_header->flags & M_dds_flags_mip_map_count_) && m_header->mip_map_count ? m_header->mip_map_count : 1;
+  M_check_log_return_val(m_mip_count <= 32, false, "Too many mip levels");
+  m_is_cube = m_header10->misc_flag & M_dds_resource_misc_texture_cube_;
+  m_array_size = max(m_header10->array_size, 1u) * (m_is_cube ? 6 : 1);
+  m_subresources.resize(m_mip_count * m_array_size);
+  const U8* end = m_file_data.m_p + m_file_data.len();
+  for (U32 i = 0; i < m_array_size; ++i) {
+    U32 width = m_header->width;
+    U32 height = m_header->height;
+    for (U32 j = 0; j < m_mip_count; ++j) {
+      Texture_subresource_t* subresource = &m_subresources[i * m_mip_count + j];
+      subresource->data = p;
+      subresource->width = width;
+      subresource->height = height;
+      M_check_log_return_val(get_subresource_size_(m_format, width, height, &subresource->row_pitch, &subresource->row_count), false, "Unsupported DDS format");
+      Sip size = (Sip)subresource->row_pitch * subresource->row_count;
+      M_check_log_return_val(end - p >= size, false, "The DDS file is truncated");
+      p += size;
+      width = max(width / 2, 1u);
+      height = max(height / 2, 1u);
+    }
+  }
   return true;
 }
 
 void Dds_loader_t::destroy() {
+  m_subresources.destroy();
   m_file_data.destroy();
 }
+
+bool dds_write(const Os_char* path, E_dxgi_format format, U32 width, U32 height, U32 mip_count, const U8* data, Sip data_len) {
+  Dds_header_t header = {};
+  header.size = sizeof(Dds_header_t);
+  header.flags = M_dds_flags_caps_ | M_dds_flags_height_ | M_dds_flags_width_ | M_dds_flags_pixel_format_ | M_dds_flags_mip_map_count_;
+  header.width = width;
+  header.height = height;
+  header.mip_map_count = mip_count;
+  header.pixel_format.size = sizeof(Dds_pixel_format_t);
+  header.pixel_format.flags = M_dds_pixel_format_four_cc_;
+  header.pixel_format.four_cc = four_cc("DX10");
+  header.caps = M_dds_caps_texture_ | (mip_count > 1 ? M_dds_caps_complex_ | M_dds_caps_mip_map_ : 0);
+  Dds_header_dxt10_t header10 = {};
+  header10.dxgi_format = format;
+  header10.resource_dimension = e_d3d10_resource_dimension_texture2d;
+  header10.array_size = 1;
+  File_t f;
+  M_check_log_return_val(f.open(path, e_file_mode_write), false, "Can't open " M_txt_p " to write dds", path);
+  M_scope_exit(f.close());
+  U32 magic_num = 0x20534444;
+  File_iovec_t vecs[] = {
+    {&magic_num, sizeof(magic_num)},
+    {&header, sizeof(header)},
+    {&header10, sizeof(header10)},
+    {data, data_len},
+  };
+  Sip bytes_written = 0;
+  M_check_log_return_val(f.write_v(&bytes_written, vecs, static_array_size(vecs)), false, "Can't write " M_txt_p, path);
+  return true;
+}
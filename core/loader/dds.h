@@ -187,14 +187,26 @@ struct Dds_header_dxt10_t {
 
 class Dds_loader_t {
 public:
-  Dds_loader_t(Allocator_t* allocator) : m_file_data(allocator) {}
+  Dds_loader_t(Allocator_t* allocator) : m_file_data(allocator), m_subresources(allocator) {}
   bool init(const Path_t& path);
+  // Parses the content of a DDS file, |file_data| is owned by the loader.
+  bool init(const Dynamic_array_t<U8>& file_data);
   void destroy();
 
   Dynamic_array_t<U8> m_file_data;
   Dds_header_t* m_header = NULL;
   Dds_header_dxt10_t* m_header10 = NULL;
+  // The top level of the first slice.
   U8* m_data = NULL;
   U8* m_data2 = NULL;
   E_format m_format;
+  U32 m_mip_count = 0;
+  // A cube has 6 slices.
+  U32 m_array_size = 0;
+  bool m_is_cube = false;
+  // Points to |m_file_data|, the mips of the first slice are first like in the file.
+  Dynamic_array_t<Texture_subresource_t> m_subresources;
 };
+
+// Writes a 2D texture with a DX10 header. |data| has the |mip_count| levels one after another, the rows of each level are tightly packed.
+bool dds_write(const Os_char* path, E_dxgi_format format, U32 width, U32 height, U32 mip_count, const U8* data, Sip data_len);
@@ -0,0 +1,569 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/mipmap.h"
+
+#include "core/allocator.h"
+#include "core/compiler.h"
+#include "core/job.h"
+#include "core/linear_allocator.h"
+#include "core/log.h"
+#include "core/profiler.h"
+#include "core/utils.h"
+
+#include <math.h>
+#include <string.h>
+
+// SSE2 is always there on x64, AVX is checked at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define M_mip_sse2_ 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if M_compiler_is_msvc()
+#include <intrin.h>
+#define M_mip_target_avx_
+#else
+#define M_mip_target_avx_ __attribute__((target("avx")))
+#endif
+#endif
+
+static const int gc_max_tap_count_ = 6;
+// Linear values are quantized to this many steps to be encoded to 8-bit sRGB.
+static const int gc_linear_to_srgb8_size_ = 4096;
+// Levels that have fewer pixels are done by one job.
+static const int gc_min_parallel_pixel_count_ = 64 * 1024;
+// Rows of a job are about this many pixels.
+static const int gc_job_pixel_count_ = 16 * 1024;
+
+struct Srgb_tables_t_ {
+  float srgb8_to_linear[256];
+  float srgb16_to_linear[65536];
+  U8 linear_to_srgb8[gc_linear_to_srgb8_size_];
+};
+
+static Srgb_tables_t_ g_srgb_tables_;
+
+static float srgb_to_linear_(float v) {
+  return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb_(float v) {
+  return v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+}
+
+static bool init_srgb_tables_(Srgb_tables_t_* tables) {
+  for (int i = 0; i < 256; ++i) {
+    tables->srgb8_to_linear[i] = srgb_to_linear_(i / 255.0f);
+  }
+  for (int i = 0; i < 65536; ++i) {
+    tables->srgb16_to_linear[i] = srgb_to_linear_(i / 65535.0f);
+  }
+  for (int i = 0; i < gc_linear_to_srgb8_size_; ++i) {
+    tables->linear_to_srgb8[i] = (U8)(linear_to_srgb_(i / (float)(gc_linear_to_srgb8_size_ - 1)) * 255.0f + 0.5f);
+  }
+  return true;
+}
+
+static const Srgb_tables_t_* get_srgb_tables_() {
+  // Built by the first thread that needs it.
+  static const Srgb_tables_t_* sc_tables = init_srgb_tables_(&g_srgb_tables_) ? &g_srgb_tables_ : NULL;
+  return sc_tables;
+}
+
+#if M_mip_sse2_
+static bool has_avx_() {
+#if M_compiler_is_msvc()
+  int info[4];
+  __cpuid(info, 1);
+  // AVX and the OS saves the YMM registers.
+  bool has_avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27));
+  return has_avx && (_xgetbv(0) & 6) == 6;
+#else
+  return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+static double bessel_i0_(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int i = 1; i < 32; ++i) {
+    term *= (x / (2.0 * i)) * (x / (2.0 * i));
+    sum += term;
+  }
+  return sum;
+}
+
+// The taps of one output pixel, they are the same for every pixel because the levels halve.
+struct Mip_filter_t_ {
+  int tap_count;
+  // Offset of the first tap from 2 * x.
+  int first_tap;
+  float weights[gc_max_tap_count_];
+};
+
+static Mip_filter_t_ get_filter_(E_mip_filter filter) {
+  Mip_filter_t_ rv = {};
+  if (filter == e_mip_filter_box) {
+    rv.tap_count = 2;
+    rv.first_tap = 0;
+    rv.weights[0] = 0.5f;
+    rv.weights[1] = 0.5f;
+    return rv;
+  }
+  // The window is 3 output pixels wide with alpha 4, which are the usual values for mips.
+  const double c_alpha = 4.0;
+  const double c_half_width = 1.5;
+  const double c_pi = 3.14159265358979323846;
+  rv.tap_count = 6;
+  rv.first_tap = -2;
+  double weights[6];
+  double sum = 0.0;
+  for (int i = 0; i < 6; ++i) {
+    // The center of the output pixel is between the input pixels 2x and 2x + 1, the distance is in output pixels.
+    double t = (i + rv.first_tap + 0.5 - 1.0) / 2.0;
+    double sinc = t == 0.0 ? 1.0 : sin(c_pi * t) / (c_pi * t);
+    double r = t / c_half_width;
+    double window = r * r < 1.0 ? bessel_i0_(c_alpha * sqrt(1.0 - r * r)) / bessel_i0_(c_alpha) : 0.0;
+    weights[i] = sinc * window;
+    sum += weights[i];
+  }
+  for (int i = 0; i < 6; ++i) {
+    rv.weights[i] = (float)(weights[i] / sum);
+  }
+  return rv;
+}
+
+struct Mip_downsample_t_ {
+  const U8* src;
+  U8* dst;
+  U32 src_width;
+  U32 src_height;
+  U32 dst_width;
+  U32 dst_height;
+  int bytes_per_component;
+  bool is_srgb;
+  bool is_simd;
+  bool has_avx;
+  Mip_filter_t_ filter;
+  const Srgb_tables_t_* srgb_tables;
+};
+
+// Box filter without sRGB, the sums are done on integers.
+static void box_rows_scalar_(const Mip_downsample_t_* d, int begin, int end) {
+  int src_pitch = d->src_width * 4;
+  int dst_pitch = d->dst_width * 4;
+  for (int y = begin; y < end; ++y) {
+    int y1 = min(2 * y + 1, (int)d->src_height - 1);
+    for (U32 x = 0; x < d->dst_width; ++x) {
+      int x1 = min(2 * x + 1, d->src_width - 1);
+      for (int c = 0; c < 4; ++c) {
+        if (d->bytes_per_component == 1) {
+          const U8* row0 = d->src + 2 * y * src_pitch;
+          const U8* row1 = d->src + y1 * src_pitch;
+          int sum = row0[2 * x * 4 + c] + row0[x1 * 4 + c] + row1[2 * x * 4 + c] + row1[x1 * 4 + c];
+          d->dst[y * dst_pitch + x * 4 + c] = (sum + 2) >> 2;
+        } else {
+          const U16* row0 = (const U16*)d->src + 2 * y * src_pitch;
+          const U16* row1 = (const U16*)d->src + y1 * src_pitch;
+          int sum = row0[2 * x * 4 + c] + row0[x1 * 4 + c] + row1[2 * x * 4 + c] + row1[x1 * 4 + c];
+          ((U16*)d->dst)[y * dst_pitch + x * 4 + c] = (sum + 2) >> 2;
+        }
+      }
+    }
+  }
+}
+
+#if M_mip_sse2_
+// 8 input pixels of 2 rows to 4 output pixels per iteration, returns the number of output pixels that are done.
+static U32 box_row8_sse2_(const U8* row0, const U8* row1, U8* dst, U32 dst_width) {
+  const __m128i c_zero = _mm_setzero_si128();
+  const __m128i c_two = _mm_set1_epi16(2);
+  U32 x = 0;
+  for (; x + 4 <= dst_width; x += 4) {
+    __m128i rv[2];
+    for (int i = 0; i < 2; ++i) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(row0 + (x + 2 * i) * 8));
+      __m128i b = _mm_loadu_si128((const __m128i*)(row1 + (x + 2 * i) * 8));
+      // 2 pixels of 4 16-bit components in each half.
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, c_zero), _mm_unpacklo_epi8(b, c_zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, c_zero), _mm_unpackhi_epi8(b, c_zero));
+      __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+      rv[i] = _mm_srli_epi16(_mm_add_epi16(sum, c_two), 2);
+    }
+    _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(rv[0], rv[1]));
+  }
+  return x;
+}
+
+// 4 input pixels of 2 rows to 2 output pixels per iteration.
+static U32 box_row16_sse2_(const U8* row0, const U8* row1, U8* dst, U32 dst_width) {
+  const __m128i c_zero = _mm_setzero_si128();
+  const __m128i c_two = _mm_set1_epi32(2);
+  const __m128i c_bias32 = _mm_set1_epi32(32768);
+  const __m128i c_bias16 = _mm_set1_epi16((short)0x8000);
+  U32 x = 0;
+  for (; x + 2 <= dst_width; x += 2) {
+    __m128i rv[2];
+    for (int i = 0; i < 2; ++i) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(row0 + (x + i) * 16));
+      __m128i b = _mm_loadu_si128((const __m128i*)(row1 + (x + i) * 16));
+      __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a, c_zero), _mm_unpackhi_epi16(a, c_zero)), _mm_add_epi32(_mm_unpacklo_epi16(b, c_zero), _mm_unpackhi_epi16(b, c_zero)));
+      rv[i] = _mm_srli_epi32(_mm_add_epi32(sum, c_two), 2);
+    }
+    // There is no unsigned 32 to 16-bit pack in SSE2, the values are shifted to the signed range and back.
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(rv[0], c_bias32), _mm_sub_epi32(rv[1], c_bias32));
+    _mm_storeu_si128((__m128i*)(dst + x * 8), _mm_xor_si128(packed, c_bias16));
+  }
+  return x;
+}
+#endif
+
+static void box_rows_(const Mip_downsample_t_* d, int begin, int end) {
+#if M_mip_sse2_
+  // The SIMD kernels read 2 input pixels for each output pixel.
+  if (d->is_simd && d->src_width >= 2) {
+    int src_pitch = d->src_width * 4 * d->bytes_per_component;
+    int dst_pitch = d->dst_width * 4 * d->bytes_per_component;
+    for (int y = begin; y < end; ++y) {
+      const U8* row0 = d->src + 2 * y * src_pitch;
+      const U8* row1 = d->src + min(2 * y + 1, (int)d->src_height - 1) * src_pitch;
+      U8* dst = d->dst + y * dst_pitch;
+      U32 x = d->bytes_per_component == 1 ? box_row8_sse2_(row0, row1, dst, d->dst_width) : box_row16_sse2_(row0, row1, dst, d->dst_width);
+      for (; x < d->dst_width; ++x) {
+        for (int c = 0; c < 4; ++c) {
+          if (d->bytes_per_component == 1) {
+            int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+            dst[x * 4 + c] = (sum + 2) >> 2;
+          } else {
+            const U16* r0 = (const U16*)row0;
+            const U16* r1 = (const U16*)row1;
+            int sum = r0[x * 8 + c] + r0[x * 8 + 4 + c] + r1[x * 8 + c] + r1[x * 8 + 4 + c];
+            ((U16*)dst)[x * 4 + c] = (sum + 2) >> 2;
+          }
+        }
+      }
+    }
+    return;
+  }
+#endif
+  box_rows_scalar_(d, begin, end);
+}
+
+// Converts a row to linear float RGBA.
+static void decode_row_(const Mip_downsample_t_* d, const U8* src, float* dst) {
+  U32 width = d->src_width;
+  U32 x = 0;
+  if (d->is_srgb) {
+    const float* table = d->bytes_per_component == 1 ? d->srgb_tables->srgb8_to_linear : d->srgb_tables->srgb16_to_linear;
+    for (; x < width; ++x) {
+      for (int c = 0; c < 3; ++c) {
+        dst[x * 4 + c] = table[d->bytes_per_component == 1 ? src[x * 4 + c] : ((const U16*)src)[x * 4 + c]];
+      }
+      dst[x * 4 + 3] = d->bytes_per_component == 1 ? src[x * 4 + 3] * (1.0f / 255.0f) : ((const U16*)src)[x * 4 + 3] * (1.0f / 65535.0f);
+    }
+    return;
+  }
+#if M_mip_sse2_
+  if (d->is_simd) {
+    const __m128i c_zero = _mm_setzero_si128();
+    if (d->bytes_per_component == 1) {
+      const __m128 c_scale = _mm_set1_ps(1.0f / 255.0f);
+      for (; x + 4 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        __m128i lo = _mm_unpacklo_epi8(v, c_zero);
+        __m128i hi = _mm_unpackhi_epi8(v, c_zero);
+        _mm_storeu_ps(dst + x * 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, c_zero)), c_scale));
+        _mm_storeu_ps(dst + x * 4 + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, c_zero)), c_scale));
+        _mm_storeu_ps(dst + x * 4 + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, c_zero)), c_scale));
+        _mm_storeu_ps(dst + x * 4 + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, c_zero)), c_scale));
+      }
+    } else {
+      const __m128 c_scale = _mm_set1_ps(1.0f / 65535.0f);
+      for (; x + 2 <= width; x += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 8));
+        _mm_storeu_ps(dst + x * 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, c_zero)), c_scale));
+        _mm_storeu_ps(dst + x * 4 + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, c_zero)), c_scale));
+      }
+    }
+  }
+#endif
+  for (; x < width; ++x) {
+    for (int c = 0; c < 4; ++c) {
+      dst[x * 4 + c] = d->bytes_per_component == 1 ? src[x * 4 + c] * (1.0f / 255.0f) : ((const U16*)src)[x * 4 + c] * (1.0f / 65535.0f);
+    }
+  }
+}
+
+// Filters a linear row horizontally, the taps past the edges are clamped.
+static void filter_row_(const Mip_downsample_t_* d, const float* src, float* dst) {
+  const Mip_filter_t_& filter = d->filter;
+  int last = d->src_width - 1;
+  for (U32 x = 0; x < d->dst_width; ++x) {
+    int first = 2 * x + filter.first_tap;
+    bool is_inside = first >= 0 && first + filter.tap_count - 1 <= last;
+#if M_mip_sse2_
+    if (d->is_simd) {
+      __m128 sum = _mm_setzero_ps();
+      for (int k = 0; k < filter.tap_count; ++k) {
+        int i = is_inside ? first + k : min(max(first + k, 0), last);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(filter.weights[k]), _mm_loadu_ps(src + i * 4)));
+      }
+      _mm_storeu_ps(dst + x * 4, sum);
+      continue;
+    }
+#endif
+    for (int c = 0; c < 4; ++c) {
+      float sum = 0.0f;
+      for (int k = 0; k < filter.tap_count; ++k) {
+        int i = is_inside ? first + k : min(max(first + k, 0), last);
+        sum = sum + filter.weights[k] * src[i * 4 + c];
+      }
+      dst[x * 4 + c] = sum;
+    }
+  }
+}
+
+#if M_mip_sse2_
+M_mip_target_avx_ static Sip filter_column_avx_(const float* const* rows, const float* weights, int tap_count, float* dst, Sip len) {
+  Sip i = 0;
+  for (; i + 8 <= len; i += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int k = 0; k < tap_count; ++k) {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+    }
+    _mm256_storeu_ps(dst + i, sum);
+  }
+  return i;
+}
+#endif
+
+// Sums the horizontally filtered rows with the vertical weights.
+static void filter_column_(const Mip_downsample_t_* d, const float* const* rows, float* dst) {
+  const Mip_filter_t_& filter = d->filter;
+  Sip len = (Sip)d->dst_width * 4;
+  Sip i = 0;
+#if M_mip_sse2_
+  if (d->is_simd) {
+    if (d->has_avx) {
+      i = filter_column_avx_(rows, filter.weights, filter.tap_count, dst, len);
+    }
+    for (; i + 4 <= len; i += 4) {
+      __m128 sum = _mm_setzero_ps();
+      for (int k = 0; k < filter.tap_count; ++k) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(filter.weights[k]), _mm_loadu_ps(rows[k] + i)));
+      }
+      _mm_storeu_ps(dst + i, sum);
+    }
+  }
+#endif
+  for (; i < len; ++i) {
+    float sum = 0.0f;
+    for (int k = 0; k < filter.tap_count; ++k) {
+      sum = sum + filter.weights[k] * rows[k][i];
+    }
+    dst[i] = sum;
+  }
+}
+
+// Converts a linear row back, the values are clamped to [0, 1].
+static void encode_row_(const Mip_downsample_t_* d, const float* src, U8* dst) {
+  U32 width = d->dst_width;
+  U32 x = 0;
+  if (d->is_srgb) {
+    for (; x < width; ++x) {
+      for (int c = 0; c < 4; ++c) {
+        float v = min(max(src[x * 4 + c], 0.0f), 1.0f);
+        if (d->bytes_per_component == 1) {
+          dst[x * 4 + c] = c < 3 ? d->srgb_tables->linear_to_srgb8[(int)(v * (gc_linear_to_srgb8_size_ - 1) + 0.5f)] : (U8)(v * 255.0f + 0.5f);
+        } else {
+          ((U16*)dst)[x * 4 + c] = (U16)((c < 3 ? linear_to_srgb_(v) : v) * 65535.0f + 0.5f);
+        }
+      }
+    }
+    return;
+  }
+#if M_mip_sse2_
+  if (d->is_simd) {
+    const __m128 c_zero = _mm_setzero_ps();
+    const __m128 c_one = _mm_set1_ps(1.0f);
+    const __m128 c_half = _mm_set1_ps(0.5f);
+    if (d->bytes_per_component == 1) {
+      const __m128 c_scale = _mm_set1_ps(255.0f);
+      for (; x + 4 <= width; x += 4) {
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) {
+          __m128 f = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + (x + i) * 4), c_zero), c_one);
+          v[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, c_scale), c_half));
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+        _mm_storeu_si128((__m128i*)(dst + x * 4), packed);
+      }
+    } else {
+      const __m128 c_scale = _mm_set1_ps(65535.0f);
+      const __m128i c_bias32 = _mm_set1_epi32(32768);
+      const __m128i c_bias16 = _mm_set1_epi16((short)0x8000);
+      for (; x + 2 <= width; x += 2) {
+        __m128i v[2];
+        for (int i = 0; i < 2; ++i) {
+          __m128 f = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + (x + i) * 4), c_zero), c_one);
+          v[i] = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, c_scale), c_half)), c_bias32);
+        }
+        _mm_storeu_si128((__m128i*)(dst + x * 8), _mm_xor_si128(_mm_packs_epi32(v[0], v[1]), c_bias16));
+      }
+    }
+  }
+#endif
+  for (; x < width; ++x) {
+    for (int c = 0; c < 4; ++c) {
+      float v = min(max(src[x * 4 + c], 0.0f), 1.0f);
+      if (d->bytes_per_component == 1) {
+        dst[x * 4 + c] = (U8)(v * 255.0f + 0.5f);
+      } else {
+        ((U16*)dst)[x * 4 + c] = (U16)(v * 65535.0f + 0.5f);
+      }
+    }
+  }
+}
+
+// Filters in linear float, each input row is decoded and filtered horizontally once and kept while the output rows need it.
+static void float_rows_(const Mip_downsample_t_* d, int begin, int end) {
+  Linear_allocator_t<> temp_allocator("mip_temp_allocator");
+  M_scope_exit(temp_allocator.destroy());
+  int tap_count = d->filter.tap_count;
+  float* linear_row = (float*)temp_allocator.aligned_alloc((Sip)d->src_width * 4 * sizeof(float), 16);
+  float* out_row = (float*)temp_allocator.aligned_alloc((Sip)d->dst_width * 4 * sizeof(float), 16);
+  // The needed rows are consecutive (or clamped) so row r is always in slot r % |tap_count|.
+  float* filtered_rows[gc_max_tap_count_];
+  int filtered_row_indices[gc_max_tap_count_];
+  for (int k = 0; k < tap_count; ++k) {
+    filtered_rows[k] = (float*)temp_allocator.aligned_alloc((Sip)d->dst_width * 4 * sizeof(float), 16);
+    filtered_row_indices[k] = -1;
+  }
+  Sip src_pitch = (Sip)d->src_width * 4 * d->bytes_per_component;
+  Sip dst_pitch = (Sip)d->dst_width * 4 * d->bytes_per_component;
+  const float* rows[gc_max_tap_count_];
+  for (int y = begin; y < end; ++y) {
+    for (int k = 0; k < tap_count; ++k) {
+      int r = min(max(2 * y + d->filter.first_tap + k, 0), (int)d->src_height - 1);
+      int slot = r % tap_count;
+      if (filtered_row_indices[slot] != r) {
+        decode_row_(d, d->src + r * src_pitch, linear_row);
+        filter_row_(d, linear_row, filtered_rows[slot]);
+        filtered_row_indices[slot] = r;
+      }
+      rows[k] = filtered_rows[slot];
+    }
+    filter_column_(d, rows, out_row);
+    encode_row_(d, out_row, d->dst + y * dst_pitch);
+  }
+}
+
+static void downsample_rows_(const Mip_downsample_t_* d, int begin, int end) {
+  // Box without sRGB is the same in integers.
+  if (d->filter.tap_count == 2 && !d->is_srgb) {
+    box_rows_(d, begin, end);
+  } else {
+    float_rows_(d, begin, end);
+  }
+}
+
+static bool downsample_(const U8* src, U32 width, U32 height, U8* dst, E_format format, E_mip_filter filter, bool is_srgb, bool is_simd) {
+  M_check_log_return_val(format == e_format_r8g8b8a8_unorm || format == e_format_r16g16b16a16_unorm, false, "Mips can only be generated for RGBA with 8 or 16 bits");
+  M_check_return_val(width > 0 && height > 0, false);
+  Mip_downsample_t_ d = {};
+  d.src = src;
+  d.dst = dst;
+  d.src_width = width;
+  d.src_height = height;
+  d.dst_width = max(width / 2, 1u);
+  d.dst_height = max(height / 2, 1u);
+  d.bytes_per_component = format == e_format_r8g8b8a8_unorm ? 1 : 2;
+  d.is_srgb = is_srgb;
+  d.is_simd = is_simd;
+  d.filter = get_filter_(filter);
+  d.srgb_tables = is_srgb ? get_srgb_tables_() : NULL;
+#if M_mip_sse2_
+  static const bool sc_has_avx = has_avx_();
+  d.has_avx = sc_has_avx;
+#endif
+  Sip dst_pixel_count = (Sip)d.dst_width * d.dst_height;
+  if (!is_simd || job_get_worker_index() == -1 || dst_pixel_count < gc_min_parallel_pixel_count_) {
+    downsample_rows_(&d, 0, d.dst_height);
+    return true;
+  }
+  // Each job decodes the input rows that its first output row needs again, the rows are big enough to make that small.
+  int grain_size = max(gc_job_pixel_count_ / (int)d.dst_width, 4);
+  job_parallel_for(0, d.dst_height, grain_size, [&d](int begin, int end) {
+    downsample_rows_(&d, begin, end);
+  });
+  return true;
+}
+
+bool mip_downsample(const U8* src, U32 width, U32 height, U8* dst, E_format format, E_mip_filter filter, bool is_srgb) {
+  M_profile_zone("mip_downsample");
+  return downsample_(src, width, height, dst, format, filter, is_srgb, true);
+}
+
+bool mip_downsample_scalar(const U8* src, U32 width, U32 height, U8* dst, E_format format, E_mip_filter filter, bool is_srgb) {
+  return downsample_(src, width, height, dst, format, filter, is_srgb, false);
+}
+
+U32 mip_get_full_count(U32 width, U32 height) {
+  U32 count = 1;
+  for (U32 size = max(width, height); size > 1; size /= 2) {
+    ++count;
+  }
+  return count;
+}
+
+bool Mip_chain_t::init(Allocator_t* allocator, const Mip_chain_create_info_t& ci) {
+  M_profile_zone("Mip_chain_t::init");
+  M_check_log_return_val(ci.format == e_format_r8g8b8a8_unorm || ci.format == e_format_r16g16b16a16_unorm, false, "Mips can only be generated for RGBA with 8 or 16 bits");
+  M_check_return_val(ci.data && ci.width > 0 && ci.height > 0, false);
+  m_allocator = allocator;
+  m_format = ci.format;
+  m_mip_count = mip_get_full_count(ci.width, ci.height);
+  if (ci.max_mip_count) {
+    m_mip_count = min(m_mip_count, ci.max_mip_count);
+  }
+  U32 bytes_per_pixel = ci.format == e_format_r8g8b8a8_unorm ? 4 : 8;
+  Sip data_len = 0;
+  U32 width = ci.width;
+  U32 height = ci.height;
+  for (U32 i = 0; i < m_mip_count; ++i) {
+    Texture_subresource_t* subresource = &m_subresources[i];
+    subresource->width = width;
+    subresource->height = height;
+    subresource->row_pitch = width * bytes_per_pixel;
+    subresource->row_count = height;
+    if (i) {
+      data_len += (Sip)subresource->row_pitch * subresource->row_count;
+    }
+    width = max(width / 2, 1u);
+    height = max(height / 2, 1u);
+  }
+  m_subresources[0].data = (U8*)ci.data;
+  if (m_mip_count > 1) {
+    m_data = (U8*)m_allocator->alloc(data_len);
+    M_check_log_return_val(m_data, false, "Out of memory for the mips");
+  }
+  U8* p = m_data;
+  for (U32 i = 1; i < m_mip_count; ++i) {
+    const Texture_subresource_t& prev = m_subresources[i - 1];
+    m_subresources[i].data = p;
+    M_check_return_val(mip_downsample(prev.data, prev.width, prev.height, p, ci.format, ci.filter, ci.is_srgb), false);
+    p += (Sip)m_subresources[i].row_pitch * m_subresources[i].row_count;
+  }
+  return true;
+}
+
+void Mip_chain_t::destroy() {
+  if (m_data) {
+    m_allocator->free(m_data);
+    m_data = NULL;
+  }
+}
@@ -0,0 +1,58 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/gpu/gpu.h"
+#include "core/types.h"
+
+class Allocator_t;
+
+enum E_mip_filter {
+  // Average of 2x2 pixels.
+  e_mip_filter_box,
+  // Kaiser windowed sinc over 6x6 pixels, it keeps more detail than box but it can ring a little.
+  e_mip_filter_kaiser,
+};
+
+struct Mip_chain_create_info_t {
+  // The top level, tightly packed RGBA with 8 or 16 bits per component (e_format_r8g8b8a8_unorm or e_format_r16g16b16a16_unorm).
+  // It isn't copied so it must be alive as long as the chain.
+  const U8* data;
+  U32 width;
+  U32 height;
+  E_format format;
+  E_mip_filter filter;
+  // RGB is filtered in linear space, alpha is always linear.
+  bool is_srgb;
+  // 0 means all the levels down to 1x1.
+  U32 max_mip_count;
+};
+
+// Generates the levels of a runtime loaded image (PNG, TGA...) so it can be uploaded with all its mips.
+// Each level is filtered from the previous one. On a worker, the rows of the big levels are split among the workers.
+struct Mip_chain_t {
+public:
+  bool init(Allocator_t* allocator, const Mip_chain_create_info_t& ci);
+  void destroy();
+
+  Allocator_t* m_allocator = NULL;
+  // The levels after the top level, the top level is |m_subresources[0].data|.
+  U8* m_data = NULL;
+  Texture_subresource_t m_subresources[32];
+  U32 m_mip_count = 0;
+  E_format m_format;
+};
+
+// Downsamples |src| of |width| x |height| to |dst| of max(|width| / 2, 1) x max(|height| / 2, 1), both are tightly packed.
+// The last column or row of an odd size is dropped by the box filter. Returns false if |format| isn't RGBA with 8 or 16 bits.
+// It uses the SSE2 and AVX kernels if they are available.
+bool mip_downsample(const U8* src, U32 width, U32 height, U8* dst, E_format format, E_mip_filter filter, bool is_srgb);
+// Same as mip_downsample() without SIMD and jobs, the SIMD kernels are tested against it.
+bool mip_downsample_scalar(const U8* src, U32 width, U32 height, U8* dst, E_format format, E_mip_filter filter, bool is_srgb);
+
+// Number of levels down to 1x1.
+U32 mip_get_full_count(U32 width, U32 height);
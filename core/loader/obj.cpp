@@ -11,6 +11,7 @@
 #include "core/linear_allocator.h"
 #include "core/log.h"
 #include "core/math/vec3.h"
+#include "core/profiler.h"
 #include "core/utils.h"
 
 #include <ctype.h>
@@ -45,6 +46,7 @@ static inline int parse_index_(int index, int len) {
 Obj_loader_t::Obj_loader_t(Allocator_t* allocator) : m_vertices(allocator), m_uvs(allocator), m_normals(allocator) {}
 
 bool Obj_loader_t::init(const Os_char* path) {
+  M_profile_zone("Obj_loader_t::init");
   Linear_allocator_t<> temp_allocator("Obj_loader_allocator");
   M_scope_exit(temp_allocator.destroy());
 
@@ -13,12 +13,19 @@
 #include "core/bit_stream.h"
 #include "core/dynamic_array.h"
 #include "core/file.h"
+#include "core/job.h"
 #include "core/linear_allocator.h"
+#include "core/loader/png_unfilter.h"
 #include "core/log.h"
 #include "core/os.h"
+#include "core/profiler.h"
+#include "core/sync.h"
 #include "core/utils.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
 
 #if M_os_is_win()
 #  define M_bswap32_(x) _byteswap_ulong(x)
@@ -27,11 +34,39 @@
 #  define M_bswap32_(x) bswap_32(x)
 #endif
 
-#define M_fast_bit_count 11
+// The chunk fields aren't aligned so they are copied out.
+static U32 read_u32_(const U8* p) {
+  U32 v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+// Number of bits that index the first level of the decode tables, the codes that are longer are decoded with a second lookup in a subtable.
+#define M_lit_or_len_root_bit_count_ 10
+#define M_dist_root_bit_count_ 8
+// Code length codes are at most 7 bits so they never need a subtable.
+#define M_code_len_root_bit_count_ 7
 
 // From 0 - 15
 static const int gc_max_code_len_ = 16;
-static const int gc_max_code_ = 286 + 30;
+// HLIT and HDIST can describe up to 288 + 32 code lengths even if the last 2 of each are never used.
+static const int gc_max_code_ = 288 + 32;
+// Max number of entries (first level + subtables) of the decode tables for any valid code, computed with zlib's examples/enough.c
+// ("enough 288 10 15" and "enough 32 8 15").
+static const int gc_lit_or_len_table_size_ = 1334;
+static const int gc_dist_table_size_ = 402;
+static const int gc_code_len_table_size_ = 1 << M_code_len_root_bit_count_;
+// A match is copied in chunks of up to 16 bytes so it can write this many bytes after its end.
+static const int gc_match_copy_slack_ = 16;
+static const int gc_max_match_len_ = 258;
+// Max distance of a match.
+static const int gc_inflate_window_size_ = 32 * 1024;
+// Minimum number of bytes that are inflated between two flushes of the window.
+static const int gc_inflate_chunk_size_ = 64 * 1024;
+// Images with at least this many bytes of inflated data are unfiltered by a job while they are inflated.
+static const Sip gc_min_pipelined_image_size_ = 1024 * 1024;
+// Number of bytes that are inflated between two slides of a pipelined window.
+static const int gc_pipelined_inflate_size_ = 1024 * 1024;
 static const int gc_png_sig_len_ = 8;
 
 static const U8 gc_png_signature_[gc_png_sig_len_] = {137, 80, 78, 71, 13, 10, 26, 10};
@@ -53,33 +88,33 @@ static const int gc_dist_extra_bits_[] = {0, 0, 0,  0,  1,  1,  2,  2,  3,  3,
                                           4, 4, 5,  5,  6,  6,  7,  7,  8,  8,
                                           9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
 
-// Structure saves codes of specific length.
-// |codes| contains codes of a specific length in an increasing order.
-// |min| is the smallest codes of that length.
-// |count| is the number of codes.
-struct Codes_for_length_t_ {
-  U16 codes[gc_max_code_];
-  U16 min;
-  U16 count;
+enum E_huffman_entry_ : U8 {
+  // Unused code or a symbol that isn't allowed (literal/length 286, 287, distance 30, 31).
+  e_huffman_entry_invalid,
+  // |value| is a literal byte or a code length (0 - 18).
+  e_huffman_entry_literal,
+  // |value| is the base of a length or a distance, the extra bits follow the code.
+  e_huffman_entry_base,
+  e_huffman_entry_end_of_block,
+  // |value| is the index of the subtable and |extra_bit_count| is the number of bits that index it.
+  e_huffman_entry_subtable,
 };
 
-struct Symbol_t_ {
-  U16 val;
-  U8 len;
+// Huffman codes are read from the least significant bit so a table is indexed by the next bits of the stream (the reversed code).
+// All the indices that start with a code have the same entry, so a symbol is decoded with one lookup, plus one in a subtable for the long codes.
+struct Huffman_entry_t_ {
+  U16 value;
+  E_huffman_entry_ type;
+  // Bits of the code, in a subtable it's the bits after the first level.
+  U8 code_len : 4;
+  U8 extra_bit_count : 4;
 };
+static_assert(sizeof(Huffman_entry_t_) == 4);
 
-// |cfl| is a pointer to array of where the index is the length and value is the
-// codes for that length.
-struct Alphabet_t_ {
-  Codes_for_length_t_ cfls[gc_max_code_len_];
-  // Since Huffman codes use prefix code, so each code has unique prefix.
-  // But since reading msb is slow, we define |M_fast_bit_count| and reverse all the codes that are shorter or equal in length.
-  // So the reversed codes will have unique endings. And we fill the remaining bits with all possible prefixes and use them as the indices for |fast_table|.
-  // So when we read from a bit stream, we can just read |M_fast_bit_count| bits as the index.
-  // But since most of the codes have shorter lengths, we've benchmarked |M_fast_bit_count| and pick the current value.
-  Symbol_t_ fast_table[1 << M_fast_bit_count];
-  U8 min_len;
-  U8 max_len;
+enum E_huffman_alphabet_ {
+  e_huffman_alphabet_lit_or_len,
+  e_huffman_alphabet_dist,
+  e_huffman_alphabet_code_len,
 };
 
 static U16 reverse16_(U16 n) {
@@ -90,177 +125,420 @@ static U16 reverse16_(U16 n) {
   return n;
 }
 
-// Build an alphabet based on lengths of codes from 0 to |count| - 1.
-static void build_alphabet_(U8* lens, int count, Alphabet_t_* alphabet) {
-  U8 len_counts[gc_max_code_len_] = {};
-  for (int i = 0; i < count; ++i) {
-    if (lens[i]) {
-      alphabet->cfls[lens[i]].codes[len_counts[lens[i]]] = i;
-      len_counts[lens[i]]++;
+static Huffman_entry_t_ get_symbol_entry_(E_huffman_alphabet_ alphabet, int symbol) {
+  Huffman_entry_t_ entry = {};
+  if (alphabet == e_huffman_alphabet_code_len || (alphabet == e_huffman_alphabet_lit_or_len && symbol < 256)) {
+    entry.type = e_huffman_entry_literal;
+    entry.value = symbol;
+  } else if (alphabet == e_huffman_alphabet_lit_or_len) {
+    if (symbol == 256) {
+      entry.type = e_huffman_entry_end_of_block;
+    } else if (symbol - 257 < (int)static_array_size(gc_len_bases_)) {
+      entry.type = e_huffman_entry_base;
+      entry.value = gc_len_bases_[symbol - 257];
+      entry.extra_bit_count = gc_len_extra_bits_[symbol - 257];
     }
+  } else if (symbol < (int)static_array_size(gc_dist_bases_)) {
+    entry.type = e_huffman_entry_base;
+    entry.value = gc_dist_bases_[symbol];
+    entry.extra_bit_count = gc_dist_extra_bits_[symbol];
   }
-  for (int i = 0; i < gc_max_code_len_; ++i) {
-    if (len_counts[i]) {
-      alphabet->min_len = i;
-      break;
-    }
+  return entry;
+}
+
+// Builds the decode table of the code lengths |lens| of |count| symbols.
+// A first level entry of a code that is longer than |root_bit_count| points to a subtable that is indexed by the rest of the code.
+// The subtable is just big enough for the codes that start with that entry, so the table size is bounded (see |gc_lit_or_len_table_size_|).
+// Returns false if the lengths don't make a prefix code.
+static bool build_decode_table_(const U8* lens, int count, E_huffman_alphabet_ alphabet, int root_bit_count, Huffman_entry_t_* table, int table_size) {
+  U16 len_counts[gc_max_code_len_] = {};
+  for (int i = 0; i < count; ++i) {
+    len_counts[lens[i]]++;
   }
-  for (U8 i = gc_max_code_len_ - 1; i > 0; --i) {
-    if (len_counts[i]) {
-      alphabet->max_len = i;
-      break;
-    }
+  len_counts[0] = 0;
+  // Codes that are left at each length, a code that is over-subscribed can't be decoded.
+  int left = 1;
+  for (int i = 1; i < gc_max_code_len_; ++i) {
+    left = (left << 1) - len_counts[i];
+    M_check_log_return_val(left >= 0, false, "Over-subscribed Huffman code");
   }
-
-  int smallest_code = 0;
-  for (U8 i = alphabet->min_len; i <= alphabet->max_len; ++i) {
-    smallest_code = smallest_code;
-    alphabet->cfls[i].min = smallest_code;
-    alphabet->cfls[i].count = len_counts[i];
-    smallest_code = (smallest_code + len_counts[i]) << 1;
+  // Symbols sorted by code length, the canonical codes are assigned in this order.
+  U16 offsets[gc_max_code_len_ + 1] = {};
+  for (int i = 1; i < gc_max_code_len_; ++i) {
+    offsets[i + 1] = offsets[i] + len_counts[i];
+  }
+  U16 sorted_symbols[gc_max_code_];
+  for (int i = 0; i < count; ++i) {
+    if (lens[i]) {
+      sorted_symbols[offsets[lens[i]]++] = i;
+    }
   }
 
-  for (int i = alphabet->min_len; i <= M_fast_bit_count; ++i) {
-    for (int j = 0; j < alphabet->cfls[i].count; ++j) {
-      U16 code = alphabet->cfls[i].codes[j];
-      Symbol_t_ fast_code = {code, (U8)i};
-      U16 c = alphabet->cfls[i].min + j;
-      c = reverse16_(c);
-      c = c >> (16 - i);
-      int max_prefix = 1 << (M_fast_bit_count - i);
-      for (int k = 0; k < max_prefix; ++k) {
-        alphabet->fast_table[c | (k << i)] = fast_code;
+  memset(table, 0, table_size * sizeof(Huffman_entry_t_));
+  int table_len = 1 << root_bit_count;
+  const U32 c_root_mask = (1 << root_bit_count) - 1;
+  U32 subtable_prefix = (U32)-1;
+  int subtable_index = 0;
+  int subtable_bit_count = 0;
+  int code = 0;
+  int sorted_index = 0;
+  for (int len = 1; len < gc_max_code_len_; ++len) {
+    for (int i = 0; i < len_counts[len]; ++i, ++code) {
+      int symbol = sorted_symbols[sorted_index++];
+      Huffman_entry_t_ entry = get_symbol_entry_(alphabet, symbol);
+      U32 reversed = reverse16_(code) >> (16 - len);
+      if (len <= root_bit_count) {
+        entry.code_len = len;
+        for (U32 j = reversed; j <= c_root_mask; j += 1 << len) {
+          table[j] = entry;
+        }
+        continue;
+      }
+      U32 prefix = reversed & c_root_mask;
+      if (prefix != subtable_prefix) {
+        // The codes that start with |prefix| are next to each other in the canonical order and the shortest one is first.
+        // Grow the subtable until those codes fill it, like zlib's inflate_table().
+        subtable_prefix = prefix;
+        subtable_index = table_len;
+        subtable_bit_count = len - root_bit_count;
+        int subtable_left = 1 << subtable_bit_count;
+        for (int j = len; j < gc_max_code_len_; ++j) {
+          subtable_left -= len_counts[j] - (j == len ? i : 0);
+          if (subtable_left <= 0) {
+            break;
+          }
+          subtable_left <<= 1;
+          ++subtable_bit_count;
+        }
+        subtable_bit_count = min(subtable_bit_count, gc_max_code_len_ - 1 - root_bit_count);
+        table_len += 1 << subtable_bit_count;
+        M_check_log_return_val(table_len <= table_size, false, "Huffman table overflowed");
+        Huffman_entry_t_& root_entry = table[prefix];
+        root_entry.type = e_huffman_entry_subtable;
+        root_entry.value = subtable_index;
+        root_entry.code_len = root_bit_count;
+        root_entry.extra_bit_count = subtable_bit_count;
+      }
+      entry.code_len = len - root_bit_count;
+      for (U32 j = reversed >> root_bit_count; j < (1u << subtable_bit_count); j += 1 << (len - root_bit_count)) {
+        table[subtable_index + j] = entry;
       }
     }
+    code <<= 1;
   }
+  return true;
 }
 
-inline static int decode_(Bit_stream_t* bs, const Alphabet_t_* c_alphabet) {
-  U16 v = bs->peek_lsb(M_fast_bit_count);
-  Symbol_t_ code = c_alphabet->fast_table[v];
-  if (code.len) {
-    bs->skip(code.len);
-    return code.val;
+// Decodes a symbol and adds its extra bits to |value|.
+// |bs| must have enough bits buffered for the longest code and its extra bits.
+inline static Huffman_entry_t_ decode_(Bit_stream_t* bs, const Huffman_entry_t_* table, int root_bit_count) {
+  Huffman_entry_t_ entry = table[bs->peek_lsb(root_bit_count)];
+  if (entry.type == e_huffman_entry_subtable) {
+    bs->skip(root_bit_count);
+    entry = table[entry.value + bs->peek_lsb(entry.extra_bit_count)];
   }
+  int bit_count = entry.code_len + entry.extra_bit_count;
+  U32 bits = bs->peek_lsb(bit_count);
+  bs->skip(bit_count);
+  entry.value += bits >> entry.code_len;
+  return entry;
+}
+
+struct Huffman_tables_t_ {
+  Huffman_entry_t_ lit_or_len[gc_lit_or_len_table_size_];
+  Huffman_entry_t_ dist[gc_dist_table_size_];
+};
 
-  bs->skip(M_fast_bit_count);
-  v = reverse16_(v) >> (16 - M_fast_bit_count);
+static Huffman_tables_t_ build_fixed_tables_() {
+  Huffman_tables_t_ tables;
+  U8 lens[288];
+  memset(lens, 8, 144);
+  memset(lens + 144, 9, 112);
+  memset(lens + 256, 7, 24);
+  memset(lens + 280, 8, 8);
+  build_decode_table_(lens, 288, e_huffman_alphabet_lit_or_len, M_lit_or_len_root_bit_count_, tables.lit_or_len, gc_lit_or_len_table_size_);
+  memset(lens, 5, 32);
+  build_decode_table_(lens, 32, e_huffman_alphabet_dist, M_dist_root_bit_count_, tables.dist, gc_dist_table_size_);
+  return tables;
+}
+
+static const Huffman_tables_t_& get_fixed_tables_() {
+  // Built the first time a fixed Huffman block is decoded.
+  static const Huffman_tables_t_ sc_tables = build_fixed_tables_();
+  return sc_tables;
+}
 
-  for (U8 i = M_fast_bit_count; i <= c_alphabet->max_len; ++i) {
-    int delta_to_min = v - c_alphabet->cfls[i].min;
-    if (delta_to_min < c_alphabet->cfls[i].count) {
-      return c_alphabet->cfls[i].codes[delta_to_min];
+// Copies |len| bytes from |dist| bytes before |p| to |p|, it can write up to |gc_match_copy_slack_| bytes after |p| + |len|.
+inline static void copy_match_(U8* p, int dist, int len) {
+  const U8* src = p - dist;
+  U8* end = p + len;
+  if (dist >= 16) {
+    do {
+      memcpy(p, src, 16);
+      p += 16;
+      src += 16;
+    } while (p < end);
+  } else if (dist >= 8) {
+    do {
+      memcpy(p, src, 8);
+      p += 8;
+      src += 8;
+    } while (p < end);
+  } else {
+    // The match repeats the last |dist| bytes, copy the first 8 bytes one by one so they contain the pattern,
+    // then store them at the largest multiple of |dist| that is <= 8 until the end.
+    for (int i = 0; i < 8; ++i) {
+      p[i] = src[i];
+    }
+    U64 pattern;
+    memcpy(&pattern, p, sizeof(pattern));
+    int step = 8 - 8 % dist;
+    for (p += step; p < end; p += step) {
+      memcpy(p, &pattern, sizeof(pattern));
     }
-    v = v << 1 | bs->consume_msb(1);
   }
-  M_logf("Can't decode_");
-  return -1;
 }
 
-static void decode_len_and_dist_(U8** o_deflated, int len_code, Bit_stream_t* bs, const Alphabet_t_* c_dist_alphabet) {
-  int len_idx = len_code % 257;
-  int len_base = gc_len_bases_[len_idx];
-  int len_extra_bits = gc_len_extra_bits_[len_idx];
-  int len = len_base + bs->consume_lsb(len_extra_bits);
-  int dist_idx = c_dist_alphabet ? decode_(bs, c_dist_alphabet) : bs->consume_lsb(5);
-  int dist_base = gc_dist_bases_[dist_idx];
-  int dist_extra_bits = gc_dist_extra_bits_[dist_idx];
-  int dist = dist_base + bs->consume_lsb(dist_extra_bits);
-  U8* copy = *o_deflated - dist;
-  for (int i = 0; i < len; ++i) {
-    *(*o_deflated)++ = *copy++;
+enum E_inflate_result_ {
+  e_inflate_result_error,
+  e_inflate_result_end_of_block,
+  e_inflate_result_window_full,
+};
+
+// Decodes the symbols of a Huffman block until the end-of-block symbol or until |*io_p| reaches |limit|, the block can be continued after the window is flushed.
+// |limit| must be followed by |gc_max_match_len_| + |gc_match_copy_slack_| writable bytes. |window| is the first byte that a match can copy from.
+static E_inflate_result_ inflate_huffman_block_(Bit_stream_t* bs, const Huffman_tables_t_* c_tables, const U8* window, const U8* limit, U8** io_p) {
+  U8* p = *io_p;
+  while (p < limit) {
+    // A literal/length code, its extra bits, a distance code and its extra bits are at most 15 + 5 + 15 + 13 bits so one refill is enough.
+    bs->refill();
+    Huffman_entry_t_ lit_or_len = decode_(bs, c_tables->lit_or_len, M_lit_or_len_root_bit_count_);
+    if (lit_or_len.type == e_huffman_entry_literal) {
+      *p++ = lit_or_len.value;
+      // At least 41 bits are left, enough for another literal from the root table without a refill.
+      Huffman_entry_t_ next = c_tables->lit_or_len[bs->peek_lsb(M_lit_or_len_root_bit_count_)];
+      if (next.type == e_huffman_entry_literal) {
+        bs->skip(next.code_len);
+        *p++ = next.value;
+      }
+      continue;
+    }
+    if (lit_or_len.type == e_huffman_entry_end_of_block) {
+      *io_p = p;
+      M_check_log_return_val(!bs->is_overrun(), e_inflate_result_error, "Truncated Huffman block");
+      return e_inflate_result_end_of_block;
+    }
+    M_check_log_return_val(lit_or_len.type == e_huffman_entry_base, e_inflate_result_error, "Invalid literal/length code");
+    Huffman_entry_t_ dist = decode_(bs, c_tables->dist, M_dist_root_bit_count_);
+    M_check_log_return_val(dist.type == e_huffman_entry_base, e_inflate_result_error, "Invalid distance code");
+    M_check_log_return_val(dist.value <= p - window, e_inflate_result_error, "Invalid match");
+    copy_match_(p, dist.value, lit_or_len.value);
+    p += lit_or_len.value;
   }
+  *io_p = p;
+  M_check_log_return_val(!bs->is_overrun(), e_inflate_result_error, "Truncated Huffman block");
+  return e_inflate_result_window_full;
 }
 
-inline static int paeth_(int a, int b, int c) {
-  int p = a + b - c;
-  int pa = abs(p - a);
-  int pb = abs(p - b);
-  int pc = abs(p - c);
-  if (pa <= pb && pa <= pc) {
-    return a;
-  } else if (pb <= pc) {
-    return b;
+// The IDAT chunks are consecutive, they are given to the bit stream one by one.
+struct Idat_reader_t_ {
+  const U8* data;
+  Sip len;
+  // The header of the next chunk.
+  Sip offset;
+};
+
+static bool read_next_idat_(void* context, const U8** o_data, Sip* o_len) {
+  Idat_reader_t_* reader = (Idat_reader_t_*)context;
+  if (reader->offset + 12 > reader->len) {
+    return false;
   }
-  return c;
+  const U8* p = reader->data + reader->offset;
+  int data_len = M_bswap32_(read_u32_(p));
+  if (read_u32_(p + 4) != four_cc("IDAT") || data_len < 0 || data_len > reader->len - reader->offset - 12) {
+    return false;
+  }
+  *o_data = p + 8;
+  *o_len = data_len;
+  // Length, type, data and CRC.
+  reader->offset += data_len + 12;
+  return true;
 }
 
-inline U16 Bit_stream_t::peek_lsb(Sip bit_count) {
-  M_check(bit_count <= 16);
-  int remaining_bit_count = 32 - m_bit_index;
-  if (bit_count <= remaining_bit_count) {
-    return (m_cache_lsb >> m_bit_index) & ((1 << bit_count) - 1);
+// The inflated data goes through a window that keeps the last 32 KB for the matches and the part of a row that isn't complete yet.
+// Each complete row is unfiltered to a two-row buffer (the row and the one above it) and written to the destination.
+// Big images are pipelined: the rows are unfiltered by a job while the next rows are inflated, the window is only slid after the job is done with it.
+struct Png_row_decoder_t_ {
+  U8* window;
+  // Inflating stops at |flush_p| so the complete rows can be unfiltered.
+  U8* flush_p;
+  // The window is slid when the inflated data reaches |limit|.
+  U8* limit;
+  // Number of bytes that were slid out of the window.
+  Sip slid_len;
+  // The filter type byte and the row.
+  int filtered_row_len;
+  int row_len;
+  int bytes_per_pixel;
+  U8* rows[2];
+  // 16-bit rows are swapped (and expanded) here before they are written.
+  U8* converted_row;
+  int width;
+  int height;
+  bool is_16_bit;
+  bool is_rgb;
+  U8* dst;
+  Sip dst_pitch;
+  // The next row to unfilter, only the thread that unfilters uses it.
+  int row_index;
+  bool is_pipelined;
+  // Rows that are complete in the window.
+  std::atomic<int> ready_row_count;
+  // Rows that have been written to |dst|.
+  std::atomic<int> done_row_count;
+  std::atomic<bool> is_row_job_running;
+  std::atomic<bool> has_row_error;
+  Job_counter_t row_job_counter;
+};
+
+static void write_row_(Png_row_decoder_t_* d, const U8* row) {
+  U8* dst = d->dst + d->row_index * d->dst_pitch;
+  if (!d->is_16_bit) {
+    if (d->is_rgb) {
+      png_expand_rgb_to_rgba(row, dst, d->width, 1);
+    } else {
+      memcpy(dst, row, d->row_len);
+    }
+    return;
   }
-  U16 rv = m_cache_lsb >> m_bit_index;
-  bit_count -= remaining_bit_count;
-  if (bit_count <= 8) {
-    rv |= (m_data[m_byte_index + 4] & ((1 << bit_count) - 1)) << remaining_bit_count;
-    return rv;
+  // The unfiltered row is the prior row of the next one so it's swapped in |converted_row|, |dst| is only written.
+  int converted_row_len = d->row_len;
+  if (d->is_rgb) {
+    png_expand_rgb_to_rgba(row, d->converted_row, d->width, 2);
+    converted_row_len = d->width * 8;
+  } else {
+    memcpy(d->converted_row, row, d->row_len);
   }
-  rv |= m_data[m_byte_index + 4] << remaining_bit_count;
-  bit_count -= 8;
-  rv |= (m_data[m_byte_index + 5] & ((1 << bit_count) - 1)) << (remaining_bit_count + 8);
-  return rv;
+  png_swap_16_bit(d->converted_row, converted_row_len / 2);
+  memcpy(dst, d->converted_row, converted_row_len);
 }
 
-inline U16 Bit_stream_t::consume_lsb(Sip bit_count) {
-  U16 rv = peek_lsb(bit_count);
-  skip(bit_count);
-  return rv;
+static bool unfilter_rows_(Png_row_decoder_t_* d, int row_count) {
+  for (; d->row_index < row_count; ++d->row_index) {
+    const U8* filtered = d->window + (Sip)d->row_index * d->filtered_row_len - d->slid_len;
+    U8* row = d->rows[d->row_index & 1];
+    const U8* prior = d->row_index ? d->rows[(d->row_index - 1) & 1] : NULL;
+    M_check_log_return_val(png_unfilter_row(filtered[0], d->bytes_per_pixel, filtered + 1, prior, row, d->row_len), false, "Invalid filter method");
+    write_row_(d, row);
+  }
+  return true;
 }
 
-inline U16 Bit_stream_t::consume_msb(Sip bit_count) {
-  U16 rv = consume_lsb(bit_count);
-  rv = ((rv & 0xAAAA) >>  1) | ((rv & 0x5555) << 1);
-  rv = ((rv & 0xCCCC) >>  2) | ((rv & 0x3333) << 2);
-  rv = ((rv & 0xF0F0) >>  4) | ((rv & 0x0F0F) << 4);
-  rv = ((rv & 0xFF00) >>  8) | ((rv & 0x00FF) << 8);
-  rv = rv >> (16 - bit_count);
-  return rv;
+// Unfilters the ready rows until there isn't any left. Only one of these jobs runs at a time.
+static void unfilter_rows_job_(void* args) {
+  Png_row_decoder_t_* d = (Png_row_decoder_t_*)args;
+  while (true) {
+    int ready_row_count = d->ready_row_count.load(std::memory_order_acquire);
+    if (!unfilter_rows_(d, ready_row_count)) {
+      d->has_row_error.store(true, std::memory_order_relaxed);
+      d->row_index = ready_row_count;
+    }
+    // |row_index| belongs to the next job once the flag is cleared.
+    int done_row_count = d->row_index;
+    d->done_row_count.store(done_row_count, std::memory_order_release);
+    d->is_row_job_running.store(false);
+    // The rows that became ready after the load are done here unless the decoding thread has already started another job for them.
+    if (d->ready_row_count.load() == done_row_count || d->is_row_job_running.exchange(true)) {
+      return;
+    }
+  }
 }
 
-inline void Bit_stream_t::skip(Sip bit_count) {
-  m_bit_index += bit_count;
-  if (m_bit_index > 31) {
-    m_bit_index = m_bit_index % 32;
-    m_byte_index += 4;
-    cache_();
+// Runs other jobs (it can be the row job) until the ready rows are done.
+static void wait_for_rows_(Png_row_decoder_t_* d) {
+  while (d->done_row_count.load(std::memory_order_acquire) < d->ready_row_count.load(std::memory_order_relaxed) || d->is_row_job_running.load(std::memory_order_acquire)) {
+    if (!job_execute_one()) {
+      sync_pause();
+    }
   }
 }
 
-inline void Bit_stream_t::cache_() {
-  m_cache_lsb = 0;
-  // Little endian
-  for (int i = 0; i < 4 && m_byte_index + i < m_len; ++i) {
-    m_cache_lsb |= m_data[m_byte_index + i] << (i * 8);
+// Unfilters the complete rows before |*io_p| (or passes them to the row job), then moves the last 32 KB and the incomplete row to the start of the window if it's full.
+static bool flush_rows_(Png_row_decoder_t_* d, U8** io_p) {
+  U8* p = *io_p;
+  Sip inflated_len = d->slid_len + (p - d->window);
+  M_check_log_return_val(inflated_len / d->filtered_row_len <= d->height, false, "Too much image data");
+  int row_count = inflated_len / d->filtered_row_len;
+  if (d->is_pipelined) {
+    d->ready_row_count.store(row_count);
+    if (!d->is_row_job_running.exchange(true)) {
+      Job_decl_t job = {unfilter_rows_job_, d};
+      job_run(&job, 1, &d->row_job_counter);
+    }
+  } else {
+    M_check_return_val(unfilter_rows_(d, row_count), false);
+  }
+  if (p >= d->limit) {
+    if (d->is_pipelined) {
+      wait_for_rows_(d);
+    }
+    U8* row_p = d->window + (Sip)row_count * d->filtered_row_len - d->slid_len;
+    U8* keep = min(p - gc_inflate_window_size_, row_p);
+    Sip keep_len = p - keep;
+    memmove(d->window, keep, keep_len);
+    d->slid_len += keep - d->window;
+    p = d->window + keep_len;
   }
+  *io_p = p;
+  d->flush_p = min(p + gc_inflate_chunk_size_, d->limit);
+  return true;
 }
 
 bool Png_loader_t::init(Allocator_t* allocator, const Path_t& path) {
+  M_profile_zone("Png_loader_t::init(path)");
+  Linear_allocator_t<> file_allocator("PNG_loader_file_allocator");
+  M_scope_exit(file_allocator.destroy());
+  Dynamic_array_t<U8> data = File_t::read_whole_file_as_binary(&file_allocator, path.m_path);
+  // The file data is freed when this returns.
+  M_scope_exit(m_file_data = NULL; m_file_len = 0);
+  return init(allocator, data.m_p, data.len());
+}
+
+bool Png_loader_t::init(Allocator_t* allocator, const U8* data, Sip len) {
+  M_profile_zone("Png_loader_t::init");
   m_allocator = allocator;
+  M_check_return_val(init_header(data, len), false);
+  Sip pitch = (Sip)m_width * m_bytes_per_pixel;
+  m_data = (U8*)m_allocator->alloc(pitch * m_height);
+  if (!decode(m_data, pitch)) {
+    m_allocator->free(m_data);
+    m_data = NULL;
+    return false;
+  }
+  return true;
+}
 
-  Linear_allocator_t<> temp_allocator("PNG_loader_temp_allocator");
-  M_scope_exit(temp_allocator.destroy());
-  Dynamic_array_t<U8> data = File_t::read_whole_file_as_text(&temp_allocator, path.m_path);
-  M_check_log_return_val(!memcmp(&data[0], &gc_png_signature_[0], gc_png_sig_len_), false, "Invalid PNG signature");
-  Dynamic_array_t<U8> idat_full(&temp_allocator);
-  for (int i = gc_png_sig_len_; i < data.len();) {
-    int data_len = M_bswap32_(*((int*)(&data[0] + i)));
+bool Png_loader_t::init_header(const U8* data, Sip len) {
+  M_check_log_return_val(len >= gc_png_sig_len_ && !memcmp(data, &gc_png_signature_[0], gc_png_sig_len_), false, "Invalid PNG signature");
+  m_file_data = data;
+  m_file_len = len;
+  for (Sip i = gc_png_sig_len_; i + 12 <= len;) {
+    const Sip chunk_offset = i;
+    int data_len = M_bswap32_(read_u32_(data + i));
     i += 4;
-    const U8* chunk_it = &data[0] + i;
-    M_unused(chunk_it);
-    const int chunk_type = *((int*)(&data[0] + i));
+    const U32 chunk_type = read_u32_(data + i);
     i += 4;
-    U8* p = &data[0] + i;
+    M_check_log_return_val(data_len >= 0 && data_len <= len - i - 4, false, "Invalid chunk length");
+    const U8* p = data + i;
     i += data_len;
     // U8* cRC = it;
     i += 4;
     switch (chunk_type) {
     case four_cc("IHDR"): {
       M_check_return_val(data_len == 13, false);
-      m_width = M_bswap32_(*(int*)p);
+      m_width = M_bswap32_(read_u32_(p));
       p += 4;
-      m_height = M_bswap32_(*(int*)p);
+      m_height = M_bswap32_(read_u32_(p));
       p += 4;
       m_bit_depth = *p++;
       U8 color_type = *p++;
@@ -314,8 +592,12 @@ bool Png_loader_t::init(Allocator_t* allocator, const Path_t& path) {
       } else {
         M_unimplemented();
       }
+      m_file_bytes_per_pixel = m_bit_depth / 8 * m_components_per_pixel;
+      if (m_components_per_pixel == 3) {
+        // RGB is expanded to RGBA.
+        m_components_per_pixel = 4;
+      }
       m_bytes_per_pixel = m_bit_depth / 8 * m_components_per_pixel;
-      idat_full.reserve((m_width + 1) * m_height * m_bytes_per_pixel);
       U8 compression_method = *p++;
       M_check_log_return_val(!compression_method, false, "Invalid compression method");
       U8 filter_method = *p++;
@@ -328,213 +610,219 @@ bool Png_loader_t::init(Allocator_t* allocator, const Path_t& path) {
       break;
     }
     case four_cc("IDAT"): {
-      idat_full.append_array(p, data_len);
-      break;
+      M_check_log_return_val(m_width && m_height, false, "IDAT before IHDR");
+      m_idat_offset = chunk_offset;
+      return true;
     }
     case four_cc("IEND"): {
-      Bit_stream_t bs(idat_full.m_p, idat_full.len());
-      // 2 bytes of zlib header.
-      U32 zlib_compress_method = bs.consume_lsb(4);
-      M_check_log_return_val(zlib_compress_method == 8, false, "Invalid zlib compression method");
-      U32 zlib_compress_info = bs.consume_lsb(4);
-      M_unused(zlib_compress_info);
-      M_check_log_return_val((idat_full[0] * 256 + idat_full[1]) % 31 == 0, false, "Invalid FCHECK bits");
-      bs.consume_lsb(5);
-      U8 fdict = bs.consume_lsb(1);
-      M_unused(fdict);
-      U8 flevel = bs.consume_lsb(2);
-      M_unused(flevel);
-      U8* deflated_data = (U8*)temp_allocator.alloc((m_width + 1) * m_height * m_bytes_per_pixel);
-      U8* deflated_p = deflated_data;
-      while (true) {
-        // 3 header bits
-        const U8 bfinal = bs.consume_lsb(1);
-        const U8 ctype = bs.consume_lsb(2);
-        if (ctype == 1) {
-          // Fixed Huffman.
-          for (;;) {
-            int code;
-            code = bs.consume_msb(7);
-            if (code >= 0 && code <= 23) {
-              code += 256;
-              if (code == 256) {
-                break;
-              }
-            } else {
-              code = code << 1 | bs.consume_msb(1);
-              if (code >= 48 && code <= 191) {
-                *deflated_p++ = code - 48;
-                continue;
-              } else if (code >= 192 && code <= 199) {
-                code += 88;
-              } else {
-                code = code << 1 | bs.consume_msb(1);
-                M_check_log_return_val(code >= 400 && code <= 511, false, "Can't decode_ fixed Huffman");
-                *deflated_p++ = code - 256;
-                continue;
-              }
-            }
-            decode_len_and_dist_(&deflated_p, code, &bs, NULL);
-          }
-        } else if (ctype == 2) {
-          // Dynamic Huffman.
-          int hlit = bs.consume_lsb(5) + 257;
-          int hdist = bs.consume_lsb(5) + 1;
-          int hclen = bs.consume_lsb(4) + 4;
-          U8 len_of_len[19] = {};
-          const int c_len_alphabet[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
-          for (int j = 0; j < hclen; ++j) {
-            len_of_len[c_len_alphabet[j]] = bs.consume_lsb(3);
-          }
-          Alphabet_t_ code_len_alphabet = {};
-          build_alphabet_(len_of_len, 19, &code_len_alphabet);
-          int index = 0;
-          U8 lit_and_dist_lens[gc_max_code_] = {};
-          while (index < hlit + hdist) {
-            int code_len = decode_(&bs, &code_len_alphabet);
-            if (code_len < 16) {
-              lit_and_dist_lens[index++] = code_len;
-            } else {
-              U8 repeat_count;
-              U8 repeated_val = 0;
-              if (code_len == 16) {
-                repeat_count = bs.consume_lsb(2) + 3;
-                repeated_val = lit_and_dist_lens[index - 1];
-              } else if (code_len == 17) {
-                repeat_count = bs.consume_lsb(3) + 3;
-              } else if (code_len == 18) {
-                repeat_count = bs.consume_lsb(7) + 11;
-              }
-              memset(lit_and_dist_lens + index, repeated_val, repeat_count);
-              index += repeat_count;
-            }
-            M_check_log_return_val(index <= hlit + hdist, false, "Can't decode_ literal and length alphabet, overflowed");
-          }
-          M_check_log_return_val(lit_and_dist_lens[256], false, "Symbol 256 can't have length of 0");
-          Alphabet_t_ lit_or_len_alphabet = {};
-          build_alphabet_(lit_and_dist_lens, hlit, &lit_or_len_alphabet);
-          Alphabet_t_ dist_alphabet = {};
-          build_alphabet_(lit_and_dist_lens + hlit, hdist, &dist_alphabet);
-          for (;;) {
-            int lit_or_len_code = decode_(&bs, &lit_or_len_alphabet);
-            if (lit_or_len_code < 256) {
-              *deflated_p++ = lit_or_len_code;
-              continue;
-            }
-            if (lit_or_len_code == 256) {
-              break;
-            }
-            decode_len_and_dist_(&deflated_p, lit_or_len_code, &bs, &dist_alphabet);
-          }
+      M_logf_return_val(false, "No IDAT chunk");
+    }
+    }
+  }
+  M_logf_return_val(false, "No IDAT chunk");
+}
+
+bool Png_loader_t::decode(U8* dst, Sip dst_pitch, Allocator_t* temp_allocator) {
+  M_profile_zone("Png_loader_t::decode");
+  Linear_allocator_t<> own_temp_allocator("PNG_loader_temp_allocator");
+  M_scope_exit(own_temp_allocator.destroy());
+  if (!temp_allocator) {
+    temp_allocator = &own_temp_allocator;
+  }
+  Idat_reader_t_ idat_reader = {m_file_data, m_file_len, m_idat_offset};
+  const U8* idat;
+  Sip idat_len;
+  M_check_log_return_val(read_next_idat_(&idat_reader, &idat, &idat_len), false, "Invalid IDAT chunk");
+  Bit_stream_t bs(idat, idat_len, 0, read_next_idat_, &idat_reader);
+  // 2 bytes of zlib header.
+  U8 cmf = bs.consume_lsb(8);
+  U8 flg = bs.consume_lsb(8);
+  M_check_log_return_val((cmf & 0xf) == 8, false, "Invalid zlib compression method");
+  M_check_log_return_val((cmf * 256 + flg) % 31 == 0, false, "Invalid FCHECK bits");
+  M_check_log_return_val(!(flg & 0x20), false, "Preset dictionary is not allowed");
+
+  Png_row_decoder_t_ d = {};
+  // The row job must be done before |d| goes away, even if it fails.
+  M_scope_exit(job_wait(&d.row_job_counter));
+  d.row_len = m_width * m_file_bytes_per_pixel;
+  d.filtered_row_len = d.row_len + 1;
+  d.bytes_per_pixel = m_file_bytes_per_pixel;
+  d.width = m_width;
+  d.height = m_height;
+  d.is_16_bit = m_bit_depth == 16;
+  d.is_rgb = m_file_bytes_per_pixel != m_bytes_per_pixel;
+  d.dst = dst;
+  d.dst_pitch = dst_pitch;
+  d.is_pipelined = job_get_worker_index() != -1 && job_get_worker_count() > 1 && (Sip)d.filtered_row_len * d.height >= gc_min_pipelined_image_size_;
+  // After a slide the window has at most max(32 KB, a row) so there are always |gc_inflate_chunk_size_| bytes to inflate to.
+  // A pipelined window is bigger so it's slid (and waits for the row job) less often.
+  Sip window_size = gc_inflate_window_size_ + d.filtered_row_len + (d.is_pipelined ? gc_pipelined_inflate_size_ : gc_inflate_chunk_size_);
+  d.window = (U8*)temp_allocator->alloc(window_size + gc_max_match_len_ + gc_match_copy_slack_);
+  d.limit = d.window + window_size;
+  d.flush_p = d.window + gc_inflate_chunk_size_;
+  d.rows[0] = (U8*)temp_allocator->alloc(d.row_len);
+  d.rows[1] = (U8*)temp_allocator->alloc(d.row_len);
+  if (d.is_16_bit) {
+    d.converted_row = (U8*)temp_allocator->alloc(m_width * m_bytes_per_pixel);
+  }
+  U8* p = d.window;
+  while (true) {
+    // 3 header bits
+    const U8 bfinal = bs.consume_lsb(1);
+    const U8 ctype = bs.consume_lsb(2);
+    if (ctype == 0) {
+      // Stored.
+      bs.align_to_byte();
+      U16 len = bs.consume_lsb(16);
+      U16 nlen = bs.consume_lsb(16);
+      M_check_log_return_val(len == (U16)~nlen, false, "Invalid stored block length");
+      while (len) {
+        if (p >= d.flush_p) {
+          M_check_return_val(flush_rows_(&d, &p), false);
         }
-        if (bfinal) {
-          break;
+        int count = min<Sip>(len, d.flush_p - p);
+        for (int j = 0; j < count; ++j) {
+          *p++ = bs.consume_lsb(8);
         }
+        len -= count;
       }
-      m_data = (U8*)m_allocator->alloc(m_width * m_height * m_bytes_per_pixel);
-      int bytes_per_deflated_row = m_bytes_per_pixel * m_width + 1;
-      int bytes_per_data_row = m_bytes_per_pixel * m_width;
-      for (int r = 0; r < m_height; ++r) {
-        const U8 filter_type = deflated_data[r * bytes_per_deflated_row];
-        const int data_offset = r * bytes_per_data_row;
-        const int deflated_offset = r * bytes_per_deflated_row + 1;
-        U8* a = &m_data[r * bytes_per_data_row];
-        U8* b = NULL;
-        if (r) {
-          b = &m_data[(r - 1) * bytes_per_data_row];
-        }
-        U8* c = NULL;
-        if (r) {
-          c = &m_data[(r - 1) * bytes_per_data_row];
+      M_check_log_return_val(!bs.is_overrun(), false, "Truncated stored block");
+    } else if (ctype == 1 || ctype == 2) {
+      Huffman_tables_t_ dynamic_tables;
+      const Huffman_tables_t_* tables = &dynamic_tables;
+      if (ctype == 1) {
+        // Fixed Huffman.
+        tables = &get_fixed_tables_();
+      } else {
+        // Dynamic Huffman.
+        int hlit = bs.consume_lsb(5) + 257;
+        int hdist = bs.consume_lsb(5) + 1;
+        int hclen = bs.consume_lsb(4) + 4;
+        U8 len_of_len[19] = {};
+        const int c_len_alphabet[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        for (int j = 0; j < hclen; ++j) {
+          len_of_len[c_len_alphabet[j]] = bs.consume_lsb(3);
         }
-        switch (filter_type) {
-        case 0: {
-          memcpy(m_data + data_offset, deflated_data + deflated_offset, bytes_per_data_row);
-        } break;
-        case 1: {
-          for (int j = 0; j < m_bytes_per_pixel; ++j) {
-            m_data[data_offset + j] = deflated_data[deflated_offset + j];
-          }
-          for (int j = m_bytes_per_pixel; j < bytes_per_data_row; ++j) {
-            m_data[data_offset + j] = deflated_data[deflated_offset + j] + *a++;
-          }
-        } break;
-        case 2: {
-          if (!r) {
-            for (int j = 0; j < bytes_per_data_row; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j];
-            }
-          } else {
-            for (int j = 0; j < bytes_per_data_row; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j] + *b++;
-            }
-          }
-        } break;
-        case 3: {
-          if (!r) {
-            for (int j = 0; j < m_bytes_per_pixel; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j];
-            }
-            for (int j = m_bytes_per_pixel; j < bytes_per_data_row; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j] + *a++ / 2;
-            }
-          } else {
-            for (int j = 0; j < m_bytes_per_pixel; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j] + *b++ / 2;
-            }
-            for (int j = m_bytes_per_pixel; j < bytes_per_data_row; ++j) {
-              int p_i = j - m_bytes_per_pixel;
-              m_data[data_offset + j] = deflated_data[deflated_offset + j] + (a[p_i] + b[p_i]) / 2;
-            }
-          }
-        } break;
-        case 4: {
-          if (!r) {
-            for (int j = 0; j < bytes_per_data_row; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j];
-            }
+        Huffman_entry_t_ code_len_table[gc_code_len_table_size_];
+        M_check_log_return_val(build_decode_table_(len_of_len, 19, e_huffman_alphabet_code_len, M_code_len_root_bit_count_, code_len_table, gc_code_len_table_size_), false, "Invalid code length code");
+        int index = 0;
+        U8 lit_and_dist_lens[gc_max_code_] = {};
+        while (index < hlit + hdist) {
+          bs.refill();
+          Huffman_entry_t_ entry = decode_(&bs, code_len_table, M_code_len_root_bit_count_);
+          M_check_log_return_val(entry.type == e_huffman_entry_literal, false, "Can't decode_ code length");
+          int code_len = entry.value;
+          if (code_len < 16) {
+            lit_and_dist_lens[index++] = code_len;
           } else {
-            for (int j = 0; j < m_bytes_per_pixel; ++j) {
-              m_data[data_offset + j] = deflated_data[deflated_offset + j] + paeth_(0, *b++, 0);
-            }
-            for (int j = m_bytes_per_pixel; j < bytes_per_data_row; ++j) {
-              int p_i = j - m_bytes_per_pixel;
-              m_data[data_offset + j] = deflated_data[deflated_offset + j] + paeth_(a[p_i], b[p_i], c[p_i]);
+            U8 repeat_count;
+            U8 repeated_val = 0;
+            if (code_len == 16) {
+              M_check_log_return_val(index, false, "Nothing to repeat");
+              repeat_count = bs.consume_lsb(2) + 3;
+              repeated_val = lit_and_dist_lens[index - 1];
+            } else if (code_len == 17) {
+              repeat_count = bs.consume_lsb(3) + 3;
+            } else {
+              repeat_count = bs.consume_lsb(7) + 11;
             }
+            M_check_log_return_val(index + repeat_count <= hlit + hdist, false, "Can't decode_ literal and length alphabet, overflowed");
+            memset(lit_and_dist_lens + index, repeated_val, repeat_count);
+            index += repeat_count;
           }
-        } break;
-        default:
-          M_logf_return_val(false, "Invalid filter method");
         }
+        M_check_log_return_val(lit_and_dist_lens[256], false, "Symbol 256 can't have length of 0");
+        M_check_log_return_val(build_decode_table_(lit_and_dist_lens, hlit, e_huffman_alphabet_lit_or_len, M_lit_or_len_root_bit_count_, dynamic_tables.lit_or_len, gc_lit_or_len_table_size_), false, "Invalid literal/length code");
+        M_check_log_return_val(build_decode_table_(lit_and_dist_lens + hlit, hdist, e_huffman_alphabet_dist, M_dist_root_bit_count_, dynamic_tables.dist, gc_dist_table_size_), false, "Invalid distance code");
       }
-      if (m_bit_depth == 16) {
-        for (int j = 0; j < m_bytes_per_pixel * m_width * m_height; j = j + 2) {
-          swap(&m_data[j], &m_data[j+1]);
-        }
-      }
-      if (m_components_per_pixel == 3) {
-        U8* temp_data = (U8*)temp_allocator.alloc(m_width * m_height * m_bytes_per_pixel);
-        memcpy(temp_data, m_data, m_width * m_height * m_bytes_per_pixel);
-        U8 new_components_per_pixel = 4;
-        U8 new_bytes_per_pixel = m_bit_depth * new_components_per_pixel / 8;
-        m_data = (U8*)allocator->realloc(m_data, m_width * m_height * new_bytes_per_pixel);
-        for (int j = 0; j < m_width * m_height; ++j) {
-          memcpy(m_data + j * new_bytes_per_pixel, temp_data + j * m_bytes_per_pixel, m_bytes_per_pixel);
-          // Set alpha to max
-          for (int k = m_bytes_per_pixel; k < new_bytes_per_pixel; ++k) {
-            m_data[j*new_bytes_per_pixel + k] = 255;
-          }
+      while (true) {
+        E_inflate_result_ result = inflate_huffman_block_(&bs, tables, d.window, d.flush_p, &p);
+        M_check_log_return_val(result != e_inflate_result_error, false, "Can't decode_ Huffman block");
+        if (result == e_inflate_result_end_of_block) {
+          break;
         }
-        m_components_per_pixel = new_components_per_pixel;
-        m_bytes_per_pixel = new_bytes_per_pixel;
+        M_check_return_val(flush_rows_(&d, &p), false);
       }
-      break;
+    } else {
+      M_logf_return_val(false, "Invalid block type");
     }
+    if (bfinal) {
+      break;
     }
   }
+  M_check_return_val(flush_rows_(&d, &p), false);
+  if (d.is_pipelined) {
+    wait_for_rows_(&d);
+    M_check_return_val(!d.has_row_error.load(std::memory_order_relaxed), false);
+  }
+  M_check_log_return_val(d.row_index == d.height, false, "Not enough image data");
   return true;
 }
 
 void Png_loader_t::destroy() {
   m_allocator->free(m_data);
 }
+
+struct Png_batch_t_ {
+  Allocator_t* allocator;
+  // |allocator| isn't thread-safe.
+  Mutex_t allocator_mutex;
+  const Path_t* paths;
+  Png_loader_t* pngs;
+  // One per worker.
+  Linear_allocator_t<>* scratch_allocators;
+  std::atomic<bool> is_ok;
+};
+
+static bool decode_batch_png_(Png_batch_t_* batch, int index) {
+  // A worker can run another file while it waits inside decode(), that one's scope is nested in this one.
+  Scope_allocator_t<> scratch_allocator(&batch->scratch_allocators[job_get_worker_index()]);
+  Dynamic_array_t<U8> data = File_t::read_whole_file_as_binary(&scratch_allocator, batch->paths[index].m_path);
+  Png_loader_t* png = &batch->pngs[index];
+  // |data| is freed with the scope.
+  M_scope_exit(png->m_file_data = NULL; png->m_file_len = 0);
+  png->m_allocator = batch->allocator;
+  M_check_return_val(png->init_header(data.m_p, data.len()), false);
+  Sip pitch = (Sip)png->m_width * png->m_bytes_per_pixel;
+  {
+    Scope_lock_t lock(&batch->allocator_mutex);
+    png->m_data = (U8*)batch->allocator->alloc(pitch * png->m_height);
+  }
+  if (!png->decode(png->m_data, pitch, &scratch_allocator)) {
+    Scope_lock_t lock(&batch->allocator_mutex);
+    batch->allocator->free(png->m_data);
+    png->m_data = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool png_decode_batch(Allocator_t* allocator, const Path_t* paths, int count, Png_loader_t* o_pngs) {
+  M_profile_zone("png_decode_batch");
+  M_check_log_return_val(job_get_worker_index() != -1, false, "png_decode_batch must be called from a worker");
+  int worker_count = job_get_worker_count();
+  Linear_allocator_t<> batch_allocator("png_batch_allocator");
+  M_scope_exit(batch_allocator.destroy());
+  Linear_allocator_t<>* scratch_allocators = (Linear_allocator_t<>*)batch_allocator.alloc(worker_count * sizeof(Linear_allocator_t<>));
+  for (int i = 0; i < worker_count; ++i) {
+    new (&scratch_allocators[i]) Linear_allocator_t<>("png_batch_scratch_allocator");
+  }
+  Png_batch_t_ batch;
+  batch.allocator = allocator;
+  batch.paths = paths;
+  batch.pngs = o_pngs;
+  batch.scratch_allocators = scratch_allocators;
+  batch.is_ok = true;
+  job_parallel_for(0, count, 1, [&batch](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      if (!decode_batch_png_(&batch, i)) {
+        M_logw("Can't decode %s", batch.paths[i].get_path8().m_path);
+        batch.is_ok.store(false, std::memory_order_relaxed);
+      }
+    }
+  });
+  for (int i = 0; i < worker_count; ++i) {
+    scratch_allocators[i].destroy();
+  }
+  return batch.is_ok.load(std::memory_order_relaxed);
+}
@@ -12,28 +12,20 @@
 
 class Allocator_t;
 
-// Provide methods to read bits value from a bytes array.
-class Bit_stream_t {
-public:
-  Bit_stream_t(const U8* data, int len) : m_data(data), m_len(len) { cache_(); }
-
-  U16 peek_lsb(Sip bit_count);
-  U16 consume_lsb(Sip bit_count);
-  U16 consume_msb(Sip bit_count);
-  void skip(Sip bit_count);
-
-  const U8* m_data = NULL;
-  Sip m_len = 0;
-  U32 m_cache_lsb;
-  Sip m_byte_index = 0;
-  Sip m_bit_index = 0;
-private:
-  void cache_();
-};
-
 struct Png_loader_t {
 public:
   bool init(Allocator_t* allocator, const Path_t& path);
+  // |data| is the content of a PNG file, it's only used during the call.
+  bool init(Allocator_t* allocator, const U8* data, Sip len);
+  // Reads the chunks before the image data so the size and the format are known before decode() is called, nothing is allocated.
+  // |data| must be alive until decode() returns.
+  bool init_header(const U8* data, Sip len);
+  // Decodes the image to |dst| which has |m_height| rows of |m_width| * |m_bytes_per_pixel| bytes, row r starts at |dst| + r * |dst_pitch|.
+  // The IDAT chunks are inflated in place and each row is written as soon as it's unfiltered, only a 32 KB window and two rows are allocated.
+  // |dst| is only written so it can be a mapped upload buffer.
+  // On a worker, big images are unfiltered by another job while they are inflated.
+  // The window is allocated from |temp_allocator|, or from an allocator that is created for the call if it's NULL.
+  bool decode(U8* dst, Sip dst_pitch, Allocator_t* temp_allocator = NULL);
   void destroy();
 
   Allocator_t* m_allocator;
@@ -41,7 +33,18 @@ public:
   U32 m_width = 0;
   U32 m_height = 0;
   U8 m_bit_depth = 0;
+  // RGB is expanded to RGBA so these are the values after the expansion.
   U8 m_components_per_pixel = 0;
   U8 m_bytes_per_pixel = 0;
   E_format m_format;
+  // Set by init_header().
+  const U8* m_file_data = NULL;
+  Sip m_file_len = 0;
+  Sip m_idat_offset = 0;
+  U8 m_file_bytes_per_pixel = 0;
 };
+
+// Decodes |count| PNG files in parallel, one job per file, and waits for all of them. It must be called from a worker.
+// Each worker reads and decodes in its own scratch arena, only the pixels are allocated from |allocator| (under a lock).
+// Returns false if any file can't be decoded, those have a NULL |m_data|.
+bool png_decode_batch(Allocator_t* allocator, const Path_t* paths, int count, Png_loader_t* o_pngs);
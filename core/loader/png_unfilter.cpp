@@ -0,0 +1,322 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/png_unfilter.h"
+
+#include "core/compiler.h"
+#include "core/utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// SSE2 is always there on x64, SSSE3 is checked at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define M_png_sse2_ 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if M_compiler_is_msvc()
+#include <intrin.h>
+#define M_png_target_ssse3_
+#else
+#define M_png_target_ssse3_ __attribute__((target("ssse3")))
+#endif
+#endif
+
+inline static int paeth_(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return a;
+  } else if (pb <= pc) {
+    return b;
+  }
+  return c;
+}
+
+bool png_unfilter_row_scalar(U8 filter_type, int bytes_per_pixel, const U8* filtered, const U8* prior, U8* row, int len) {
+  if (!prior) {
+    // The row before the first row is all zeros, so Up doesn't change anything and Paeth always picks the left byte like Sub.
+    if (filter_type == e_png_filter_up) {
+      filter_type = e_png_filter_none;
+    } else if (filter_type == e_png_filter_paeth) {
+      filter_type = e_png_filter_sub;
+    }
+  }
+  int first_len = min(bytes_per_pixel, len);
+  switch (filter_type) {
+  case e_png_filter_none: {
+    memcpy(row, filtered, len);
+  } break;
+  case e_png_filter_sub: {
+    memcpy(row, filtered, first_len);
+    for (int j = bytes_per_pixel; j < len; ++j) {
+      row[j] = filtered[j] + row[j - bytes_per_pixel];
+    }
+  } break;
+  case e_png_filter_up: {
+    for (int j = 0; j < len; ++j) {
+      row[j] = filtered[j] + prior[j];
+    }
+  } break;
+  case e_png_filter_average: {
+    if (!prior) {
+      memcpy(row, filtered, first_len);
+      for (int j = bytes_per_pixel; j < len; ++j) {
+        row[j] = filtered[j] + row[j - bytes_per_pixel] / 2;
+      }
+    } else {
+      for (int j = 0; j < first_len; ++j) {
+        row[j] = filtered[j] + prior[j] / 2;
+      }
+      for (int j = bytes_per_pixel; j < len; ++j) {
+        row[j] = filtered[j] + (row[j - bytes_per_pixel] + prior[j]) / 2;
+      }
+    }
+  } break;
+  case e_png_filter_paeth: {
+    for (int j = 0; j < first_len; ++j) {
+      row[j] = filtered[j] + prior[j];
+    }
+    for (int j = bytes_per_pixel; j < len; ++j) {
+      row[j] = filtered[j] + paeth_(row[j - bytes_per_pixel], prior[j], prior[j - bytes_per_pixel]);
+    }
+  } break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+#if M_png_sse2_
+static bool has_ssse3_() {
+#if M_compiler_is_msvc()
+  int info[4];
+  __cpuid(info, 1);
+  return info[2] & (1 << 9);
+#else
+  return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// Loads |T_bpp| bytes to the low bytes of a register, the rest are 0.
+template <int T_bpp>
+inline static __m128i load_pixel_(const U8* p) {
+  if constexpr (T_bpp == 4) {
+    int v;
+    memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(v);
+  } else if constexpr (T_bpp == 8) {
+    return _mm_loadl_epi64((const __m128i*)p);
+  } else {
+    U64 v = 0;
+    memcpy(&v, p, T_bpp);
+    return _mm_loadl_epi64((const __m128i*)&v);
+  }
+}
+
+template <int T_bpp>
+inline static void store_pixel_(U8* p, __m128i v) {
+  if constexpr (T_bpp == 4) {
+    int x = _mm_cvtsi128_si32(v);
+    memcpy(p, &x, 4);
+  } else if constexpr (T_bpp == 8) {
+    _mm_storel_epi64((__m128i*)p, v);
+  } else {
+    U64 x;
+    _mm_storel_epi64((__m128i*)&x, v);
+    memcpy(p, &x, T_bpp);
+  }
+}
+
+static void unfilter_up_sse2_(const U8* filtered, const U8* prior, U8* row, int len) {
+  int j = 0;
+  for (; j + 16 <= len; j += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(filtered + j));
+    __m128i b = _mm_loadu_si128((const __m128i*)(prior + j));
+    _mm_storeu_si128((__m128i*)(row + j), _mm_add_epi8(x, b));
+  }
+  for (; j < len; ++j) {
+    row[j] = filtered[j] + prior[j];
+  }
+}
+
+// Sub is a prefix sum of the pixels, it's done on as many whole pixels as fit in 16 bytes with log2(pixel count) shifted adds.
+// The last pixel of the previous block is added to the first pixel before the prefix sum.
+template <int T_bpp>
+static void unfilter_sub_sse2_(const U8* filtered, U8* row, int len) {
+  constexpr int c_step = 16 / T_bpp * T_bpp;
+  const __m128i c_carry_mask = _mm_srli_si128(_mm_set1_epi8(-1), 16 - T_bpp);
+  __m128i carry = _mm_setzero_si128();
+  int j = 0;
+  // It stores 16 bytes, the bytes after |c_step| are overwritten by the next block.
+  for (; j + 16 <= len; j += c_step) {
+    __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(filtered + j)), carry);
+    x = _mm_add_epi8(x, _mm_slli_si128(x, T_bpp));
+    if constexpr (2 * T_bpp < c_step) {
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 2 * T_bpp));
+    }
+    if constexpr (4 * T_bpp < c_step) {
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4 * T_bpp));
+    }
+    _mm_storeu_si128((__m128i*)(row + j), x);
+    carry = _mm_and_si128(_mm_srli_si128(x, c_step - T_bpp), c_carry_mask);
+  }
+  for (; j < len; ++j) {
+    row[j] = filtered[j] + (j >= T_bpp ? row[j - T_bpp] : 0);
+  }
+}
+
+// Each pixel depends on the previous one so it's one pixel at a time.
+template <int T_bpp>
+static void unfilter_average_sse2_(const U8* filtered, const U8* prior, U8* row, int len) {
+  const __m128i c_one = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128();
+  for (int j = 0; j < len; j += T_bpp) {
+    __m128i b = load_pixel_<T_bpp>(prior + j);
+    // _mm_avg_epu8 rounds up, subtract the lost bit to round down.
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), c_one));
+    a = _mm_add_epi8(avg, load_pixel_<T_bpp>(filtered + j));
+    store_pixel_<T_bpp>(row + j, a);
+  }
+}
+
+inline static __m128i abs_epi16_(__m128i x) {
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+inline static __m128i select_(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Paeth is computed on 16-bit lanes without branches, a pixel of up to 8 bytes fits in a register.
+template <int T_bpp>
+static void unfilter_paeth_sse2_(const U8* filtered, const U8* prior, U8* row, int len) {
+  const __m128i c_zero = _mm_setzero_si128();
+  __m128i a = c_zero;
+  __m128i c = c_zero;
+  for (int j = 0; j < len; j += T_bpp) {
+    __m128i b = _mm_unpacklo_epi8(load_pixel_<T_bpp>(prior + j), c_zero);
+    // p = a + b - c so p - a = b - c, p - b = a - c and p - c = (b - c) + (a - c).
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = abs_epi16_(_mm_add_epi16(pa, pb));
+    pa = abs_epi16_(pa);
+    pb = abs_epi16_(pb);
+    __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+    // Ties go to a, then b, then c.
+    __m128i nearest = select_(_mm_cmpeq_epi16(pa, smallest), a, select_(_mm_cmpeq_epi16(pb, smallest), b, c));
+    __m128i x = _mm_unpacklo_epi8(load_pixel_<T_bpp>(filtered + j), c_zero);
+    a = _mm_and_si128(_mm_add_epi16(nearest, x), _mm_set1_epi16(0xff));
+    store_pixel_<T_bpp>(row + j, _mm_packus_epi16(a, a));
+    c = b;
+  }
+}
+
+template <int T_bpp>
+static bool unfilter_row_sse2_(U8 filter_type, const U8* filtered, const U8* prior, U8* row, int len) {
+  if (!prior && filter_type != e_png_filter_sub) {
+    // The first row is decoded once per image, it's not worth a kernel.
+    return png_unfilter_row_scalar(filter_type, T_bpp, filtered, prior, row, len);
+  }
+  switch (filter_type) {
+  case e_png_filter_none: {
+    memcpy(row, filtered, len);
+  } break;
+  case e_png_filter_sub: {
+    unfilter_sub_sse2_<T_bpp>(filtered, row, len);
+  } break;
+  case e_png_filter_up: {
+    unfilter_up_sse2_(filtered, prior, row, len);
+  } break;
+  case e_png_filter_average: {
+    unfilter_average_sse2_<T_bpp>(filtered, prior, row, len);
+  } break;
+  case e_png_filter_paeth: {
+    unfilter_paeth_sse2_<T_bpp>(filtered, prior, row, len);
+  } break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+// Expands 4 pixels per iteration. Returns the number of expanded pixels.
+M_png_target_ssse3_ static Sip expand_rgb8_to_rgba8_ssse3_(const U8* src, U8* dst, Sip pixel_count) {
+  const __m128i c_shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i c_alpha = _mm_set1_epi32((int)0xff000000);
+  Sip i = 0;
+  // The 16-byte load reads 4 bytes past the 4 pixels.
+  for (; i + 6 <= pixel_count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(src + i * 3));
+    _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(x, c_shuffle), c_alpha));
+  }
+  return i;
+}
+
+// Expands 2 pixels per iteration. Returns the number of expanded pixels.
+M_png_target_ssse3_ static Sip expand_rgb16_to_rgba16_ssse3_(const U8* src, U8* dst, Sip pixel_count) {
+  const __m128i c_shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+  const __m128i c_alpha = _mm_set1_epi64x((S64)0xffff000000000000ull);
+  Sip i = 0;
+  // The 16-byte load reads 4 bytes past the 2 pixels.
+  for (; i + 3 <= pixel_count; i += 2) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(src + i * 6));
+    _mm_storeu_si128((__m128i*)(dst + i * 8), _mm_or_si128(_mm_shuffle_epi8(x, c_shuffle), c_alpha));
+  }
+  return i;
+}
+#endif
+
+bool png_unfilter_row(U8 filter_type, int bytes_per_pixel, const U8* filtered, const U8* prior, U8* row, int len) {
+#if M_png_sse2_
+  switch (bytes_per_pixel) {
+  case 3:
+    return unfilter_row_sse2_<3>(filter_type, filtered, prior, row, len);
+  case 4:
+    return unfilter_row_sse2_<4>(filter_type, filtered, prior, row, len);
+  case 6:
+    return unfilter_row_sse2_<6>(filter_type, filtered, prior, row, len);
+  case 8:
+    return unfilter_row_sse2_<8>(filter_type, filtered, prior, row, len);
+  }
+  if (filter_type == e_png_filter_up && prior) {
+    unfilter_up_sse2_(filtered, prior, row, len);
+    return true;
+  }
+#endif
+  return png_unfilter_row_scalar(filter_type, bytes_per_pixel, filtered, prior, row, len);
+}
+
+void png_swap_16_bit(U8* data, Sip count) {
+  Sip i = 0;
+#if M_png_sse2_
+  for (; i + 8 <= count; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(data + i * 2));
+    _mm_storeu_si128((__m128i*)(data + i * 2), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+  }
+#endif
+  for (; i < count; ++i) {
+    swap(&data[i * 2], &data[i * 2 + 1]);
+  }
+}
+
+void png_expand_rgb_to_rgba(const U8* src, U8* dst, Sip pixel_count, int bytes_per_component) {
+  Sip i = 0;
+#if M_png_sse2_
+  static const bool sc_has_ssse3 = has_ssse3_();
+  if (sc_has_ssse3) {
+    i = bytes_per_component == 1 ? expand_rgb8_to_rgba8_ssse3_(src, dst, pixel_count) : expand_rgb16_to_rgba16_ssse3_(src, dst, pixel_count);
+  }
+#endif
+  int src_bytes_per_pixel = 3 * bytes_per_component;
+  int dst_bytes_per_pixel = 4 * bytes_per_component;
+  for (; i < pixel_count; ++i) {
+    memcpy(dst + i * dst_bytes_per_pixel, src + i * src_bytes_per_pixel, src_bytes_per_pixel);
+    memset(dst + i * dst_bytes_per_pixel + src_bytes_per_pixel, 0xff, bytes_per_component);
+  }
+}
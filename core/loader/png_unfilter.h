@@ -0,0 +1,32 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/types.h"
+
+// Row filters of PNG, the first byte of each row in the inflated data is one of them.
+enum E_png_filter : U8 {
+  e_png_filter_none,
+  e_png_filter_sub,
+  e_png_filter_up,
+  e_png_filter_average,
+  e_png_filter_paeth,
+};
+
+// Reverses |filter_type| of a row of |len| bytes from |filtered| to |row|.
+// |prior| is the previous unfiltered row or NULL for the first row, which is the same as a row of zeros.
+// |len| is a multiple of |bytes_per_pixel|. |filtered| and |row| can't overlap. Returns false if |filter_type| is invalid.
+// It uses the SIMD kernels for 3, 4, 6 and 8 bytes per pixel if they are available.
+bool png_unfilter_row(U8 filter_type, int bytes_per_pixel, const U8* filtered, const U8* prior, U8* row, int len);
+// Same as png_unfilter_row() without SIMD, the SIMD kernels are tested against it.
+bool png_unfilter_row_scalar(U8 filter_type, int bytes_per_pixel, const U8* filtered, const U8* prior, U8* row, int len);
+
+// Swaps the bytes of |count| 16-bit values in place, PNG stores them big-endian.
+void png_swap_16_bit(U8* data, Sip count);
+// Expands |pixel_count| RGB pixels from |src| to RGBA in |dst| with an opaque alpha.
+// |bytes_per_component| is 1 or 2. |src| and |dst| can't overlap.
+void png_expand_rgb_to_rgba(const U8* src, U8* dst, Sip pixel_count, int bytes_per_component);
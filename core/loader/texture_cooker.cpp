@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+// Compresses a PNG to a DDS, it's run by texture() in cmake/texture.cmake:
+//   texture_cooker --format bc7 [--quality 2] [--mips] [--srgb] --input input.png --output output.dds
+// The PSNR and the speed of the top level are logged.
+
+#include "core/command_line.h"
+#include "core/core_init.h"
+#include "core/job.h"
+#include "core/linear_allocator.h"
+#include "core/loader/bc.h"
+#include "core/loader/dds.h"
+#include "core/loader/mipmap.h"
+#include "core/loader/png.h"
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/path.h"
+#include "core/string.h"
+#include "core/utils.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Cooker_format_t_ {
+  const char* name;
+  E_bc_format format;
+  E_dxgi_format dxgi_format;
+  int channel_count;
+};
+
+// The sRGB DXGI formats aren't used because E_format doesn't have them, --srgb only changes how the mips are filtered.
+static const Cooker_format_t_ gc_formats_[] = {
+  {"bc1", e_bc_format_bc1, e_dxgi_format_bc1_unorm, 3},
+  {"bc4", e_bc_format_bc4, e_dxgi_format_bc4_unorm, 1},
+  {"bc5", e_bc_format_bc5, e_dxgi_format_bc5_unorm, 2},
+  {"bc7", e_bc_format_bc7, e_dxgi_format_bc7_unorm, 4},
+};
+
+static const Cooker_format_t_* find_format_(const char* name) {
+  char lower[8] = {};
+  for (int i = 0; name[i] && i < (int)static_array_size(lower) - 1; ++i) {
+    lower[i] = tolower(name[i]);
+  }
+  for (const Cooker_format_t_& format : gc_formats_) {
+    if (Cstring_t(format.name).equals(lower)) {
+      return &format;
+    }
+  }
+  return NULL;
+}
+
+// Converts the decoded PNG to tightly packed RGBA8, grey is copied to RGB.
+static bool convert_to_rgba8_(const Png_loader_t& png, U8* dst) {
+  Sip pixel_count = (Sip)png.m_width * png.m_height;
+  int component_count = png.m_components_per_pixel;
+  M_check_log_return_val(component_count == 1 || component_count == 4, false, "Unsupported PNG color type");
+  for (Sip i = 0; i < pixel_count; ++i) {
+    U8 rgba[4];
+    for (int c = 0; c < component_count; ++c) {
+      if (png.m_bit_depth == 16) {
+        rgba[c] = (((const U16*)png.m_data)[i * component_count + c] + 128) / 257;
+      } else {
+        rgba[c] = png.m_data[i * component_count + c];
+      }
+    }
+    if (component_count == 1) {
+      rgba[1] = rgba[2] = rgba[0];
+      rgba[3] = 255;
+    }
+    memcpy(dst + i * 4, rgba, 4);
+  }
+  return true;
+}
+
+static bool cook_(const Cooker_format_t_& format, E_bc_quality quality, bool has_mips, bool is_srgb, const Path_t& input, const Path_t& output) {
+  Linear_allocator_t<> allocator("texture_cooker_allocator");
+  M_scope_exit(allocator.destroy());
+  Png_loader_t png;
+  M_check_log_return_val(png.init(&allocator, input), false, "Can't load " M_txt_p, input.m_path);
+  U32 width = png.m_width;
+  U32 height = png.m_height;
+  U8* rgba = (U8*)allocator.alloc((Sip)width * height * 4);
+  M_check_return_val(rgba && convert_to_rgba8_(png, rgba), false);
+
+  Mip_chain_create_info_t ci = {};
+  ci.data = rgba;
+  ci.width = width;
+  ci.height = height;
+  ci.format = e_format_r8g8b8a8_unorm;
+  ci.filter = e_mip_filter_kaiser;
+  ci.is_srgb = is_srgb;
+  ci.max_mip_count = has_mips ? 0 : 1;
+  Mip_chain_t mips;
+  M_check_return_val(mips.init(&allocator, ci), false);
+  M_scope_exit(mips.destroy());
+
+  Sip data_len = 0;
+  for (U32 i = 0; i < mips.m_mip_count; ++i) {
+    data_len += bc_get_size(format.format, mips.m_subresources[i].width, mips.m_subresources[i].height);
+  }
+  U8* data = (U8*)allocator.alloc(data_len);
+  M_check_return_val(data, false);
+  U8* p = data;
+  F64 top_level_seconds = 0.0;
+  S64 start = mono_time_now();
+  for (U32 i = 0; i < mips.m_mip_count; ++i) {
+    const Texture_subresource_t& subresource = mips.m_subresources[i];
+    S64 level_start = mono_time_now();
+    M_check_return_val(bc_encode(subresource.data, subresource.width, subresource.height, p, format.format, quality), false);
+    if (i == 0) {
+      top_level_seconds = mono_time_to_s(mono_time_now() - level_start);
+    }
+    p += bc_get_size(format.format, subresource.width, subresource.height);
+  }
+  F64 seconds = mono_time_to_s(mono_time_now() - start);
+
+  U8* decoded = (U8*)allocator.alloc((Sip)width * height * 4);
+  M_check_return_val(decoded && bc_decode(data, width, height, decoded, format.format), false);
+  F64 psnr = bc_get_psnr(rgba, decoded, width, height, format.channel_count);
+  M_logi(M_txt_p ": %s %ux%u, %u mips, %.2f dB, %.2f MPixel/s (top level), %.3f s", input.m_path, format.name, width, height, mips.m_mip_count, psnr, width * height / max(top_level_seconds, 1e-9) / 1e6, seconds);
+  return dds_write(output.m_path, format.dxgi_format, width, height, mips.m_mip_count, data, data_len);
+}
+
+struct Cook_args_t_ {
+  const Cooker_format_t_* format;
+  E_bc_quality quality;
+  bool has_mips;
+  bool is_srgb;
+  const Path_t* input;
+  const Path_t* output;
+  bool rv;
+};
+
+static void cook_job_(void* args) {
+  Cook_args_t_* a = (Cook_args_t_*)args;
+  a->rv = cook_(*a->format, a->quality, a->has_mips, a->is_srgb, *a->input, *a->output);
+}
+
+int main(int argc, char** argv) {
+  core_init(M_txt("texture_cooker.log"));
+  M_scope_exit(core_destroy());
+  // bc1, bc4, bc5 or bc7.
+  g_cl->register_flag(NULL, "--format", e_value_type_string);
+  // See E_bc_quality, the default is e_bc_quality_normal.
+  g_cl->register_flag(NULL, "--quality", e_value_type_string);
+  g_cl->register_flag(NULL, "--mips", e_value_type_bool);
+  g_cl->register_flag(NULL, "--srgb", e_value_type_bool);
+  g_cl->register_flag(NULL, "--input", e_value_type_string);
+  g_cl->register_flag(NULL, "--output", e_value_type_string);
+  M_check_return_val(g_cl->parse(argc, argv), 1);
+  const char* input_path = g_cl->get_flag_value("--input").m_const_string;
+  const char* output_path = g_cl->get_flag_value("--output").m_const_string;
+  M_check_log_return_val(input_path && output_path, 1, "Usage: texture_cooker --format bc7 [--quality 2] [--mips] [--srgb] --input input.png --output output.dds");
+  const char* format_name = g_cl->get_flag_value("--format").m_const_string;
+  const Cooker_format_t_* format = format_name ? find_format_(format_name) : NULL;
+  M_check_log_return_val(format, 1, "--format must be bc1, bc4, bc5 or bc7");
+  const char* quality_name = g_cl->get_flag_value("--quality").m_const_string;
+  int quality = quality_name ? atoi(quality_name) : e_bc_quality_normal;
+  M_check_log_return_val(quality >= e_bc_quality_fastest && quality <= e_bc_quality_slow, 1, "--quality must be between 0 and 3");
+  bool has_mips = g_cl->get_flag_value("--mips").get_bool();
+  bool is_srgb = g_cl->get_flag_value("--srgb").get_bool();
+  Path_t input = Path_t::from_char(input_path);
+  Path_t output = Path_t::from_char(output_path);
+  // The mip chain and the encoder only split their work when they run on a worker, running cook_ as a job guarantees that.
+  Cook_args_t_ args = {format, (E_bc_quality)quality, has_mips, is_srgb, &input, &output, false};
+  Job_decl_t job = {cook_job_, &args};
+  Job_counter_t counter;
+  job_run(&job, 1, &counter);
+  job_wait(&counter);
+  return args.rv ? 0 : 1;
+}
@@ -13,6 +13,7 @@
 #include "core/linear_allocator.h"
 #include "core/log.h"
 #include "core/math/vec2.h"
+#include "core/profiler.h"
 #include "core/string.h"
 
 #include <stdio.h>
@@ -64,6 +65,7 @@ Ttf_loader_t::Ttf_loader_t(Allocator_t* allocator) : m_allocator(allocator) {
 }
 
 bool Ttf_loader_t::init(const Path_t& path) {
+  M_profile_zone("Ttf_loader_t::init");
   Linear_allocator_t<> temp_allocator("ttf_allocator");
   M_scope_exit(temp_allocator.destroy());
   Dynamic_array_t<U8> ttf = File_t::read_whole_file_as_binary(&temp_allocator, path.m_path);
@@ -8,157 +8,374 @@
 
 #include "core/dynamic_array.h"
 #include "core/file.h"
-#include "core/hash_table.h"
-#include "core/intrusive_list.h"
 #include "core/linear_allocator.h"
+#include "core/loader/xml_scan.h"
+#include "core/log.h"
+#include "core/profiler.h"
 #include "core/string.h"
 #include "core/utils.h"
 
-#include <ctype.h>
-#include <stdlib.h>
+#include <string.h>
 
-static char* alloc_string_(Allocator_t* allocator, const char* start, const char* end) {
-  int len = end - start;
-  char* str = (char*)allocator->alloc(end - start + 1);
-  memcpy(str, start, len);
-  str[len] = 0;
-  return str;
+static bool is_space_(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
-static Xml_node_t* parse_xml_(const char** last_pos, Allocator_t* allocator, const char* start, const char* end) {
-  const char* p = start;
-  Xml_node_t* node = NULL;
-  while (p != end) {
-    if (!node) {
-      node = allocator->construct<Xml_node_t>(allocator);
+// The spaces in the tags are 0 or 1 byte most of the time so they are skipped byte by byte.
+static char* skip_spaces_(char* p, const char* end) {
+  while (p != end && is_space_(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+static bool starts_with_(const char* p, const char* end, const Cstring_t& str) {
+  return end - p >= str.m_length && !memcmp(p, str.m_p, str.m_length);
+}
+
+static char* find_str_(char* p, const char* end, const Cstring_t& str) {
+  while ((p = (char*)memchr(p, str.m_p[0], end - p))) {
+    if (starts_with_(p, end, str)) {
+      return p;
     }
-    while (p != end && *p != '<') {
-      ++p;
+    ++p;
+  }
+  return NULL;
+}
+
+static int encode_utf8_(U32 code, char* dst) {
+  if (code < 0x80) {
+    dst[0] = code;
+    return 1;
+  }
+  if (code < 0x800) {
+    dst[0] = 0xc0 | (code >> 6);
+    dst[1] = 0x80 | (code & 0x3f);
+    return 2;
+  }
+  if (code < 0x10000) {
+    dst[0] = 0xe0 | (code >> 12);
+    dst[1] = 0x80 | ((code >> 6) & 0x3f);
+    dst[2] = 0x80 | (code & 0x3f);
+    return 3;
+  }
+  dst[0] = 0xf0 | (code >> 18);
+  dst[1] = 0x80 | ((code >> 12) & 0x3f);
+  dst[2] = 0x80 | ((code >> 6) & 0x3f);
+  dst[3] = 0x80 | (code & 0x3f);
+  return 4;
+}
+
+// Returns 0 if |name| (without & and ;) isn't a predefined entity or a valid character reference.
+static U32 get_entity_code_(const Cstring_t& name) {
+  if (name == "lt") {
+    return '<';
+  }
+  if (name == "gt") {
+    return '>';
+  }
+  if (name == "amp") {
+    return '&';
+  }
+  if (name == "quot") {
+    return '"';
+  }
+  if (name == "apos") {
+    return '\'';
+  }
+  if (name.m_length < 2 || name.m_p[0] != '#') {
+    return 0;
+  }
+  bool is_hex = name.m_p[1] == 'x';
+  Sip i = is_hex ? 2 : 1;
+  if (i == name.m_length) {
+    return 0;
+  }
+  U32 code = 0;
+  for (; i < name.m_length; ++i) {
+    char c = name.m_p[i];
+    U32 digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (is_hex && c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (is_hex && c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return 0;
     }
-    if (*p == '<') {
-      const char* tag_start = p + 1;
-      if (*tag_start == '?') {
-        p = (const char*)memchr(p, '>', end - p);
-        M_check_log_return_val(p, NULL, "Can't find closing bracket for metadata tag");
-        continue;
-      }
-      while (*(++p) != '>') {}
-      const char* tag_end = p;
-      ++p;
-      // Check self-closing tag
-      bool is_self_closing = false;
-      const char* tag_p = tag_end - 1;
-      while(tag_p > tag_start && isspace(*tag_p)) {
-        --tag_p;
-      }
-      if (*tag_p == '/') {
-        tag_end = tag_p;
-        is_self_closing = true;
-      }
+    code = code * (is_hex ? 16 : 10) + digit;
+    if (code > 0x10ffff) {
+      return 0;
+    }
+  }
+  return code;
+}
 
-      // Parse m_tag_name
-      tag_p = tag_start;
-      while(tag_p != tag_end && isspace(*tag_p)) {
-        ++tag_p;
-      }
-      const char* m_tag_name_start = tag_p;
-      while (tag_p != tag_end && !isspace(*tag_p)) {
-        ++tag_p;
-      }
-      const char* m_tag_name_end = tag_p;
-      node->m_tag_name = alloc_string_(allocator, m_tag_name_start, m_tag_name_end);
-
-      Cstring_t tag_str(tag_p, tag_end);
-      node->m_attributes.reserve(tag_str.count('='));
-      // Parse attribute
-      while (tag_p != tag_end) {
-        // attribute name
-        while(tag_p != tag_end && isspace(*tag_p)) {
-          ++tag_p;
-        }
-        if (tag_p == tag_end) {
-          break;
-        }
+// Decodes the entities of |str| in place, the unknown ones are kept as they are.
+// A reference is never shorter than its UTF-8 encoding so the result fits.
+void xml_decode_entities(Mstring_t* str) {
+  char* end = str->m_p + str->m_length;
+  char* src = (char*)memchr(str->m_p, '&', str->m_length);
+  if (!src) {
+    return;
+  }
+  char* dst = src;
+  while (src != end) {
+    if (*src != '&') {
+      *dst++ = *src++;
+      continue;
+    }
+    // &#x10ffff; is the longest one.
+    char* semicolon = (char*)memchr(src, ';', min(end - src, (Sip)10));
+    U32 code = semicolon ? get_entity_code_(Cstring_t(src + 1, semicolon)) : 0;
+    if (!code) {
+      *dst++ = *src++;
+      continue;
+    }
+    dst += encode_utf8_(code, dst);
+    src = semicolon + 1;
+  }
+  *dst = 0;
+  str->m_length = dst - str->m_p;
+}
 
-        const char* a_name_start = tag_p;
-        while(tag_p != tag_end && !isspace(*tag_p) && *tag_p != '=') {
-          ++tag_p;
-        }
-        const char* a_name_end = tag_p;
-        char* a_name = alloc_string_(allocator, a_name_start, a_name_end);
-        ++tag_p;
+// Finds the ends of the names and the values with the masks of xml_scan_64() instead of testing each byte.
+// The 64 bytes from the first position that isn't in the current block are classified, most of the tags fit in one block.
+// The 0s that terminate the strings are only written before the scanning position so the masks of the block stay right
+// for the bytes after it.
+struct Xml_scanner_t_ {
+  char* end;
+  // The block that the masks are for, it's |end| before the first one.
+  char* block;
+  U64 open_bracket;
+  U64 quote;
+  // Space or structural, it ends the names.
+  U64 delimiter;
+};
 
-        // attribute val
-        while(tag_p != tag_end && *tag_p != '"') {
-          ++tag_p;
-        }
-        const char* a_val_start = ++tag_p;
-        while(tag_p != tag_end && *tag_p != '"') {
-          ++tag_p;
-        }
-        const char* a_val_end = tag_p;
-        char* a_val = alloc_string_(allocator, a_val_start, a_val_end);
-        node->m_attributes[a_name] = a_val;
-        ++tag_p;
-      }
+static Xml_scan_masks_t classify_block_(char* block, char* end) {
+  Xml_scan_masks_t masks;
+  if (end - block >= 64) {
+    xml_scan_64(block, &masks);
+  } else {
+    // The last block is padded with 0s, they aren't in any mask.
+    char tail[64] = {};
+    memcpy(tail, block, end - block);
+    xml_scan_64(tail, &masks);
+  }
+  return masks;
+}
 
-      if (is_self_closing) {
-        if (last_pos) {
-          *last_pos = p;
-        }
-        return node;
+// Returns the first character from |p| whose bit is set in |T_mask|, it's |end| if there isn't any.
+template <U64 Xml_scanner_t_::*T_mask>
+static char* scan_(Xml_scanner_t_* s, char* p) {
+  while (true) {
+    U64 offset = (U64)(p - s->block);
+    if (offset >= 64) {
+      if (p >= s->end) {
+        return s->end;
       }
+      Xml_scan_masks_t masks = classify_block_(p, s->end);
+      s->block = p;
+      s->open_bracket = masks.open_bracket;
+      s->quote = masks.quote;
+      s->delimiter = masks.structural | masks.space;
+      offset = 0;
+    }
+    U64 bits = s->*T_mask >> offset;
+    if (bits) {
+      return p + xml_scan_get_lowest_bit(bits);
+    }
+    p = s->block + 64;
+  }
+}
 
-      // Parse content
-      while (p != end && isspace(*p)) {
-        ++p;
+static char* find_delimiter_(Xml_scanner_t_* s, char* p) {
+  return scan_<&Xml_scanner_t_::delimiter>(s, p);
+}
+
+static char* find_quote_(Xml_scanner_t_* s, char* p, char quote) {
+  while ((p = scan_<&Xml_scanner_t_::quote>(s, p)) != s->end && *p != quote) {
+    ++p;
+  }
+  return p;
+}
+
+// The text between the tags is either short or long like the arrays of COLLADA. The rest of the current block is checked
+// with its mask and memchr() is faster than classifying the blocks for the long ones.
+static char* find_open_bracket_(Xml_scanner_t_* s, char* p) {
+  U64 offset = (U64)(p - s->block);
+  if (offset < 64) {
+    U64 bits = s->open_bracket >> offset;
+    if (bits) {
+      return p + xml_scan_get_lowest_bit(bits);
+    }
+    p = min(s->block + 64, s->end);
+  }
+  char* open_bracket = (char*)memchr(p, '<', s->end - p);
+  return open_bracket ? open_bracket : s->end;
+}
+
+// The nodes that are open, their children are kept in |children| until they are closed so each node allocates its arrays once.
+struct Xml_parser_t_ {
+  Xml_parser_t_(Allocator_t* allocator) : open_nodes(allocator), child_starts(allocator), children(allocator), attributes(allocator) {}
+  void destroy() {
+    open_nodes.destroy();
+    child_starts.destroy();
+    children.destroy();
+    attributes.destroy();
+  }
+
+  Dynamic_array_t<Xml_node_t*> open_nodes;
+  // Where the children of each open node start in |children|.
+  Dynamic_array_t<Sip> child_starts;
+  Dynamic_array_t<Xml_node_t*> children;
+  Dynamic_array_t<Xml_attribute_t> attributes;
+};
+
+static void close_node_(Xml_parser_t_* parser) {
+  Xml_node_t* node = parser->open_nodes.last();
+  Sip start = parser->child_starts.last();
+  Sip count = parser->children.len() - start;
+  if (count) {
+    node->m_children.resize(count);
+    memcpy(node->m_children.m_p, parser->children.m_p + start, count * sizeof(Xml_node_t*));
+  }
+  parser->children.resize(start);
+  parser->open_nodes.resize(parser->open_nodes.len() - 1);
+  parser->child_starts.resize(parser->child_starts.len() - 1);
+}
+
+// The names, the values and the texts are terminated by writing a 0 over the character after them once it's parsed.
+static Xml_node_t* parse_xml_(Allocator_t* allocator, char* start, char* end) {
+  M_profile_zone("parse_xml_");
+  Linear_allocator_t<> scratch_allocator("xml_parser_allocator");
+  M_scope_exit(scratch_allocator.destroy());
+  Xml_parser_t_ parser(&scratch_allocator);
+  M_scope_exit(parser.destroy());
+  Xml_scanner_t_ scanner = {end, end, 0, 0, 0};
+  Xml_scanner_t_* s = &scanner;
+  Xml_node_t* root = NULL;
+  char* p = start;
+  while (true) {
+    char* open_bracket = find_open_bracket_(s, p);
+    if (open_bracket == end) {
+      break;
+    }
+    if (parser.open_nodes.len()) {
+      Xml_node_t* node = parser.open_nodes.last();
+      char* text_start = skip_spaces_(p, open_bracket);
+      if (text_start != open_bracket && !node->m_raw_text.m_p && parser.children.len() == parser.child_starts.last()) {
+        node->m_raw_text = Mstring_t(text_start, open_bracket);
+        *open_bracket = 0;
       }
+    }
+    p = open_bracket + 1;
+    M_check_log_return_val(p != end, NULL, "The XML ends with <");
 
-      // It's the text.
-      if (*p != '<') {
-        const char* text_start = p;
-        const char* text_end = (const char*)memchr(p, '<', end - text_start);
-        M_check_log_return_val(text_end, NULL, "Can't find closing tag");
-        node->m_text = alloc_string_(allocator, text_start, text_end);
-        p = text_end + 1;
-
-        const char* closing_name_start = ++p;
-        const char* closing_name_end = (const char*)memchr(p, '>', end - p);
-        M_check_log_return_val(closing_name_end, NULL, "Can't find closing bracket of closing tag name");
-        M_check_log_return_val(closing_name_end - closing_name_start && !memcmp(closing_name_start, node->m_tag_name.m_p, closing_name_end - closing_name_start), NULL, "Unmatched closing tag name");
-        if (last_pos) {
-          *last_pos = closing_name_end;
+    if (*p == '?') {
+      char* pi_end = find_str_(p, end, "?>");
+      M_check_log_return_val(pi_end, NULL, "Can't find the end of a processing instruction");
+      p = pi_end + 2;
+      continue;
+    }
+    if (*p == '!') {
+      if (starts_with_(p, end, "!--")) {
+        char* comment_end = find_str_(p + 3, end, "-->");
+        M_check_log_return_val(comment_end, NULL, "Can't find the end of a comment");
+        p = comment_end + 3;
+      } else if (starts_with_(p, end, "![CDATA[")) {
+        char* cdata_end = find_str_(p + 8, end, "]]>");
+        M_check_log_return_val(cdata_end, NULL, "Can't find the end of a CDATA section");
+        M_check_log_return_val(parser.open_nodes.len(), NULL, "CDATA section outside of the root");
+        Xml_node_t* node = parser.open_nodes.last();
+        if (!node->m_raw_text.m_p && parser.children.len() == parser.child_starts.last()) {
+          // There isn't any entity in CDATA.
+          node->m_raw_text = Mstring_t(p + 8, cdata_end);
+          node->m_is_text_decoded = true;
+          *cdata_end = 0;
         }
-        return node;
+        p = cdata_end + 3;
+      } else {
+        // <!DOCTYPE ...> without an internal subset.
+        char* declaration_end = (char*)memchr(p, '>', end - p);
+        M_check_log_return_val(declaration_end, NULL, "Can't find the end of a declaration");
+        p = declaration_end + 1;
       }
+      continue;
+    }
 
-      // It's the children
-      while (p != end) {
-        while (p != end && isspace(*p)) {
-          ++p;
-        }
-        const char* opening_bracket = p;
-        M_check_log_return_val(*p == '<', NULL, "This codepath processes children or closing tag which have to start with <");
-        ++p;
-        // It's closing tag.
-        if (*p == '/') {
-          const char* closing_name_start = ++p;
-          const char* closing_name_end = (const char*)memchr(p, '>', end - p);
-          M_check_log_return_val(closing_name_end, NULL, "Can't find closing bracket of closing tag name");
-          M_check_log_return_val(closing_name_end - closing_name_start && !memcmp(closing_name_start, node->m_tag_name.m_p, closing_name_end - closing_name_start), NULL, "Unmatched closing tag name");
-          if (last_pos) {
-            *last_pos = closing_name_end;
-          }
-          return node;
-        }
+    if (*p == '/') {
+      char* name_start = p + 1;
+      char* name_end = find_delimiter_(s, name_start);
+      p = skip_spaces_(name_end, end);
+      M_check_log_return_val(p != end && *p == '>', NULL, "Can't find closing bracket of closing tag name");
+      M_check_log_return_val(parser.open_nodes.len(), NULL, "Closing tag without an opening tag");
+      M_check_log_return_val(parser.open_nodes.last()->m_tag_name == Cstring_t(name_start, name_end), NULL, "Unmatched closing tag name");
+      close_node_(&parser);
+      ++p;
+      continue;
+    }
 
-        Xml_node_t* child = parse_xml_(&p, allocator, opening_bracket, end);
-        node->m_children.append(child);
+    char* name_start = p;
+    char* name_end = find_delimiter_(s, p);
+    M_check_log_return_val(name_start != name_end, NULL, "Empty tag name");
+    p = name_end;
+    parser.attributes.resize(0);
+    bool is_self_closing = false;
+    while (true) {
+      p = skip_spaces_(p, end);
+      M_check_log_return_val(p != end, NULL, "Can't find closing bracket of tag");
+      if (*p == '>') {
         ++p;
+        break;
       }
+      if (*p == '/') {
+        M_check_log_return_val(end - p >= 2 && p[1] == '>', NULL, "/ has to be followed by > in a tag");
+        is_self_closing = true;
+        p += 2;
+        break;
+      }
+      char* attr_name_start = p;
+      char* attr_name_end = find_delimiter_(s, p);
+      M_check_log_return_val(attr_name_start != attr_name_end, NULL, "Empty attribute name");
+      p = skip_spaces_(attr_name_end, end);
+      M_check_log_return_val(p != end && *p == '=', NULL, "Can't find = after an attribute name");
+      p = skip_spaces_(p + 1, end);
+      M_check_log_return_val(p != end && (*p == '"' || *p == '\''), NULL, "Attribute values have to be quoted");
+      char* value_start = p + 1;
+      char* value_end = find_quote_(s, value_start, *p);
+      M_check_log_return_val(value_end != end, NULL, "Can't find the end of an attribute value");
+      parser.attributes.append({Cstring_t(attr_name_start, attr_name_end), Mstring_t(value_start, value_end), false});
+      *value_end = 0;
+      p = value_end + 1;
+    }
+    // The characters after the names have been parsed.
+    *name_end = 0;
+    for (Xml_attribute_t& attr : parser.attributes) {
+      ((char*)attr.name.m_p)[attr.name.m_length] = 0;
+    }
+
+    Xml_node_t* node = allocator->construct<Xml_node_t>(allocator);
+    node->m_tag_name = Cstring_t(name_start, name_end);
+    if (parser.attributes.len()) {
+      node->m_attributes.resize(parser.attributes.len());
+      memcpy(node->m_attributes.m_p, parser.attributes.m_p, parser.attributes.len() * sizeof(Xml_attribute_t));
+    }
+    if (parser.open_nodes.len()) {
+      parser.children.append(node);
+    } else {
+      M_check_log_return_val(!root, NULL, "There can only be one root");
+      root = node;
+    }
+    if (!is_self_closing) {
+      parser.open_nodes.append(node);
+      parser.child_starts.append(parser.children.len());
     }
   }
-  return node;
+  M_check_log_return_val(root && !parser.open_nodes.len(), NULL, "Can't find closing tag");
+  return root;
 }
 
 const Xml_node_t* Xml_node_t::find_first_by_path(const Cstring_t& name) const {
@@ -198,8 +415,8 @@ const Xml_node_t* Xml_node_t::find_first_by_path(const Cstring_t& name) const {
 const Xml_node_t* Xml_node_t::find_first_by_attr(const Cstring_t& name, const Cstring_t& val) const {
   const Xml_node_t* curr = this;
   for (const auto& child : curr->m_children) {
-    Cstring_t* id_val = child->m_attributes.find(name);
-    if (id_val && *id_val == val) {
+    Cstring_t id_val = child->get_attribute(name);
+    if (id_val.m_p && id_val == val) {
       return child;
     }
     const Xml_node_t* child_rv = child->find_first_by_attr(name, val);
@@ -244,19 +461,182 @@ int Xml_node_t::count_all_by_tag(const Cstring_t& name) const {
   return rv;
 }
 
+Cstring_t Xml_node_t::get_attribute(const Cstring_t& name) const {
+  for (Xml_attribute_t& attr : m_attributes) {
+    if (attr.name == name) {
+      if (!attr.is_decoded) {
+        xml_decode_entities(&attr.raw_value);
+        attr.is_decoded = true;
+      }
+      return attr.raw_value.to_const();
+    }
+  }
+  return Cstring_t();
+}
+
+Cstring_t Xml_node_t::get_text() const {
+  if (!m_is_text_decoded) {
+    // The buffer belongs to the parser, decoding it in place doesn't change what is read.
+    Xml_node_t* self = const_cast<Xml_node_t*>(this);
+    if (m_raw_text.m_p) {
+      xml_decode_entities(&self->m_raw_text);
+    }
+    self->m_is_text_decoded = true;
+  }
+  return m_raw_text.to_const();
+}
+
 void Xml_node_t::destory() {
 }
 
+static int count_nodes_(const Xml_node_t* node) {
+  int rv = 1;
+  for (const Xml_node_t* child : node->m_children) {
+    rv += count_nodes_(child);
+  }
+  return rv;
+}
+
+// The subtrees with fewer nodes are walked.
+static const int gc_xml_index_walk_size = 32;
+
+// Returns the first number that isn't less than |pre_order| in [begin, end).
+static const int* lower_bound_(const int* begin, const int* end, int pre_order) {
+  while (begin < end) {
+    const int* middle = begin + (end - begin) / 2;
+    if (*middle < pre_order) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
+
+void Xml_index_t::init(Xml_node_t* root) {
+  M_profile_zone("Xml_index_t::init");
+  M_check_return(root);
+  // The nodes are counted by tag first so |m_nodes| is allocated once. The temporary arrays are big for big documents so
+  // they are allocated once too and from the same allocator.
+  int node_count = count_nodes_(root);
+  m_nodes.resize(node_count);
+  m_pre_orders.resize(node_count);
+  Xml_nodes_t nodes(m_nodes.m_allocator);
+  Dynamic_array_t<int> tag_ids(m_nodes.m_allocator);
+  nodes.reserve(node_count);
+  tag_ids.reserve(node_count);
+  number_nodes_(&nodes, &tag_ids, root, NULL);
+  Sip start = 0;
+  for (Tag_range_t_& range : m_tag_ranges) {
+    range.start = start;
+    start += range.count;
+    range.count = 0;
+  }
+  for (Sip i = 0; i < node_count; ++i) {
+    Tag_range_t_& range = m_tag_ranges[tag_ids[i]];
+    m_nodes[range.start + range.count] = nodes[i];
+    m_pre_orders[range.start + range.count] = i;
+    ++range.count;
+  }
+  tag_ids.destroy();
+  nodes.destroy();
+}
+
+void Xml_index_t::destroy() {
+  m_tags.destroy();
+  m_tag_ranges.destroy();
+  m_pre_orders.destroy();
+  m_nodes.destroy();
+}
+
+const Xml_node_t* Xml_index_t::find_first_by_tag(const Xml_node_t* node, const Cstring_t& name) const {
+  if (node->m_subtree_end - node->m_pre_order <= gc_xml_index_walk_size) {
+    return node->find_first_by_tag(name);
+  }
+  Sip begin;
+  Sip end;
+  find_range_(&begin, &end, node, name);
+  return begin != end ? m_nodes[begin] : NULL;
+}
+
+void Xml_index_t::find_all_by_tag(Xml_nodes_t* nodes, const Xml_node_t* node, const Cstring_t& name) const {
+  if (node->m_subtree_end - node->m_pre_order <= gc_xml_index_walk_size) {
+    node->find_all_by_tag(nodes, name);
+    return;
+  }
+  Sip begin;
+  Sip end;
+  find_range_(&begin, &end, node, name);
+  if (begin != end) {
+    nodes->append_array(m_nodes.m_p + begin, end - begin);
+  }
+}
+
+int Xml_index_t::count_all_by_tag(const Xml_node_t* node, const Cstring_t& name) const {
+  if (node->m_subtree_end - node->m_pre_order <= gc_xml_index_walk_size) {
+    return node->count_all_by_tag(name);
+  }
+  Sip begin;
+  Sip end;
+  find_range_(&begin, &end, node, name);
+  return end - begin;
+}
+
+void Xml_index_t::number_nodes_(Xml_nodes_t* o_nodes, Dynamic_array_t<int>* o_tag_ids, Xml_node_t* node, Xml_node_t* parent) {
+  node->m_parent = parent;
+  node->m_pre_order = o_nodes->len();
+  o_nodes->append(node);
+  int* tag_id = m_tags.find(node->m_tag_name);
+  if (!tag_id) {
+    tag_id = &m_tags[node->m_tag_name];
+    *tag_id = m_tag_ranges.len();
+    m_tag_ranges.append({0, 0});
+  }
+  ++m_tag_ranges[*tag_id].count;
+  o_tag_ids->append(*tag_id);
+  for (Xml_node_t* child : node->m_children) {
+    number_nodes_(o_nodes, o_tag_ids, child, node);
+  }
+  node->m_subtree_end = o_nodes->len();
+}
+
+void Xml_index_t::find_range_(Sip* o_begin, Sip* o_end, const Xml_node_t* node, const Cstring_t& name) const {
+  *o_begin = 0;
+  *o_end = 0;
+  M_check_return(node->m_pre_order >= 0);
+  const int* tag_id = m_tags.find(name);
+  if (!tag_id) {
+    return;
+  }
+  const Tag_range_t_& range = m_tag_ranges[*tag_id];
+  const int* pre_orders = m_pre_orders.m_p + range.start;
+  const int* begin = lower_bound_(pre_orders, pre_orders + range.count, node->m_pre_order + 1);
+  const int* end = lower_bound_(begin, pre_orders + range.count, node->m_subtree_end);
+  *o_begin = begin - m_pre_orders.m_p;
+  *o_end = end - m_pre_orders.m_p;
+}
+
 bool Xml_t::init(const Path_t& path) {
-  Linear_allocator_t<> file_allocator("xml_file_allocator");
-  M_scope_exit(file_allocator.destroy());
-  Dynamic_array_t<U8> buffer = File_t::read_whole_file_as_text(&file_allocator, path.m_path);
-  return init((char*)buffer.m_p, buffer.m_length);
+  M_profile_zone("Xml_t::init(path)");
+  Dynamic_array_t<U8> buffer = File_t::read_whole_file_as_text(m_allocator, path.m_path);
+  M_check_log_return_val(buffer.len(), false, "Can't read " M_txt_p, path.m_path);
+  // The last byte is the 0 that terminates the text.
+  return init_in_situ((char*)buffer.m_p, buffer.len() - 1);
 }
 
 bool Xml_t::init(const char* buffer, int length) {
-  m_root = parse_xml_(NULL, m_allocator, buffer, buffer + length);
-  return true;
+  M_profile_zone("Xml_t::init");
+  char* copy = (char*)m_allocator->alloc(length + 1);
+  M_check_return_val(copy, false);
+  memcpy(copy, buffer, length);
+  copy[length] = 0;
+  return init_in_situ(copy, length);
+}
+
+bool Xml_t::init_in_situ(char* buffer, Sip length) {
+  M_profile_zone("Xml_t::init_in_situ");
+  m_root = parse_xml_(m_allocator, buffer, buffer + length);
+  return m_root;
 }
 
 void Xml_t::destroy() {
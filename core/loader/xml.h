@@ -16,6 +16,14 @@ class Allocator_t;
 class Xml_node_t;
 typedef Dynamic_array_t<Xml_node_t*> Xml_nodes_t;
 
+struct Xml_attribute_t {
+  Cstring_t name;
+  // Read it with Xml_node_t::get_attribute(), the entities aren't decoded before that.
+  Mstring_t raw_value;
+  bool is_decoded;
+};
+
+// The strings are views into the buffer that was parsed, they are terminated by a 0 written over the character after them.
 class Xml_node_t {
 public:
   Xml_node_t(Allocator_t* allocator) : m_attributes(allocator), m_children(allocator) {}
@@ -27,17 +35,72 @@ public:
   void find_all_by_tag(Xml_nodes_t* nodes, const Cstring_t& name) const;
   int count_all_by_tag(const Cstring_t& name) const;
 
-  Mstring_t m_tag_name;
-  Mstring_t m_text;
-  Hash_map_t<Cstring_t, Cstring_t> m_attributes;
+  // The entities (&lt; &#60; ...) are decoded in place the first time a value is read.
+  // Returns an empty string without data if the node doesn't have the attribute.
+  Cstring_t get_attribute(const Cstring_t& name) const;
+  Cstring_t get_text() const;
+
+  Cstring_t m_tag_name;
+  // The text before the first child or the closing tag, the leading spaces are skipped. Read it with get_text().
+  Mstring_t m_raw_text;
+  bool m_is_text_decoded = false;
+  // Both are allocated once with their final size when the closing tag is parsed.
+  Dynamic_array_t<Xml_attribute_t> m_attributes;
   Xml_nodes_t m_children;
+  // Set by Xml_index_t::init(). The nodes are numbered in document order, the subtree of a node is
+  // [m_pre_order, m_subtree_end).
+  Xml_node_t* m_parent = NULL;
+  int m_pre_order = -1;
+  int m_subtree_end = -1;
 };
 
+// Built once after parsing so finding the nodes by tag doesn't walk the subtrees.
+// The nodes of each tag are kept in document order and the ones of a subtree are a range of them that is binary searched
+// with the numbers of the subtree. The queries give the same results as the ones of Xml_node_t.
+class Xml_index_t {
+public:
+  Xml_index_t(Allocator_t* allocator) : m_nodes(allocator), m_pre_orders(allocator), m_tag_ranges(allocator), m_tags(allocator) {}
+  // The tree mustn't change after that.
+  void init(Xml_node_t* root);
+  void destroy();
+
+  // |node| has to be in the tree of the index, the node itself isn't part of the results. The small subtrees are still walked
+  // because it's faster than searching the ranges.
+  const Xml_node_t* find_first_by_tag(const Xml_node_t* node, const Cstring_t& name) const;
+  void find_all_by_tag(Xml_nodes_t* nodes, const Xml_node_t* node, const Cstring_t& name) const;
+  int count_all_by_tag(const Xml_node_t* node, const Cstring_t& name) const;
+
+private:
+  struct Tag_range_t_ {
+    Sip start;
+    Sip count;
+  };
+  // Appends the nodes in document order and the ids of their tags.
+  void number_nodes_(Xml_nodes_t* o_nodes, Dynamic_array_t<int>* o_tag_ids, Xml_node_t* node, Xml_node_t* parent);
+  // Returns the range of the nodes of |name| in the subtree of |node| in |m_nodes| as [*o_begin, *o_end).
+  void find_range_(Sip* o_begin, Sip* o_end, const Xml_node_t* node, const Cstring_t& name) const;
+
+  // The nodes grouped by tag, the range of each tag is in |m_tag_ranges|. |m_pre_orders| are the numbers of the nodes so they
+  // are binary searched without reading the nodes.
+  Xml_nodes_t m_nodes;
+  Dynamic_array_t<int> m_pre_orders;
+  Dynamic_array_t<Tag_range_t_> m_tag_ranges;
+  // The tag names are interned to ids so they are only hashed once per node.
+  Hash_map_t<Cstring_t, int> m_tags;
+};
+
+// Decodes the entities (&lt; &#60; ...) of |str| in place, the unknown ones are kept as they are.
+void xml_decode_entities(Mstring_t* str);
+
 class Xml_t {
 public:
   Xml_t(Allocator_t* allocator) : m_allocator(allocator) {}
+  // The file is read to |m_allocator| and parsed in situ.
   bool init(const Path_t& path);
+  // |buffer| is copied to |m_allocator| once and the copy is parsed in situ.
   bool init(const char* buffer, int length);
+  // Parses |buffer| without copying it, it's modified and it must outlive the nodes.
+  bool init_in_situ(char* buffer, Sip length);
   void destroy();
   Allocator_t* m_allocator = NULL;
   Xml_node_t* m_root = NULL;
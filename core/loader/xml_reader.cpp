@@ -0,0 +1,404 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/xml_reader.h"
+
+#include "core/loader/xml.h"
+#include "core/log.h"
+#include "core/profiler.h"
+#include "core/utils.h"
+
+#include <string.h>
+
+static bool is_space_(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_delimiter_(char c) {
+  return is_space_(c) || c == '<' || c == '>' || c == '/' || c == '=' || c == '"' || c == '\'';
+}
+
+static bool starts_with_(const char* p, const char* end, const Cstring_t& str) {
+  return end - p >= str.m_length && !memcmp(p, str.m_p, str.m_length);
+}
+
+Xml_reader_t::Xml_reader_t(Allocator_t* allocator, Sip window_size)
+    : m_window(allocator), m_open_names(allocator), m_open_name_starts(allocator), m_attributes(allocator) {
+  m_window.resize(window_size);
+}
+
+bool Xml_reader_t::init(const Path_t& path) {
+  M_check_log_return_val(m_file.open(path.m_path, e_file_mode_read), false, "Can't open " M_txt_p, path.m_path);
+  m_is_file_open = true;
+  m_begin = m_end = m_window.m_p;
+  return true;
+}
+
+bool Xml_reader_t::init(const char* buffer, Sip length) {
+  m_input = buffer;
+  m_input_end = buffer + length;
+  m_begin = m_end = m_window.m_p;
+  return true;
+}
+
+void Xml_reader_t::destroy() {
+  if (m_is_file_open) {
+    m_file.close();
+    m_is_file_open = false;
+  }
+  m_attributes.destroy();
+  m_open_name_starts.destroy();
+  m_open_names.destroy();
+  m_window.destroy();
+}
+
+E_xml_event Xml_reader_t::next() {
+  if (m_has_error) {
+    return e_xml_event_error;
+  }
+  if (m_next_attribute < m_attributes.len()) {
+    const Attribute_t_& attr = m_attributes[m_next_attribute++];
+    m_name = attr.name;
+    m_value = attr.value;
+    return e_xml_event_attribute;
+  }
+  m_attributes.resize(0);
+  m_next_attribute = 0;
+  m_name = Cstring_t();
+  m_value = Cstring_t();
+  if (m_is_self_closing) {
+    m_is_self_closing = false;
+    m_name = m_self_closing_name;
+    return e_xml_event_end_element;
+  }
+  while (true) {
+    E_xml_event event;
+    if (m_is_at_tag || (m_begin != m_end && *m_begin == '<')) {
+      if (parse_tag_(&event)) {
+        return event;
+      }
+      continue;
+    }
+    if (m_begin == m_end && !read_more_()) {
+      M_check_log_return_val(m_has_root && !m_open_name_starts.len(), fail_(), "Can't find closing tag");
+      m_depth = 0;
+      return e_xml_event_end_document;
+    }
+    if (*m_begin != '<' && parse_text_(&event)) {
+      return event;
+    }
+  }
+}
+
+bool Xml_reader_t::read_more_() {
+  if (m_is_input_done) {
+    return false;
+  }
+  Sip unread = m_end - m_begin;
+  if (m_begin != m_window.m_p) {
+    memmove(m_window.m_p, m_begin, unread);
+  } else if (unread == m_window.len()) {
+    m_window.resize(m_window.len() * 2);
+  }
+  m_begin = m_window.m_p;
+  m_end = m_begin + unread;
+  Sip size = m_window.m_p + m_window.len() - m_end;
+  Sip bytes_read = 0;
+  if (m_is_file_open) {
+    if (!m_file.read(m_end, &bytes_read, size)) {
+      bytes_read = 0;
+    }
+  } else {
+    bytes_read = min(size, (Sip)(m_input_end - m_input));
+    memcpy(m_end, m_input, bytes_read);
+    m_input += bytes_read;
+  }
+  if (!bytes_read) {
+    m_is_input_done = true;
+    return false;
+  }
+  m_end += bytes_read;
+  return true;
+}
+
+bool Xml_reader_t::ensure_(Sip count) {
+  while (m_end - m_begin < count) {
+    if (!read_more_()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Sip Xml_reader_t::find_(Sip offset, const Cstring_t& str) {
+  while (true) {
+    char* p = m_begin + offset;
+    while (m_end - p >= str.m_length && (p = (char*)memchr(p, str.m_p[0], m_end - p))) {
+      if (starts_with_(p, m_end, str)) {
+        return p - m_begin;
+      }
+      ++p;
+    }
+    // The bytes that are left can still be the start of |str|.
+    offset = max(offset, (Sip)(m_end - m_begin) - str.m_length + 1);
+    if (!read_more_()) {
+      return -1;
+    }
+  }
+}
+
+bool Xml_reader_t::skip_past_(const Cstring_t& str) {
+  while (true) {
+    Sip index = find_(0, str);
+    if (index >= 0) {
+      m_begin += index + str.m_length;
+      return true;
+    }
+    if (m_end - m_begin < str.m_length) {
+      return false;
+    }
+    // Only the bytes that can still be the start of |str| are kept so the window doesn't grow.
+    m_begin = m_end - str.m_length + 1;
+    if (!read_more_()) {
+      return false;
+    }
+  }
+}
+
+bool Xml_reader_t::parse_tag_(E_xml_event* o_event) {
+  // |m_begin| is at <, it's 0 if the text before it was terminated there.
+  m_is_at_tag = false;
+  ensure_(9);
+  char* p = m_begin + 1;
+  if (starts_with_(p, m_end, "?")) {
+    if (!skip_past_("?>")) {
+      M_logf("Can't find the end of a processing instruction");
+      *o_event = fail_();
+      return true;
+    }
+    return false;
+  }
+  if (starts_with_(p, m_end, "!--")) {
+    if (!skip_past_("-->")) {
+      M_logf("Can't find the end of a comment");
+      *o_event = fail_();
+      return true;
+    }
+    return false;
+  }
+  if (starts_with_(p, m_end, "![CDATA[")) {
+    // CDATA isn't split so it must fit in the window.
+    Sip end_index = find_(9, "]]>");
+    if (end_index < 0) {
+      M_logf("Can't find the end of a CDATA section");
+      *o_event = fail_();
+      return true;
+    }
+    if (!m_open_name_starts.len()) {
+      M_logf("CDATA section outside of the root");
+      *o_event = fail_();
+      return true;
+    }
+    char* text_end = m_begin + end_index;
+    *text_end = 0;
+    m_value = Cstring_t(m_begin + 9, text_end);
+    m_depth = m_open_name_starts.len();
+    m_begin = text_end + 3;
+    *o_event = e_xml_event_text;
+    return true;
+  }
+  if (starts_with_(p, m_end, "!")) {
+    // <!DOCTYPE ...> without an internal subset.
+    if (!skip_past_(">")) {
+      M_logf("Can't find the end of a declaration");
+      *o_event = fail_();
+      return true;
+    }
+    return false;
+  }
+  if (starts_with_(p, m_end, "/")) {
+    Sip close_index = find_(2, ">");
+    if (close_index < 0) {
+      M_logf("Can't find closing bracket of closing tag name");
+      *o_event = fail_();
+      return true;
+    }
+    char* name_start = m_begin + 2;
+    char* name_end = m_begin + close_index;
+    while (name_end != name_start && is_space_(name_end[-1])) {
+      --name_end;
+    }
+    Sip open_count = m_open_name_starts.len();
+    if (!open_count) {
+      M_logf("Closing tag without an opening tag");
+      *o_event = fail_();
+      return true;
+    }
+    m_name = Cstring_t(m_open_names.m_p + m_open_name_starts[open_count - 1]);
+    if (m_name != Cstring_t(name_start, name_end)) {
+      M_logf("Unmatched closing tag name");
+      *o_event = fail_();
+      return true;
+    }
+    // The name stays in |m_open_names| until the next element is opened.
+    m_open_names.resize(m_open_name_starts[open_count - 1]);
+    m_open_name_starts.resize(open_count - 1);
+    m_depth = open_count;
+    m_begin += close_index + 1;
+    *o_event = e_xml_event_end_element;
+    return true;
+  }
+  *o_event = parse_start_tag_();
+  return true;
+}
+
+E_xml_event Xml_reader_t::parse_start_tag_() {
+  // The whole tag has to be in the window, it's parsed again after more input is read.
+  while (true) {
+    m_attributes.resize(0);
+    char* p = m_begin + 1;
+    char* name_start = p;
+    while (p != m_end && !is_delimiter_(*p)) {
+      ++p;
+    }
+    char* name_end = p;
+    bool is_complete = false;
+    while (p != m_end) {
+      M_check_log_return_val(name_start != name_end, fail_(), "Empty tag name");
+      while (p != m_end && is_space_(*p)) {
+        ++p;
+      }
+      if (p == m_end) {
+        break;
+      }
+      if (*p == '>') {
+        m_is_self_closing = false;
+        is_complete = true;
+        ++p;
+        break;
+      }
+      if (*p == '/') {
+        if (m_end - p < 2) {
+          break;
+        }
+        M_check_log_return_val(p[1] == '>', fail_(), "/ has to be followed by > in a tag");
+        m_is_self_closing = true;
+        is_complete = true;
+        p += 2;
+        break;
+      }
+      char* attr_name_start = p;
+      while (p != m_end && !is_delimiter_(*p)) {
+        ++p;
+      }
+      char* attr_name_end = p;
+      M_check_log_return_val(p == m_end || attr_name_start != attr_name_end, fail_(), "Empty attribute name");
+      while (p != m_end && is_space_(*p)) {
+        ++p;
+      }
+      if (p == m_end) {
+        break;
+      }
+      M_check_log_return_val(*p == '=', fail_(), "Can't find = after an attribute name");
+      ++p;
+      while (p != m_end && is_space_(*p)) {
+        ++p;
+      }
+      if (p == m_end) {
+        break;
+      }
+      M_check_log_return_val(*p == '"' || *p == '\'', fail_(), "Attribute values have to be quoted");
+      char* value_start = p + 1;
+      char* value_end = (char*)memchr(value_start, *p, m_end - value_start);
+      if (!value_end) {
+        p = m_end;
+        break;
+      }
+      m_attributes.append({Cstring_t(attr_name_start, attr_name_end), Cstring_t(value_start, value_end)});
+      p = value_end + 1;
+    }
+    if (!is_complete) {
+      M_check_log_return_val(read_more_(), fail_(), "Can't find closing bracket of tag");
+      continue;
+    }
+
+    M_check_log_return_val(m_open_name_starts.len() || !m_has_root, fail_(), "There can only be one root");
+    m_has_root = true;
+    // The characters after the names and the values have been parsed.
+    *name_end = 0;
+    for (Attribute_t_& attr : m_attributes) {
+      ((char*)attr.name.m_p)[attr.name.m_length] = 0;
+      Mstring_t value((char*)attr.value.m_p, attr.value.m_length);
+      value.m_p[value.m_length] = 0;
+      xml_decode_entities(&value);
+      attr.value = value.to_const();
+    }
+    m_name = Cstring_t(name_start, name_end);
+    m_depth = m_open_name_starts.len() + 1;
+    if (m_is_self_closing) {
+      m_self_closing_name = m_name;
+    } else {
+      m_open_name_starts.append(m_open_names.len());
+      m_open_names.append_array(name_start, name_end - name_start + 1);
+    }
+    m_begin = p;
+    return e_xml_event_start_element;
+  }
+}
+
+bool Xml_reader_t::parse_text_(E_xml_event* o_event) {
+  while (true) {
+    char* p = m_begin;
+    while (p != m_end && is_space_(*p)) {
+      ++p;
+    }
+    char* open_bracket = (char*)memchr(p, '<', m_end - p);
+    bool is_in_root = m_open_name_starts.len();
+    if (open_bracket) {
+      m_begin = open_bracket;
+      if (p == open_bracket || !is_in_root) {
+        // Only spaces or text outside of the root which is skipped like Xml_t does.
+        return false;
+      }
+      *open_bracket = 0;
+      m_is_at_tag = true;
+      Mstring_t text(p, open_bracket);
+      xml_decode_entities(&text);
+      m_value = text.to_const();
+      m_depth = m_open_name_starts.len();
+      *o_event = e_xml_event_text;
+      return true;
+    }
+    m_begin = p;
+    if (p != m_end && m_begin == m_window.m_p && m_end == m_window.m_p + m_window.len() && is_in_root) {
+      // The window is full of text, the part before the last space is sent so the window doesn't have to grow.
+      char* space = m_end - 1;
+      while (space != p && !is_space_(*space)) {
+        --space;
+      }
+      if (space != p) {
+        *space = 0;
+        Mstring_t text(p, space);
+        xml_decode_entities(&text);
+        m_value = text.to_const();
+        m_depth = m_open_name_starts.len();
+        m_begin = space + 1;
+        *o_event = e_xml_event_text;
+        return true;
+      }
+    }
+    if (!read_more_()) {
+      // The end of the document is checked by next().
+      m_begin = m_end;
+      return false;
+    }
+  }
+}
+
+E_xml_event Xml_reader_t::fail_() {
+  m_has_error = true;
+  return e_xml_event_error;
+}
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/dynamic_array.h"
+#include "core/file.h"
+#include "core/path.h"
+#include "core/string.h"
+
+class Allocator_t;
+
+enum E_xml_event {
+  // |m_name| is the tag name, the attributes of the element follow it.
+  e_xml_event_start_element,
+  // |m_name| and |m_value| are the name and the decoded value of an attribute.
+  e_xml_event_attribute,
+  // |m_value| is decoded text that isn't only spaces, the leading spaces are skipped.
+  e_xml_event_text,
+  // |m_name| is the tag name, it also comes right after the attributes of <tag/>.
+  e_xml_event_end_element,
+  e_xml_event_end_document,
+  // The XML is malformed or it can't be read, every following call returns it too.
+  e_xml_event_error,
+};
+
+// Pulls the events of an XML document one by one from a file or a buffer without building the nodes.
+// Only a window of the input and the names of the open elements are kept so the memory doesn't depend on the size of the document.
+// The window grows when a tag or a run of text without spaces is bigger than it.
+// A long text is split into several text events at spaces so the numbers of COLLADA arrays can be parsed as they come, the
+// spaces where it's split aren't in any event. CDATA sections are not split.
+// The strings are terminated by a 0 and they are valid until the next call to next().
+class Xml_reader_t {
+public:
+  Xml_reader_t(Allocator_t* allocator, Sip window_size = 64 * 1024);
+  bool init(const Path_t& path);
+  // |buffer| isn't modified, it's copied to the window part by part.
+  bool init(const char* buffer, Sip length);
+  void destroy();
+  E_xml_event next();
+
+  Cstring_t m_name;
+  Cstring_t m_value;
+  // The number of elements that contain the event, the root element is at 1.
+  int m_depth = 0;
+
+private:
+  // Moves the unread bytes to the start of the window, grows it if it's full and reads more input.
+  // Returns false if there isn't any input left.
+  bool read_more_();
+  // Reads more input until there are |count| unread bytes, returns false if there aren't enough.
+  bool ensure_(Sip count);
+  // Returns the offset from |m_begin| of the first |str| after |offset|, more input is read until it's found. Returns -1 if
+  // it isn't in the rest of the input.
+  Sip find_(Sip offset, const Cstring_t& str);
+  // Skips everything until after |str|, the skipped bytes are dropped from the window as it goes.
+  bool skip_past_(const Cstring_t& str);
+  // Both return false when there isn't any event, like for comments or for the spaces between tags.
+  bool parse_tag_(E_xml_event* o_event);
+  bool parse_text_(E_xml_event* o_event);
+  E_xml_event parse_start_tag_();
+  E_xml_event fail_();
+
+  Dynamic_array_t<char> m_window;
+  // The unread bytes are [m_begin, m_end) of |m_window|.
+  char* m_begin = NULL;
+  char* m_end = NULL;
+  File_t m_file;
+  bool m_is_file_open = false;
+  const char* m_input = NULL;
+  const char* m_input_end = NULL;
+  bool m_is_input_done = false;
+
+  // The names of the open elements, each one is terminated by a 0.
+  Dynamic_array_t<char> m_open_names;
+  Dynamic_array_t<Sip> m_open_name_starts;
+  // The attributes of the current start tag, they are all parsed before the start element event.
+  struct Attribute_t_ {
+    Cstring_t name;
+    Cstring_t value;
+  };
+  Dynamic_array_t<Attribute_t_> m_attributes;
+  int m_next_attribute = 0;
+  bool m_is_self_closing = false;
+  Cstring_t m_self_closing_name;
+  // The text before it ended at < which was overwritten by its 0.
+  bool m_is_at_tag = false;
+  bool m_has_root = false;
+  bool m_has_error = false;
+};
@@ -0,0 +1,142 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/xml_scan.h"
+
+// SSE2 is always there on x64, AVX2 is checked at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define M_xml_sse2_ 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if M_compiler_is_msvc()
+#define M_xml_target_avx2_
+#else
+#define M_xml_target_avx2_ __attribute__((target("avx2")))
+#endif
+#endif
+
+void xml_scan_64_scalar(const char* p, Xml_scan_masks_t* o_masks) {
+  U64 open_bracket = 0;
+  U64 quote = 0;
+  U64 structural = 0;
+  U64 space = 0;
+  for (int i = 0; i < 64; ++i) {
+    char c = p[i];
+    U64 bit = 1ull << i;
+    if (c == '<') {
+      open_bracket |= bit;
+    }
+    if (c == '"' || c == '\'') {
+      quote |= bit;
+    }
+    if (c == '<' || c == '>' || c == '/' || c == '=' || c == '"' || c == '\'') {
+      structural |= bit;
+    }
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      space |= bit;
+    }
+  }
+  o_masks->open_bracket = open_bracket;
+  o_masks->quote = quote;
+  o_masks->structural = structural;
+  o_masks->space = space;
+}
+
+#if M_xml_sse2_
+static bool has_avx2_() {
+#if M_compiler_is_msvc()
+  int info[4];
+  __cpuid(info, 1);
+  // AVX and the OS saves the YMM registers.
+  bool has_avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+  __cpuidex(info, 7, 0);
+  return has_avx && (info[1] & (1 << 5));
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static void xml_scan_64_sse2_(const char* p, Xml_scan_masks_t* o_masks) {
+  U64 open_bracket = 0;
+  U64 quote = 0;
+  U64 structural = 0;
+  U64 space = 0;
+  for (int i = 0; i < 64; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+    __m128i lt = _mm_cmpeq_epi8(v, _mm_set1_epi8('<'));
+    __m128i q = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    __m128i s = _mm_or_si128(lt, q);
+    s = _mm_or_si128(s, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+    s = _mm_or_si128(s, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+    s = _mm_or_si128(s, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+    // Tab is 9, LF is 10 and CR is 13.
+    __m128i w = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    w = _mm_or_si128(w, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    w = _mm_or_si128(w, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    open_bracket |= (U64)(U16)_mm_movemask_epi8(lt) << i;
+    quote |= (U64)(U16)_mm_movemask_epi8(q) << i;
+    structural |= (U64)(U16)_mm_movemask_epi8(s) << i;
+    space |= (U64)(U16)_mm_movemask_epi8(w) << i;
+  }
+  o_masks->open_bracket = open_bracket;
+  o_masks->quote = quote;
+  o_masks->structural = structural;
+  o_masks->space = space;
+}
+
+// The bytes are classified with 2 table lookups, one for the low nibble and one for the high nibble, and the bits that are in
+// both are the classes of the byte. The classes are:
+//   1: < which is 0x3c
+//   2: > = which are 0x3e 0x3d
+//   4: / which is 0x2f
+//   8: " ' which are 0x22 0x27
+//   16: space which is 0x20
+//   32: tab, LF and CR which are 0x09 0x0a 0x0d
+M_xml_target_avx2_ static void xml_scan_64_avx2_(const char* p, Xml_scan_masks_t* o_masks) {
+  const __m256i c_low_table = _mm256_setr_epi8(16, 0, 8, 0, 0, 0, 0, 8, 0, 32, 32, 0, 1, 2 | 32, 2, 4,
+                                               16, 0, 8, 0, 0, 0, 0, 8, 0, 32, 32, 0, 1, 2 | 32, 2, 4);
+  const __m256i c_high_table = _mm256_setr_epi8(32, 0, 4 | 8 | 16, 1 | 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                32, 0, 4 | 8 | 16, 1 | 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i c_nibble_mask = _mm256_set1_epi8(0x0f);
+  const __m256i c_zero = _mm256_setzero_si256();
+  U64 open_bracket = 0;
+  U64 quote = 0;
+  U64 structural = 0;
+  U64 space = 0;
+  for (int i = 0; i < 64; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+    __m256i low = _mm256_shuffle_epi8(c_low_table, _mm256_and_si256(v, c_nibble_mask));
+    __m256i high = _mm256_shuffle_epi8(c_high_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), c_nibble_mask));
+    __m256i classes = _mm256_and_si256(low, high);
+    // The comparisons with 0 give the bytes that are not in the classes, the masks are inverted after.
+    __m256i lt = _mm256_cmpeq_epi8(_mm256_and_si256(classes, _mm256_set1_epi8(1)), c_zero);
+    __m256i q = _mm256_cmpeq_epi8(_mm256_and_si256(classes, _mm256_set1_epi8(8)), c_zero);
+    __m256i s = _mm256_cmpeq_epi8(_mm256_and_si256(classes, _mm256_set1_epi8(1 | 2 | 4 | 8)), c_zero);
+    __m256i w = _mm256_cmpeq_epi8(_mm256_and_si256(classes, _mm256_set1_epi8(16 | 32)), c_zero);
+    open_bracket |= (U64)(U32)~_mm256_movemask_epi8(lt) << i;
+    quote |= (U64)(U32)~_mm256_movemask_epi8(q) << i;
+    structural |= (U64)(U32)~_mm256_movemask_epi8(s) << i;
+    space |= (U64)(U32)~_mm256_movemask_epi8(w) << i;
+  }
+  o_masks->open_bracket = open_bracket;
+  o_masks->quote = quote;
+  o_masks->structural = structural;
+  o_masks->space = space;
+}
+#endif
+
+void xml_scan_64(const char* p, Xml_scan_masks_t* o_masks) {
+#if M_xml_sse2_
+  static const bool sc_has_avx2 = has_avx2_();
+  if (sc_has_avx2) {
+    xml_scan_64_avx2_(p, o_masks);
+  } else {
+    xml_scan_64_sse2_(p, o_masks);
+  }
+#else
+  xml_scan_64_scalar(p, o_masks);
+#endif
+}
@@ -0,0 +1,42 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/compiler.h"
+#include "core/types.h"
+
+#if M_compiler_is_msvc()
+#include <intrin.h>
+#endif
+
+// The characters of 64 bytes of XML that the parser looks for, bit i of a mask is for byte i.
+struct Xml_scan_masks_t {
+  // <
+  U64 open_bracket;
+  // " '
+  U64 quote;
+  // < > / = " ' which end the names.
+  U64 structural;
+  // Space, tab, CR and LF.
+  U64 space;
+};
+
+// Classifies the 64 bytes at |p| with AVX2 or SSE2 if they are available.
+void xml_scan_64(const char* p, Xml_scan_masks_t* o_masks);
+// Same as xml_scan_64() without SIMD, the SIMD kernels are tested against it.
+void xml_scan_64_scalar(const char* p, Xml_scan_masks_t* o_masks);
+
+// Index of the lowest set bit of |mask|, which can't be 0.
+inline int xml_scan_get_lowest_bit(U64 mask) {
+#if M_compiler_is_msvc()
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return index;
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
@@ -6,93 +6,448 @@
 
 #include "core/log.h"
 
+#include "core/binary_log.h"
+#include "core/command_line.h"
 #include "core/file.h"
-#include "core/linear_allocator.h"
+#include "core/mono_time.h"
+#include "core/thread.h"
 #include "core/utils.h"
 
 #include <stdarg.h>
 #include <stdlib.h>
 
+#include <atomic>
+
 #if M_os_is_win()
 #include <Windows.h>
 #endif
 
+// Size of the ring buffer that holds the formatted records, must be a power of 2.
+#define M_log_ring_size_ (1 << 20)
+// Size of the per-thread buffer that a record is formatted into.
+#define M_log_thread_buffer_size_ 4096
+// Maximum number of records that are written in one File_t::write_v call.
+#define M_log_max_batch_count_ 256
+// Size of the buffer that binary logs of a batch are formatted into.
+#define M_log_decode_buffer_size_ (64 * 1024)
+// How long the writer thread waits for more records after it wakes up.
+#define M_log_writer_batch_interval_ms_ 1
+
 static const char* gc_log_level_strings_[] = {
-    "INFO",
+    "TRACE",
     "DEBUG",
+    "INFO",
     "WARNING",
     "FATAL",
     "TEST",
 };
 
+// Names that are used in --log-level.
+static const char* gc_log_level_names_[] = {
+    "trace",
+    "debug",
+    "info",
+    "warning",
+};
+
+static const char* gc_log_category_names_[] = {
+    "general",
+    "core",
+    "gpu",
+    "loader",
+    "window",
+    "reflection",
+};
+static_assert(sizeof(gc_log_category_names_) / sizeof(gc_log_category_names_[0]) == e_log_category_count);
+
+// A record in the ring buffer, the payload follows the header.
+// The payload is either a null-terminated text or a binary log (see core/binary_log.h) that is formatted by the consumer.
+// |state| is 0 when the record is being written and non-zero when it's committed.
+// Padding records fill the tail of the ring when a record doesn't fit in the remaining space.
+// The sizes of all records are aligned to sizeof(Log_record_t_) so a padding record always has room for its header.
+struct Log_record_t_ {
+  enum E_state : U32 {
+    e_state_empty,
+    e_state_committed,
+    e_state_padding,
+  };
+  std::atomic<U32> state;
+  U32 size;
+  U32 payload_len;
+  U8 level;
+  bool is_printed;
+  bool is_binary;
+};
+
+// Multiple producers reserve space by advancing |write_pos| with a CAS.
+// Only the consumer, which is either the writer thread or a thread flushing a fatal log, advances |read_pos|.
+// Consumed space is zeroed before |read_pos| is advanced so that an empty state means an uncommitted record.
+struct Log_ring_t_ {
+  alignas(64) std::atomic<U64> write_pos;
+  alignas(64) std::atomic<U64> read_pos;
+  alignas(64) U8 data[M_log_ring_size_];
+};
+
 bool g_is_log_in_testing = false;
+E_log_level_ g_log_category_levels[e_log_category_count] = {};
 static File_t g_log_file_;
 static bool g_log_inited_ = false;
+static Log_ring_t_ g_log_ring_;
+static std::atomic<bool> g_log_consumer_lock_;
+static Thread_t g_log_writer_;
+static std::atomic<bool> g_log_writer_running_;
+static std::atomic<bool> g_log_writer_sleeping_;
+static std::atomic<U32> g_log_wake_seq_;
+static thread_local char g_log_thread_buffer_[M_log_thread_buffer_size_];
+// Only used by the consumer.
+static char g_log_decode_buffer_[M_log_decode_buffer_size_];
+static S64 g_log_start_time_;
+// Set while the current thread is consuming, logs from the writing code itself are dropped to avoid deadlocks.
+static thread_local bool g_log_is_consuming_ = false;
+
+static_assert((sizeof(Log_record_t_) & (sizeof(Log_record_t_) - 1)) == 0, "The size of Log_record_t_ has to be a power of 2");
+
+static Sip align_record_size_(Sip size) {
+  return (size + sizeof(Log_record_t_) - 1) & ~(sizeof(Log_record_t_) - 1);
+}
+
+static Log_record_t_* get_record_(U64 pos) {
+  return (Log_record_t_*)(g_log_ring_.data + (pos & (M_log_ring_size_ - 1)));
+}
+
+static bool try_lock_consumer_() {
+  return !g_log_consumer_lock_.load(std::memory_order_relaxed) && !g_log_consumer_lock_.exchange(true, std::memory_order_acquire);
+}
+
+static void unlock_consumer_() {
+  g_log_consumer_lock_.store(false, std::memory_order_release);
+}
+
+// Writes all contiguous committed records to the console and the log file.
+// The caller has to hold the consumer lock. Returns the number of records that were consumed.
+static int drain_() {
+  g_log_is_consuming_ = true;
+  int total_count = 0;
+  U64 read_pos = g_log_ring_.read_pos.load(std::memory_order_relaxed);
+  while (true) {
+    File_iovec_t vecs[M_log_max_batch_count_];
+    int vec_count = 0;
+    int decoded_len = 0;
+    U64 pos = read_pos;
+    // Stop the batch when the decode buffer may not fit another binary log.
+    while (vec_count < M_log_max_batch_count_ && decoded_len + M_log_thread_buffer_size_ <= M_log_decode_buffer_size_) {
+      Log_record_t_* record = get_record_(pos);
+      U32 state = record->state.load(std::memory_order_acquire);
+      if (state == Log_record_t_::e_state_empty) {
+        break;
+      }
+      if (state == Log_record_t_::e_state_committed) {
+        const char* text = (const char*)(record + 1);
+        Sip text_len = record->payload_len;
+        if (record->is_binary) {
+          char* decoded = g_log_decode_buffer_ + decoded_len;
+          text_len = binary_log_decode_(decoded, M_log_thread_buffer_size_, (const U8*)(record + 1), record->payload_len, gc_log_level_strings_[record->level], g_log_start_time_);
+          decoded_len += text_len + 1;
+          text = decoded;
+        }
+        vecs[vec_count++] = {text, text_len};
+        if (record->is_printed) {
+          fwrite(text, 1, text_len, record->level <= e_log_level_info ? stdout : stderr);
+        }
+#if M_os_is_win()
+        OutputDebugStringA(text);
+#endif
+      }
+      pos += record->size;
+    }
+    if (pos == read_pos) {
+      break;
+    }
+    fflush(stdout);
+    g_log_file_.write_v(NULL, vecs, vec_count);
+    // Zero the consumed space in at most 2 parts since it may wrap around.
+    U64 begin = read_pos & (M_log_ring_size_ - 1);
+    U64 len = pos - read_pos;
+    U64 first_len = min(len, M_log_ring_size_ - begin);
+    memset(g_log_ring_.data + begin, 0, first_len);
+    memset(g_log_ring_.data, 0, len - first_len);
+    read_pos = pos;
+    g_log_ring_.read_pos.store(read_pos, std::memory_order_release);
+    total_count += vec_count;
+  }
+  g_log_is_consuming_ = false;
+  return total_count;
+}
+
+// Drains until every record reserved before |end_pos| has been written.
+static void flush_until_(U64 end_pos) {
+  while (g_log_ring_.read_pos.load(std::memory_order_acquire) < end_pos) {
+    if (try_lock_consumer_()) {
+      drain_();
+      unlock_consumer_();
+    }
+    if (g_log_ring_.read_pos.load(std::memory_order_acquire) < end_pos) {
+      Thread_t::yield();
+    }
+  }
+}
+
+// Reserves a record with |payload_len| bytes of payload, the record has to be committed with commit_().
+// |o_end_pos| is the end position of the record in the ring.
+static Log_record_t_* reserve_(U64* o_end_pos, Sip payload_len) {
+  const U64 size = align_record_size_(sizeof(Log_record_t_) + payload_len);
+  U64 pos = g_log_ring_.write_pos.load(std::memory_order_relaxed);
+  U64 padding;
+  while (true) {
+    U64 offset = pos & (M_log_ring_size_ - 1);
+    padding = offset + size > M_log_ring_size_ ? M_log_ring_size_ - offset : 0;
+    if (pos + padding + size - g_log_ring_.read_pos.load(std::memory_order_acquire) > M_log_ring_size_) {
+      // The ring is full, help the writer thread or wait for it.
+      if (try_lock_consumer_()) {
+        drain_();
+        unlock_consumer_();
+      } else {
+        Thread_t::yield();
+      }
+      pos = g_log_ring_.write_pos.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (g_log_ring_.write_pos.compare_exchange_weak(pos, pos + padding + size, std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  if (padding) {
+    Log_record_t_* padding_record = get_record_(pos);
+    padding_record->size = padding;
+    padding_record->state.store(Log_record_t_::e_state_padding, std::memory_order_release);
+    pos += padding;
+  }
+  Log_record_t_* record = get_record_(pos);
+  record->size = size;
+  record->payload_len = payload_len;
+  maybe_assign(o_end_pos, pos + size);
+  return record;
+}
+
+static void commit_(Log_record_t_* record) {
+  record->state.store(Log_record_t_::e_state_committed, std::memory_order_seq_cst);
+  if (g_log_writer_sleeping_.load(std::memory_order_seq_cst)) {
+    g_log_wake_seq_.fetch_add(1, std::memory_order_seq_cst);
+    g_log_wake_seq_.notify_one();
+  }
+}
+
+// Copies |parts| into the ring as one text record. Returns the end position of the record in the ring.
+static U64 push_(E_log_level_ level, bool is_printed, const File_iovec_t* parts, int part_count) {
+  Sip text_len = 0;
+  for (int i = 0; i < part_count; ++i) {
+    text_len += parts[i].len;
+  }
+  // Truncate the (very unlikely) record that can't fit in a quarter of the ring.
+  const Sip c_max_text_len = M_log_ring_size_ / 4 - sizeof(Log_record_t_) - 1;
+  if (text_len > c_max_text_len) {
+    text_len = c_max_text_len;
+  }
+  U64 end_pos;
+  Log_record_t_* record = reserve_(&end_pos, text_len + 1);
+  record->payload_len = text_len;
+  record->level = level;
+  record->is_printed = is_printed;
+  record->is_binary = false;
+  char* text = (char*)(record + 1);
+  Sip remaining_len = text_len;
+  for (int i = 0; i < part_count && remaining_len; ++i) {
+    Sip len = min(parts[i].len, remaining_len);
+    memcpy(text, parts[i].p, len);
+    text += len;
+    remaining_len -= len;
+  }
+  *text = 0;
+  commit_(record);
+  return end_pos;
+}
+
+// Kept out of ng_log_() so the big trace buffer is only on the stack of fatal logs.
+static void push_and_flush_with_stack_trace_(E_log_level_ level, bool is_printed, const File_iovec_t& log) {
+  File_iovec_t parts[4] = {log};
+  int part_count = 1;
+  char trace[M_max_stack_trace_length_];
+  if (!debug_is_debugger_attached()) {
+    debug_get_stack_trace(trace, M_max_stack_trace_length_);
+    const char* trace_title = "StackTraces:\n";
+    parts[part_count++] = {trace_title, (Sip)strlen(trace_title)};
+    parts[part_count++] = {trace, (Sip)strlen(trace)};
+    parts[part_count++] = {"\n", 1};
+  }
+  U64 end_pos = push_(level, is_printed, parts, part_count);
+  // Make sure the log hits the disk before we possibly break into the debugger or crash.
+  flush_until_(end_pos);
+}
+
+static void writer_thread_(void*) {
+  while (g_log_writer_running_.load(std::memory_order_acquire)) {
+    int count = 0;
+    if (try_lock_consumer_()) {
+      count = drain_();
+      unlock_consumer_();
+    }
+    if (count) {
+      // Let more records pile up so they are written in bigger batches.
+      Thread_t::sleep_ms(M_log_writer_batch_interval_ms_);
+      continue;
+    }
+    // Nothing to write, sleep until a producer wakes us up.
+    U32 seq = g_log_wake_seq_.load(std::memory_order_seq_cst);
+    g_log_writer_sleeping_.store(true, std::memory_order_seq_cst);
+    U64 read_pos = g_log_ring_.read_pos.load(std::memory_order_acquire);
+    if (get_record_(read_pos)->state.load(std::memory_order_seq_cst) == Log_record_t_::e_state_empty && g_log_writer_running_.load(std::memory_order_acquire)) {
+      g_log_wake_seq_.wait(seq, std::memory_order_seq_cst);
+    }
+    g_log_writer_sleeping_.store(false, std::memory_order_relaxed);
+    Thread_t::sleep_ms(M_log_writer_batch_interval_ms_);
+  }
+}
 
 void ng_log_(E_log_level_ level, const char* file, int line, const char* format, ...) {
-  if (!g_log_inited_) {
+  if (!g_log_inited_ || g_log_is_consuming_) {
     return;
   }
-  Linear_allocator_t<> temp_allocator("log_temp_allocator");
-  M_scope_exit(temp_allocator.destroy());
-
+  char* log_buffer = g_log_thread_buffer_;
   // FILE(LINE) for visual studio click to go to location.
-  int log_len = 0;
-  const char* log_prefix_format = "%s(%d): %s: ";
   const char* level_str = gc_log_level_strings_[(int)level];
-  int prefix_len = snprintf(NULL, 0, log_prefix_format, file, line, level_str);
-  log_len += prefix_len;
-  char* log_buffer = (char*)temp_allocator.alloc(log_len + 1);
-  snprintf(log_buffer, log_len + 1, log_prefix_format, file, line, level_str);
+  int prefix_len = snprintf(log_buffer, M_log_thread_buffer_size_, "%s(%d): %s: ", file, line, level_str);
+  if (prefix_len >= M_log_thread_buffer_size_) {
+    prefix_len = M_log_thread_buffer_size_ - 1;
+  }
 
-  va_list argptr, argptr2;
+  va_list argptr;
   va_start(argptr, format);
-  va_copy(argptr2, argptr);
   // +1 for new line char.
-  int msg_len = vsnprintf(NULL, 0, format, argptr) + 1;
+  int msg_len = vsnprintf(log_buffer + prefix_len, M_log_thread_buffer_size_ - prefix_len, format, argptr) + 1;
   va_end(argptr);
-  log_buffer = (char*)temp_allocator.realloc(log_buffer, log_len + msg_len + 1);
-  va_start(argptr2, format);
-  vsnprintf(log_buffer + log_len, msg_len + 1, format, argptr2);
-  va_end(argptr2);
-  log_len += msg_len;
+  char* heap_buffer = NULL;
+  if (prefix_len + msg_len >= M_log_thread_buffer_size_) {
+    // Too long for the per-thread buffer, format again into a heap buffer.
+    heap_buffer = (char*)malloc(prefix_len + msg_len + 1);
+    memcpy(heap_buffer, log_buffer, prefix_len);
+    va_start(argptr, format);
+    vsnprintf(heap_buffer + prefix_len, msg_len, format, argptr);
+    va_end(argptr);
+    log_buffer = heap_buffer;
+  }
+  int log_len = prefix_len + msg_len;
   log_buffer[log_len - 1] = '\n';
   log_buffer[log_len] = 0;
 
-  if ((level == e_log_level_fatal || level == e_log_level_test) && !debug_is_debugger_attached()) {
-    const char* trace_format = "StackTraces:\n%s\n";
-    char trace[M_max_stack_trace_length_];
-    debug_get_stack_trace(trace, M_max_stack_trace_length_);
-    int trace_len = snprintf(NULL, 0, trace_format, trace);
-    log_buffer = (char*)temp_allocator.realloc(log_buffer, log_len + trace_len + 1);
-    snprintf(log_buffer + log_len, trace_len + 1, trace_format, trace);
-    log_len += trace_len;
-  }
-  // Log to stream
-  FILE* stream;
-  if (level == e_log_level_info || level == e_log_level_debug) {
-    stream = stdout;
+  bool is_printed = level == e_log_level_test || !g_is_log_in_testing;
+  File_iovec_t part = {log_buffer, log_len};
+  if (level == e_log_level_fatal || level == e_log_level_test) {
+    push_and_flush_with_stack_trace_(level, is_printed, part);
   } else {
-    stream = stderr;
+    push_(level, is_printed, &part, 1);
   }
-  if (level == e_log_level_test || !g_is_log_in_testing) {
-    fprintf(stream, "%s", log_buffer);
+  if (heap_buffer) {
+    free(heap_buffer);
   }
-#if M_os_is_win()
-  OutputDebugStringA(log_buffer);
-#endif
-  g_log_file_.write(NULL, log_buffer, log_len);
+}
+
+U8* log_begin_binary_record_(E_log_level_ level, Sip payload_len) {
+  if (!g_log_inited_ || g_log_is_consuming_ || payload_len > M_log_ring_size_ / 4) {
+    return NULL;
+  }
+  Log_record_t_* record = reserve_(NULL, payload_len);
+  record->level = level;
+  record->is_printed = !g_is_log_in_testing;
+  record->is_binary = true;
+  return (U8*)(record + 1);
+}
+
+void log_end_binary_record_(U8* payload) {
+  commit_((Log_record_t_*)payload - 1);
+}
+
+// Finds |name| of length |len| in |names|, returns -1 if it's not found.
+static int find_name_(const char* const* names, int name_count, const char* name, int len) {
+  for (int i = 0; i < name_count; ++i) {
+    if ((int)strlen(names[i]) == len && !strncmp(names[i], name, len)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool log_set_levels(const char* levels) {
+  E_log_level_ new_levels[e_log_category_count];
+  memcpy(new_levels, g_log_category_levels, sizeof(new_levels));
+  const char* p = levels;
+  while (true) {
+    const char* end = strchr(p, ',');
+    if (!end) {
+      end = p + strlen(p);
+    }
+    const char* equal = (const char*)memchr(p, '=', end - p);
+    const char* level_name = equal ? equal + 1 : p;
+    int level = find_name_(gc_log_level_names_, static_array_size(gc_log_level_names_), level_name, end - level_name);
+    M_check_log_return_val(level != -1, false, "Invalid log level in \"%s\"", levels);
+    if (equal) {
+      int category = find_name_(gc_log_category_names_, e_log_category_count, p, equal - p);
+      M_check_log_return_val(category != -1, false, "Invalid log category in \"%s\"", levels);
+      new_levels[category] = (E_log_level_)level;
+    } else {
+      for (int i = 0; i < e_log_category_count; ++i) {
+        new_levels[i] = (E_log_level_)level;
+      }
+    }
+    if (!*end) {
+      break;
+    }
+    p = end + 1;
+  }
+  memcpy(g_log_category_levels, new_levels, sizeof(new_levels));
+  return true;
+}
+
+bool log_set_levels_from_command_line() {
+  Value_t levels = g_cl->get_flag_value("--log-level");
+  if (!levels.m_const_string) {
+    return true;
+  }
+  return log_set_levels(levels.m_const_string);
 }
 
 bool log_init(const Os_char* log_path) {
+  g_log_start_time_ = mono_time_now();
   g_log_file_.init();
   g_log_file_.open(log_path, e_file_mode_append);
   g_log_inited_ = g_log_file_.is_valid();
+  if (g_log_inited_) {
+    g_log_writer_running_.store(true, std::memory_order_release);
+    if (!g_log_writer_.init(writer_thread_, NULL)) {
+      // Without the writer thread, records are written when the ring is full or when it's flushed.
+      g_log_writer_running_.store(false, std::memory_order_release);
+    }
+    // Some programs exit without calling core_destroy(), don't lose their last records.
+    atexit(log_flush);
+  }
   return g_log_inited_;
 }
 
+void log_flush() {
+  if (!g_log_inited_) {
+    return;
+  }
+  flush_until_(g_log_ring_.write_pos.load(std::memory_order_acquire));
+}
+
 void log_destroy() {
   if (g_log_inited_) {
+    if (g_log_writer_running_.load(std::memory_order_acquire)) {
+      g_log_writer_running_.store(false, std::memory_order_release);
+      g_log_wake_seq_.fetch_add(1, std::memory_order_seq_cst);
+      g_log_wake_seq_.notify_one();
+      g_log_writer_.wait_for();
+    }
+    log_flush();
     g_log_file_.close();
   }
   g_log_inited_ = false;
@@ -14,22 +14,47 @@
 #include <stdio.h>
 #include <string.h>
 
+// Ordered by severity, a log is dropped if its level is lower than the minimum level.
 enum E_log_level_ {
-  e_log_level_info = 0,
+  e_log_level_trace = 0,
   e_log_level_debug = 1,
-  e_log_level_warning = 2,
-  e_log_level_fatal = 3,
-  e_log_level_test = 4,
+  e_log_level_info = 2,
+  e_log_level_warning = 3,
+  e_log_level_fatal = 4,
+  e_log_level_test = 5,
+};
+
+// Each category (module) has its own minimum level at runtime.
+enum E_log_category {
+  e_log_category_general,
+  e_log_category_core,
+  e_log_category_gpu,
+  e_log_category_loader,
+  e_log_category_window,
+  e_log_category_reflection,
+  e_log_category_count,
 };
 
 extern bool g_is_log_in_testing;
+// Runtime minimum level of each category, fatal and test logs are never dropped.
+extern E_log_level_ g_log_category_levels[e_log_category_count];
 
 void ng_log_(E_log_level_ level, const char* file, int line, const char* format, ...);
 
-#define M_log_size_ (1024 + M_max_stack_trace_length_)
-
 bool log_init(const Os_char* log_path);
 void log_destroy();
+// Blocks until every log that has been pushed so far is written.
+void log_flush();
+// Used by binary logs (see core/binary_log.h) to write their payload straight into the log ring.
+// Returns NULL if the log can't be written.
+U8* log_begin_binary_record_(E_log_level_ level, Sip payload_len);
+void log_end_binary_record_(U8* payload);
+// |levels| is a comma-separated list of "<level>" (for every category) or "<category>=<level>".
+// e.g. "warning,gpu=debug". Levels are trace, debug, info and warning.
+// Returns false and doesn't change anything if |levels| is invalid.
+bool log_set_levels(const char* levels);
+// Applies --log-level from g_cl, call it after g_cl->parse().
+bool log_set_levels_from_command_line();
 
 #if M_compiler_is_msvc()
 #define M_likely(x) (x)
@@ -39,10 +64,30 @@ void log_destroy();
 #define M_unlikely(x) __builtin_expect((x), 0)
 #endif
 
+// Logs that are lower than this level are compiled out, it's the value of one of E_log_level_.
+// The build can define it to override the default.
+#if !defined(M_log_min_level)
+#  if M_is_dev()
+#    define M_log_min_level 0
+#  else
+#    define M_log_min_level 2
+#  endif
+#endif
+
+// |level| is a constant so the first check is resolved at compile time.
+#define M_log_is_enabled(level, category) ((int)(level) >= M_log_min_level && (level) >= g_log_category_levels[category])
+
+// The arguments are only evaluated if the log is enabled.
+#define M_log_(level, category, format, ...) \
+  (M_log_is_enabled(level, category) ? ng_log_(level, __FILE__, __LINE__, format, ##__VA_ARGS__) : (void)0)
+
 // See log_level
-#define M_logi(format, ...) ng_log_(e_log_level_info, __FILE__, __LINE__, format, ##__VA_ARGS__)
-#define M_logd(format, ...) ng_log_(e_log_level_debug, __FILE__, __LINE__, format, ##__VA_ARGS__)
-#define M_logw(format, ...) ng_log_(e_log_level_warning, __FILE__, __LINE__, format, ##__VA_ARGS__)
+#define M_logci(category, format, ...) M_log_(e_log_level_info, category, format, ##__VA_ARGS__)
+#define M_logcd(category, format, ...) M_log_(e_log_level_debug, category, format, ##__VA_ARGS__)
+#define M_logcw(category, format, ...) M_log_(e_log_level_warning, category, format, ##__VA_ARGS__)
+#define M_logi(format, ...) M_logci(e_log_category_general, format, ##__VA_ARGS__)
+#define M_logd(format, ...) M_logcd(e_log_category_general, format, ##__VA_ARGS__)
+#define M_logw(format, ...) M_logcw(e_log_category_general, format, ##__VA_ARGS__)
 
 #if M_is_dev()
 #  define M_logf(format, ...)                                                \
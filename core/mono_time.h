@@ -8,9 +8,16 @@
 
 #include "core/types.h"
 
+// The unit of the time depends on the source (TSC ticks, nanoseconds, QueryPerformanceCounter ticks...), use the conversion functions.
 bool mono_time_init();
 S64 mono_time_now();
+// Name of the clock that mono_time_now() reads.
+const char* mono_time_get_source();
+// Measured in mono_time_init().
+F64 mono_time_get_now_overhead_ns();
 S64 mono_time_from_s(F64 s);
+S64 mono_time_from_ms(F64 ms);
 F64 mono_time_to_s(S64 t);
 F64 mono_time_to_ms(S64 t);
 F64 mono_time_to_us(S64 t);
+F64 mono_time_to_ns(S64 t);
@@ -8,26 +8,106 @@
 
 #include <time.h>
 
-bool mono_time_init() { return true; }
+#if defined(__x86_64__) || defined(__i386__)
+#  include <cpuid.h>
+#  include <x86intrin.h>
+#  define M_mono_time_has_tsc_ 1
+#else
+#  define M_mono_time_has_tsc_ 0
+#endif
 
-S64 mono_time_now() {
+// The TSC is used when it's invariant (it ticks at a constant rate in all power states and is synchronized between cores),
+// reading it is much cheaper than clock_gettime() even with vDSO.
+// Otherwise the time is in nanoseconds from CLOCK_MONOTONIC.
+static bool g_mono_time_is_tsc_ = false;
+static F64 g_mono_time_ticks_per_s_ = 1000000000.0;
+static F64 g_mono_time_s_per_tick_ = 1.0 / 1000000000.0;
+static F64 g_mono_time_now_overhead_ns_ = 0.0;
+
+static S64 get_clock_gettime_ns_() {
   struct timespec ts;
   clock_gettime(CLOCK_MONOTONIC, &ts);
   return ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
+#if M_mono_time_has_tsc_
+static bool is_tsc_invariant_() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return edx & (1 << 8);
+}
+
+// Counts the TSC ticks in a CLOCK_MONOTONIC interval.
+static F64 calibrate_tsc_() {
+  const S64 c_calibration_ns = 10000000;
+  S64 start_ns = get_clock_gettime_ns_();
+  U64 start_tsc = __rdtsc();
+  S64 end_ns;
+  do {
+    end_ns = get_clock_gettime_ns_();
+  } while (end_ns - start_ns < c_calibration_ns);
+  U64 end_tsc = __rdtsc();
+  return (F64)(end_tsc - start_tsc) * 1000000000.0 / (end_ns - start_ns);
+}
+#endif
+
+bool mono_time_init() {
+#if M_mono_time_has_tsc_
+  if (is_tsc_invariant_()) {
+    g_mono_time_ticks_per_s_ = calibrate_tsc_();
+    g_mono_time_s_per_tick_ = 1.0 / g_mono_time_ticks_per_s_;
+    g_mono_time_is_tsc_ = true;
+  }
+#endif
+  const int c_overhead_call_count = 1000;
+  S64 start = mono_time_now();
+  for (int i = 0; i < c_overhead_call_count - 1; ++i) {
+    mono_time_now();
+  }
+  g_mono_time_now_overhead_ns_ = mono_time_to_ns(mono_time_now() - start) / c_overhead_call_count;
+  return true;
+}
+
+S64 mono_time_now() {
+#if M_mono_time_has_tsc_
+  if (g_mono_time_is_tsc_) {
+    return __rdtsc();
+  }
+#endif
+  return get_clock_gettime_ns_();
+}
+
+const char* mono_time_get_source() {
+  return g_mono_time_is_tsc_ ? "tsc" : "clock_gettime";
+}
+
+F64 mono_time_get_now_overhead_ns() {
+  return g_mono_time_now_overhead_ns_;
+}
+
 S64 mono_time_from_s(F64 s) {
-  return s * 1000000000.0;
+  return s * g_mono_time_ticks_per_s_;
+}
+
+S64 mono_time_from_ms(F64 ms) {
+  return mono_time_from_s(ms / 1000.0);
 }
 
 F64 mono_time_to_s(S64 t) {
-  return t / 1000000000.0;
+  return t * g_mono_time_s_per_tick_;
 }
 
 F64 mono_time_to_ms(S64 t) {
-  return t / 1000000.0;
+  return t * g_mono_time_s_per_tick_ * 1000.0;
 }
 
 F64 mono_time_to_us(S64 t) {
-  return t / 1000.0;
+  return t * g_mono_time_s_per_tick_ * 1000000.0;
+}
+
+F64 mono_time_to_ns(S64 t) {
+  return t * g_mono_time_s_per_tick_ * 1000000000.0;
 }
@@ -9,15 +9,37 @@
 #include <Windows.h>
 
 static LARGE_INTEGER g_performance_freq_;
+static F64 g_mono_time_now_overhead_ns_ = 0.0;
 
 bool mono_time_init() {
-  return QueryPerformanceFrequency(&g_performance_freq_);
+  if (!QueryPerformanceFrequency(&g_performance_freq_)) {
+    return false;
+  }
+  const int c_overhead_call_count = 1000;
+  S64 start = mono_time_now();
+  for (int i = 0; i < c_overhead_call_count - 1; ++i) {
+    mono_time_now();
+  }
+  g_mono_time_now_overhead_ns_ = mono_time_to_ns(mono_time_now() - start) / c_overhead_call_count;
+  return true;
+}
+
+const char* mono_time_get_source() {
+  return "QueryPerformanceCounter";
+}
+
+F64 mono_time_get_now_overhead_ns() {
+  return g_mono_time_now_overhead_ns_;
 }
 
 S64 mono_time_from_s(F64 s) {
   return s * g_performance_freq_.QuadPart;
 }
 
+S64 mono_time_from_ms(F64 ms) {
+  return mono_time_from_s(ms / 1000.0);
+}
+
 S64 mono_time_now() {
   LARGE_INTEGER pc;
   QueryPerformanceCounter(&pc);
@@ -35,3 +57,7 @@ F64 mono_time_to_ms(S64 t) {
 F64 mono_time_to_us(S64 t) {
   return mono_time_to_s(t) * 1000000;
 }
+
+F64 mono_time_to_ns(S64 t) {
+  return mono_time_to_s(t) * 1000000000;
+}
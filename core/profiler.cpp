@@ -0,0 +1,202 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/profiler.h"
+
+#include "core/file.h"
+#include "core/log.h"
+#include "core/thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define M_profiler_max_thread_count_ 64
+// Number of zones per thread, it's a power of 2.
+#define M_profiler_zone_count_ (1 << 16)
+
+struct Profiler_zone_t_ {
+  const char* name;
+  S64 begin;
+  S64 end;
+};
+
+// Only its thread writes to it so recording a zone doesn't need any lock.
+struct Profiler_thread_t_ {
+  // A ring, the oldest zones are overwritten when it's full.
+  Profiler_zone_t_* zones;
+  std::atomic<U64> write_count;
+  // |write_count| when profiler_start() was called.
+  U64 start_count;
+  const char* name;
+  std::atomic<bool> is_ready;
+  // Odd while the thread records a zone, profiler_stop() waits for it to change before reading the ring.
+  std::atomic<U32> sequence;
+};
+
+std::atomic<bool> g_profiler_is_recording{false};
+static Profiler_thread_t_ g_profiler_threads_[M_profiler_max_thread_count_];
+static std::atomic<int> g_profiler_thread_count_{0};
+static S64 g_profiler_start_time_ = 0;
+static thread_local Profiler_thread_t_* g_profiler_thread_ = NULL;
+static thread_local bool g_profiler_is_thread_full_ = false;
+static thread_local const char* g_profiler_thread_name_ = NULL;
+
+static Profiler_thread_t_* get_thread_() {
+  if (g_profiler_thread_ || g_profiler_is_thread_full_) {
+    return g_profiler_thread_;
+  }
+  int index = g_profiler_thread_count_.fetch_add(1, std::memory_order_relaxed);
+  if (index >= M_profiler_max_thread_count_) {
+    g_profiler_is_thread_full_ = true;
+    M_logw("Too many threads for the profiler");
+    return NULL;
+  }
+  Profiler_thread_t_* thread = &g_profiler_threads_[index];
+  thread->zones = (Profiler_zone_t_*)malloc(M_profiler_zone_count_ * sizeof(Profiler_zone_t_));
+  if (!thread->zones) {
+    g_profiler_is_thread_full_ = true;
+    M_logw("Out of memory for the profiler");
+    return NULL;
+  }
+  thread->name = g_profiler_thread_name_;
+  thread->is_ready.store(true, std::memory_order_release);
+  g_profiler_thread_ = thread;
+  return thread;
+}
+
+// Writes |str| as a JSON string.
+static void write_json_string_(File_t* file, const char* str) {
+  file->write(NULL, "\"", 1);
+  const char* begin = str;
+  for (const char* p = str; *p; ++p) {
+    if (*p == '"' || *p == '\\') {
+      if (p != begin) {
+        file->write(NULL, begin, p - begin);
+      }
+      file->write(NULL, "\\", 1);
+      begin = p;
+    }
+  }
+  if (*begin) {
+    file->write(NULL, begin, strlen(begin));
+  }
+  file->write(NULL, "\"", 1);
+}
+
+bool profiler_init() {
+  return true;
+}
+
+// The other threads that recorded zones must have exited.
+void profiler_destroy() {
+  g_profiler_is_recording.store(false, std::memory_order_relaxed);
+  int thread_count = min(g_profiler_thread_count_.load(std::memory_order_acquire), M_profiler_max_thread_count_);
+  for (int i = 0; i < thread_count; ++i) {
+    Profiler_thread_t_* thread = &g_profiler_threads_[i];
+    free(thread->zones);
+    thread->zones = NULL;
+    thread->write_count.store(0, std::memory_order_relaxed);
+    thread->start_count = 0;
+    thread->name = NULL;
+    thread->is_ready.store(false, std::memory_order_relaxed);
+    thread->sequence.store(0, std::memory_order_relaxed);
+  }
+  g_profiler_thread_count_.store(0, std::memory_order_relaxed);
+  g_profiler_thread_ = NULL;
+}
+
+void profiler_start() {
+  int thread_count = min(g_profiler_thread_count_.load(std::memory_order_acquire), M_profiler_max_thread_count_);
+  for (int i = 0; i < thread_count; ++i) {
+    g_profiler_threads_[i].start_count = g_profiler_threads_[i].write_count.load(std::memory_order_acquire);
+  }
+  g_profiler_start_time_ = mono_time_now();
+  g_profiler_is_recording.store(true, std::memory_order_relaxed);
+}
+
+// Waits for the zones that are being recorded, the ones that end after this see that the profiler stopped.
+static void wait_for_recording_zones_() {
+  int thread_count = min(g_profiler_thread_count_.load(std::memory_order_seq_cst), M_profiler_max_thread_count_);
+  for (int i = 0; i < thread_count; ++i) {
+    Profiler_thread_t_* thread = &g_profiler_threads_[i];
+    U32 sequence = thread->sequence.load(std::memory_order_seq_cst);
+    if (!(sequence & 1)) {
+      continue;
+    }
+    while (thread->sequence.load(std::memory_order_acquire) == sequence) {
+      Thread_t::yield();
+    }
+  }
+}
+
+bool profiler_stop(const Os_char* path) {
+  g_profiler_is_recording.store(false, std::memory_order_seq_cst);
+  wait_for_recording_zones_();
+  File_t file;
+  M_check_log_return_val(file.open(path, e_file_mode_write), false, "Can't open the profiler output");
+  M_scope_exit(file.close());
+  file.write(NULL, "{\"traceEvents\":[\n", 17);
+  bool is_first = true;
+  char buffer[256];
+  int thread_count = min(g_profiler_thread_count_.load(std::memory_order_acquire), M_profiler_max_thread_count_);
+  for (int i = 0; i < thread_count; ++i) {
+    Profiler_thread_t_* thread = &g_profiler_threads_[i];
+    if (!thread->is_ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    U64 end = thread->write_count.load(std::memory_order_acquire);
+    U64 begin = thread->start_count;
+    if (end - begin > M_profiler_zone_count_) {
+      M_logw("Profiler thread %d dropped %llu zones", i, end - begin - M_profiler_zone_count_);
+      begin = end - M_profiler_zone_count_;
+    }
+    if (thread->name) {
+      int len = snprintf(buffer, sizeof(buffer), "%s{\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", is_first ? "" : ",\n", i);
+      file.write(NULL, buffer, len);
+      write_json_string_(&file, thread->name);
+      file.write(NULL, "}}", 2);
+      is_first = false;
+    }
+    for (U64 j = begin; j < end; ++j) {
+      const Profiler_zone_t_& zone = thread->zones[j & (M_profiler_zone_count_ - 1)];
+      int len = snprintf(buffer, sizeof(buffer), "%s{\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", is_first ? "" : ",\n", i,
+                         mono_time_to_us(zone.begin - g_profiler_start_time_), mono_time_to_us(zone.end - zone.begin));
+      file.write(NULL, buffer, len);
+      write_json_string_(&file, zone.name);
+      file.write(NULL, "}", 1);
+      is_first = false;
+    }
+  }
+  file.write(NULL, "\n]}\n", 4);
+  return true;
+}
+
+void profiler_set_thread_name(const char* name) {
+  g_profiler_thread_name_ = name;
+  if (g_profiler_thread_) {
+    g_profiler_thread_->name = name;
+  }
+}
+
+void profiler_record_zone_(const char* name, S64 begin, S64 end) {
+  Profiler_thread_t_* thread = get_thread_();
+  if (!thread) {
+    return;
+  }
+  // Counted before the flag is read so profiler_stop() either waits for this zone or this zone sees that it stopped.
+  thread->sequence.fetch_add(1, std::memory_order_seq_cst);
+  M_scope_exit(thread->sequence.fetch_add(1, std::memory_order_release));
+  if (!g_profiler_is_recording.load(std::memory_order_seq_cst)) {
+    return;
+  }
+  U64 count = thread->write_count.load(std::memory_order_relaxed);
+  Profiler_zone_t_* zone = &thread->zones[count & (M_profiler_zone_count_ - 1)];
+  zone->name = name;
+  zone->begin = begin;
+  zone->end = end;
+  thread->write_count.store(count + 1, std::memory_order_release);
+}
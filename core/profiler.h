@@ -0,0 +1,51 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/mono_time.h"
+#include "core/types.h"
+#include "core/utils.h"
+
+#include <atomic>
+
+// An instrumented CPU profiler.
+// M_profile_zone("name") records the time of the rest of the scope into a buffer of the current thread, |name| must be a string literal.
+// Nothing is recorded until profiler_start() is called, a zone only checks a flag when the profiler isn't recording.
+// profiler_stop() writes the zones in the Chrome trace format, it can be opened in chrome://tracing or https://ui.perfetto.dev.
+
+extern std::atomic<bool> g_profiler_is_recording;
+
+bool profiler_init();
+void profiler_destroy();
+void profiler_start();
+// Stops recording and writes the zones that were recorded since profiler_start() to |path|.
+// It waits for the zones that are being recorded on the other threads, the zones that end after it aren't recorded.
+bool profiler_stop(const Os_char* path);
+// Shown in the trace instead of the thread index, |name| must be alive until the trace is written.
+void profiler_set_thread_name(const char* name);
+
+void profiler_record_zone_(const char* name, S64 begin, S64 end);
+
+inline bool profiler_is_recording() {
+  return g_profiler_is_recording.load(std::memory_order_relaxed);
+}
+
+class Profile_zone_t_ {
+public:
+  Profile_zone_t_(const char* name) : m_name(name), m_begin(profiler_is_recording() ? mono_time_now() : 0) {}
+  ~Profile_zone_t_() {
+    // A zone that started before profiler_start() isn't recorded.
+    if (m_begin) {
+      profiler_record_zone_(m_name, m_begin, mono_time_now());
+    }
+  }
+
+  const char* m_name;
+  S64 m_begin;
+};
+
+#define M_profile_zone(name) Profile_zone_t_ M_string_join_(zz_profile_zone_at_line_, __LINE__)(name)
@@ -227,7 +227,7 @@ int main(int argc, char** argv) {
         snprintf(init_fields.m_p + init_fields_old_len - 1, field_str_len + 1, gc_init_fields_field_, g_fields_[j].m_p);
       }
       dict["fields"] = init_fields.m_p;
-      M_logi("parse time: %f", mono_time_to_ms(mono_time_now() - t));
+      M_logci(e_log_category_reflection, "parse time: %f", mono_time_to_ms(mono_time_now() - t));
       auto final_template = string_format<char>(&clang_allocator, (char*)template_format.m_p, dict);
       f.write(NULL, final_template.m_p, final_template.m_length);
       break;
@@ -0,0 +1,27 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/types.h"
+
+// A sampling CPU profiler, it only works on Linux for now.
+// A SIGPROF timer interrupts the threads that are using the CPU and the signal handler captures the stack of the interrupted thread.
+// The stacks are counted in a lock-free hash table so the handler never takes a lock or allocates, they are only symbolized when the profiler stops.
+// The output is in the folded format ("main;foo;bar 42" per line), it can be turned into a flame graph with flamegraph.pl or opened in https://www.speedscope.app.
+// Stacks are counted by address so the same functions can be on several lines, the tools add them up.
+// Unlike M_profile_zone(), it doesn't need any change in the code but it only shows where the time is spent on average.
+
+// |frequency| is the number of samples per second of CPU time, the kernel may round it to its tick rate.
+bool sampling_profiler_start(int frequency);
+// Stops sampling and writes the stacks that were sampled since sampling_profiler_start() to |path|.
+bool sampling_profiler_stop(const Os_char* path);
+bool sampling_profiler_is_running();
+// Starts the profiler if --sampling-profile <file> is passed (and --sampling-profile-hz <frequency>, 1000 by default).
+// The stacks are written to <file> next to the executable in core_destroy().
+bool sampling_profiler_start_from_command_line();
+// Stops the profiler that was started by sampling_profiler_start_from_command_line().
+void sampling_profiler_destroy();
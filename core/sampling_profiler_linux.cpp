@@ -0,0 +1,260 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sampling_profiler.h"
+
+#include "core/command_line.h"
+#include "core/debug.h"
+#include "core/file.h"
+#include "core/log.h"
+#include "core/path.h"
+#include "core/path_utils.h"
+#include "core/thread.h"
+#include "core/utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+// Number of different stacks that can be sampled, it's a power of 2.
+#define M_sampling_profiler_stack_count_ (1 << 14)
+// Number of slots that are probed before a sample is dropped.
+#define M_sampling_profiler_max_probe_count_ 64
+// Frames of the signal handler that are skipped if the interrupted frame can't be found (debug_capture_stack_trace, the handler and the signal trampoline).
+#define M_sampling_profiler_handler_frame_count_ 3
+
+struct Sampled_stack_t_ {
+  // 0 means the slot is empty. Stacks with the same hash are counted as the same stack, a 64-bit hash is enough for that.
+  std::atomic<U64> hash;
+  std::atomic<U32> count;
+  // Set after |frames| and |depth| are written.
+  std::atomic<bool> is_ready;
+  int depth;
+  // The interrupted frame is first.
+  void* frames[M_max_traces_];
+};
+
+static Sampled_stack_t_* g_sampling_profiler_stacks_ = NULL;
+static std::atomic<bool> g_sampling_profiler_is_running_{false};
+// Handlers that may be using the table, it's only freed when there is none.
+static std::atomic<int> g_sampling_profiler_handler_count_{0};
+static std::atomic<U32> g_sampling_profiler_sample_count_{0};
+// Samples that didn't fit in the table.
+static std::atomic<U32> g_sampling_profiler_dropped_count_{0};
+static struct sigaction g_sampling_profiler_old_action_;
+// Set by sampling_profiler_start_from_command_line().
+static Path_t g_sampling_profiler_path_;
+
+static const void* get_interrupted_address_(void* context) {
+#if defined(__x86_64__)
+  return (const void*)((ucontext_t*)context)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__aarch64__)
+  return (const void*)((ucontext_t*)context)->uc_mcontext.pc;
+#else
+  return NULL;
+#endif
+}
+
+// Runs in the signal handler so it can only use atomics.
+static void add_sample_(void** frames, int depth) {
+  // FNV-1a of the addresses.
+  U64 hash = 14695981039346656037ull;
+  for (int i = 0; i < depth; ++i) {
+    hash = (hash ^ (Uip)frames[i]) * 1099511628211ull;
+  }
+  hash = hash ? hash : 1;
+  g_sampling_profiler_sample_count_.fetch_add(1, std::memory_order_relaxed);
+  for (int i = 0; i < M_sampling_profiler_max_probe_count_; ++i) {
+    Sampled_stack_t_* stack = &g_sampling_profiler_stacks_[(hash + i) & (M_sampling_profiler_stack_count_ - 1)];
+    U64 stack_hash = stack->hash.load(std::memory_order_acquire);
+    if (stack_hash == 0) {
+      if (stack->hash.compare_exchange_strong(stack_hash, hash, std::memory_order_acq_rel)) {
+        memcpy(stack->frames, frames, depth * sizeof(void*));
+        stack->depth = depth;
+        stack->is_ready.store(true, std::memory_order_release);
+        stack->count.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      // Another thread took the slot, |stack_hash| is its hash now.
+    }
+    if (stack_hash == hash) {
+      stack->count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  g_sampling_profiler_dropped_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void signal_handler_(int, siginfo_t*, void* context) {
+  // Counted before |g_sampling_profiler_is_running_| is read so stop_sampling_() either sees this handler or this handler sees that it stopped.
+  g_sampling_profiler_handler_count_.fetch_add(1, std::memory_order_seq_cst);
+  M_scope_exit(g_sampling_profiler_handler_count_.fetch_sub(1, std::memory_order_release));
+  if (!g_sampling_profiler_is_running_.load(std::memory_order_seq_cst)) {
+    return;
+  }
+  // backtrace() was called once in debug_init() so it doesn't load libgcc (and allocate) here.
+  int saved_errno = errno;
+  void* frames[M_max_traces_ + M_sampling_profiler_handler_frame_count_];
+  int count = debug_capture_stack_trace(frames, static_array_size(frames));
+  // The frames before the interrupted one belong to the handler.
+  const void* address = get_interrupted_address_(context);
+  int first = min(count, M_sampling_profiler_handler_frame_count_);
+  for (int i = 0; i < count; ++i) {
+    if (frames[i] == address) {
+      first = i;
+      break;
+    }
+  }
+  if (count > first) {
+    add_sample_(frames + first, min(count - first, M_max_traces_));
+  }
+  errno = saved_errno;
+}
+
+// Writes the function of "<module>: <function>" to |buffer|, or the file name of the module if the function is unknown.
+// ';' separates the frames in the folded format so it's replaced.
+static void get_frame_name_(char* buffer, int len, const void* address) {
+  char symbol[M_max_symbol_length_];
+  debug_get_symbol_name(symbol, sizeof(symbol), address);
+  const char* name = symbol;
+  char* separator = strstr(symbol, ": ");
+  if (separator && separator[2]) {
+    name = separator + 2;
+  } else {
+    if (separator) {
+      *separator = '\0';
+    }
+    const char* slash = strrchr(symbol, '/');
+    name = slash ? slash + 1 : symbol;
+  }
+  snprintf(buffer, len, "%s", name);
+  for (char* p = buffer; *p; ++p) {
+    if (*p == ';') {
+      *p = ':';
+    }
+  }
+}
+
+static void stop_sampling_() {
+  g_sampling_profiler_is_running_.store(false, std::memory_order_seq_cst);
+  itimerval timer = {};
+  setitimer(ITIMER_PROF, &timer, NULL);
+  // A SIGPROF may still be pending on a thread and the old action is usually SIG_DFL which terminates the process.
+  // Ignoring the signal discards the pending ones, the old action is only restored after that.
+  struct sigaction ignore_action = {};
+  ignore_action.sa_handler = SIG_IGN;
+  sigemptyset(&ignore_action.sa_mask);
+  sigaction(SIGPROF, &ignore_action, NULL);
+  // The handlers that are running on the other threads may still write to the table.
+  while (g_sampling_profiler_handler_count_.load(std::memory_order_acquire)) {
+    Thread_t::yield();
+  }
+  sigaction(SIGPROF, &g_sampling_profiler_old_action_, NULL);
+}
+
+static void free_stacks_() {
+  free(g_sampling_profiler_stacks_);
+  g_sampling_profiler_stacks_ = NULL;
+}
+
+bool sampling_profiler_start(int frequency) {
+  M_check_log_return_val(!g_sampling_profiler_stacks_, false, "The sampling profiler is already running");
+  M_check_return_val(frequency > 0, false);
+  g_sampling_profiler_stacks_ = (Sampled_stack_t_*)calloc(M_sampling_profiler_stack_count_, sizeof(Sampled_stack_t_));
+  M_check_log_return_val(g_sampling_profiler_stacks_, false, "Out of memory for the sampling profiler");
+  g_sampling_profiler_sample_count_.store(0, std::memory_order_relaxed);
+  g_sampling_profiler_dropped_count_.store(0, std::memory_order_relaxed);
+  struct sigaction action = {};
+  action.sa_sigaction = signal_handler_;
+  // Interrupted system calls are restarted so the sampled code doesn't see EINTR.
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &g_sampling_profiler_old_action_) != 0) {
+    free_stacks_();
+    M_logw("Can't install the SIGPROF handler");
+    return false;
+  }
+  g_sampling_profiler_is_running_.store(true, std::memory_order_release);
+  // ITIMER_PROF counts the CPU time of the whole process, the signal goes to the thread that is running when it expires.
+  itimerval timer = {};
+  // tv_usec must be less than a second.
+  int interval_us = max(1000000 / frequency, 1);
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    stop_sampling_();
+    free_stacks_();
+    M_logw("Can't start the SIGPROF timer");
+    return false;
+  }
+  return true;
+}
+
+bool sampling_profiler_stop(const Os_char* path) {
+  M_check_log_return_val(g_sampling_profiler_stacks_, false, "The sampling profiler isn't running");
+  stop_sampling_();
+  M_scope_exit(free_stacks_());
+  File_t file;
+  M_check_log_return_val(file.open(path, e_file_mode_write), false, "Can't open the sampling profiler output");
+  M_scope_exit(file.close());
+  char name[M_max_symbol_length_];
+  for (int i = 0; i < M_sampling_profiler_stack_count_; ++i) {
+    Sampled_stack_t_* stack = &g_sampling_profiler_stacks_[i];
+    if (!stack->is_ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    // The root is first in the folded format.
+    for (int j = stack->depth - 1; j >= 0; --j) {
+      // The other frames are return addresses, they may be past the end of their function if the last instruction is a call.
+      const U8* address = (const U8*)stack->frames[j] - (j ? 1 : 0);
+      get_frame_name_(name, sizeof(name), address);
+      file.write(NULL, name, strlen(name));
+      file.write(NULL, j ? ";" : " ", 1);
+    }
+    int len = snprintf(name, sizeof(name), "%u\n", stack->count.load(std::memory_order_relaxed));
+    file.write(NULL, name, len);
+  }
+  U32 dropped_count = g_sampling_profiler_dropped_count_.load(std::memory_order_relaxed);
+  if (dropped_count) {
+    M_logw("The sampling profiler dropped %u of %u samples", dropped_count, g_sampling_profiler_sample_count_.load(std::memory_order_relaxed));
+  }
+  return true;
+}
+
+bool sampling_profiler_is_running() {
+  return g_sampling_profiler_is_running_.load(std::memory_order_relaxed);
+}
+
+bool sampling_profiler_start_from_command_line() {
+  Value_t file_name = g_cl->get_flag_value("--sampling-profile");
+  if (!file_name.m_const_string) {
+    return true;
+  }
+  Value_t frequency = g_cl->get_flag_value("--sampling-profile-hz");
+  g_sampling_profiler_path_ = g_exe_dir.join(file_name.m_const_string);
+  return sampling_profiler_start(frequency.m_const_string ? atoi(frequency.m_const_string) : 1000);
+}
+
+void sampling_profiler_destroy() {
+  if (!g_sampling_profiler_stacks_) {
+    return;
+  }
+  if (g_sampling_profiler_path_.m_path[0]) {
+    sampling_profiler_stop(g_sampling_profiler_path_.m_path);
+    g_sampling_profiler_path_ = Path_t();
+    return;
+  }
+  stop_sampling_();
+  free_stacks_();
+}
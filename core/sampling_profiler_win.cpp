@@ -0,0 +1,32 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sampling_profiler.h"
+
+#include "core/command_line.h"
+#include "core/log.h"
+
+bool sampling_profiler_start(int frequency) {
+  M_logw("The sampling profiler isn't supported on Windows");
+  return false;
+}
+
+bool sampling_profiler_stop(const Os_char* path) {
+  return false;
+}
+
+bool sampling_profiler_is_running() {
+  return false;
+}
+
+bool sampling_profiler_start_from_command_line() {
+  if (!g_cl->get_flag_value("--sampling-profile").m_const_string) {
+    return true;
+  }
+  return sampling_profiler_start(0);
+}
+
+void sampling_profiler_destroy() {}
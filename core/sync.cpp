@@ -0,0 +1,151 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sync.h"
+
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/utils.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define M_sync_has_pause_ 1
+#endif
+
+// Upper bound of the adaptive spinning of Mutex_t.
+#define M_mutex_max_spin_count_ 128
+
+void sync_pause() {
+#if M_sync_has_pause_
+  _mm_pause();
+#endif
+}
+
+void Mutex_t::lock() {
+  U32 expected = e_state_unlocked;
+  if (M_likely(m_state.compare_exchange_strong(expected, e_state_locked, std::memory_order_acquire, std::memory_order_relaxed))) {
+    return;
+  }
+  lock_slow_();
+}
+
+bool Mutex_t::try_lock() {
+  U32 expected = e_state_unlocked;
+  return m_state.compare_exchange_strong(expected, e_state_locked, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+void Mutex_t::unlock() {
+  if (M_unlikely(m_state.exchange(e_state_unlocked, std::memory_order_release) == e_state_locked_with_waiters)) {
+    sync_wake_one(&m_state);
+  }
+}
+
+void Mutex_t::lock_slow_() {
+  // Spin a bit longer than it usually takes, like glibc's PTHREAD_MUTEX_ADAPTIVE_NP.
+  S32 average_spin_count = m_spin_count.load(std::memory_order_relaxed);
+  S32 max_spin_count = min(average_spin_count * 2 + 10, M_mutex_max_spin_count_);
+  for (S32 i = 0; i < max_spin_count; ++i) {
+    sync_pause();
+    U32 expected = e_state_unlocked;
+    if (m_state.load(std::memory_order_relaxed) == e_state_unlocked &&
+        m_state.compare_exchange_weak(expected, e_state_locked, std::memory_order_acquire, std::memory_order_relaxed)) {
+      m_spin_count.store(average_spin_count + (i - average_spin_count) / 8, std::memory_order_relaxed);
+      return;
+    }
+  }
+  m_spin_count.store(average_spin_count + (max_spin_count - average_spin_count) / 8, std::memory_order_relaxed);
+  // "Futexes Are Tricky" (Drepper), mutex 3. Once we sleep, we don't know if there are other waiters so the unlocker always wakes one.
+  while (m_state.exchange(e_state_locked_with_waiters, std::memory_order_acquire) != e_state_unlocked) {
+    sync_wait_on_address(&m_state, e_state_locked_with_waiters);
+  }
+}
+
+void Semaphore_t::acquire() {
+  if (M_likely(m_count.fetch_sub(1, std::memory_order_acquire) > 0)) {
+    return;
+  }
+  while (true) {
+    U32 wakeup_count = m_wakeup_count.load(std::memory_order_relaxed);
+    while (wakeup_count > 0) {
+      if (m_wakeup_count.compare_exchange_weak(wakeup_count, wakeup_count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    sync_wait_on_address(&m_wakeup_count, 0);
+  }
+}
+
+bool Semaphore_t::try_acquire() {
+  S32 count = m_count.load(std::memory_order_relaxed);
+  while (count > 0) {
+    if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Semaphore_t::release(S32 count) {
+  S32 old_count = m_count.fetch_add(count, std::memory_order_release);
+  if (old_count >= 0) {
+    return;
+  }
+  S32 waiter_count = min(-old_count, count);
+  m_wakeup_count.fetch_add(waiter_count, std::memory_order_release);
+  if (waiter_count == 1) {
+    sync_wake_one(&m_wakeup_count);
+  } else {
+    sync_wake_all(&m_wakeup_count);
+  }
+}
+
+void Event_t::set() {
+  m_state.store(1, std::memory_order_seq_cst);
+  if (m_waiter_count.load(std::memory_order_seq_cst) > 0) {
+    if (m_is_manual_reset) {
+      sync_wake_all(&m_state);
+    } else {
+      sync_wake_one(&m_state);
+    }
+  }
+}
+
+void Event_t::reset() {
+  m_state.store(0, std::memory_order_relaxed);
+}
+
+void Event_t::wait() {
+  wait_for(-1);
+}
+
+bool Event_t::wait_for(int timeout_ms) {
+  auto try_consume = [this]() {
+    if (m_is_manual_reset) {
+      return m_state.load(std::memory_order_acquire) == 1;
+    }
+    U32 expected = 1;
+    return m_state.compare_exchange_strong(expected, 0, std::memory_order_acquire, std::memory_order_relaxed);
+  };
+  if (M_likely(try_consume())) {
+    return true;
+  }
+  S64 start = mono_time_now();
+  m_waiter_count.fetch_add(1, std::memory_order_seq_cst);
+  bool rv = true;
+  while (!try_consume()) {
+    int remaining_ms = -1;
+    if (timeout_ms >= 0) {
+      remaining_ms = timeout_ms - (int)mono_time_to_ms(mono_time_now() - start);
+      if (remaining_ms <= 0) {
+        rv = try_consume();
+        break;
+      }
+    }
+    sync_wait_on_address(&m_state, 0, remaining_ms);
+  }
+  m_waiter_count.fetch_sub(1, std::memory_order_relaxed);
+  return rv;
+}
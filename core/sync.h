@@ -0,0 +1,95 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/types.h"
+
+#include <atomic>
+
+// Synchronization primitives on top of futex (Linux) and WaitOnAddress (Windows).
+// The uncontended paths are a single atomic instruction and never enter the kernel.
+
+#define M_cache_line_size 64
+
+// Blocks while |*address| == |expected|, it can return spuriously.
+// |timeout_ms| < 0 means no timeout. Returns false if it timed out.
+bool sync_wait_on_address(std::atomic<U32>* address, U32 expected, int timeout_ms = -1);
+void sync_wake_one(std::atomic<U32>* address);
+void sync_wake_all(std::atomic<U32>* address);
+// A hint to the CPU that we are spinning.
+void sync_pause();
+
+// Spins for a while before it sleeps, the spin count adapts to how long the lock is usually held.
+class Mutex_t {
+public:
+  void lock();
+  bool try_lock();
+  void unlock();
+
+  enum E_state : U32 {
+    e_state_unlocked,
+    e_state_locked,
+    e_state_locked_with_waiters,
+  };
+  std::atomic<U32> m_state{e_state_unlocked};
+  // Average number of spins that it took to get the lock, it's only a hint so it doesn't need to be exact.
+  std::atomic<S32> m_spin_count{0};
+
+private:
+  void lock_slow_();
+};
+
+// Locks in the constructor and unlocks in the destructor.
+class Scope_lock_t {
+public:
+  Scope_lock_t(Mutex_t* mutex) : m_mutex(mutex) { m_mutex->lock(); }
+  ~Scope_lock_t() { m_mutex->unlock(); }
+
+  Mutex_t* m_mutex;
+};
+
+class Semaphore_t {
+public:
+  Semaphore_t(S32 count = 0) : m_count(count) {}
+  void acquire();
+  bool try_acquire();
+  void release(S32 count = 1);
+
+  // Negative when there are waiters.
+  std::atomic<S32> m_count;
+  // Number of waiters that have been released but haven't woken up yet, the waiters sleep on it.
+  std::atomic<U32> m_wakeup_count{0};
+};
+
+class Event_t {
+public:
+  // An auto-reset event releases one waiter and resets itself, a manual-reset event stays set until reset() is called.
+  Event_t(bool is_manual_reset = false, bool is_set = false) : m_is_manual_reset(is_manual_reset), m_state(is_set) {}
+  void set();
+  void reset();
+  void wait();
+  // Returns false if it timed out.
+  bool wait_for(int timeout_ms);
+
+  bool m_is_manual_reset;
+  // 1 when the event is set.
+  std::atomic<U32> m_state;
+  std::atomic<U32> m_waiter_count{0};
+};
+
+// Counters that are updated by many threads should be on their own cache line so they don't share it with other data.
+template <typename T>
+struct alignas(M_cache_line_size) Atomic_counter_t {
+  T add(T v) { return m_value.fetch_add(v, std::memory_order_relaxed) + v; }
+  T increment() { return add(1); }
+  T decrement() { return add(-1); }
+  T get() const { return m_value.load(std::memory_order_relaxed); }
+  void set(T v) { m_value.store(v, std::memory_order_relaxed); }
+
+  std::atomic<T> m_value{0};
+};
+static_assert(sizeof(Atomic_counter_t<S64>) == M_cache_line_size);
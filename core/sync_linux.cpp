@@ -0,0 +1,33 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sync.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(sizeof(std::atomic<U32>) == sizeof(U32) && std::atomic<U32>::is_always_lock_free, "futex needs a plain 32-bit word");
+
+bool sync_wait_on_address(std::atomic<U32>* address, U32 expected, int timeout_ms) {
+  struct timespec ts;
+  ts.tv_sec = timeout_ms / 1000;
+  ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+  long rv = syscall(SYS_futex, (U32*)address, FUTEX_WAIT_PRIVATE, expected, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+  return rv == 0 || errno != ETIMEDOUT;
+}
+
+void sync_wake_one(std::atomic<U32>* address) {
+  syscall(SYS_futex, (U32*)address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+void sync_wake_all(std::atomic<U32>* address) {
+  syscall(SYS_futex, (U32*)address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
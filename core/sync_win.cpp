@@ -0,0 +1,24 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sync.h"
+
+#include <Windows.h>
+
+static_assert(sizeof(std::atomic<U32>) == sizeof(U32) && std::atomic<U32>::is_always_lock_free, "WaitOnAddress needs a plain 32-bit word");
+
+bool sync_wait_on_address(std::atomic<U32>* address, U32 expected, int timeout_ms) {
+  BOOL rv = WaitOnAddress((volatile VOID*)address, &expected, sizeof(U32), timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+  return rv || GetLastError() != ERROR_TIMEOUT;
+}
+
+void sync_wake_one(std::atomic<U32>* address) {
+  WakeByAddressSingle((PVOID)address);
+}
+
+void sync_wake_all(std::atomic<U32>* address) {
+  WakeByAddressAll((PVOID)address);
+}
@@ -0,0 +1,40 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/task.h"
+
+#include "core/file.h"
+#include "core/thread.h"
+
+void task_resume_job_(void* args) {
+  std::coroutine_handle<>::from_address(args).resume();
+}
+
+void task_wait_for_join_counter_(std::atomic<int>* counter) {
+  while (counter->load(std::memory_order_acquire)) {
+    if (!job_execute_one()) {
+      Thread_t::yield();
+    }
+  }
+}
+
+void task_poll_yield_() {
+  if (!job_execute_one()) {
+    Thread_t::yield();
+  }
+}
+
+static void read_file_job_(void* args) {
+  auto awaiter = (Task_read_file_awaiter_t_*)args;
+  awaiter->data = File_t::read_whole_file_as_binary(awaiter->allocator, awaiter->path);
+  awaiter->handle.resume();
+}
+
+void Task_read_file_awaiter_t_::await_suspend(std::coroutine_handle<> h) {
+  handle = h;
+  Job_decl_t job = {read_file_job_, this};
+  job_run(&job, 1, NULL);
+}
@@ -0,0 +1,309 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#pragma once
+
+#include "core/allocator.h"
+#include "core/dynamic_array.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "core/types.h"
+
+#include <stddef.h>
+
+#include <atomic>
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+// Coroutines on top of the job system.
+// A function that returns a Task_t<T> is a coroutine, it doesn't start until it's awaited (co_await), passed to task_when_all() or task_wait().
+// The frame of a coroutine is allocated from its first Allocator_t* parameter (the second one for member functions and lambdas), there is no default allocator:
+//   Task_t<int> load(Allocator_t* allocator, int i);
+// When a coroutine is resumed by a job it continues on that job's worker, so the code after a co_await can run on another thread.
+// Task_t doesn't synchronize anything itself, the data that is shared between tasks must be synchronized the same way as between jobs.
+
+struct Task_promise_base_t_ {
+  // Stored in front of the frame so operator delete knows where the frame is from.
+  static constexpr Sip sc_header_size = alignof(max_align_t);
+
+  static void* alloc_frame_(Sip size, Allocator_t* allocator) {
+    M_check_return_val(allocator, NULL);
+    U8* p = (U8*)allocator->aligned_alloc(size + sc_header_size, sc_header_size);
+    M_check_return_val(p, NULL);
+    *(Allocator_t**)p = allocator;
+    return p + sc_header_size;
+  }
+
+  template <typename... T_args>
+  static void* operator new(Sz size, Allocator_t* allocator, T_args&...) {
+    return alloc_frame_(size, allocator);
+  }
+
+  template <typename T_class, typename... T_args>
+  static void* operator new(Sz size, T_class&, Allocator_t* allocator, T_args&...) {
+    return alloc_frame_(size, allocator);
+  }
+
+  static void operator delete(void* p, Sz) {
+    U8* frame = (U8*)p - sc_header_size;
+    (*(Allocator_t**)frame)->free(frame);
+  }
+
+  struct Final_awaiter_t_ {
+    bool await_ready() noexcept { return false; }
+
+    template <typename T_promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<T_promise> handle) noexcept {
+      Task_promise_base_t_& promise = handle.promise();
+      // The frame can be destroyed as soon as the join counter is decremented, read everything before that.
+      std::coroutine_handle<> continuation = promise.m_continuation ? promise.m_continuation : std::noop_coroutine();
+      if (promise.m_join_counter && promise.m_join_counter->fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        // Other tasks that the continuation is waiting for are still running, the last one resumes it.
+        return std::noop_coroutine();
+      }
+      return continuation;
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  Final_awaiter_t_ final_suspend() noexcept { return {}; }
+  void unhandled_exception() { M_logf("Unhandled exception in a task"); }
+
+  // Resumed when the task is done.
+  std::coroutine_handle<> m_continuation;
+  // If it's not NULL, it's decremented when the task is done and |m_continuation| is only resumed when it reaches 0.
+  std::atomic<int>* m_join_counter = NULL;
+};
+
+template <typename T>
+class Task_t;
+
+template <typename T>
+struct Task_promise_t_ : Task_promise_base_t_ {
+  ~Task_promise_t_() {
+    if (m_has_value) {
+      get_value().~T();
+    }
+  }
+
+  Task_t<T> get_return_object() { return Task_t<T>(std::coroutine_handle<Task_promise_t_>::from_promise(*this)); }
+
+  template <typename T_value>
+  void return_value(T_value&& value) {
+    new (m_value_storage) T(std::forward<T_value>(value));
+    m_has_value = true;
+  }
+
+  T& get_value() { return *(T*)m_value_storage; }
+
+  // T doesn't need a default constructor.
+  alignas(T) U8 m_value_storage[sizeof(T)];
+  bool m_has_value = false;
+};
+
+template <>
+struct Task_promise_t_<void> : Task_promise_base_t_ {
+  Task_t<void> get_return_object();
+  void return_void() {}
+  void get_value() {}
+};
+
+template <typename T = void>
+class Task_t {
+public:
+  using promise_type = Task_promise_t_<T>;
+
+  Task_t() = default;
+  explicit Task_t(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+  Task_t(Task_t&& other) : m_handle(other.m_handle) { other.m_handle = NULL; }
+  Task_t(const Task_t&) = delete;
+  ~Task_t() { destroy(); }
+
+  Task_t& operator=(Task_t&& other) {
+    if (this != &other) {
+      destroy();
+      m_handle = other.m_handle;
+      other.m_handle = NULL;
+    }
+    return *this;
+  }
+
+  // Frees the frame, the task must be done or not started.
+  void destroy() {
+    if (m_handle) {
+      m_handle.destroy();
+      m_handle = NULL;
+    }
+  }
+
+  bool is_done() const { return !m_handle || m_handle.done(); }
+
+  // Only valid after the task is done.
+  std::add_lvalue_reference_t<T> get_value() { return m_handle.promise().get_value(); }
+
+  struct Awaiter_t_ {
+    bool await_ready() noexcept { return !handle || handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+      handle.promise().m_continuation = continuation;
+      return handle;
+    }
+
+    T await_resume() {
+      if constexpr (!std::is_void_v<T>) {
+        return std::move(handle.promise().get_value());
+      }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+  };
+
+  Awaiter_t_ operator co_await() noexcept { return Awaiter_t_{m_handle}; }
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+inline Task_t<void> Task_promise_t_<void>::get_return_object() {
+  return Task_t<void>(std::coroutine_handle<Task_promise_t_>::from_promise(*this));
+}
+
+void task_resume_job_(void* args);
+void task_wait_for_join_counter_(std::atomic<int>* counter);
+
+// Starts |task| and runs other jobs until it's done. It's how a normal function waits for a task.
+template <typename T>
+void task_wait(Task_t<T>& task) {
+  if (task.is_done()) {
+    return;
+  }
+  std::atomic<int> counter{1};
+  task.m_handle.promise().m_join_counter = &counter;
+  task.m_handle.resume();
+  task_wait_for_join_counter_(&counter);
+}
+
+template <typename T>
+struct Task_when_all_awaiter_t_ {
+  bool await_ready() noexcept { return count <= 0; }
+
+  bool await_suspend(std::coroutine_handle<> continuation) noexcept {
+    // The extra count stops the tasks from resuming |continuation| before all of them are started.
+    remaining.store(count + 1, std::memory_order_relaxed);
+    for (int i = 0; i < count; ++i) {
+      auto& promise = tasks[i].m_handle.promise();
+      promise.m_continuation = continuation;
+      promise.m_join_counter = &remaining;
+      tasks[i].m_handle.resume();
+    }
+    // Don't suspend if all of them are already done.
+    return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+  }
+
+  void await_resume() noexcept {}
+
+  Task_t<T>* tasks;
+  int count;
+  std::atomic<int> remaining{0};
+};
+
+// Starts |count| tasks that haven't been started and resumes the awaiting coroutine when all of them are done.
+// A task that co_awaits a job or a file read (or task_switch_to_worker()) runs in parallel with the others.
+template <typename T>
+Task_when_all_awaiter_t_<T> task_when_all(Task_t<T>* tasks, int count) {
+  return Task_when_all_awaiter_t_<T>{tasks, count};
+}
+
+struct Task_job_awaiter_t_ {
+  bool await_ready() noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    Job_decl_t job = {task_resume_job_, handle.address()};
+    job_run(&job, 1, NULL, dependency);
+  }
+
+  void await_resume() noexcept {}
+
+  Job_counter_t* dependency;
+};
+
+// Continues the coroutine in a new job so the code that follows runs in parallel with the caller.
+inline Task_job_awaiter_t_ task_switch_to_worker() {
+  return Task_job_awaiter_t_{NULL};
+}
+
+// Suspends the coroutine until the jobs of |counter| are done, the worker runs other jobs in the meantime.
+inline Task_job_awaiter_t_ task_wait_for(Job_counter_t* counter) {
+  return Task_job_awaiter_t_{counter};
+}
+
+void task_poll_yield_();
+
+template <typename T_func>
+struct Task_poll_awaiter_t_ {
+  bool await_ready() { return is_ready(); }
+
+  bool await_suspend(std::coroutine_handle<> h) {
+    if (job_get_worker_index() == -1) {
+      // There isn't any worker to poll on, so wait here.
+      while (!is_ready()) {
+        task_poll_yield_();
+      }
+      return false;
+    }
+    handle = h;
+    Job_decl_t job = {poll_job_, this};
+    job_run(&job, 1, NULL);
+    return true;
+  }
+
+  void await_resume() noexcept {}
+
+  static void poll_job_(void* args) {
+    auto self = (Task_poll_awaiter_t_*)args;
+    if (self->is_ready()) {
+      self->handle.resume();
+      return;
+    }
+    // The job is pushed to the bottom of the deque so it would be popped again right away, run something else first.
+    task_poll_yield_();
+    Job_decl_t job = {poll_job_, self};
+    job_run(&job, 1, NULL);
+  }
+
+  T_func is_ready;
+  std::coroutine_handle<> handle;
+};
+
+// Suspends the coroutine until |is_ready()| returns true, it's checked between jobs.
+// It's for things that can't wake us up, like GPU fences.
+template <typename T_func>
+Task_poll_awaiter_t_<T_func> task_poll(T_func is_ready) {
+  return Task_poll_awaiter_t_<T_func>{std::move(is_ready), {}};
+}
+
+struct Task_read_file_awaiter_t_ {
+  Task_read_file_awaiter_t_(Allocator_t* a, const Os_char* p) : allocator(a), path(p), data(a) {}
+
+  bool await_ready() noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h);
+
+  Dynamic_array_t<U8> await_resume() noexcept { return data; }
+
+  Allocator_t* allocator;
+  const Os_char* path;
+  std::coroutine_handle<> handle;
+  Dynamic_array_t<U8> data;
+};
+
+// Reads the whole file in a job and continues the coroutine on that job's worker.
+// |path| must be alive until the read is done. The result is empty if the file can't be read.
+inline Task_read_file_awaiter_t_ task_read_whole_file(Allocator_t* allocator, const Os_char* path) {
+  return Task_read_file_awaiter_t_(allocator, path);
+}
@@ -27,6 +27,9 @@ public:
   bool init(ngThread_func start_func, void* args);
   void wait_for();
   static int get_total_thread_count();
+  // Gives up the rest of the current thread's time slice.
+  static void yield();
+  static void sleep_ms(int ms);
 
   ngThread_handle_ m_handle;
   ngThread_func m_start_func;
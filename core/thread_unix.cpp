@@ -9,6 +9,8 @@
 #include "core/log.h"
 
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <unistd.h>
 
 static void* platform_thread_start(void* args) {
@@ -32,3 +34,14 @@ void Thread_t::wait_for() {
 int Thread_t::get_total_thread_count() {
   return sysconf(_SC_NPROCESSORS_ONLN);
 }
+
+void Thread_t::yield() {
+  sched_yield();
+}
+
+void Thread_t::sleep_ms(int ms) {
+  struct timespec ts;
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000;
+  nanosleep(&ts, NULL);
+}
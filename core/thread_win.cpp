@@ -33,3 +33,11 @@ int Thread_t::get_total_thread_count() {
   GetSystemInfo(&info);
   return info.dwNumberOfProcessors;
 }
+
+void Thread_t::yield() {
+  SwitchToThread();
+}
+
+void Thread_t::sleep_ms(int ms) {
+  Sleep(ms);
+}
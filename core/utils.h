@@ -20,6 +20,11 @@ const T& min(const T& a, const T& b) {
   return a < b ? a : b;
 }
 
+template <typename T>
+const T& max(const T& a, const T& b) {
+  return a < b ? b : a;
+}
+
 template <typename T, Sz N>
 Sz static_array_size(const T(&)[N]) {
   return N;
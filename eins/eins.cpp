@@ -4,11 +4,13 @@
 // Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
 //----------------------------------------------------------------------------//
 
+#include "core/binary_log.h"
 #include "core/command_line.h"
 #include "core/core_allocators.h"
 #include "core/core_init.h"
 #include "core/dynamic_array.h"
 #include "core/fixed_array.h"
+#include "core/frame_stats.h"
 #include "core/linear_allocator.h"
 #include "core/loader/dae.h"
 #include "core/loader/dds.h"
@@ -21,14 +23,36 @@
 #include "core/math/vec3.h"
 #include "core/mono_time.h"
 #include "core/path_utils.h"
+#include "core/profiler.h"
+#include "core/sampling_profiler.h"
 #include "core/string.h"
+#include "core/task.h"
 #include "core/utils.h"
 #include "core/window/window.h"
 #include "eins/cam.h"
 
+#include <stdlib.h>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "third_party/stb/stb_image.h"
 
+enum E_frame_stat_ {
+  e_frame_stat_interval,
+  e_frame_stat_cpu,
+  e_frame_stat_acquire,
+  e_frame_stat_fence_wait,
+  e_frame_stat_cmd_end,
+  e_frame_stat_count,
+};
+
+static const char* gc_frame_stat_names_[e_frame_stat_count] = {
+  "interval",
+  "cpu",
+  "acquire",
+  "fence_wait",
+  "cmd_end",
+};
+
 struct Per_obj_t_ {
   M4_t world = {};
   M4_t joints[300] = {};
@@ -118,7 +142,7 @@ static Textured_sphere_t generate_sphere(Allocator_t* allocator, float r, int n)
 
 class Eins_window_t : public Window_t {
 public:
-  Eins_window_t(const Os_char* title, int w, int h) : Window_t(title, w, h), m_gpu_allocator("gpu_allocator"), m_dae_model(&m_gpu_allocator) {}
+  Eins_window_t(const Os_char* title, int w, int h) : Window_t(title, w, h), m_gpu_allocator("gpu_allocator"), m_dae_model(&m_gpu_allocator), m_frame_stats(g_persistent_allocator) {}
 
   bool init();
   void destroy() override;
@@ -188,12 +212,26 @@ public:
   int m_obj_indices_counts[10];
   int m_sphere_vertice_count;
   S64 m_time_start;
+  S64 m_frame_index = 0;
+  bool m_should_trace_frames = false;
+  bool m_should_collect_frame_stats = false;
+  // Start of the last frame, 0 before the first frame.
+  S64 m_last_frame_start = 0;
+  Frame_stats_t m_frame_stats;
 
   Dae_loader_t m_dae_model;
 private:
-  void create_texture_and_srv_(Texture_t** texture, Resource_t* srv, const Path_t& path, Resources_set_t* set, int binding, E_format srv_format);
+  bool create_texture_and_srv_(Texture_t** texture, Resource_t* srv, const Dds_loader_t& dds, Resources_set_t* set, int binding, E_format srv_format);
+  // The PBR textures and the cube faces are read and parsed in parallel, the GPU textures are created after that.
+  Task_t<> load_textures_async_(Allocator_t* task_allocator, Linear_allocator_t<>* temp_allocator);
 };
 
+static Task_t<bool> load_dds_async_(Allocator_t* task_allocator, Dds_loader_t* dds, const Os_char* path) {
+  Dynamic_array_t<U8> file_data = co_await task_read_whole_file(dds->m_file_data.m_allocator, path);
+  // It's parsed on the worker that read the file.
+  co_return dds->init(file_data);
+}
+
 bool Eins_window_t::init() {
   Window_t::init();
   Linear_allocator_t<> temp_allocator("gpu_init_temp_allocator");
@@ -316,50 +354,11 @@ bool Eins_window_t::init() {
       ci.visibility = e_shader_stage_fragment;
       m_pbr_srvs = m_gpu->create_resources_set(&m_gpu_allocator, ci);
     }
-    create_texture_and_srv_(&m_albedo_texture, &m_albedo_srv, g_exe_dir.join(M_txt("assets/basecolor.dds")), m_pbr_srvs, 0, e_format_bc7_unorm);
-    create_texture_and_srv_(&m_normal_texture, &m_normal_srv, g_exe_dir.join(M_txt("assets/normal.dds")), m_pbr_srvs, 1, e_format_bc7_unorm);
-    create_texture_and_srv_(&m_metallic_texture, &m_metallic_srv, g_exe_dir.join(M_txt("assets/metallic.dds")), m_pbr_srvs, 2, e_format_bc7_unorm);
-    create_texture_and_srv_(&m_roughness_texture, &m_roughness_srv, g_exe_dir.join(M_txt("assets/roughness.dds")), m_pbr_srvs, 3, e_format_bc7_unorm);
     {
-      Scope_allocator_t<> scope_allocator(&temp_allocator);
-      Path_t paths[6] = {
-        g_exe_dir.join(M_txt("assets/posx.dds")),
-        g_exe_dir.join(M_txt("assets/negx.dds")),
-        g_exe_dir.join(M_txt("assets/posy.dds")),
-        g_exe_dir.join(M_txt("assets/negy.dds")),
-        g_exe_dir.join(M_txt("assets/posz.dds")),
-        g_exe_dir.join(M_txt("assets/negz.dds")),
-      };
-      U8* cube_data = NULL;
-      U32 dimension = 0;
-      U32 one_face_size = 0;
-      E_format format;
-      Texture_create_info_t ci = {};
-      for (int i = 0; i < 6; ++i) {
-        Linear_allocator_t<> texture_temp_allocator("texture_temp_allocator");
-        M_scope_exit(texture_temp_allocator.destroy());
-        Dds_loader_t cube_texture(&texture_temp_allocator);
-        cube_texture.init(paths[i]);
-        ci = get_texture_create_info(cube_texture);
-        M_check(cube_texture.m_header->width == cube_texture.m_header->height);
-        if (dimension == 0) {
-          dimension = cube_texture.m_header->width;
-          one_face_size = ci.row_count * ci.row_pitch;
-          cube_data = (U8*)scope_allocator.alloc(6 * one_face_size);
-          format = cube_texture.m_format;
-        } else {
-          M_check(dimension == cube_texture.m_header->width);
-          M_check(format == cube_texture.m_format);
-        }
-        memcpy(cube_data + i*one_face_size, cube_texture.m_data, one_face_size);
-      }
-      ci.data = cube_data;
-      m_cube_texture = m_gpu->create_texture_cube(&m_gpu_allocator, ci);
-      Image_view_create_info_t cube_srv_ci = {};
-      cube_srv_ci.texture = m_cube_texture;
-      cube_srv_ci.format = e_format_bc7_unorm;
-      m_cube_srv = m_gpu->create_image_view(&m_gpu_allocator, cube_srv_ci);
-      m_gpu->bind_resource_to_set(m_cube_srv, m_cube_srvs, 0);
+      Linear_allocator_t<> task_allocator("texture_task_allocator");
+      M_scope_exit(task_allocator.destroy());
+      Task_t<> task = load_textures_async_(&task_allocator, &temp_allocator);
+      task_wait(task);
     }
   }
 
@@ -649,17 +648,34 @@ bool Eins_window_t::init() {
     m_per_obj_pbr->world = m4_identity();
   }
 
+  m_should_trace_frames = g_cl->get_flag_value("--trace-frames").get_bool();
+  m_should_collect_frame_stats = g_cl->get_flag_value("--frame-stats").get_bool();
+  if (m_should_collect_frame_stats) {
+    const char* window_size = g_cl->get_flag_value("--frame-stats-window").m_const_string;
+    Path_t csv_path = g_exe_dir.join(M_txt("eins_frame_stats.csv"));
+    bool should_write_csv = g_cl->get_flag_value("--frame-stats-csv").get_bool();
+    m_should_collect_frame_stats = m_frame_stats.init(gc_frame_stat_names_, e_frame_stat_count, window_size ? atoi(window_size) : 300, should_write_csv ? csv_path.m_path : NULL);
+  }
   m_time_start = mono_time_now();
   return true;
 }
 
 void Eins_window_t::destroy() {
+  if (m_should_collect_frame_stats) {
+    m_frame_stats.destroy();
+  }
 }
 
 void Eins_window_t::loop() {
+  M_profile_zone("Eins_window_t::loop");
+  S64 frame_start = mono_time_now();
   m_cam.update();
   m_shared->view = m_cam.m_view_mat;
   F64 delta_s = mono_time_to_s(mono_time_now() - m_time_start);
+  if (m_should_trace_frames) {
+    M_logt("Frame %lld at %f s", m_frame_index, delta_s);
+  }
+  ++m_frame_index;
 
   m_dae_model.update_joint_matrices_at(delta_s);
   memcpy(m_per_obj[0]->joints, m_dae_model.m_joint_matrices.m_p, m_dae_model.m_joint_matrices.len() * sizeof(M4_t));
@@ -727,6 +743,20 @@ void Eins_window_t::loop() {
   //   m_gpu->cmd_end_render_pass(m_pbr_render_pass);
   // }
   m_gpu->cmd_end();
+
+  if (m_should_collect_frame_stats) {
+    // The first frame doesn't have an interval.
+    if (m_last_frame_start) {
+      S64 times[e_frame_stat_count];
+      times[e_frame_stat_interval] = frame_start - m_last_frame_start;
+      times[e_frame_stat_cpu] = mono_time_now() - frame_start;
+      times[e_frame_stat_acquire] = m_gpu->m_frame_times.acquire;
+      times[e_frame_stat_fence_wait] = m_gpu->m_frame_times.fence_wait;
+      times[e_frame_stat_cmd_end] = m_gpu->m_frame_times.cmd_end;
+      m_frame_stats.add_frame(times);
+    }
+    m_last_frame_start = frame_start;
+  }
 }
 
 void Eins_window_t::on_mouse_event(E_mouse mouse, int x, int y, bool is_down) {
@@ -746,26 +776,138 @@ void Eins_window_t::on_resized() {
   }
 }
 
-void Eins_window_t::create_texture_and_srv_(Texture_t** texture, Resource_t* srv, const Path_t& path, Resources_set_t* set, int binding, E_format srv_format) {
-  Linear_allocator_t<> temp_allocator("texture_temp_allocator");
-  M_scope_exit(temp_allocator.destroy());
-  Dds_loader_t dds(&temp_allocator);
-  dds.init(path);
+bool Eins_window_t::create_texture_and_srv_(Texture_t** texture, Resource_t* srv, const Dds_loader_t& dds, Resources_set_t* set, int binding, E_format srv_format) {
   *texture = m_gpu->create_texture(&m_gpu_allocator, get_texture_create_info(dds));
+  if (!*texture) {
+    return false;
+  }
 
   Image_view_create_info_t image_view_ci = {};
   image_view_ci.texture = *texture;
   image_view_ci.format = srv_format;
   *srv = m_gpu->create_image_view(&m_gpu_allocator, image_view_ci);
   m_gpu->bind_resource_to_set(*srv, set, binding);
+  return true;
+}
+
+Task_t<> Eins_window_t::load_textures_async_(Allocator_t* task_allocator, Linear_allocator_t<>* temp_allocator) {
+  // The 4 PBR textures then the 6 cube faces.
+  Path_t paths[10] = {
+    g_exe_dir.join(M_txt("assets/basecolor.dds")),
+    g_exe_dir.join(M_txt("assets/normal.dds")),
+    g_exe_dir.join(M_txt("assets/metallic.dds")),
+    g_exe_dir.join(M_txt("assets/roughness.dds")),
+    g_exe_dir.join(M_txt("assets/posx.dds")),
+    g_exe_dir.join(M_txt("assets/negx.dds")),
+    g_exe_dir.join(M_txt("assets/posy.dds")),
+    g_exe_dir.join(M_txt("assets/negy.dds")),
+    g_exe_dir.join(M_txt("assets/posz.dds")),
+    g_exe_dir.join(M_txt("assets/negz.dds")),
+  };
+  // Each texture has its own allocator because they are loaded on different threads.
+  Linear_allocator_t<> dds_allocators[10] = {
+    "pbr_texture_allocator",
+    "pbr_texture_allocator",
+    "pbr_texture_allocator",
+    "pbr_texture_allocator",
+    "cube_face_allocator",
+    "cube_face_allocator",
+    "cube_face_allocator",
+    "cube_face_allocator",
+    "cube_face_allocator",
+    "cube_face_allocator",
+  };
+  M_scope_exit(for (auto& allocator : dds_allocators) { allocator.destroy(); });
+  Dds_loader_t ddses[10] = {
+    &dds_allocators[0],
+    &dds_allocators[1],
+    &dds_allocators[2],
+    &dds_allocators[3],
+    &dds_allocators[4],
+    &dds_allocators[5],
+    &dds_allocators[6],
+    &dds_allocators[7],
+    &dds_allocators[8],
+    &dds_allocators[9],
+  };
+  Task_t<bool> dds_tasks[10];
+  for (int i = 0; i < 10; ++i) {
+    dds_tasks[i] = load_dds_async_(task_allocator, &ddses[i], paths[i].m_path);
+  }
+  co_await task_when_all(dds_tasks, 10);
+  for (int i = 0; i < 10; ++i) {
+    if (!dds_tasks[i].get_value()) {
+      M_logw("Can't load %s", paths[i].get_path8().m_path);
+      co_return;
+    }
+  }
+
+  // The GPU textures are created on this thread.
+  // The textures keep the formats of their files, metallic and roughness can be BC4 and normal can be BC5.
+  Texture_t** pbr_textures[] = {&m_albedo_texture, &m_normal_texture, &m_metallic_texture, &m_roughness_texture};
+  Resource_t* pbr_srvs[] = {&m_albedo_srv, &m_normal_srv, &m_metallic_srv, &m_roughness_srv};
+  for (int i = 0; i < 4; ++i) {
+    if (!create_texture_and_srv_(pbr_textures[i], pbr_srvs[i], ddses[i], m_pbr_srvs, i, ddses[i].m_format)) {
+      M_logw("Can't create the texture of %s", paths[i].get_path8().m_path);
+      co_return;
+    }
+  }
+  Dds_loader_t* faces = ddses + 4;
+
+  Scope_allocator_t<> scope_allocator(temp_allocator);
+  U32 dimension = faces[0].m_header->width;
+  E_format format = faces[0].m_format;
+  Texture_create_info_t ci = get_texture_create_info(faces[0]);
+  // The faces stay in the files, the table has the mips of each face.
+  U32 mip_count = faces[0].m_mip_count;
+  Texture_subresource_t* subresources = (Texture_subresource_t*)scope_allocator.alloc(6 * mip_count * sizeof(Texture_subresource_t));
+  for (int i = 0; i < 6; ++i) {
+    M_check(faces[i].m_header->width == faces[i].m_header->height);
+    M_check(dimension == faces[i].m_header->width);
+    M_check(format == faces[i].m_format);
+    M_check(mip_count == faces[i].m_mip_count);
+    memcpy(subresources + i * mip_count, faces[i].m_subresources.m_p, mip_count * sizeof(Texture_subresource_t));
+  }
+  ci.subresources = subresources;
+  ci.array_size = 6;
+  m_cube_texture = m_gpu->create_texture_cube(&m_gpu_allocator, ci);
+  if (!m_cube_texture) {
+    M_logw("Can't create the cube texture");
+    co_return;
+  }
+  Image_view_create_info_t cube_srv_ci = {};
+  cube_srv_ci.texture = m_cube_texture;
+  cube_srv_ci.format = format;
+  m_cube_srv = m_gpu->create_image_view(&m_gpu_allocator, cube_srv_ci);
+  m_gpu->bind_resource_to_set(m_cube_srv, m_cube_srvs, 0);
+  // The upload doesn't block the worker, the other jobs run while the GPU copies the faces.
+  co_await gpu_wait_for_upload_async(m_gpu, m_gpu->get_upload_fence_value());
 }
 
 int main(int argc, char** argv) {
   core_init(M_txt("eins.log"));
+  g_cl->register_flag(NULL, "--trace-frames", e_value_type_bool);
+  g_cl->register_flag(NULL, "--profile", e_value_type_bool);
+  g_cl->register_flag(NULL, "--frame-stats", e_value_type_bool);
+  // Number of frames between the logged statistics, 0 only logs the summary on exit.
+  g_cl->register_flag(NULL, "--frame-stats-window", e_value_type_string);
+  // Writes the times of each frame to eins_frame_stats.csv.
+  g_cl->register_flag(NULL, "--frame-stats-csv", e_value_type_bool);
   g_cl->parse(argc, argv);
+  log_set_levels_from_command_line();
+  sampling_profiler_start_from_command_line();
+  bool should_profile = g_cl->get_flag_value("--profile").get_bool();
+  if (should_profile) {
+    profiler_start();
+  }
   Eins_window_t w(M_txt("eins"), 1024, 768);
   w.init();
   w.os_loop();
+  w.destroy();
+  if (should_profile) {
+    Path_t trace_path = g_exe_dir.join(M_txt("eins_trace.json"));
+    profiler_stop(trace_path.m_path);
+  }
   core_destroy();
   return 0;
 }
@@ -29,7 +29,10 @@ struct PSInput {
 };
 
 float3 get_normal_from_map(PSInput input) {
-  float3 tangent_normal = g_normal_texture.Sample(g_sampler, input.uv).xyz * 2.0 - 1.0;
+  // Z is rebuilt from X and Y so the normal map can be BC5.
+  float3 tangent_normal;
+  tangent_normal.xy = g_normal_texture.Sample(g_sampler, input.uv).xy * 2.0 - 1.0;
+  tangent_normal.z = sqrt(saturate(1.0 - dot(tangent_normal.xy, tangent_normal.xy)));
 
   float3 q1 = ddx(input.world_pos);
   float3 q2 = ddy(input.world_pos);
@@ -0,0 +1,76 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/command_line.h"
+#include "core/core_init.h"
+#include "core/linear_allocator.h"
+#include "core/loader/bc.h"
+#include "core/loader/dds.h"
+#include "core/loader/png.h"
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/path.h"
+#include "core/path_utils.h"
+#include "core/sampling_profiler.h"
+#include "core/utils.h"
+
+// Reports the PSNR and the speed of every format and BC7 quality on an RGBA8 PNG:
+//   bc_sample --input assets/texture.png [--reference assets/texture.dds]
+// |reference| is the same texture compressed to BC7 by another encoder, its PSNR is logged next to ours.
+
+int main(int argc, char** argv) {
+  core_init(M_txt("bc_sample.log"));
+  M_scope_exit(core_destroy());
+  g_cl->register_flag(NULL, "--input", e_value_type_string);
+  g_cl->register_flag(NULL, "--reference", e_value_type_string);
+  g_cl->parse(argc, argv);
+  sampling_profiler_start_from_command_line();
+  const char* input_path = g_cl->get_flag_value("--input").m_const_string;
+  const char* reference_path = g_cl->get_flag_value("--reference").m_const_string;
+  M_check_log_return_val(input_path, 1, "Usage: bc_sample --input texture.png [--reference texture.dds]");
+
+  Linear_allocator_t<> allocator("bc_sample_allocator");
+  M_scope_exit(allocator.destroy());
+  Png_loader_t png;
+  M_check_log_return_val(png.init(&allocator, Path_t::from_char(input_path)), 1, "Can't load %s", input_path);
+  M_check_log_return_val(png.m_bit_depth == 8 && png.m_components_per_pixel == 4, 1, "%s isn't RGBA8", input_path);
+  U32 width = png.m_width;
+  U32 height = png.m_height;
+  U8* blocks = (U8*)allocator.alloc(bc_get_size(e_bc_format_bc7, width, height));
+  U8* decoded = (U8*)allocator.alloc((Sip)width * height * 4);
+
+  const struct {
+    const char* name;
+    E_bc_format format;
+    E_bc_quality quality;
+    int channel_count;
+  } c_cases[] = {
+    {"bc1", e_bc_format_bc1, e_bc_quality_normal, 3},
+    {"bc4", e_bc_format_bc4, e_bc_quality_normal, 1},
+    {"bc5", e_bc_format_bc5, e_bc_quality_normal, 2},
+    {"bc7 fastest", e_bc_format_bc7, e_bc_quality_fastest, 4},
+    {"bc7 fast", e_bc_format_bc7, e_bc_quality_fast, 4},
+    {"bc7 normal", e_bc_format_bc7, e_bc_quality_normal, 4},
+    {"bc7 slow", e_bc_format_bc7, e_bc_quality_slow, 4},
+  };
+  for (const auto& c : c_cases) {
+    S64 start = mono_time_now();
+    bc_encode(png.m_data, width, height, blocks, c.format, c.quality);
+    F64 seconds = mono_time_to_s(mono_time_now() - start);
+    bc_decode(blocks, width, height, decoded, c.format);
+    M_logi("%-12s %.2f dB, %.2f MPixel/s", c.name, bc_get_psnr(png.m_data, decoded, width, height, c.channel_count), width * height / max(seconds, 1e-9) / 1e6);
+  }
+
+  if (reference_path) {
+    Dds_loader_t dds(&allocator);
+    M_check_log_return_val(dds.init(Path_t::from_char(reference_path)), 1, "Can't load %s", reference_path);
+    M_scope_exit(dds.destroy());
+    M_check_log_return_val(dds.m_format == e_format_bc7_unorm && dds.m_header->width == width && dds.m_header->height == height, 1, "%s isn't a BC7 texture of the same size", reference_path);
+    bc_decode(dds.m_data, width, height, decoded, e_bc_format_bc7);
+    M_logi("%-12s %.2f dB", "reference", bc_get_psnr(png.m_data, decoded, width, height, 4));
+  }
+  return 0;
+}
@@ -4,14 +4,18 @@
 // Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
 //----------------------------------------------------------------------------//
 
+#include "core/command_line.h"
 #include "core/core_init.h"
 #include "core/linear_allocator.h"
 #include "core/loader/dae.h"
 #include "core/path.h"
 #include "core/path_utils.h"
+#include "core/sampling_profiler.h"
 
 int main(int argc, char** argv) {
   core_init(M_txt("dae_sample.log"));
+  g_cl->parse(argc, argv);
+  sampling_profiler_start_from_command_line();
   Linear_allocator_t<> allocator("allocator");
   Dae_loader_t dae(&allocator);
   dae.init(g_exe_dir.join(M_txt("assets/pirate.dae")));
@@ -12,11 +12,13 @@
 #include "core/gpu/gpu.h"
 #include "core/linear_allocator.h"
 #include "core/loader/ttf.h"
+#include "core/log.h"
 #include "core/math/mat4.h"
 #include "core/math/transform.h"
 #include "core/math/vec2.h"
 #include "core/path.h"
 #include "core/path_utils.h"
+#include "core/sampling_profiler.h"
 #include "core/utils.h"
 #include "core/window/window.h"
 
@@ -255,6 +257,8 @@ void Font_window_t::on_resized() {
 int main(int argc, char** argv) {
   core_init(M_txt("font_sample.log"));
   g_cl->parse(argc, argv);
+  log_set_levels_from_command_line();
+  sampling_profiler_start_from_command_line();
   {
     unsigned char screen[20][79];
     stbtt_fontinfo font;
@@ -0,0 +1,72 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/command_line.h"
+#include "core/core_init.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/sampling_profiler.h"
+#include "core/thread.h"
+#include "core/utils.h"
+
+#include <math.h>
+
+// Measures how job_parallel_for scales from 1 to N workers on a compute bound loop and on tiny jobs.
+static F64 g_sink_;
+
+static F64 compute_(int begin, int end) {
+  F64 sum = 0;
+  for (int i = begin; i < end; ++i) {
+    sum += sqrt((F64)i) * sin((F64)i);
+  }
+  return sum;
+}
+
+template <typename T>
+F64 time_func(T f) {
+  S64 t0 = mono_time_now();
+  f();
+  return mono_time_to_s(mono_time_now() - t0);
+}
+
+int main(int argc, const char** argv) {
+  core_init(M_txt("job_sample.log"));
+  g_cl->parse(argc, argv);
+  sampling_profiler_start_from_command_line();
+  const int c_max_worker_count = Thread_t::get_total_thread_count();
+  const int c_count = 1 << 24;
+  const int c_tiny_job_count = 1 << 20;
+  job_system_destroy();
+  F64 one_worker_time = 0;
+  for (int worker_count = 1;; worker_count = min(worker_count * 2, c_max_worker_count)) {
+    job_system_init(worker_count);
+    std::atomic<F64> sum{0};
+    F64 compute_time = time_func([&]() {
+      job_parallel_for(0, c_count, 1 << 14, [&](int begin, int end) {
+        F64 s = compute_(begin, end);
+        F64 old = sum.load();
+        while (!sum.compare_exchange_weak(old, old + s)) {
+        }
+      });
+    });
+    g_sink_ += sum;
+    if (worker_count == 1) {
+      one_worker_time = compute_time;
+    }
+    std::atomic<int> tiny_count{0};
+    F64 tiny_time = time_func([&]() {
+      job_parallel_for(0, c_tiny_job_count, 1, [&](int begin, int end) { tiny_count.fetch_add(end - begin, std::memory_order_relaxed); });
+    });
+    M_logi("%d workers: compute %f s (%.2fx), %d tiny jobs %f s (%f us/job)", worker_count, compute_time, one_worker_time / compute_time, c_tiny_job_count, tiny_time, tiny_time * 1e6 / c_tiny_job_count);
+    job_system_destroy();
+    if (worker_count == c_max_worker_count) {
+      break;
+    }
+  }
+  core_destroy();
+  return 0;
+}
@@ -4,6 +4,7 @@
 // Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
 //----------------------------------------------------------------------------//
 
+#include "core/command_line.h"
 #include "core/core_init.h"
 #include "core/dynamic_array.h"
 #include "core/linear_allocator.h"
@@ -11,6 +12,7 @@
 #include "core/mono_time.h"
 #include "core/path.h"
 #include "core/path_utils.h"
+#include "core/sampling_profiler.h"
 #include "core/utils.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -18,6 +20,8 @@
 
 int main(int argc, char** argv) {
   core_init(M_txt("gpu_sample.log"));
+  g_cl->parse(argc, argv);
+  sampling_profiler_start_from_command_line();
   Path_t paths[] = {
     g_exe_dir.join(M_txt("assets/posx.png")),
     g_exe_dir.join(M_txt("assets/negx.png")),
@@ -42,6 +46,15 @@ int main(int argc, char** argv) {
   }
   M_logi("%f s", mono_time_to_s(mono_time_now() - start) / count);
 
+  // The same images decoded on all the workers.
+  start = mono_time_now();
+  for (int c = 0; c < count; ++c) {
+    Scope_allocator_t<> scope_allocator(&png_temp_allocator);
+    Png_loader_t pngs[static_array_size(paths)];
+    png_decode_batch(&scope_allocator, paths, static_array_size(paths), pngs);
+  }
+  M_logi("%f s (batch)", mono_time_to_s(mono_time_now() - start) / count);
+
   start = mono_time_now();
   for (int c = 0; c < count; ++c) {
     int x,y,n;
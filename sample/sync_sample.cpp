@@ -0,0 +1,89 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/command_line.h"
+#include "core/core_init.h"
+#include "core/log.h"
+#include "core/mono_time.h"
+#include "core/os.h"
+#include "core/sampling_profiler.h"
+#include "core/sync.h"
+#include "core/thread.h"
+
+#if M_os_is_linux()
+#include <pthread.h>
+#elif M_os_is_win()
+#include <Windows.h>
+#endif
+
+// Compares Mutex_t with the OS mutex (pthread_mutex_t on Linux, SRWLOCK on Windows) with 1 to 8 threads
+// incrementing a shared counter in a short critical section.
+
+#define M_iteration_count_ 1000000
+#define M_max_thread_count_ 8
+
+struct Os_mutex_t_ {
+#if M_os_is_linux()
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  void lock() { pthread_mutex_lock(&mutex); }
+  void unlock() { pthread_mutex_unlock(&mutex); }
+#elif M_os_is_win()
+  SRWLOCK lock_ = SRWLOCK_INIT;
+  void lock() { AcquireSRWLockExclusive(&lock_); }
+  void unlock() { ReleaseSRWLockExclusive(&lock_); }
+#endif
+};
+
+template <typename T_mutex>
+struct Bench_t_ {
+  T_mutex mutex;
+  Event_t start_event{true};
+  int iteration_count;
+  U64 count = 0;
+};
+
+template <typename T_mutex>
+static void bench_thread_(void* args) {
+  Bench_t_<T_mutex>* bench = (Bench_t_<T_mutex>*)args;
+  bench->start_event.wait();
+  for (int i = 0; i < bench->iteration_count; ++i) {
+    bench->mutex.lock();
+    ++bench->count;
+    bench->mutex.unlock();
+  }
+}
+
+// Returns the time per lock/unlock pair in nanoseconds.
+template <typename T_mutex>
+static F64 bench_(int thread_count) {
+  Bench_t_<T_mutex> bench;
+  bench.iteration_count = M_iteration_count_ / thread_count;
+  Thread_t threads[M_max_thread_count_];
+  for (int i = 0; i < thread_count; ++i) {
+    threads[i].init(bench_thread_<T_mutex>, &bench);
+  }
+  S64 start = mono_time_now();
+  bench.start_event.set();
+  for (int i = 0; i < thread_count; ++i) {
+    threads[i].wait_for();
+  }
+  F64 elapsed_ms = mono_time_to_ms(mono_time_now() - start);
+  M_check(bench.count == (U64)bench.iteration_count * thread_count);
+  return elapsed_ms * 1e6 / (bench.iteration_count * thread_count);
+}
+
+int main(int argc, const char** argv) {
+  core_init(M_txt("sync_sample.log"));
+  g_cl->parse(argc, argv);
+  sampling_profiler_start_from_command_line();
+  for (int thread_count = 1; thread_count <= M_max_thread_count_; thread_count *= 2) {
+    F64 mutex_ns = bench_<Mutex_t>(thread_count);
+    F64 os_mutex_ns = bench_<Os_mutex_t_>(thread_count);
+    M_logi("%d threads: Mutex_t %.1f ns, OS mutex %.1f ns", thread_count, mutex_ns, os_mutex_ns);
+  }
+  core_destroy();
+  return 0;
+}
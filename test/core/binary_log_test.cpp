@@ -0,0 +1,54 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/binary_log.h"
+
+#include "test/test.h"
+
+template <typename... T_args>
+static Sip encode_(U8* payload, U32 id, S64 time, const T_args&... args) {
+  memcpy(payload, &id, sizeof(id));
+  memcpy(payload + sizeof(id), &time, sizeof(time));
+  U8* p = payload + sizeof(id) + sizeof(time);
+  ((p = write_binary_log_arg_(p, args)), ...);
+  return p - payload;
+}
+
+template <typename... T_args>
+static bool decode_equals_(const char* format, const char* expected, const T_args&... args) {
+  using T_arg_types = decltype(get_binary_log_arg_types_(args...));
+  U32 id = binary_log_register_("file", 1, format, T_arg_types::sc_types, T_arg_types::sc_sizes, T_arg_types::sc_count);
+  if (!id) {
+    return false;
+  }
+  U8 payload[256];
+  Sip payload_len = encode_(payload, id, 0, args...);
+  char out[256];
+  int len = binary_log_decode_(out, sizeof(out), payload, payload_len, "TRACE", 0);
+  // Skip the prefix.
+  const char* prefix = "file(1): TRACE: [0.000000] ";
+  Sip prefix_len = strlen(prefix);
+  return len > prefix_len && !strncmp(out, prefix, prefix_len) && !strcmp(out + prefix_len, expected);
+}
+
+void binary_log_test() {
+  M_test(decode_equals_("no args", "no args\n"));
+  M_test(decode_equals_("%d %u %x", "-1 4294967295 ff\n", -1, 0xffffffffu, (U8)255));
+  M_test(decode_equals_("%lld %zu", "-5000000000 7\n", (S64)-5000000000, (Sz)7));
+  // Integers are truncated to the size printf reads.
+  M_test(decode_equals_("%x %u %o", "ffffffff 4294967294 37777777775\n", -1, -2, -3));
+  M_test(decode_equals_("%hhx %hu %d", "ff 65535 -1\n", -1, (S16)-1, 0xffffffffu));
+  M_test(decode_equals_("%llx %x", "ffffffffffffffff 100000000\n", (S64)-1, (U64)1 << 32));
+  M_test(decode_equals_("%.2f|%4.1f|%c", "1.50| 2.5|x\n", 1.5f, 2.5, 'x'));
+  M_test(decode_equals_("[%s] [%-4s] [%s]", "[abc] [d   ] []\n", "abc", "d", (const char*)NULL));
+  M_test(decode_equals_("100%% %d%%", "100% 5%\n", 5));
+  M_test(decode_equals_("%p", "(nil)\n", (void*)NULL) || decode_equals_("%p", "0000000000000000\n", (void*)NULL));
+  // Mismatched conversions and argument counts are rejected.
+  using T_int_types = decltype(get_binary_log_arg_types_(1));
+  M_test(binary_log_register_("file", 1, "%s", T_int_types::sc_types, T_int_types::sc_sizes, T_int_types::sc_count) == 0);
+  M_test(binary_log_register_("file", 1, "%d %d", T_int_types::sc_types, T_int_types::sc_sizes, T_int_types::sc_count) == 0);
+  M_test(binary_log_register_("file", 1, "no args", T_int_types::sc_types, T_int_types::sc_sizes, T_int_types::sc_count) == 0);
+}
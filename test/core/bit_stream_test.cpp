@@ -4,10 +4,30 @@
 // Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
 //----------------------------------------------------------------------------//
 
-#include "core/loader/png.h"
+#include "core/bit_stream.h"
 
+#include "core/utils.h"
 #include "test/test.h"
 
+struct Bit_stream_parts_t_ {
+  const U8* data;
+  const int* part_lens;
+  int part_count;
+  int part_index;
+  int offset;
+};
+
+static bool get_next_part_(void* context, const U8** o_data, Sip* o_len) {
+  Bit_stream_parts_t_* parts = (Bit_stream_parts_t_*)context;
+  if (parts->part_index == parts->part_count) {
+    return false;
+  }
+  *o_data = parts->data + parts->offset;
+  *o_len = parts->part_lens[parts->part_index];
+  parts->offset += parts->part_lens[parts->part_index++];
+  return true;
+}
+
 void bit_stream_test() {
   {
     U8 data[5];
@@ -41,4 +61,68 @@ void bit_stream_test() {
     M_test(bs.consume_msb(16) == 0b1111100000111111);
     M_test(bs.consume_msb(9) == 0b110000000);
   }
+  {
+    // Crosses the refills of the 64-bit buffer, both the 8-byte loads and the byte by byte refills at the end.
+    U8 data[32];
+    for (int i = 0; i < 32; ++i) {
+      data[i] = i * 37 + 11;
+    }
+    Bit_stream_t bs(data, 32);
+    int bit_index = 0;
+    for (int bit_count = 1; bit_index + bit_count <= 32 * 8; bit_count = bit_count % 32 + 1) {
+      U64 expected = 0;
+      for (int i = 0; i < bit_count; ++i) {
+        int index = bit_index + i;
+        expected |= (U64)((data[index / 8] >> (index % 8)) & 1) << i;
+      }
+      M_test(bs.consume_lsb(bit_count) == expected);
+      bit_index += bit_count;
+      M_test(bs.get_consumed_byte_count() == (bit_index + 7) / 8);
+    }
+    M_test(!bs.is_overrun());
+    M_test(bs.consume_lsb(32 * 8 - bit_index) == (U32)(data[31] >> (8 - (32 * 8 - bit_index))));
+    M_test(!bs.is_overrun());
+    M_test(bs.consume_lsb(1) == 0);
+    M_test(bs.is_overrun());
+  }
+  {
+    U8 data[3] = {0b10100101, 0xAB, 0xCD};
+    Bit_stream_t bs(data, 3);
+    M_test(bs.consume_lsb(3) == 0b101);
+    bs.align_to_byte();
+    M_test(bs.get_consumed_byte_count() == 1);
+    M_test(bs.consume_lsb(16) == 0xCDAB);
+    M_test(!bs.is_overrun());
+  }
+  {
+    // The padding is read by the fast refill but it's still past the end.
+    U8 data[2 + Bit_stream_t::sc_padding] = {0x34, 0x12};
+    Bit_stream_t bs(data, 2, Bit_stream_t::sc_padding);
+    M_test(bs.consume_lsb(16) == 0x1234);
+    M_test(!bs.is_overrun());
+    M_test(bs.consume_lsb(8) == 0);
+    M_test(bs.is_overrun());
+  }
+  {
+    // The same bits split in parts, including empty parts and parts shorter than a refill.
+    U8 data[40];
+    for (int i = 0; i < 40; ++i) {
+      data[i] = i * 53 + 7;
+    }
+    const int c_part_lens[] = {3, 0, 1, 9, 8, 0, 2, 17};
+    Bit_stream_parts_t_ parts = {data, c_part_lens, (int)static_array_size(c_part_lens), 0, 0};
+    const U8* first;
+    Sip first_len;
+    get_next_part_(&parts, &first, &first_len);
+    Bit_stream_t bs(first, first_len, 0, get_next_part_, &parts);
+    Bit_stream_t expected_bs(data, 40);
+    bool is_same = true;
+    for (int bit_count = 1, bit_index = 0; bit_index + bit_count <= 40 * 8; bit_index += bit_count, bit_count = bit_count % 13 + 1) {
+      is_same &= bs.consume_lsb(bit_count) == expected_bs.consume_lsb(bit_count);
+    }
+    M_test(is_same);
+    M_test(!bs.is_overrun());
+    bs.consume_lsb(32);
+    M_test(bs.is_overrun());
+  }
 }
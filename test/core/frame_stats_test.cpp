@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/frame_stats.h"
+
+#include "core/free_list_allocator.h"
+#include "core/mono_time.h"
+#include "core/path_utils.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <math.h>
+#include <string.h>
+
+static bool is_near_(F64 a, F64 b) {
+  return fabs(a - b) < 0.001;
+}
+
+void frame_stats_test() {
+  Free_list_allocator_t allocator("frame_stats_test_allocator", 1024000);
+  allocator.init();
+  M_scope_exit(allocator.destroy());
+  const char* names[] = {"a", "b"};
+  Path_t csv_path = g_exe_dir.join(M_txt("frame_stats_test.csv"));
+  Frame_stats_t stats(&allocator);
+  M_test(stats.init(names, 2, 10, csv_path.m_path));
+  // Channel a is 1, 2, 3 ms and the window isn't full yet.
+  for (int i = 1; i <= 3; ++i) {
+    S64 times[2] = {mono_time_from_ms(i), mono_time_from_ms(5)};
+    stats.add_frame(times);
+  }
+  Frame_stat_summary_t s;
+  stats.get_window_summary(0, &s);
+  M_test(is_near_(s.min, 1.0) && is_near_(s.avg, 2.0) && is_near_(s.p50, 2.0) && is_near_(s.max, 3.0));
+  // Channel a is 1, 2, ..., 100 ms, channel b is always 5 ms.
+  for (int i = 4; i <= 100; ++i) {
+    S64 times[2] = {mono_time_from_ms(i), mono_time_from_ms(5)};
+    stats.add_frame(times);
+  }
+  M_test(stats.get_frame_count() == 100);
+  // Only the last 10 frames are in the window.
+  stats.get_window_summary(0, &s);
+  M_test(is_near_(s.min, 91.0));
+  M_test(is_near_(s.avg, 95.5));
+  M_test(is_near_(s.p50, 95.0));
+  M_test(is_near_(s.max, 100.0));
+  // The percentiles of the whole run are from the histogram.
+  stats.get_run_summary(0, &s);
+  M_test(is_near_(s.min, 1.0));
+  M_test(is_near_(s.avg, 50.5));
+  M_test(fabs(s.p50 - 50.0) < 50.0 / 64);
+  M_test(fabs(s.p99 - 99.0) < 99.0 / 64);
+  M_test(is_near_(s.max, 100.0));
+  stats.get_run_summary(1, &s);
+  M_test(is_near_(s.min, 5.0) && is_near_(s.p99, 5.0) && is_near_(s.max, 5.0));
+  stats.destroy();
+
+  Dynamic_array_t<U8> csv = File_t::read_whole_file_as_text(&allocator, csv_path.m_path);
+  const char* c_header = "frame,a_ms,b_ms\n0,1.0000,5.0000\n1,2.0000,5.0000\n";
+  M_test(csv.len() > (Sip)strlen(c_header) && memcmp(csv.m_p, c_header, strlen(c_header)) == 0);
+  csv.destroy();
+  File_t::delete_path(csv_path.m_path);
+}
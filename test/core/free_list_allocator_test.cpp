@@ -0,0 +1,125 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/free_list_allocator.h"
+
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+static bool is_filled_(const U8* p, Sip size, U8 value) {
+  for (Sip i = 0; i < size; ++i) {
+    if (p[i] != value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void free_list_allocator_test() {
+  // A freed block is reused and the blocks are merged again.
+  {
+    Free_list_allocator_t allocator("test", 4096);
+    allocator.init();
+    M_scope_exit(allocator.destroy());
+    U8* p1 = (U8*)allocator.alloc(64);
+    U8* p2 = (U8*)allocator.alloc(64);
+    memset(p2, 2, 64);
+    allocator.free(p1);
+    U8* p3 = (U8*)allocator.alloc(64);
+    M_test(p3 == p1);
+    M_test(is_filled_(p2, 64, 2));
+    allocator.free(p3);
+    allocator.free(p2);
+    M_test(allocator.m_used_size == 0);
+    // Only possible if the whole space is one block again.
+    void* p4 = allocator.alloc(3072);
+    M_test(p4);
+    allocator.free(p4);
+  }
+
+  // Sizes that aren't multiples of the alignment.
+  {
+    Free_list_allocator_t allocator("test", 4096);
+    allocator.init();
+    M_scope_exit(allocator.destroy());
+    U8* p1 = (U8*)allocator.alloc(3);
+    U8* p2 = (U8*)allocator.alloc(17);
+    M_test((Uip)p1 % 16 == 0 && (Uip)p2 % 16 == 0);
+    memset(p1, 1, 3);
+    memset(p2, 2, 17);
+    p1 = (U8*)allocator.realloc(p1, 5);
+    M_test(p1 && is_filled_(p1, 3, 1));
+    allocator.free(p2);
+    allocator.free(p1);
+    M_test(allocator.m_used_size == 0);
+  }
+
+  // realloc that has to move only copies the old allocation.
+  {
+    Free_list_allocator_t allocator("test", 4096);
+    allocator.init();
+    M_scope_exit(allocator.destroy());
+    U8* p1 = (U8*)allocator.alloc(64);
+    U8* p2 = (U8*)allocator.alloc(64);
+    memset(p1, 1, 64);
+    memset(p2, 2, 64);
+    U8* p3 = (U8*)allocator.realloc(p1, 256);
+    M_test(p3 && p3 != p1);
+    M_test(is_filled_(p3, 64, 1));
+    M_test(is_filled_(p2, 64, 2));
+    allocator.free(p3);
+    allocator.free(p2);
+    M_test(allocator.m_used_size == 0);
+  }
+
+  // Random allocs, reallocs and frees, each allocation is filled with its own value.
+  {
+    Free_list_allocator_t allocator("test", 256 * 1024);
+    allocator.init();
+    M_scope_exit(allocator.destroy());
+    const int c_slot_count = 64;
+    U8* slots[c_slot_count] = {};
+    Sip sizes[c_slot_count] = {};
+    U32 random_state = 1;
+    bool is_ok = true;
+    for (int i = 0; i < 20000; ++i) {
+      random_state = random_state * 1664525 + 1013904223;
+      int slot = (random_state >> 8) % c_slot_count;
+      Sip size = (random_state >> 16) % 600 + 1;
+      if (slots[slot]) {
+        is_ok &= is_filled_(slots[slot], sizes[slot], slot);
+      }
+      if (!slots[slot]) {
+        slots[slot] = (U8*)allocator.alloc(size);
+      } else if (random_state & 1) {
+        slots[slot] = (U8*)allocator.realloc(slots[slot], size);
+        is_ok &= slots[slot] && is_filled_(slots[slot], min(size, sizes[slot]), slot);
+      } else {
+        allocator.free(slots[slot]);
+        slots[slot] = NULL;
+        continue;
+      }
+      is_ok &= slots[slot] && (Uip)slots[slot] % 16 == 0;
+      if (!slots[slot]) {
+        break;
+      }
+      sizes[slot] = size;
+      memset(slots[slot], slot, size);
+    }
+    M_test(is_ok);
+    for (U8* p : slots) {
+      if (p) {
+        allocator.free(p);
+      }
+    }
+    M_test(allocator.m_used_size == 0);
+    void* p = allocator.alloc(200 * 1024);
+    M_test(p);
+    allocator.free(p);
+  }
+}
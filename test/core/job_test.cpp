@@ -0,0 +1,163 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/job.h"
+
+#include "core/core_allocators.h"
+#include "core/thread.h"
+#include "test/test.h"
+
+struct Job_test_step_t_ {
+  std::atomic<int>* step;
+  int expected_step;
+  bool is_in_order;
+};
+
+static void increment_(void* args) {
+  ((std::atomic<int>*)args)->fetch_add(1, std::memory_order_relaxed);
+}
+
+static void check_step_(void* args) {
+  Job_test_step_t_* step = (Job_test_step_t_*)args;
+  step->is_in_order = step->step->fetch_add(1) == step->expected_step;
+}
+
+struct Job_test_thread_t_ {
+  Job_counter_t* counter;
+  std::atomic<bool> is_running;
+  std::atomic<bool> can_finish;
+};
+
+static void wait_to_finish_(void* args) {
+  Job_test_thread_t_* thread = (Job_test_thread_t_*)args;
+  thread->is_running = true;
+  while (!thread->can_finish) {
+    Thread_t::yield();
+  }
+}
+
+// Runs a job from a thread that isn't a worker.
+static void run_from_thread_(void* args) {
+  Job_test_thread_t_* thread = (Job_test_thread_t_*)args;
+  Job_decl_t job = {wait_to_finish_, thread};
+  job_run(&job, 1, thread->counter);
+}
+
+// Runs jobs that wait for other jobs.
+static void nested_(void* args) {
+  Job_counter_t counter;
+  Job_decl_t jobs[8];
+  for (int i = 0; i < 8; ++i) {
+    jobs[i] = {increment_, args};
+  }
+  job_run(jobs, 8, &counter);
+  job_wait(&counter);
+}
+
+void job_test() {
+  {
+    std::atomic<int> count{0};
+    Job_counter_t counter;
+    Job_decl_t jobs[100];
+    for (int i = 0; i < 100; ++i) {
+      jobs[i] = {increment_, &count};
+    }
+    job_run(jobs, 100, &counter);
+    job_wait(&counter);
+    M_test(count == 100);
+    M_test(counter.m_count == 0);
+  }
+  {
+    // first -> second -> third.
+    std::atomic<int> step{0};
+    Job_test_step_t_ steps[3] = {{&step, 0, false}, {&step, 1, false}, {&step, 2, false}};
+    Job_counter_t first;
+    Job_counter_t second;
+    Job_counter_t third;
+    Job_decl_t third_job = {check_step_, &steps[2]};
+    Job_decl_t second_job = {check_step_, &steps[1]};
+    Job_decl_t first_job = {check_step_, &steps[0]};
+    job_run(&third_job, 1, &third, &second);
+    job_run(&second_job, 1, &second, &first);
+    job_run(&first_job, 1, &first);
+    job_wait(&third);
+    M_test(steps[0].is_in_order && steps[1].is_in_order && steps[2].is_in_order);
+  }
+  {
+    // The jobs that wait for a counter run when a thread that isn't a worker finishes it.
+    std::atomic<int> count{0};
+    Job_counter_t counter;
+    Job_counter_t dependent;
+    Job_test_thread_t_ args = {&counter, {false}, {false}};
+    Thread_t thread;
+    M_test(thread.init(run_from_thread_, &args));
+    while (!args.is_running) {
+      Thread_t::yield();
+    }
+    Job_decl_t job = {increment_, &count};
+    job_run(&job, 1, &dependent, &counter);
+    args.can_finish = true;
+    job_wait(&dependent);
+    thread.wait_for();
+    M_test(count == 1);
+  }
+  {
+    std::atomic<int> count{0};
+    Job_counter_t counter;
+    Job_decl_t jobs[16];
+    for (int i = 0; i < 16; ++i) {
+      jobs[i] = {nested_, &count};
+    }
+    job_run(jobs, 16, &counter);
+    job_wait(&counter);
+    M_test(count == 16 * 8);
+  }
+  {
+    const int c_count = 100000;
+    static U8 s_visited[c_count];
+    memset(s_visited, 0, sizeof(s_visited));
+    std::atomic<int> max_range{0};
+    job_parallel_for(0, c_count, 1000, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        ++s_visited[i];
+      }
+      int range = end - begin;
+      int old = max_range.load();
+      while (range > old && !max_range.compare_exchange_weak(old, range)) {
+      }
+    });
+    bool is_visited_once = true;
+    for (int i = 0; i < c_count; ++i) {
+      is_visited_once &= s_visited[i] == 1;
+    }
+    M_test(is_visited_once);
+    M_test(max_range <= 1000);
+    // Empty range.
+    job_parallel_for(5, 5, 1, [&](int, int) { max_range = -1; });
+    M_test(max_range != -1);
+  }
+  {
+    // Restarting the job system frees its workers and doesn't take persistent memory.
+    int worker_count = job_get_worker_count();
+    Sip used_size = g_persistent_allocator->m_used_size;
+    for (int i = 1; i <= 3; ++i) {
+      job_system_destroy();
+      M_test(job_system_init(i));
+    }
+    M_test(g_persistent_allocator->m_used_size == used_size);
+    std::atomic<int> count{0};
+    Job_counter_t counter;
+    Job_decl_t jobs[8];
+    for (Job_decl_t& job : jobs) {
+      job = {increment_, &count};
+    }
+    job_run(jobs, 8, &counter);
+    job_wait(&counter);
+    M_test(count == 8);
+    job_system_destroy();
+    job_system_init(worker_count);
+  }
+}
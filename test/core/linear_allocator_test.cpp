@@ -131,6 +131,19 @@ void linear_allocator_test() {
     M_test(allocator.realloc(p2, 64) == p2);
     M_test(allocator.realloc(p2, 256) == p2);
   }
+  // destroy frees the pages and the allocator can be used again
+  {
+    Linear_allocator_t<128> allocator("test");
+    Sip used_size = allocator.m_used_size;
+    M_test(allocator.alloc(1024));
+    allocator.destroy();
+    M_test(allocator.m_used_size == used_size);
+    M_test(allocator.m_total_size == 128);
+    void* p = allocator.alloc(16);
+    M_test(p && (U8*)p < allocator.m_stack_page + 128);
+    M_test(allocator.alloc(1024));
+    allocator.destroy();
+  }
   // Scope_allocator_t
   {
     Linear_allocator_t<> allocator("test");
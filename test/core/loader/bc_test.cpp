@@ -0,0 +1,166 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/bc.h"
+
+#include "core/core_allocators.h"
+#include "core/dynamic_array.h"
+#include "core/file.h"
+#include "core/linear_allocator.h"
+#include "core/loader/dds.h"
+#include "core/path_utils.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+static U32 g_random_state_ = 1;
+
+static U8 next_random_() {
+  g_random_state_ = g_random_state_ * 1664525 + 1013904223;
+  return g_random_state_ >> 24;
+}
+
+// Gradients with a bit of noise, the right part has a varying alpha that stays opaque for BC1.
+static void create_image_(U8* dst, U32 width, U32 height) {
+  for (U32 y = 0; y < height; ++y) {
+    for (U32 x = 0; x < width; ++x) {
+      U8* p = dst + (y * width + x) * 4;
+      p[0] = x * 255 / width + (next_random_() >> 6);
+      p[1] = y * 255 / height + (next_random_() >> 6);
+      p[2] = (x + y) * 127 / (width + height) + (next_random_() >> 6);
+      p[3] = x < width / 2 ? 255 : 128 + y * 127 / height;
+    }
+  }
+}
+
+void loader_bc_test() {
+  {
+    // The SSE2 search and the jobs (160x128 is split among the workers) give the same blocks as the scalar code.
+    const U32 c_sizes[][2] = {{1, 1}, {5, 3}, {37, 19}, {160, 128}};
+    Dynamic_array_t<U8> src(g_persistent_allocator);
+    Dynamic_array_t<U8> dst(g_persistent_allocator);
+    Dynamic_array_t<U8> expected(g_persistent_allocator);
+    M_scope_exit(src.destroy());
+    M_scope_exit(dst.destroy());
+    M_scope_exit(expected.destroy());
+    for (E_bc_format format : {e_bc_format_bc1, e_bc_format_bc4, e_bc_format_bc5, e_bc_format_bc7}) {
+      for (E_bc_quality quality : {e_bc_quality_fastest, e_bc_quality_fast, e_bc_quality_normal}) {
+        bool is_same = true;
+        for (const auto& size : c_sizes) {
+          src.resize(size[0] * size[1] * 4);
+          create_image_(src.m_p, size[0], size[1]);
+          Sip dst_len = bc_get_size(format, size[0], size[1]);
+          // One more byte to check that it isn't written.
+          dst.resize(dst_len + 1);
+          expected.resize(dst_len);
+          dst[dst_len] = 0xcd;
+          is_same &= bc_encode(src.m_p, size[0], size[1], dst.m_p, format, quality);
+          is_same &= bc_encode_scalar(src.m_p, size[0], size[1], expected.m_p, format, quality);
+          is_same &= !memcmp(dst.m_p, expected.m_p, dst_len) && dst[dst_len] == 0xcd;
+        }
+        M_test(is_same);
+      }
+    }
+  }
+  {
+    const U32 c_width = 64;
+    const U32 c_height = 64;
+    Dynamic_array_t<U8> src(g_persistent_allocator);
+    Dynamic_array_t<U8> blocks(g_persistent_allocator);
+    Dynamic_array_t<U8> decoded(g_persistent_allocator);
+    M_scope_exit(src.destroy());
+    M_scope_exit(blocks.destroy());
+    M_scope_exit(decoded.destroy());
+    src.resize(c_width * c_height * 4);
+    decoded.resize(src.len());
+    blocks.resize(bc_get_size(e_bc_format_bc7, c_width, c_height));
+    create_image_(src.m_p, c_width, c_height);
+    // The minimum PSNR of each format on the noisy gradients, they are a few dB under what the encoder gets.
+    const struct {
+      E_bc_format format;
+      int channel_count;
+      double min_psnr;
+    } c_cases[] = {
+      {e_bc_format_bc1, 3, 35.0},
+      {e_bc_format_bc4, 1, 48.0},
+      {e_bc_format_bc5, 2, 48.0},
+      {e_bc_format_bc7, 4, 40.0},
+    };
+    for (const auto& c : c_cases) {
+      bc_encode(src.m_p, c_width, c_height, blocks.m_p, c.format, e_bc_quality_normal);
+      bc_decode(blocks.m_p, c_width, c_height, decoded.m_p, c.format);
+      M_test(bc_get_psnr(src.m_p, decoded.m_p, c_width, c_height, c.channel_count) > c.min_psnr);
+    }
+    // The mode search is better than mode 6 alone.
+    bc_encode(src.m_p, c_width, c_height, blocks.m_p, e_bc_format_bc7, e_bc_quality_fastest);
+    bc_decode(blocks.m_p, c_width, c_height, decoded.m_p, e_bc_format_bc7);
+    double fastest_psnr = bc_get_psnr(src.m_p, decoded.m_p, c_width, c_height, 4);
+    bc_encode(src.m_p, c_width, c_height, blocks.m_p, e_bc_format_bc7, e_bc_quality_normal);
+    bc_decode(blocks.m_p, c_width, c_height, decoded.m_p, e_bc_format_bc7);
+    M_test(bc_get_psnr(src.m_p, decoded.m_p, c_width, c_height, 4) > fastest_psnr);
+  }
+  {
+    // 2 values per channel are kept exactly by BC4 and BC5, transparent pixels of BC1 are black.
+    U8 src[4 * 4 * 4];
+    for (int i = 0; i < 16; ++i) {
+      src[i * 4] = i % 3 ? 17 : 230;
+      src[i * 4 + 1] = i % 2 ? 0 : 255;
+      src[i * 4 + 2] = 99;
+      src[i * 4 + 3] = i < 8 ? 255 : 0;
+    }
+    U8 block[16];
+    U8 decoded[4 * 4 * 4];
+    bc_encode(src, 4, 4, block, e_bc_format_bc5, e_bc_quality_normal);
+    bc_decode(block, 4, 4, decoded, e_bc_format_bc5);
+    M_test(bc_get_psnr(src, decoded, 4, 4, 2) == 99.0);
+    bc_encode(src, 4, 4, block, e_bc_format_bc1, e_bc_quality_normal);
+    bc_decode(block, 4, 4, decoded, e_bc_format_bc1);
+    M_test(decoded[7 * 4 + 3] == 255 && !memcmp(decoded + 8 * 4, "\0\0\0\0", 4) && decoded[15 * 4 + 3] == 0);
+  }
+  {
+    // Blocks of the modes that the encoder doesn't write, the pixels are from another decoder.
+    const U8 c_mode1_block[] = {0x96, 0xe2, 0x94, 0x78, 0xbd, 0x71, 0x43, 0x1c, 0x1f, 0xc3, 0x5d, 0xaa, 0x61, 0xd7, 0x05, 0xd9};
+    const U8 c_mode4_block[] = {0xd0, 0xe2, 0x2b, 0x6a, 0x6e, 0x26, 0xf9, 0xd2, 0x8b, 0xf4, 0x15, 0xdb, 0xda, 0x15, 0x6e, 0x15};
+    const U8 c_mode1_pixels[][4] = {{113, 154, 168, 255}, {48, 199, 196, 255}, {120, 64, 193, 255}, {87, 57, 225, 255}};
+    const U8 c_mode4_pixels[][4] = {{83, 101, 88, 105}, {188, 82, 150, 142}, {16, 101, 49, 82}, {16, 73, 49, 82}};
+    U8 decoded[16][4];
+    bc_decode(c_mode1_block, 4, 4, decoded[0], e_bc_format_bc7);
+    bool is_same = true;
+    for (int i = 0; i < 4; ++i) {
+      is_same &= !memcmp(decoded[i * 5], c_mode1_pixels[i], 4);
+    }
+    bc_decode(c_mode4_block, 4, 4, decoded[0], e_bc_format_bc7);
+    for (int i = 0; i < 4; ++i) {
+      is_same &= !memcmp(decoded[i * 5], c_mode4_pixels[i], 4);
+    }
+    M_test(is_same);
+  }
+  {
+    // A BC7 file with its mips is read back by Dds_loader_t.
+    Linear_allocator_t<> allocator("bc_test_allocator");
+    M_scope_exit(allocator.destroy());
+    const Sip c_level_sizes[] = {bc_get_size(e_bc_format_bc7, 20, 8), bc_get_size(e_bc_format_bc7, 10, 4), bc_get_size(e_bc_format_bc7, 5, 2), 16, 16};
+    Sip data_len = 0;
+    for (Sip size : c_level_sizes) {
+      data_len += size;
+    }
+    U8* data = (U8*)allocator.alloc(data_len);
+    for (Sip i = 0; i < data_len; ++i) {
+      data[i] = next_random_();
+    }
+    Path_t path = g_exe_dir.join(M_txt("bc_test.dds"));
+    M_test(dds_write(path.m_path, e_dxgi_format_bc7_unorm, 20, 8, 5, data, data_len));
+    Dds_loader_t dds(&allocator);
+    M_test(dds.init(path));
+    M_test(dds.m_mip_count == 5 && dds.m_array_size == 1 && dds.m_header->width == 20 && dds.m_header->height == 8);
+    M_test(dds.m_subresources[4].data + 16 == dds.m_file_data.end() && !memcmp(dds.m_data, data, data_len));
+    dds.destroy();
+    File_t::delete_path(path.m_path);
+  }
+  M_test(bc_get_size(e_bc_format_bc1, 5, 3) == 16);
+  M_test(bc_get_size(e_bc_format_bc7, 5, 3) == 32);
+}
@@ -0,0 +1,112 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/dds.h"
+
+#include "core/linear_allocator.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+// A texture of 20x8 with 5 mips (20x8, 10x4, 5x2, 2x1, 1x1) and 2 slices, |data_len| can be shorter to truncate it.
+static Dynamic_array_t<U8> create_dds_(Allocator_t* allocator, Sip data_len, E_dxgi_format format = e_dxgi_format_bc7_unorm) {
+  Dds_header_t header = {};
+  header.size = sizeof(Dds_header_t);
+  header.flags = 0x20000;
+  header.width = 20;
+  header.height = 8;
+  header.mip_map_count = 5;
+  header.pixel_format.four_cc = four_cc("DX10");
+  Dds_header_dxt10_t header10 = {};
+  header10.dxgi_format = format;
+  header10.resource_dimension = e_d3d10_resource_dimension_texture2d;
+  header10.array_size = 2;
+  U32 magic_num = 0x20534444;
+  Dynamic_array_t<U8> file_data(allocator);
+  file_data.append_array((const U8*)&magic_num, sizeof(magic_num));
+  file_data.append_array((const U8*)&header, sizeof(header));
+  file_data.append_array((const U8*)&header10, sizeof(header10));
+  for (Sip i = 0; i < data_len; ++i) {
+    file_data.append((U8)i);
+  }
+  return file_data;
+}
+
+void loader_dds_test() {
+  Linear_allocator_t<> allocator("dds_test_allocator");
+  M_scope_exit(allocator.destroy());
+  const U32 c_widths[] = {20, 10, 5, 2, 1};
+  const U32 c_heights[] = {8, 4, 2, 1, 1};
+  const U32 c_row_pitches[] = {80, 48, 32, 16, 16};
+  const U32 c_row_counts[] = {2, 1, 1, 1, 1};
+  const Sip c_slice_size = 160 + 48 + 32 + 16 + 16;
+  {
+    Dds_loader_t dds(&allocator);
+    M_test(dds.init(create_dds_(&allocator, 2 * c_slice_size)));
+    M_test(dds.m_format == e_format_bc7_unorm);
+    M_test(dds.m_mip_count == 5);
+    M_test(dds.m_array_size == 2);
+    M_test(!dds.m_is_cube);
+    M_test(dds.m_subresources.len() == 10);
+    const U8* p = dds.m_data;
+    for (int i = 0; i < 10; ++i) {
+      const Texture_subresource_t& subresource = dds.m_subresources[i];
+      int mip = i % 5;
+      M_test(subresource.data == p);
+      M_test(subresource.width == c_widths[mip]);
+      M_test(subresource.height == c_heights[mip]);
+      M_test(subresource.row_pitch == c_row_pitches[mip]);
+      M_test(subresource.row_count == c_row_counts[mip]);
+      p += subresource.row_pitch * subresource.row_count;
+    }
+    M_test(p == dds.m_file_data.end());
+    // The second slice starts after all the mips of the first one.
+    M_test(dds.m_subresources[5].data - dds.m_data == c_slice_size);
+    dds.destroy();
+  }
+  {
+    Dds_loader_t dds(&allocator);
+    M_test(!dds.init(create_dds_(&allocator, 2 * c_slice_size - 1)));
+    dds.destroy();
+  }
+  {
+    // The file ends inside the DX10 header.
+    Dds_loader_t dds(&allocator);
+    Dynamic_array_t<U8> file_data = create_dds_(&allocator, 0);
+    file_data.resize(file_data.len() - 1);
+    M_test(!dds.init(file_data));
+    dds.destroy();
+  }
+  {
+    // The pitch of the top level and the size of a slice of the other formats.
+    const struct {
+      E_dxgi_format dxgi_format;
+      E_format format;
+      U32 row_pitch;
+      U32 row_count;
+      Sip slice_size;
+    } c_formats[] = {
+      {e_dxgi_format_bc1_unorm, e_format_bc1_unorm, 40, 2, 80 + 24 + 16 + 8 + 8},
+      {e_dxgi_format_bc3_unorm, e_format_bc3_unorm, 80, 2, c_slice_size},
+      {e_dxgi_format_bc4_unorm, e_format_bc4_unorm, 40, 2, 80 + 24 + 16 + 8 + 8},
+      {e_dxgi_format_bc5_unorm, e_format_bc5_unorm, 80, 2, c_slice_size},
+      {e_dxgi_format_bc6h_uf16, e_format_bc6h_ufloat, 80, 2, c_slice_size},
+      {e_dxgi_format_r8g8_unorm, e_format_r8g8_unorm, 40, 8, (160 + 40 + 10 + 2 + 1) * 2},
+      {e_dxgi_format_r11g11b10_float, e_format_r11g11b10_float, 80, 8, (160 + 40 + 10 + 2 + 1) * 4},
+      {e_dxgi_format_r16g16b16a16_float, e_format_r16g16b16a16_float, 160, 8, (160 + 40 + 10 + 2 + 1) * 8},
+    };
+    for (const auto& f : c_formats) {
+      Dds_loader_t dds(&allocator);
+      M_test(dds.init(create_dds_(&allocator, 2 * f.slice_size, f.dxgi_format)));
+      M_test(dds.m_format == f.format);
+      M_test(dds.m_subresources[0].row_pitch == f.row_pitch && dds.m_subresources[0].row_count == f.row_count);
+      M_test(dds.m_subresources[5].data - dds.m_data == f.slice_size);
+      M_test(dds.m_subresources[9].data + dds.m_subresources[9].row_pitch * dds.m_subresources[9].row_count == dds.m_file_data.end());
+      dds.destroy();
+    }
+  }
+}
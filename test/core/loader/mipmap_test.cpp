@@ -0,0 +1,105 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/mipmap.h"
+
+#include "core/core_allocators.h"
+#include "core/dynamic_array.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+static U32 g_random_state_ = 1;
+
+static U8 next_random_() {
+  g_random_state_ = g_random_state_ * 1664525 + 1013904223;
+  return g_random_state_ >> 24;
+}
+
+void loader_mipmap_test() {
+  {
+    // The SIMD kernels and the jobs (800x400 is split among the workers) give the same result as the scalar code.
+    const U32 c_sizes[][2] = {{1, 1}, {2, 2}, {5, 3}, {37, 19}, {64, 1}, {1, 64}, {130, 66}, {800, 400}};
+    Dynamic_array_t<U8> src(g_persistent_allocator);
+    Dynamic_array_t<U8> dst(g_persistent_allocator);
+    Dynamic_array_t<U8> expected(g_persistent_allocator);
+    M_scope_exit(src.destroy());
+    M_scope_exit(dst.destroy());
+    M_scope_exit(expected.destroy());
+    for (E_format format : {e_format_r8g8b8a8_unorm, e_format_r16g16b16a16_unorm}) {
+      int bytes_per_pixel = format == e_format_r8g8b8a8_unorm ? 4 : 8;
+      for (E_mip_filter filter : {e_mip_filter_box, e_mip_filter_kaiser}) {
+        for (int is_srgb = 0; is_srgb < 2; ++is_srgb) {
+          bool is_same = true;
+          for (const auto& size : c_sizes) {
+            src.resize(size[0] * size[1] * bytes_per_pixel);
+            for (Sip i = 0; i < src.len(); ++i) {
+              src[i] = next_random_();
+            }
+            Sip dst_len = max(size[0] / 2, 1u) * max(size[1] / 2, 1u) * bytes_per_pixel;
+            // One more byte to check that it isn't written.
+            dst.resize(dst_len + 1);
+            expected.resize(dst_len);
+            dst[dst_len] = 0xcd;
+            is_same &= mip_downsample(src.m_p, size[0], size[1], dst.m_p, format, filter, is_srgb);
+            is_same &= mip_downsample_scalar(src.m_p, size[0], size[1], expected.m_p, format, filter, is_srgb);
+            is_same &= !memcmp(dst.m_p, expected.m_p, dst_len) && dst[dst_len] == 0xcd;
+          }
+          M_test(is_same);
+        }
+      }
+    }
+    M_test(!mip_downsample(src.m_p, 2, 2, dst.m_p, e_format_r8_unorm, e_mip_filter_box, false));
+  }
+  {
+    const U8 c_src[] = {
+      0, 10, 255, 0,   1, 20, 0, 255,
+      2, 30, 0, 255,   3, 40, 255, 0,
+    };
+    U8 dst[4];
+    mip_downsample(c_src, 2, 2, dst, e_format_r8g8b8a8_unorm, e_mip_filter_box, false);
+    M_test(dst[0] == 2 && dst[1] == 25 && dst[2] == 128 && dst[3] == 128);
+    // Half black and half white is 0.5 in linear space, which is 188 in sRGB. Alpha is linear.
+    mip_downsample(c_src, 2, 2, dst, e_format_r8g8b8a8_unorm, e_mip_filter_box, true);
+    M_test(dst[2] == 188 && dst[3] == 128);
+  }
+  {
+    // The weights of the Kaiser filter add up to 1 so a flat image stays flat.
+    U8 src[16 * 16 * 4];
+    U8 dst[8 * 8 * 4];
+    memset(src, 77, sizeof(src));
+    mip_downsample(src, 16, 16, dst, e_format_r8g8b8a8_unorm, e_mip_filter_kaiser, false);
+    bool is_flat = true;
+    for (U8 v : dst) {
+      is_flat &= v == 77;
+    }
+    M_test(is_flat);
+  }
+  {
+    U8 src[5 * 3 * 4] = {};
+    Mip_chain_create_info_t ci = {};
+    ci.data = src;
+    ci.width = 5;
+    ci.height = 3;
+    ci.format = e_format_r8g8b8a8_unorm;
+    ci.filter = e_mip_filter_box;
+    Mip_chain_t mips;
+    M_test(mips.init(g_persistent_allocator, ci));
+    M_test(mips.m_mip_count == 3);
+    M_test(mips.m_subresources[0].data == src);
+    M_test(mips.m_subresources[1].width == 2 && mips.m_subresources[1].height == 1 && mips.m_subresources[1].row_pitch == 8);
+    M_test(mips.m_subresources[2].width == 1 && mips.m_subresources[2].height == 1 && mips.m_subresources[2].data == mips.m_subresources[1].data + 8);
+    mips.destroy();
+    ci.max_mip_count = 2;
+    M_test(mips.init(g_persistent_allocator, ci));
+    M_test(mips.m_mip_count == 2);
+    mips.destroy();
+  }
+  M_test(mip_get_full_count(1, 1) == 1);
+  M_test(mip_get_full_count(256, 4) == 9);
+  M_test(mip_get_full_count(5, 3) == 3);
+}
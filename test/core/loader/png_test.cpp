@@ -0,0 +1,500 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/png.h"
+
+#include "core/dynamic_array.h"
+#include "core/file.h"
+#include "core/job.h"
+#include "core/linear_allocator.h"
+#include "core/loader/png_unfilter.h"
+#include "core/path_utils.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+enum E_png_test_block_ {
+  e_png_test_block_stored,
+  e_png_test_block_fixed,
+  e_png_test_block_dynamic,
+  // The blocks cycle through the three types.
+  e_png_test_block_mixed,
+};
+
+struct Png_test_image_t_ {
+  int width;
+  int height;
+  U8 bit_depth;
+  U8 color_type;
+};
+
+// A literal if |len| is 0.
+struct Png_test_token_t_ {
+  int len;
+  int dist_or_literal;
+};
+
+struct Png_test_code_t_ {
+  U8 lit_lens[288];
+  U16 lit_codes[288];
+  U8 dist_lens[30];
+  U16 dist_codes[30];
+};
+
+struct Png_test_bit_writer_t_ {
+  Dynamic_array_t<U8>* out;
+  U32 bits;
+  int count;
+};
+
+static const int gc_len_bases_[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int gc_len_extra_bits_[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int gc_dist_bases_[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                     193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int gc_dist_extra_bits_[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static U32 g_random_state_ = 1;
+
+static U8 next_random_() {
+  g_random_state_ = g_random_state_ * 1664525 + 1013904223;
+  return g_random_state_ >> 24;
+}
+
+static int get_channel_count_(U8 color_type) {
+  return color_type == 0 ? 1 : color_type == 2 ? 3 : 4;
+}
+
+static void write_bits_(Png_test_bit_writer_t_* w, U32 value, int count) {
+  w->bits |= value << w->count;
+  w->count += count;
+  while (w->count >= 8) {
+    w->out->append(w->bits & 0xff);
+    w->bits >>= 8;
+    w->count -= 8;
+  }
+}
+
+// Huffman codes are written from their most significant bit.
+static void write_code_(Png_test_bit_writer_t_* w, U16 code, int len) {
+  U32 reversed = 0;
+  for (int i = 0; i < len; ++i) {
+    reversed |= ((code >> i) & 1) << (len - 1 - i);
+  }
+  write_bits_(w, reversed, len);
+}
+
+static void align_bits_(Png_test_bit_writer_t_* w) {
+  if (w->count) {
+    write_bits_(w, 0, 8 - w->count);
+  }
+}
+
+// The canonical codes of the code lengths.
+static void get_codes_(const U8* lens, int count, U16* o_codes) {
+  int len_counts[16] = {};
+  for (int i = 0; i < count; ++i) {
+    ++len_counts[lens[i]];
+  }
+  len_counts[0] = 0;
+  int next_codes[16] = {};
+  int code = 0;
+  for (int len = 1; len < 16; ++len) {
+    code = (code + len_counts[len - 1]) << 1;
+    next_codes[len] = code;
+  }
+  for (int i = 0; i < count; ++i) {
+    if (lens[i]) {
+      o_codes[i] = next_codes[lens[i]]++;
+    }
+  }
+}
+
+static void write_token_(Png_test_bit_writer_t_* w, const Png_test_code_t_& code, const Png_test_token_t_& token) {
+  if (!token.len) {
+    write_code_(w, code.lit_codes[token.dist_or_literal], code.lit_lens[token.dist_or_literal]);
+    return;
+  }
+  int l = static_array_size(gc_len_bases_) - 1;
+  while (gc_len_bases_[l] > token.len) {
+    --l;
+  }
+  write_code_(w, code.lit_codes[257 + l], code.lit_lens[257 + l]);
+  write_bits_(w, token.len - gc_len_bases_[l], gc_len_extra_bits_[l]);
+  int d = static_array_size(gc_dist_bases_) - 1;
+  while (gc_dist_bases_[d] > token.dist_or_literal) {
+    --d;
+  }
+  write_code_(w, code.dist_codes[d], code.dist_lens[d]);
+  write_bits_(w, token.dist_or_literal - gc_dist_bases_[d], gc_dist_extra_bits_[d]);
+}
+
+// Code lengths of a dynamic block, the runs are written with 16, 17 and 18. Every code length code has 5 bits.
+static void write_code_lens_(Png_test_bit_writer_t_* w, const U8* lens, int count) {
+  U8 cl_lens[19];
+  memset(cl_lens, 5, sizeof(cl_lens));
+  U16 cl_codes[19];
+  get_codes_(cl_lens, 19, cl_codes);
+  for (int i = 0; i < 19; ++i) {
+    write_bits_(w, 5, 3);
+  }
+  for (int i = 0; i < count;) {
+    int run = 1;
+    while (i + run < count && lens[i + run] == lens[i]) {
+      ++run;
+    }
+    if (!lens[i] && run >= 11) {
+      run = min(run, 138);
+      write_code_(w, cl_codes[18], 5);
+      write_bits_(w, run - 11, 7);
+    } else if (!lens[i] && run >= 3) {
+      run = min(run, 10);
+      write_code_(w, cl_codes[17], 5);
+      write_bits_(w, run - 3, 3);
+    } else {
+      write_code_(w, cl_codes[lens[i]], 5);
+      run = 1;
+      while (i + run < count && run < 7 && lens[i + run] == lens[i]) {
+        ++run;
+      }
+      if (run >= 4) {
+        write_code_(w, cl_codes[16], 5);
+        write_bits_(w, run - 4, 2);
+      } else {
+        run = 1;
+      }
+    }
+    i += run;
+  }
+}
+
+static int get_match_len_(const U8* data, Sip pos, Sip end, Sip dist) {
+  if (dist > pos || dist > 32768) {
+    return 0;
+  }
+  int len = 0;
+  while (pos + len < end && len < 258 && data[pos + len] == data[pos + len - dist]) {
+    ++len;
+  }
+  return len;
+}
+
+// Compresses |data| to a zlib stream with blocks of |block_size| bytes. The matches are only looked for at 1, 97 and |row_dist| bytes back.
+static void deflate_(Allocator_t* allocator, Dynamic_array_t<U8>* out, const U8* data, Sip len, E_png_test_block_ block, Sip block_size, Sip row_dist) {
+  Png_test_bit_writer_t_ w = {out, 0, 0};
+  out->append(0x78);
+  out->append(0x01);
+  Dynamic_array_t<Png_test_token_t_> tokens(allocator);
+  for (Sip start = 0, block_index = 0; start < len; start += block_size, ++block_index) {
+    Sip end = min(start + block_size, len);
+    E_png_test_block_ type = block == e_png_test_block_mixed ? (E_png_test_block_)(block_index % 3) : block;
+    write_bits_(&w, end == len, 1);
+    if (type == e_png_test_block_stored) {
+      write_bits_(&w, 0, 2);
+      align_bits_(&w);
+      write_bits_(&w, (U16)(end - start), 16);
+      write_bits_(&w, (U16)~(end - start), 16);
+      for (Sip i = start; i < end; ++i) {
+        write_bits_(&w, data[i], 8);
+      }
+      continue;
+    }
+    tokens.resize(0);
+    bool is_literal_used[256] = {};
+    for (Sip i = start; i < end;) {
+      const Sip c_dists[] = {1, 97, row_dist};
+      Png_test_token_t_ token = {0, data[i]};
+      for (Sip dist : c_dists) {
+        int match_len = get_match_len_(data, i, end, dist);
+        if (match_len >= 3 && match_len > token.len) {
+          token = {match_len, (int)dist};
+        }
+      }
+      if (!token.len) {
+        is_literal_used[data[i]] = true;
+      }
+      tokens.append(token);
+      i += token.len ? token.len : 1;
+    }
+    Png_test_code_t_ code = {};
+    if (type == e_png_test_block_fixed) {
+      write_bits_(&w, 1, 2);
+      for (int i = 0; i < 288; ++i) {
+        code.lit_lens[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+      }
+      memset(code.dist_lens, 5, sizeof(code.dist_lens));
+    } else {
+      write_bits_(&w, 2, 2);
+      // The unused literals have no code, half of the others are longer than the first level of the decode table.
+      for (int i = 0; i < 256; ++i) {
+        code.lit_lens[i] = is_literal_used[i] ? (i < 128 ? 9 : 11) : 0;
+      }
+      memset(code.lit_lens + 256, 6, 30);
+      memset(code.dist_lens, 5, sizeof(code.dist_lens));
+      write_bits_(&w, 286 - 257, 5);
+      write_bits_(&w, 30 - 1, 5);
+      write_bits_(&w, 19 - 4, 4);
+      U8 lens[286 + 30];
+      memcpy(lens, code.lit_lens, 286);
+      memcpy(lens + 286, code.dist_lens, 30);
+      write_code_lens_(&w, lens, static_array_size(lens));
+    }
+    get_codes_(code.lit_lens, 288, code.lit_codes);
+    get_codes_(code.dist_lens, 30, code.dist_codes);
+    for (const Png_test_token_t_& token : tokens) {
+      write_token_(&w, code, token);
+    }
+    write_code_(&w, code.lit_codes[256], code.lit_lens[256]);
+  }
+  align_bits_(&w);
+  U32 a = 1;
+  U32 b = 0;
+  for (Sip i = 0; i < len; ++i) {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  U32 adler = (b << 16) | a;
+  for (int i = 3; i >= 0; --i) {
+    out->append(adler >> (i * 8));
+  }
+  tokens.destroy();
+}
+
+static void append_be32_(Dynamic_array_t<U8>* out, U32 value) {
+  for (int i = 3; i >= 0; --i) {
+    out->append(value >> (i * 8));
+  }
+}
+
+// The CRCs aren't checked so they are 0.
+static void append_chunk_(Dynamic_array_t<U8>* out, const char* type, const U8* data, Sip len) {
+  append_be32_(out, len);
+  out->append_array((const U8*)type, 4);
+  if (len) {
+    out->append_array(data, len);
+  }
+  append_be32_(out, 0);
+}
+
+// |zlib| is split into IDAT chunks of |idat_size| bytes.
+static void make_png_(Dynamic_array_t<U8>* out, const Png_test_image_t_& image, const Dynamic_array_t<U8>& zlib, Sip idat_size) {
+  const U8 c_signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+  out->append_array(c_signature, 8);
+  U8 ihdr[13] = {};
+  for (int i = 0; i < 4; ++i) {
+    ihdr[i] = image.width >> ((3 - i) * 8);
+    ihdr[4 + i] = image.height >> ((3 - i) * 8);
+  }
+  ihdr[8] = image.bit_depth;
+  ihdr[9] = image.color_type;
+  append_chunk_(out, "IHDR", ihdr, sizeof(ihdr));
+  for (Sip i = 0; i < zlib.len(); i += idat_size) {
+    append_chunk_(out, "IDAT", zlib.m_p + i, min(idat_size, zlib.len() - i));
+  }
+  append_chunk_(out, "IEND", NULL, 0);
+}
+
+// Rows of random bytes with parts that repeat so there are matches, each row has another filter.
+static void make_filtered_rows_(Dynamic_array_t<U8>* o_filtered, const Png_test_image_t_& image, int row_count) {
+  int row_len = image.width * image.bit_depth / 8 * get_channel_count_(image.color_type);
+  U8 pattern[97];
+  for (U8& c : pattern) {
+    c = next_random_();
+  }
+  o_filtered->resize((Sip)(row_len + 1) * row_count);
+  U8* p = o_filtered->m_p;
+  for (int y = 0; y < row_count; ++y) {
+    *p++ = y % 5;
+    for (int j = 0; j < row_len; ++j) {
+      *p++ = j % 97 < 60 ? pattern[j % 97] : next_random_();
+    }
+  }
+}
+
+// The pixels that the decoder must write: unfiltered, 16-bit values swapped to little endian and RGB expanded to RGBA.
+static void get_expected_(Allocator_t* allocator, const Png_test_image_t_& image, const U8* filtered, U8* o_pixels) {
+  int channel_count = get_channel_count_(image.color_type);
+  int bytes_per_channel = image.bit_depth / 8;
+  int row_len = image.width * bytes_per_channel * channel_count;
+  int dst_channel_count = channel_count == 3 ? 4 : channel_count;
+  U8* rows = (U8*)allocator->alloc((Sip)row_len * image.height);
+  for (int y = 0; y < image.height; ++y) {
+    U8* row = rows + (Sip)y * row_len;
+    const U8* f = filtered + (Sip)y * (row_len + 1);
+    png_unfilter_row_scalar(f[0], bytes_per_channel * channel_count, f + 1, y ? row - row_len : NULL, row, row_len);
+    for (int x = 0; x < image.width; ++x) {
+      for (int c = 0; c < dst_channel_count; ++c) {
+        for (int b = 0; b < bytes_per_channel; ++b) {
+          *o_pixels++ = c < channel_count ? row[(x * channel_count + c) * bytes_per_channel + bytes_per_channel - 1 - b] : 0xff;
+        }
+      }
+    }
+  }
+}
+
+// Decodes |png| to a destination with a bigger pitch and checks the pixels and that the padding isn't written.
+static bool is_decoded_same_(Allocator_t* allocator, const Png_test_image_t_& image, const Dynamic_array_t<U8>& png, const Dynamic_array_t<U8>& filtered) {
+  Png_loader_t loader;
+  if (!loader.init_header(png.m_p, png.len())) {
+    return false;
+  }
+  Sip row_size = (Sip)image.width * loader.m_bytes_per_pixel;
+  Sip pitch = row_size + 16;
+  U8* expected = (U8*)allocator->alloc(row_size * image.height);
+  get_expected_(allocator, image, filtered.m_p, expected);
+  U8* dst = (U8*)allocator->alloc(pitch * image.height);
+  memset(dst, 0xcd, pitch * image.height);
+  if (!loader.decode(dst, pitch)) {
+    return false;
+  }
+  bool rv = true;
+  for (int y = 0; y < image.height; ++y) {
+    rv &= !memcmp(dst + y * pitch, expected + y * row_size, row_size);
+    for (Sip i = row_size; i < pitch; ++i) {
+      rv &= dst[y * pitch + i] == 0xcd;
+    }
+  }
+  return rv;
+}
+
+static bool is_pixels_same_(Allocator_t* allocator, const Png_test_image_t_& image, const Png_loader_t& png, const Dynamic_array_t<U8>& filtered) {
+  Sip size = (Sip)image.width * png.m_bytes_per_pixel * image.height;
+  U8* expected = (U8*)allocator->alloc(size);
+  get_expected_(allocator, image, filtered.m_p, expected);
+  return png.m_data && !memcmp(png.m_data, expected, size);
+}
+
+void loader_png_test() {
+  Linear_allocator_t<> allocator("png_test_allocator");
+  M_scope_exit(allocator.destroy());
+  {
+    // Every block type with IDAT chunks of 1 and 7 bytes so the blocks, the codes and the matches are cut by the chunks.
+    const Png_test_image_t_ c_images[] = {{37, 23, 8, 6}, {29, 17, 16, 2}, {41, 13, 8, 0}};
+    const Sip c_idat_sizes[] = {1, 7, 1 << 20};
+    for (const Png_test_image_t_& image : c_images) {
+      for (int block = e_png_test_block_stored; block <= e_png_test_block_mixed; ++block) {
+        bool is_same = true;
+        for (Sip idat_size : c_idat_sizes) {
+          Scope_allocator_t<> scope(&allocator);
+          Dynamic_array_t<U8> filtered(&scope);
+          make_filtered_rows_(&filtered, image, image.height);
+          Sip row_dist = filtered.len() / image.height;
+          Dynamic_array_t<U8> zlib(&scope);
+          deflate_(&scope, &zlib, filtered.m_p, filtered.len(), (E_png_test_block_)block, 300, row_dist);
+          Dynamic_array_t<U8> png(&scope);
+          make_png_(&png, image, zlib, idat_size);
+          is_same &= is_decoded_same_(&scope, image, png, filtered);
+        }
+        M_test(is_same);
+      }
+    }
+  }
+  {
+    // The rows are wider than the window.
+    const Png_test_image_t_ c_images[] = {{9000, 3, 8, 6}, {7000, 2, 16, 2}};
+    for (const Png_test_image_t_& image : c_images) {
+      Scope_allocator_t<> scope(&allocator);
+      Dynamic_array_t<U8> filtered(&scope);
+      make_filtered_rows_(&filtered, image, image.height);
+      Dynamic_array_t<U8> zlib(&scope);
+      deflate_(&scope, &zlib, filtered.m_p, filtered.len(), e_png_test_block_mixed, 20000, filtered.len() / image.height);
+      Dynamic_array_t<U8> png(&scope);
+      make_png_(&png, image, zlib, 1000);
+      M_test(is_decoded_same_(&scope, image, png, filtered));
+      // init() decodes to its own buffer.
+      Png_loader_t loader;
+      M_test(loader.init(&scope, png.m_p, png.len()));
+      M_test(is_pixels_same_(&scope, image, loader, filtered));
+      loader.destroy();
+    }
+  }
+  {
+    // Truncated data, too much data and a broken zlib header are errors.
+    const Png_test_image_t_ c_image = {37, 23, 8, 6};
+    Scope_allocator_t<> scope(&allocator);
+    U8* dst = (U8*)scope.alloc(37 * 4 * 24);
+    Dynamic_array_t<U8> filtered(&scope);
+    make_filtered_rows_(&filtered, c_image, c_image.height + 1);
+    Sip row_dist = filtered.len() / (c_image.height + 1);
+    for (int block = e_png_test_block_stored; block <= e_png_test_block_dynamic; ++block) {
+      Dynamic_array_t<U8> zlib(&scope);
+      deflate_(&scope, &zlib, filtered.m_p, filtered.len() - row_dist, (E_png_test_block_)block, 300, row_dist);
+      Dynamic_array_t<U8> png(&scope);
+      zlib.resize(zlib.len() / 2);
+      make_png_(&png, c_image, zlib, 7);
+      Png_loader_t loader;
+      M_test(loader.init_header(png.m_p, png.len()) && !loader.decode(dst, 37 * 4));
+
+      Dynamic_array_t<U8> long_zlib(&scope);
+      deflate_(&scope, &long_zlib, filtered.m_p, filtered.len(), (E_png_test_block_)block, 300, row_dist);
+      Dynamic_array_t<U8> long_png(&scope);
+      make_png_(&long_png, c_image, long_zlib, 7);
+      M_test(loader.init_header(long_png.m_p, long_png.len()) && !loader.decode(dst, 37 * 4));
+    }
+    Dynamic_array_t<U8> zlib(&scope);
+    deflate_(&scope, &zlib, filtered.m_p, filtered.len() - row_dist, e_png_test_block_fixed, 300, row_dist);
+    // A preset dictionary.
+    zlib[1] = 0x20;
+    Dynamic_array_t<U8> png(&scope);
+    make_png_(&png, c_image, zlib, 1 << 20);
+    Png_loader_t loader;
+    M_test(loader.init_header(png.m_p, png.len()) && !loader.decode(dst, 37 * 4));
+  }
+  {
+    // Big images are unfiltered by a job while they are inflated, it needs another worker.
+    int worker_count = job_get_worker_count();
+    if (worker_count == 1) {
+      job_system_destroy();
+      job_system_init(4);
+    }
+    const int c_image_count = 3;
+    const Png_test_image_t_ c_images[c_image_count] = {{600, 450, 8, 6}, {300, 300, 16, 2}, {37, 23, 8, 6}};
+    const Os_char* c_names[c_image_count + 1] = {M_txt("png_test_0.png"), M_txt("png_test_1.png"), M_txt("png_test_2.png"), M_txt("png_test_missing.png")};
+    Scope_allocator_t<> scope(&allocator);
+    Dynamic_array_t<U8> filtered[c_image_count] = {&scope, &scope, &scope};
+    Path_t paths[c_image_count + 1];
+    for (int i = 0; i <= c_image_count; ++i) {
+      paths[i] = g_exe_dir.join(c_names[i]);
+    }
+    for (int i = 0; i < c_image_count; ++i) {
+      const Png_test_image_t_& image = c_images[i];
+      make_filtered_rows_(&filtered[i], image, image.height);
+      Dynamic_array_t<U8> zlib(&scope);
+      deflate_(&scope, &zlib, filtered[i].m_p, filtered[i].len(), e_png_test_block_mixed, 50000, filtered[i].len() / image.height);
+      Dynamic_array_t<U8> png(&scope);
+      make_png_(&png, image, zlib, 8192);
+      M_test(is_decoded_same_(&scope, image, png, filtered[i]));
+      File_t f;
+      M_test(f.open(paths[i].m_path, e_file_mode_write));
+      Sip bytes_written = 0;
+      M_test(f.write(&bytes_written, png.m_p, png.len()));
+      f.close();
+    }
+    {
+      // init() with a path doesn't keep the file data that it freed.
+      Png_loader_t png;
+      M_test(png.init(&scope, paths[c_image_count - 1]));
+      M_test(is_pixels_same_(&scope, c_images[c_image_count - 1], png, filtered[c_image_count - 1]));
+      M_test(!png.m_file_data && !png.m_file_len);
+      png.destroy();
+    }
+    // The file that doesn't exist fails alone.
+    Png_loader_t pngs[c_image_count + 1];
+    M_test(!png_decode_batch(&scope, paths, c_image_count + 1, pngs));
+    for (int i = 0; i < c_image_count; ++i) {
+      M_test(is_pixels_same_(&scope, c_images[i], pngs[i], filtered[i]));
+      // The file data was freed.
+      M_test(!pngs[i].m_file_data && !pngs[i].m_file_len);
+      pngs[i].destroy();
+      File_t::delete_path(paths[i].m_path);
+    }
+    M_test(!pngs[c_image_count].m_data);
+    if (worker_count == 1) {
+      job_system_destroy();
+      job_system_init(worker_count);
+    }
+  }
+}
@@ -0,0 +1,157 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/png_unfilter.h"
+
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const int gc_max_row_len_ = 8 * 40;
+
+static int paeth_predictor_(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return a;
+  }
+  if (pb <= pc) {
+    return b;
+  }
+  return c;
+}
+
+// Straight from the spec, the bytes before the row and the row before the first row are 0.
+static void unfilter_reference_(U8 filter_type, int bpp, const U8* filtered, const U8* prior, U8* row, int len) {
+  for (int j = 0; j < len; ++j) {
+    int a = j >= bpp ? row[j - bpp] : 0;
+    int b = prior ? prior[j] : 0;
+    int c = prior && j >= bpp ? prior[j - bpp] : 0;
+    int predictor = 0;
+    switch (filter_type) {
+    case e_png_filter_sub:
+      predictor = a;
+      break;
+    case e_png_filter_up:
+      predictor = b;
+      break;
+    case e_png_filter_average:
+      predictor = (a + b) / 2;
+      break;
+    case e_png_filter_paeth:
+      predictor = paeth_predictor_(a, b, c);
+      break;
+    }
+    row[j] = filtered[j] + predictor;
+  }
+}
+
+static U32 g_random_state_ = 1;
+
+static U8 next_random_() {
+  g_random_state_ = g_random_state_ * 1664525 + 1013904223;
+  return g_random_state_ >> 24;
+}
+
+void loader_png_unfilter_test() {
+  const int c_bpps[] = {1, 2, 3, 4, 6, 8};
+  U8 filtered[gc_max_row_len_];
+  U8 prior[gc_max_row_len_];
+  U8 expected[gc_max_row_len_];
+  U8 row[gc_max_row_len_ + 1];
+  U8 scalar_row[gc_max_row_len_];
+  for (int bpp : c_bpps) {
+    for (U8 filter_type = e_png_filter_none; filter_type <= e_png_filter_paeth; ++filter_type) {
+      bool is_simd_same = true;
+      bool is_scalar_same = true;
+      // Pixel counts that cover the tails after the 16-byte blocks.
+      for (int pixel_count = 1; pixel_count * bpp <= gc_max_row_len_; ++pixel_count) {
+        int len = pixel_count * bpp;
+        for (int is_first_row = 0; is_first_row < 2; ++is_first_row) {
+          for (int j = 0; j < len; ++j) {
+            filtered[j] = next_random_();
+            prior[j] = next_random_();
+          }
+          const U8* p = is_first_row ? NULL : prior;
+          unfilter_reference_(filter_type, bpp, filtered, p, expected, len);
+          // Bytes after the row must not be touched.
+          memset(row, 0xcd, sizeof(row));
+          is_simd_same &= png_unfilter_row(filter_type, bpp, filtered, p, row, len);
+          is_simd_same &= !memcmp(row, expected, len) && row[len] == 0xcd;
+          is_scalar_same &= png_unfilter_row_scalar(filter_type, bpp, filtered, p, scalar_row, len);
+          is_scalar_same &= !memcmp(scalar_row, expected, len);
+        }
+      }
+      M_test(is_simd_same);
+      M_test(is_scalar_same);
+    }
+    M_test(!png_unfilter_row(5, bpp, filtered, prior, row, bpp));
+    M_test(!png_unfilter_row_scalar(5, bpp, filtered, prior, row, bpp));
+  }
+  {
+    // Every (a, b, c) of Paeth. The first pixel is the filtered byte plus c above it so it's set to a, the second pixel with b above it is the predictor.
+    bool is_same = true;
+    U8 paeth_filtered[16] = {};
+    U8 paeth_prior[16];
+    U8 paeth_row[16];
+    for (int a = 0; a < 256; ++a) {
+      for (int b = 0; b < 256; ++b) {
+        for (int c = 0; c < 256; c += 8) {
+          for (int k = 0; k < 8; ++k) {
+            paeth_prior[k] = c + k;
+            paeth_prior[8 + k] = b;
+            paeth_filtered[k] = a - (c + k);
+          }
+          png_unfilter_row(e_png_filter_paeth, 8, paeth_filtered, paeth_prior, paeth_row, 16);
+          for (int k = 0; k < 8; ++k) {
+            is_same &= paeth_row[8 + k] == paeth_predictor_(a, b, c + k);
+          }
+        }
+      }
+    }
+    M_test(is_same);
+  }
+  {
+    U8 data[2 * 40];
+    U8 swapped[2 * 40];
+    for (int count = 0; count <= 40; ++count) {
+      for (int j = 0; j < count * 2; ++j) {
+        data[j] = next_random_();
+      }
+      for (int j = 0; j < count * 2; ++j) {
+        swapped[j] = data[j ^ 1];
+      }
+      png_swap_16_bit(data, count);
+      M_test(!memcmp(data, swapped, count * 2));
+    }
+  }
+  {
+    U8 rgb[6 * 40];
+    U8 rgba[8 * 40 + 1];
+    U8 expected_rgba[8 * 40];
+    for (int bytes_per_component = 1; bytes_per_component <= 2; ++bytes_per_component) {
+      bool is_same = true;
+      for (int count = 0; count <= 40; ++count) {
+        for (int j = 0; j < count * 3 * bytes_per_component; ++j) {
+          rgb[j] = next_random_();
+        }
+        for (int j = 0; j < count; ++j) {
+          for (int k = 0; k < 4 * bytes_per_component; ++k) {
+            expected_rgba[j * 4 * bytes_per_component + k] = k < 3 * bytes_per_component ? rgb[j * 3 * bytes_per_component + k] : 0xff;
+          }
+        }
+        memset(rgba, 0xcd, sizeof(rgba));
+        png_expand_rgb_to_rgba(rgb, rgba, count, bytes_per_component);
+        is_same &= !memcmp(rgba, expected_rgba, count * 4 * bytes_per_component) && rgba[count * 4 * bytes_per_component] == 0xcd;
+      }
+      M_test(is_same);
+    }
+  }
+}
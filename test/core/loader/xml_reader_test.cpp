@@ -0,0 +1,159 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/loader/xml_reader.h"
+
+#include "core/dynamic_array.h"
+#include "core/linear_allocator.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void append_str_(Dynamic_array_t<char>* str, const Cstring_t& s) {
+  str->append_array(s.m_p, s.m_length);
+}
+
+// Writes the events as S:start A:name=value T:text E:end D and ! for an error.
+static void read_events_(Dynamic_array_t<char>* events, const char* xml, Sip window_size) {
+  Linear_allocator_t<> allocator("xml_reader_test_allocator");
+  M_scope_exit(allocator.destroy());
+  Xml_reader_t reader(&allocator, window_size);
+  M_scope_exit(reader.destroy());
+  reader.init(xml, strlen(xml));
+  while (true) {
+    E_xml_event event = reader.next();
+    char depth[16];
+    snprintf(depth, sizeof(depth), "%d", reader.m_depth);
+    switch (event) {
+    case e_xml_event_start_element:
+      append_str_(events, "S");
+      append_str_(events, depth);
+      append_str_(events, ":");
+      append_str_(events, reader.m_name);
+      break;
+    case e_xml_event_attribute:
+      append_str_(events, "A:");
+      append_str_(events, reader.m_name);
+      append_str_(events, "=");
+      append_str_(events, reader.m_value);
+      break;
+    case e_xml_event_text:
+      append_str_(events, "T:");
+      append_str_(events, reader.m_value);
+      // The strings are terminated.
+      M_test(reader.m_value.m_p[reader.m_value.m_length] == 0);
+      break;
+    case e_xml_event_end_element:
+      append_str_(events, "E");
+      append_str_(events, depth);
+      append_str_(events, ":");
+      append_str_(events, reader.m_name);
+      break;
+    case e_xml_event_end_document:
+      append_str_(events, "D");
+      break;
+    case e_xml_event_error:
+      append_str_(events, "!");
+      break;
+    }
+    if (event == e_xml_event_end_document || event == e_xml_event_error) {
+      break;
+    }
+    append_str_(events, " ");
+  }
+  events->append(0);
+}
+
+void loader_xml_reader_test() {
+  Linear_allocator_t<> test_allocator("xml_reader_test_allocator");
+  M_scope_exit(test_allocator.destroy());
+  {
+    // The tags and the comments are bigger than the small windows so they grow or drop the bytes that are skipped.
+    const char c_xml[] = R"(<?xml version="1.0"?>
+<!DOCTYPE root>
+<root a = 'x &amp;&lt; y' b="&#65;&#x42;">
+  <!-- <fake> a comment that is longer than the smallest window -->
+  <empty/>
+  <text>  1 &gt; 0 </text>
+  <cdata><![CDATA[<&amp;>]]></cdata>
+  <nested><child k="" /></nested >
+</root>
+)";
+    const char c_expected[] = "S1:root A:a=x &< y A:b=AB S2:empty E2:empty S2:text T:1 > 0  E2:text S2:cdata T:<&amp;> E2:cdata "
+                              "S2:nested S3:child A:k= E3:child E2:nested E1:root D";
+    const Sip c_window_sizes[] = {8, 16, 64, 4096};
+    for (Sip window_size : c_window_sizes) {
+      Dynamic_array_t<char> events(&test_allocator);
+      M_scope_exit(events.destroy());
+      read_events_(&events, c_xml, window_size);
+      M_test(!strcmp(events.m_p, c_expected));
+    }
+  }
+  {
+    // The numbers come in several text events that aren't cut in the middle of a number.
+    Dynamic_array_t<char> xml(&test_allocator);
+    M_scope_exit(xml.destroy());
+    append_str_(&xml, "<float_array count=\"1000\">");
+    char number[32];
+    for (int i = 0; i < 1000; ++i) {
+      snprintf(number, sizeof(number), i % 7 ? " %d.5" : "\n  %d.5", i);
+      append_str_(&xml, number);
+    }
+    append_str_(&xml, "</float_array>");
+    xml.append(0);
+
+    Xml_reader_t reader(&test_allocator, 256);
+    M_scope_exit(reader.destroy());
+    M_test(reader.init(xml.m_p, xml.len() - 1));
+    int text_count = 0;
+    int float_count = 0;
+    bool is_same = true;
+    E_xml_event event;
+    while ((event = reader.next()) != e_xml_event_end_document && event != e_xml_event_error) {
+      if (event != e_xml_event_text) {
+        continue;
+      }
+      ++text_count;
+      char* p = (char*)reader.m_value.m_p;
+      while (true) {
+        char* end;
+        float f = strtof(p, &end);
+        if (end == p) {
+          break;
+        }
+        is_same &= f == float_count + 0.5f;
+        ++float_count;
+        p = end;
+      }
+    }
+    M_test(event == e_xml_event_end_document);
+    M_test(text_count > 10);
+    M_test(float_count == 1000 && is_same);
+  }
+  {
+    const char* c_bad_xmls[] = {
+      "<a><b></a>",
+      "<a>",
+      "<a b=c/>",
+      "<a/><b/>",
+      "<a></a><b></b>",
+      "</a>",
+      "<a><!-- </a>",
+      "<a =\"b\"/>",
+      "<a b=\"c/>",
+      "",
+    };
+    for (const char* bad_xml : c_bad_xmls) {
+      Dynamic_array_t<char> events(&test_allocator);
+      M_scope_exit(events.destroy());
+      read_events_(&events, bad_xml, 16);
+      M_test(events.m_p[events.len() - 2] == '!');
+    }
+  }
+}
@@ -7,9 +7,13 @@
 #include "core/loader/xml.h"
 
 #include "core/linear_allocator.h"
+#include "core/loader/xml_scan.h"
 #include "core/utils.h"
 #include "test/test.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 const char g_xml_str_[] = R"(
 <?xml version="1.0"?>
 <catalog>
@@ -133,11 +137,150 @@ const char g_xml_str_[] = R"(
 </catalog>
 )";
 
+// Checks that the index gives the same results as walking the subtree for |node| and all its descendants.
+static bool is_index_same_(const Xml_index_t& index, const Xml_node_t* node) {
+  const char* c_tags[] = {"a", "b", "c", "d", "missing"};
+  bool rv = true;
+  for (const char* tag : c_tags) {
+    Linear_allocator_t<> allocator("xml_index_test_allocator");
+    M_scope_exit(allocator.destroy());
+    Xml_nodes_t expected(&allocator);
+    Xml_nodes_t nodes(&allocator);
+    node->find_all_by_tag(&expected, tag);
+    index.find_all_by_tag(&nodes, node, tag);
+    rv &= nodes.len() == expected.len() && (!nodes.len() || !memcmp(nodes.m_p, expected.m_p, nodes.len() * sizeof(Xml_node_t*)));
+    rv &= index.find_first_by_tag(node, tag) == node->find_first_by_tag(tag);
+    rv &= index.count_all_by_tag(node, tag) == node->count_all_by_tag(tag);
+  }
+  for (const Xml_node_t* child : node->m_children) {
+    rv &= child->m_parent == node;
+    rv &= is_index_same_(index, child);
+  }
+  return rv;
+}
+
 void loader_xml_test() {
   Linear_allocator_t<64 * 1024> allocator("xml_test_allocator");
-  Sip old_used_size = allocator.m_used_size;
-  Xml_t xml(&allocator);
-  xml.init(g_xml_str_, static_array_size(g_xml_str_));
-  xml.destroy();
-  M_test(old_used_size == allocator.m_used_size);
+  M_scope_exit(allocator.destroy());
+  {
+    Xml_t xml(&allocator);
+    M_test(xml.init(g_xml_str_, static_array_size(g_xml_str_) - 1));
+    M_test(xml.m_root->m_tag_name == "catalog");
+    M_test(xml.m_root->m_children.len() == 12);
+    M_test(xml.m_root->count_all_by_tag("book") == 12);
+    const Xml_node_t* book = xml.m_root->find_first_by_attr("id", "bk105");
+    M_test(book && book->m_children.len() == 6);
+    M_test(book->find_first_by_tag("title")->get_text() == "The Sundered Grail");
+    M_test(book->find_first_by_path("price")->get_text() == "5.95");
+    // The text is terminated in place so it can be passed to strtof().
+    M_test(!strcmp(book->find_first_by_path("genre")->get_text().m_p, "Fantasy"));
+    M_test(book->get_attribute("id").m_p[5] == 0);
+    M_test(!book->get_attribute("isbn").m_p);
+    M_test(!xml.m_root->get_text().m_p);
+    xml.destroy();
+  }
+  {
+    // The subtrees are big enough to be searched in the index and not walked.
+    const char c_part[] = "<b><c/><b><c/><d/></b><a><c/></a></b><c/><d><b><c/></b></d><b/>";
+    Dynamic_array_t<char> xml_str(&allocator);
+    M_scope_exit(xml_str.destroy());
+    xml_str.append_array("<a>", 3);
+    for (int i = 0; i < 4; ++i) {
+      xml_str.append_array("<d>", 3);
+      for (int j = 0; j < 4; ++j) {
+        xml_str.append_array(c_part, static_array_size(c_part) - 1);
+      }
+      xml_str.append_array("</d>", 4);
+    }
+    xml_str.append_array("</a>", 4);
+    Xml_t xml(&allocator);
+    bool is_parsed = xml.init(xml_str.m_p, xml_str.len());
+    M_test(is_parsed);
+    if (is_parsed) {
+      Xml_index_t index(&allocator);
+      index.init(xml.m_root);
+      // 4 * (1 + 4 * 12) nodes under the root.
+      M_test(!xml.m_root->m_parent && xml.m_root->m_pre_order == 0 && xml.m_root->m_subtree_end == 197);
+      M_test(index.count_all_by_tag(xml.m_root, "c") == 80);
+      M_test(is_index_same_(index, xml.m_root));
+      index.destroy();
+    }
+    xml.destroy();
+  }
+  {
+    // The strings point into the buffer, the entities are decoded the first time they are read.
+    char buffer[] = R"(<?xml version="1.0"?>
+<!DOCTYPE root>
+<root a = 'x &amp;&lt; y' b="&#65;&#x42;&#xe9;&bogus;&amp">
+  <!-- <fake> -->
+  <empty/>
+  <text>  1 &gt; 0 </text>
+  <cdata><![CDATA[<&amp;>]]></cdata>
+  <empty_attrs k=""  />
+</root>)";
+    Xml_t xml(&allocator);
+    M_test(xml.init_in_situ(buffer, static_array_size(buffer) - 1));
+    const Xml_node_t* root = xml.m_root;
+    M_test(root->m_tag_name.m_p > buffer && root->m_tag_name.m_p < buffer + static_array_size(buffer));
+    M_test(root->m_attributes.len() == 2 && root->m_attributes[0].raw_value == "x &amp;&lt; y");
+    M_test(root->get_attribute("a") == "x &< y");
+    // Reading it again doesn't decode it twice.
+    M_test(root->get_attribute("a") == "x &< y");
+    M_test(root->get_attribute("b") == "AB\xc3\xa9&bogus;&amp");
+    M_test(root->m_children.len() == 4);
+    M_test(root->m_children[0]->m_tag_name == "empty" && !root->m_children[0]->m_children.len());
+    M_test(root->m_children[1]->get_text() == "1 > 0 ");
+    M_test(root->m_children[2]->get_text() == "<&amp;>");
+    M_test(root->m_children[3]->get_attribute("k").m_p && root->m_children[3]->get_attribute("k").m_length == 0);
+    xml.destroy();
+  }
+  {
+    // Every byte value at every position gives the same masks with SIMD.
+    char bytes[64];
+    bool is_same = true;
+    for (int i = 0; i < 256 * 64; ++i) {
+      for (int j = 0; j < 64; ++j) {
+        bytes[j] = (char)(j == i % 64 ? i / 64 : rand());
+      }
+      Xml_scan_masks_t masks;
+      Xml_scan_masks_t expected;
+      xml_scan_64(bytes, &masks);
+      xml_scan_64_scalar(bytes, &expected);
+      is_same &= !memcmp(&masks, &expected, sizeof(masks));
+    }
+    M_test(is_same);
+  }
+  {
+    // The names, the values and the spaces cross the blocks of 64 bytes.
+    char buffer[] = "<root_with_a_name_that_is_longer_than_sixty_four_characters_for_the_scanner                                                           "
+                    "a=\"/a'long'value/with/slashes/and/quotes/that/crosses/the/end/of/the/block/of/the/scanner/\"\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n"
+                    "                                                                 b='\"'><c/>"
+                    "                                                                                                                      "
+                    "</root_with_a_name_that_is_longer_than_sixty_four_characters_for_the_scanner          >";
+    Xml_t xml(&allocator);
+    M_test(xml.init_in_situ(buffer, static_array_size(buffer) - 1));
+    M_test(xml.m_root->m_tag_name == "root_with_a_name_that_is_longer_than_sixty_four_characters_for_the_scanner");
+    M_test(xml.m_root->get_attribute("a") == "/a'long'value/with/slashes/and/quotes/that/crosses/the/end/of/the/block/of/the/scanner/");
+    M_test(xml.m_root->get_attribute("b") == "\"");
+    M_test(xml.m_root->m_children.len() == 1 && xml.m_root->m_children[0]->m_tag_name == "c");
+    xml.destroy();
+  }
+  {
+    const char* c_bad_xmls[] = {
+      "<a><b></a>",
+      "<a>",
+      "<a b=c/>",
+      "<a/><b/>",
+      "<a></a><b></b>",
+      "</a>",
+      "<a><!-- </a>",
+      "<a =\"b\"/>",
+      "<a b=\"c/>",
+    };
+    for (const char* bad_xml : c_bad_xmls) {
+      Xml_t xml(&allocator);
+      M_test(!xml.init(bad_xml, strlen(bad_xml)));
+      xml.destroy();
+    }
+  }
 }
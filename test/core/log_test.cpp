@@ -0,0 +1,45 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/log.h"
+
+#include "test/test.h"
+
+static int g_evaluated_count_ = 0;
+
+static int evaluate_() {
+  ++g_evaluated_count_;
+  return 0;
+}
+
+void log_test() {
+  E_log_level_ old_levels[e_log_category_count];
+  memcpy(old_levels, g_log_category_levels, sizeof(old_levels));
+
+  M_test(log_set_levels("warning,gpu=debug"));
+  M_test(g_log_category_levels[e_log_category_general] == e_log_level_warning);
+  M_test(g_log_category_levels[e_log_category_loader] == e_log_level_warning);
+  M_test(g_log_category_levels[e_log_category_gpu] == e_log_level_debug);
+  M_test(log_set_levels("loader=trace"));
+  M_test(g_log_category_levels[e_log_category_loader] == e_log_level_trace);
+  M_test(g_log_category_levels[e_log_category_gpu] == e_log_level_debug);
+  // Invalid levels don't change anything.
+  M_test(!log_set_levels("gpu=info,loader=loud"));
+  M_test(!log_set_levels("sound=info"));
+  M_test(!log_set_levels(""));
+  M_test(g_log_category_levels[e_log_category_gpu] == e_log_level_debug);
+
+  // The arguments of a disabled log are not evaluated.
+  M_logi("%d", evaluate_());
+  M_logcd(e_log_category_core, "%d", evaluate_());
+  M_test(g_evaluated_count_ == 0);
+  // Debug logs are compiled out below M_log_min_level so info is the lowest level that is enabled in every build.
+  M_logcw(e_log_category_core, "%d", evaluate_());
+  M_logci(e_log_category_gpu, "%d", evaluate_());
+  M_test(g_evaluated_count_ == 2);
+
+  memcpy(g_log_category_levels, old_levels, sizeof(old_levels));
+}
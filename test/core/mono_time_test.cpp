@@ -0,0 +1,33 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/mono_time.h"
+
+#include "core/thread.h"
+#include "test/test.h"
+
+void mono_time_test() {
+  {
+    S64 last = mono_time_now();
+    bool is_monotonic = true;
+    for (int i = 0; i < 1000; ++i) {
+      S64 now = mono_time_now();
+      is_monotonic &= now >= last;
+      last = now;
+    }
+    M_test(is_monotonic);
+  }
+  {
+    S64 start = mono_time_now();
+    Thread_t::sleep_ms(20);
+    F64 elapsed_ms = mono_time_to_ms(mono_time_now() - start);
+    // Sleeping can take longer on a busy machine.
+    M_test(elapsed_ms >= 19.0 && elapsed_ms < 1000.0);
+  }
+  M_test(mono_time_to_ms(mono_time_from_s(1.5)) > 1499.0 && mono_time_to_ms(mono_time_from_s(1.5)) < 1501.0);
+  M_test(mono_time_to_us(mono_time_from_ms(2.0)) > 1999.0 && mono_time_to_us(mono_time_from_ms(2.0)) < 2001.0);
+  M_test(mono_time_get_now_overhead_ns() > 0.0);
+}
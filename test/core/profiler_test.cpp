@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/profiler.h"
+
+#include "core/file.h"
+#include "core/linear_allocator.h"
+#include "core/path_utils.h"
+#include "core/thread.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+#include <atomic>
+
+static int count_(const Dynamic_array_t<U8>& text, const char* str) {
+  int count = 0;
+  Sip len = strlen(str);
+  for (Sip i = 0; i + len <= text.len(); ++i) {
+    if (memcmp(text.m_p + i, str, len) == 0) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+static void inner_() {
+  M_profile_zone("inner");
+}
+
+// Records zones until |should_exit| is set.
+static void record_zones_(void* args) {
+  std::atomic<bool>* should_exit = (std::atomic<bool>*)args;
+  while (!should_exit->load(std::memory_order_relaxed)) {
+    M_profile_zone("worker zone");
+    Thread_t::yield();
+  }
+}
+
+void profiler_test() {
+  Linear_allocator_t<> allocator("profiler_test_allocator");
+  M_scope_exit(allocator.destroy());
+  Path_t path = g_exe_dir.join(M_txt("profiler_test.json"));
+  {
+    M_profile_zone("not recorded");
+  }
+  profiler_start();
+  M_test(profiler_is_recording());
+  {
+    M_profile_zone("outer \"quoted\"");
+    for (int i = 0; i < 3; ++i) {
+      inner_();
+    }
+  }
+  M_test(profiler_stop(path.m_path));
+  M_test(!profiler_is_recording());
+  {
+    M_profile_zone("after stop");
+  }
+  Dynamic_array_t<U8> text = File_t::read_whole_file_as_text(&allocator, path.m_path);
+  M_test(count_(text, "{\"traceEvents\":[") == 1);
+  M_test(count_(text, "\"name\":\"inner\"") == 3);
+  M_test(count_(text, "\"name\":\"outer \\\"quoted\\\"\"") == 1);
+  M_test(count_(text, "\"ph\":\"X\"") == 4);
+  M_test(count_(text, "not recorded") == 0);
+  M_test(count_(text, "after stop") == 0);
+  M_test(count_(text, "\"thread_name\",\"args\":{\"name\":\"main\"}") == 1);
+  File_t::delete_path(path.m_path);
+
+  {
+    // Another thread keeps recording while the profiler stops, the zones that are written are complete.
+    std::atomic<bool> should_exit{false};
+    Thread_t thread;
+    M_test(thread.init(record_zones_, &should_exit));
+    for (int i = 0; i < 3; ++i) {
+      profiler_start();
+      Thread_t::sleep_ms(5);
+      M_test(profiler_stop(path.m_path));
+      Dynamic_array_t<U8> trace = File_t::read_whole_file_as_text(&allocator, path.m_path);
+      M_test(count_(trace, "\"name\":\"worker zone\"}") > 0);
+      M_test(count_(trace, "\n]}\n") == 1);
+    }
+    should_exit.store(true, std::memory_order_relaxed);
+    thread.wait_for();
+    File_t::delete_path(path.m_path);
+  }
+}
@@ -0,0 +1,75 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sampling_profiler.h"
+
+#include "core/file.h"
+#include "core/linear_allocator.h"
+#include "core/mono_time.h"
+#include "core/os.h"
+#include "core/path_utils.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if M_os_is_linux()
+// Not static so it has a symbol even in stripped builds.
+__attribute__((noinline)) F64 sampling_profiler_test_spin_(S64 duration) {
+  volatile F64 sum = 0;
+  S64 end = mono_time_now() + duration;
+  while (mono_time_now() < end) {
+    for (int i = 0; i < 1000; ++i) {
+      sum = sum + i;
+    }
+  }
+  return sum;
+}
+#endif
+
+void sampling_profiler_test() {
+#if M_os_is_linux()
+  Linear_allocator_t<> allocator("sampling_profiler_test_allocator");
+  M_scope_exit(allocator.destroy());
+  Path_t path = g_exe_dir.join(M_txt("sampling_profiler_test.folded"));
+  M_test(sampling_profiler_start(1000));
+  M_test(sampling_profiler_is_running());
+  M_test(!sampling_profiler_start(1000));
+  // ITIMER_PROF only counts CPU time so the thread must be busy.
+  sampling_profiler_test_spin_(mono_time_from_ms(300));
+  M_test(sampling_profiler_stop(path.m_path));
+  M_test(!sampling_profiler_is_running());
+  Dynamic_array_t<U8> text = File_t::read_whole_file_as_text(&allocator, path.m_path);
+  M_test(text.len() > 0);
+  // Each line is "frame;frame;...;frame count", the leaf is last.
+  int sample_count = 0;
+  bool has_spin = false;
+  char* line = (char*)text.m_p;
+  while (*line) {
+    char* end = strchr(line, '\n');
+    M_test(end);
+    *end = '\0';
+    char* space = strrchr(line, ' ');
+    M_test(space);
+    int count = atoi(space + 1);
+    M_test(count > 0);
+    sample_count += count;
+    *space = '\0';
+    if (strstr(line, "sampling_profiler_test_spin_") && strstr(line, "sampling_profiler_test")) {
+      has_spin = true;
+    }
+    line = end + 1;
+  }
+  // The kernel tick can be as slow as 100 Hz.
+  M_test(sample_count >= 10);
+  M_test(has_spin);
+  // The interval of 1 Hz is a second, it doesn't fit in tv_usec.
+  M_test(sampling_profiler_start(1));
+  M_test(sampling_profiler_stop(path.m_path));
+  File_t::delete_path(path.m_path);
+#endif
+}
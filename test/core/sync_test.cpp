@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/sync.h"
+
+#include "core/thread.h"
+#include "test/test.h"
+
+#define M_sync_test_thread_count_ 4
+#define M_sync_test_iteration_count_ 20000
+
+struct Sync_test_t_ {
+  Mutex_t mutex;
+  int count = 0;
+  Semaphore_t semaphore;
+  Semaphore_t done;
+  Event_t start_event{true};
+  Atomic_counter_t<S64> started_count;
+};
+
+static void lock_and_increment_(void* args) {
+  Sync_test_t_* t = (Sync_test_t_*)args;
+  t->start_event.wait();
+  t->started_count.increment();
+  for (int i = 0; i < M_sync_test_iteration_count_; ++i) {
+    Scope_lock_t lock(&t->mutex);
+    ++t->count;
+  }
+  // Wait for a token from the main thread, then tell it we are done.
+  t->semaphore.acquire();
+  t->done.release();
+}
+
+void sync_test() {
+  {
+    Mutex_t mutex;
+    M_test(mutex.try_lock());
+    M_test(!mutex.try_lock());
+    mutex.unlock();
+    M_test(mutex.m_state == Mutex_t::e_state_unlocked);
+  }
+  {
+    Semaphore_t semaphore(2);
+    M_test(semaphore.try_acquire());
+    M_test(semaphore.try_acquire());
+    M_test(!semaphore.try_acquire());
+    semaphore.release();
+    semaphore.acquire();
+    M_test(semaphore.m_count == 0);
+  }
+  {
+    Event_t auto_event;
+    M_test(!auto_event.wait_for(1));
+    auto_event.set();
+    M_test(auto_event.wait_for(0));
+    // Auto-reset.
+    M_test(!auto_event.wait_for(0));
+    Event_t manual_event(true, true);
+    M_test(manual_event.wait_for(0));
+    M_test(manual_event.wait_for(0));
+    manual_event.reset();
+    M_test(!manual_event.wait_for(0));
+  }
+  {
+    Sync_test_t_ t;
+    Thread_t threads[M_sync_test_thread_count_];
+    for (int i = 0; i < M_sync_test_thread_count_; ++i) {
+      threads[i].init(lock_and_increment_, &t);
+    }
+    t.start_event.set();
+    t.semaphore.release(M_sync_test_thread_count_);
+    for (int i = 0; i < M_sync_test_thread_count_; ++i) {
+      t.done.acquire();
+    }
+    for (int i = 0; i < M_sync_test_thread_count_; ++i) {
+      threads[i].wait_for();
+    }
+    M_test(t.started_count.get() == M_sync_test_thread_count_);
+    M_test(t.count == M_sync_test_thread_count_ * M_sync_test_iteration_count_);
+  }
+}
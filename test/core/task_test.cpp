@@ -0,0 +1,118 @@
+//----------------------------------------------------------------------------//
+// This file is distributed under the MIT License.                            //
+// See LICENSE.txt for details.                                               //
+// Copyright (C) Tran Tuan Nghia <trantuannghia95@gmail.com> 2022             //
+//----------------------------------------------------------------------------//
+
+#include "core/task.h"
+
+#include "core/file.h"
+#include "core/linear_allocator.h"
+#include "core/path_utils.h"
+#include "core/utils.h"
+#include "test/test.h"
+
+#include <string.h>
+
+static Task_t<int> square_(Allocator_t* allocator, int v) {
+  // |allocator| is only for the frame.
+  M_unused(allocator);
+  co_return v * v;
+}
+
+static Task_t<int> sum_of_squares_(Allocator_t* allocator, int count) {
+  int sum = 0;
+  for (int i = 0; i < count; ++i) {
+    sum += co_await square_(allocator, i);
+  }
+  co_return sum;
+}
+
+static void increment_(void* args) {
+  ((std::atomic<int>*)args)->fetch_add(1, std::memory_order_relaxed);
+}
+
+static Task_t<> run_jobs_(Allocator_t* allocator, std::atomic<int>* count) {
+  M_unused(allocator);
+  Job_counter_t counter;
+  Job_decl_t jobs[64];
+  for (int i = 0; i < 64; ++i) {
+    jobs[i] = {increment_, count};
+  }
+  job_run(jobs, 64, &counter);
+  co_await task_wait_for(&counter);
+}
+
+static Task_t<> increment_on_worker_(Allocator_t* allocator, std::atomic<int>* count) {
+  M_unused(allocator);
+  co_await task_switch_to_worker();
+  count->fetch_add(1, std::memory_order_relaxed);
+}
+
+static Task_t<> when_all_(Allocator_t* allocator, std::atomic<int>* count, int* count_after_when_all) {
+  Task_t<> tasks[16];
+  for (int i = 0; i < 16; ++i) {
+    tasks[i] = increment_on_worker_(allocator, count);
+  }
+  co_await task_when_all(tasks, 16);
+  *count_after_when_all = count->load(std::memory_order_relaxed);
+}
+
+static void set_flag_(void* args) {
+  ((std::atomic<bool>*)args)->store(true, std::memory_order_release);
+}
+
+static Task_t<> wait_for_flag_(Allocator_t* allocator, std::atomic<bool>* flag) {
+  M_unused(allocator);
+  Job_decl_t job = {set_flag_, flag};
+  job_run(&job, 1, NULL);
+  co_await task_poll([flag]() { return flag->load(std::memory_order_acquire); });
+}
+
+static Task_t<Sip> read_file_(Allocator_t* allocator, const Os_char* path) {
+  Dynamic_array_t<U8> data = co_await task_read_whole_file(allocator, path);
+  co_return data.len() == 5 && memcmp(data.m_p, "hello", 5) == 0 ? data.len() : -1;
+}
+
+void task_test() {
+  Linear_allocator_t<> allocator("task_test_allocator");
+  M_scope_exit(allocator.destroy());
+  {
+    Task_t<int> task = sum_of_squares_(&allocator, 10);
+    M_test(!task.is_done());
+    task_wait(task);
+    M_test(task.is_done());
+    M_test(task.get_value() == 285);
+  }
+  {
+    std::atomic<int> count{0};
+    Task_t<> task = run_jobs_(&allocator, &count);
+    task_wait(task);
+    M_test(count == 64);
+  }
+  {
+    std::atomic<int> count{0};
+    int count_after_when_all = 0;
+    Task_t<> task = when_all_(&allocator, &count, &count_after_when_all);
+    task_wait(task);
+    M_test(count_after_when_all == 16);
+  }
+  {
+    std::atomic<bool> flag{false};
+    Task_t<> task = wait_for_flag_(&allocator, &flag);
+    task_wait(task);
+    M_test(flag);
+  }
+  {
+    Path_t path = g_exe_dir.join(M_txt("task_test.txt"));
+    File_t f;
+    M_test(f.open(path.m_path, e_file_mode_write));
+    Sip written;
+    f.write(&written, "hello", 5);
+    f.close();
+    Task_t<Sip> task = read_file_(&allocator, path.m_path);
+    task_wait(task);
+    M_test(task.get_value() == 5);
+    File_t::delete_path(path.m_path);
+  }
+}
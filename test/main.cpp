@@ -20,15 +20,31 @@ int main(int argc, char** argv) {
   cl.parse(argc, argv);
 
   Hash_map_t<const char*, void (*)()> tests(g_persistent_allocator);
+  M_register_test(binary_log_test);
   M_register_test(bit_stream_test);
   M_register_test(command_line_test);
+  M_register_test(frame_stats_test);
+  M_register_test(free_list_allocator_test);
   M_register_test(linear_allocator_test);
-  // M_register_test(loader_xml_test);
+  M_register_test(log_test);
+  M_register_test(loader_bc_test);
+  M_register_test(loader_dds_test);
+  M_register_test(loader_mipmap_test);
+  M_register_test(loader_xml_reader_test);
+  M_register_test(loader_xml_test);
+  M_register_test(loader_png_test);
+  M_register_test(loader_png_unfilter_test);
+  M_register_test(mono_time_test);
   M_register_test(hash_map_test);
   M_register_test(intrusive_list_test);
+  M_register_test(job_test);
   // M_register_test(path_test);
+  M_register_test(profiler_test);
+  M_register_test(sampling_profiler_test);
   M_register_test(string_test);
   M_register_test(string_utils_test);
+  M_register_test(sync_test);
+  M_register_test(task_test);
   M_register_test(utils_test);
   for (auto& test : tests) {
     M_logi("Running test %s", test.key);